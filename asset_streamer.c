@@ -0,0 +1,434 @@
+#include "asset_streamer.h"
+#include "mesh_cache.h"
+#include "texture_cache.h"
+#include "bmp_decode.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static void load_mesh(StreamedMesh* entry){
+    MeshLoadInfo info;
+    entry->mesh = LoadMeshCached(entry->path, entry->position, entry->lods, &entry->lod_count, &info);
+    entry->load_seconds = info.seconds;
+    entry->cache_hit = info.cache_hit;
+}
+
+// General path for BMP layouts ParseBmpHeader does not take (palettes,
+// RLE, 16-bit). Decodes twice on a cache miss, once per call.
+static bool decode_bmp_sdl(const void* data, size_t size, uint8_t* rgba, uint32_t pitch, uint32_t* width, uint32_t* height){
+    SDL_Surface* surface = SDL_LoadBMP_IO(SDL_IOFromConstMem(data, size), true);
+    if (!surface) {
+        printf("[ERROR]: Could not load bmp: %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_Surface* converted = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+    SDL_DestroySurface(surface);
+    if (!converted) {
+        printf("[ERROR]: Could not convert surface: %s\n", SDL_GetError());
+        return false;
+    }
+    *width = (uint32_t)converted->w;
+    *height = (uint32_t)converted->h;
+    for (int y = 0; rgba && y < converted->h; y++) {
+        memcpy(rgba + (size_t)pitch * y, (const uint8_t*)converted->pixels + (size_t)converted->pitch * y, (size_t)converted->w * 4);
+    }
+    SDL_DestroySurface(converted);
+    return true;
+}
+
+// Decode callback for the texture cache, only called on a cache miss.
+// Uncompressed BMPs are swizzled straight from the file mapping into the mip
+// chain, without intermediate surfaces.
+static bool decode_bmp(const void* data, size_t size, uint8_t* rgba, uint32_t pitch, uint32_t* width, uint32_t* height){
+    BmpInfo info;
+    if (!ParseBmpHeader(data, size, &info)) {
+        return decode_bmp_sdl(data, size, rgba, pitch, width, height);
+    }
+    *width = info.width;
+    *height = info.height;
+    if (rgba) DecodeBmp(data, &info, rgba, pitch);
+    return true;
+}
+
+static void load_texture(StreamedTexture* entry){
+    TextureLoadInfo info;
+    LoadTextureCached(entry->path, decode_bmp, &entry->mips, &info);
+    entry->load_seconds = info.seconds;
+    entry->cache_hit = info.cache_hit;
+}
+
+// A load job owns its entry from taking it out of QUEUED until it publishes
+// the result, both under the mutex.
+static bool begin_load(AssetStreamer* streamer, StreamState* state){
+    SDL_LockMutex(streamer->mutex);
+    bool run = !streamer->quit;
+    *state = run ? STREAM_LOADING : STREAM_FAILED;
+    SDL_UnlockMutex(streamer->mutex);
+    return run;
+}
+
+static void load_mesh_job(void* data){
+    StreamedMesh* entry = data;
+    AssetStreamer* streamer = entry->owner;
+    if (!begin_load(streamer, &entry->state)) return;
+    load_mesh(entry);
+    SDL_LockMutex(streamer->mutex);
+    entry->state = entry->mesh.vertices ? STREAM_LOADED : STREAM_FAILED;
+    SDL_UnlockMutex(streamer->mutex);
+}
+
+static void load_texture_job(void* data){
+    StreamedTexture* entry = data;
+    AssetStreamer* streamer = entry->owner;
+    if (!begin_load(streamer, &entry->state)) return;
+    load_texture(entry);
+    SDL_LockMutex(streamer->mutex);
+    entry->state = entry->mips.pixels ? STREAM_LOADED : STREAM_FAILED;
+    SDL_UnlockMutex(streamer->mutex);
+}
+
+bool InitAssetStreamer(AssetStreamer* streamer, SDL_GPUDevice* device, JobSystem* jobs, GeometryPool* pool, StagingUploader* uploader, Uint32 uploadBudget, Uint64 gpuBudget){
+    *streamer = (AssetStreamer){0};
+    streamer->device = device;
+    streamer->jobs = jobs;
+    streamer->pool = pool;
+    streamer->uploader = uploader;
+    streamer->upload_budget = uploadBudget;
+
+    Uint64 poolBytes = (Uint64)pool->vertices.capacity * pool->vertex_stride + (Uint64)pool->indices.capacity * GEOMETRY_INDEX_UNIT;
+    streamer->gpu_budget = gpuBudget && gpuBudget < poolBytes ? gpuBudget : poolBytes;
+
+    SDL_GPUTextureCreateInfo placeholderInfo = {
+        .type = SDL_GPU_TEXTURETYPE_2D,
+        .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
+        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+        .width = 1,
+        .height = 1,
+        .layer_count_or_depth = 1,
+        .num_levels = 1,
+        .sample_count = SDL_GPU_SAMPLECOUNT_1
+    };
+    streamer->placeholder_texture = SDL_CreateGPUTexture(device, &placeholderInfo);
+    if (!streamer->placeholder_texture) {
+        printf("[ERROR]: could not create placeholder texture, %s\n", SDL_GetError());
+        return false;
+    }
+    const Uint8 white[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+    SDL_GPUTextureRegion placeholderRegion = { .texture = streamer->placeholder_texture, .w = 1, .h = 1, .d = 1 };
+    StageTextureData(uploader, &placeholderRegion, white, sizeof(white));
+
+    streamer->mutex = SDL_CreateMutex();
+    if (!streamer->mutex) {
+        printf("[ERROR]: could not create streamer lock, %s\n", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+void DestroyAssetStreamer(AssetStreamer* streamer){
+    if (streamer->mutex) {
+        SDL_LockMutex(streamer->mutex);
+        streamer->quit = true;
+        SDL_UnlockMutex(streamer->mutex);
+        WaitForCounter(streamer->jobs, &streamer->loads);
+    }
+
+    for (int i = 0; i < streamer->mesh_count; i++) {
+        StreamedMesh* entry = &streamer->meshes[i];
+        for (int l = 0; l < entry->lod_count; l++) {
+            FreeMeshFromPool(streamer->pool, &entry->allocations[l]);
+        }
+        if (entry->mesh.vertices) {
+            FreeMeshLods(entry->lods, entry->lod_count);
+            FreeMesh(&entry->mesh);
+        }
+    }
+    for (int i = 0; i < streamer->texture_count; i++) {
+        StreamedTexture* entry = &streamer->textures[i];
+        FreeTextureMips(&entry->mips);
+        if (entry->texture) SDL_ReleaseGPUTexture(streamer->device, entry->texture);
+    }
+    if (streamer->placeholder_texture) SDL_ReleaseGPUTexture(streamer->device, streamer->placeholder_texture);
+    if (streamer->mutex) SDL_DestroyMutex(streamer->mutex);
+    *streamer = (AssetStreamer){0};
+}
+
+int RequestStreamedMesh(AssetStreamer* streamer, const char* objPath, Vec3 pos){
+    SDL_LockMutex(streamer->mutex);
+    int handle = -1;
+    if (streamer->mesh_count < STREAM_MAX_MESHES) {
+        handle = streamer->mesh_count++;
+        StreamedMesh* entry = &streamer->meshes[handle];
+        *entry = (StreamedMesh){ .owner = streamer, .position = pos, .state = STREAM_QUEUED };
+        snprintf(entry->path, sizeof(entry->path), "%s", objPath);
+    }
+    SDL_UnlockMutex(streamer->mutex);
+    if (handle >= 0) RunBackgroundJob(streamer->jobs, load_mesh_job, &streamer->meshes[handle], &streamer->loads);
+    return handle;
+}
+
+int RequestStreamedTexture(AssetStreamer* streamer, const char* bmpPath){
+    SDL_LockMutex(streamer->mutex);
+    int handle = -1;
+    if (streamer->texture_count < STREAM_MAX_TEXTURES) {
+        handle = streamer->texture_count++;
+        StreamedTexture* entry = &streamer->textures[handle];
+        *entry = (StreamedTexture){ .owner = streamer, .state = STREAM_QUEUED };
+        snprintf(entry->path, sizeof(entry->path), "%s", bmpPath);
+    }
+    SDL_UnlockMutex(streamer->mutex);
+    if (handle >= 0) RunBackgroundJob(streamer->jobs, load_texture_job, &streamer->textures[handle], &streamer->loads);
+    return handle;
+}
+
+// Load jobs read and write states under the mutex, so the main thread
+// publishes its own transitions under it as well.
+static void publish_state(AssetStreamer* streamer, StreamState* state, StreamState value){
+    SDL_LockMutex(streamer->mutex);
+    *state = value;
+    SDL_UnlockMutex(streamer->mutex);
+}
+
+static void evict_mesh(AssetStreamer* streamer, StreamedMesh* entry){
+    for (int l = 0; l < entry->lod_count; l++) {
+        FreeMeshFromPool(streamer->pool, &entry->allocations[l]);
+    }
+    streamer->resident_bytes -= entry->gpu_bytes;
+    entry->gpu_bytes = 0;
+    publish_state(streamer, &entry->state, STREAM_LOADED);
+    entry->evicted = true;
+    streamer->stats.evictions++;
+}
+
+// Evicts the resident mesh that has gone unused the longest, if any has been
+// idle for STREAM_EVICT_FRAMES.
+static bool evictable(const AssetStreamer* streamer, const StreamedMesh* entry){
+    return entry->state == STREAM_RESIDENT && entry->last_used_frame + STREAM_EVICT_FRAMES < streamer->frame;
+}
+
+static bool evict_least_recently_used(AssetStreamer* streamer){
+    StreamedMesh* victim = NULL;
+    for (int i = 0; i < streamer->mesh_count; i++) {
+        StreamedMesh* entry = &streamer->meshes[i];
+        if (!evictable(streamer, entry)) continue;
+        if (!victim || entry->last_used_frame < victim->last_used_frame) victim = entry;
+    }
+    if (!victim) return false;
+    evict_mesh(streamer, victim);
+    return true;
+}
+
+static bool lods_fit_pool(const AssetStreamer* streamer, const StreamedMesh* entry){
+    for (int l = 0; l < entry->lod_count; l++) {
+        if (!GeometryPoolHasRoom(streamer->pool, &entry->lods[l].mesh)) return false;
+    }
+    return true;
+}
+
+// Whether the mesh would fit once the streamed meshes are evicted, only the
+// idle ones with idleOnly. Whatever else the pool holds stays, and the freed
+// ranges need not be adjacent, so true does not promise the upload succeeds.
+static bool fits_after_eviction(const AssetStreamer* streamer, const StreamedMesh* entry, Uint32 bytes, bool idleOnly){
+    const GeometryPool* pool = streamer->pool;
+    Uint64 residentBytes = streamer->resident_bytes + bytes;
+    Uint64 vertices = pool->vertices.used, indexUnits = pool->indices.used;
+    for (int i = 0; i < streamer->mesh_count; i++) {
+        const StreamedMesh* other = &streamer->meshes[i];
+        if (other->state != STREAM_RESIDENT || (idleOnly && !evictable(streamer, other))) continue;
+        residentBytes -= other->gpu_bytes;
+        for (int l = 0; l < other->lod_count; l++) {
+            vertices -= other->allocations[l].vertex_count;
+            indexUnits -= other->allocations[l].index_units;
+        }
+    }
+    for (int l = 0; l < entry->lod_count; l++) {
+        vertices += (Uint32)entry->lods[l].mesh.vertex_count;
+        indexUnits += GeometryPoolIndexUnits(&entry->lods[l].mesh);
+    }
+    return residentBytes <= streamer->gpu_budget && vertices <= pool->vertices.capacity && indexUnits <= pool->indices.capacity;
+}
+
+static bool upload_mesh(AssetStreamer* streamer, StreamedMesh* entry, Uint32 bytes){
+    if (!fits_after_eviction(streamer, entry, bytes, false)) {
+        printf("[ERROR]: %s does not fit the geometry pool or GPU budget even with nothing else resident\n", entry->path);
+        publish_state(streamer, &entry->state, STREAM_FAILED);
+        return false;
+    }
+    // evicting only makes sense once enough meshes have gone idle
+    if (!fits_after_eviction(streamer, entry, bytes, true)) return false;
+    while (streamer->resident_bytes + bytes > streamer->gpu_budget || !lods_fit_pool(streamer, entry)) {
+        if (!evict_least_recently_used(streamer)) return false;
+    }
+    for (int l = 0; l < entry->lod_count; l++) {
+        if (!UploadMeshToPool(streamer->pool, streamer->uploader, &entry->lods[l].mesh, &entry->allocations[l])) {
+            while (l-- > 0) FreeMeshFromPool(streamer->pool, &entry->allocations[l]);
+            return false;
+        }
+    }
+    if (!entry->evicted) {
+        printf("%-12s streamed in, %s %8.3f ms, lod triangles:", entry->path,
+               entry->cache_hit ? "warm (cache)" : "cold (parsed)", entry->load_seconds * 1000.0);
+        for (int l = 0; l < entry->lod_count; l++) {
+            printf(" %d", entry->lods[l].mesh.index_count / 3);
+        }
+        printf("\n");
+    }
+    publish_state(streamer, &entry->state, STREAM_RESIDENT);
+    entry->evicted = false;
+    entry->gpu_bytes = bytes;
+    entry->last_used_frame = streamer->frame;
+    streamer->resident_bytes += bytes;
+    return true;
+}
+
+static bool upload_texture(AssetStreamer* streamer, StreamedTexture* entry){
+    const TextureMips* mips = &entry->mips;
+    SDL_GPUTextureCreateInfo info = {
+        .type = SDL_GPU_TEXTURETYPE_2D,
+        .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
+        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+        .width = mips->width,
+        .height = mips->height,
+        .layer_count_or_depth = 1,
+        .num_levels = (Uint32)mips->level_count,
+        .sample_count = SDL_GPU_SAMPLECOUNT_1
+    };
+    entry->texture = SDL_CreateGPUTexture(streamer->device, &info);
+    if (!entry->texture) {
+        printf("[ERROR]: could not create texture for %s, %s\n", entry->path, SDL_GetError());
+        publish_state(streamer, &entry->state, STREAM_FAILED);
+        return false;
+    }
+    for (int l = 0; l < mips->level_count; l++) {
+        Uint32 w = TextureMipSize(mips->width, l), h = TextureMipSize(mips->height, l);
+        SDL_GPUTextureRegion region = { .texture = entry->texture, .mip_level = (Uint32)l, .w = w, .h = h, .d = 1 };
+        if (!StageTextureData(streamer->uploader, &region, mips->pixels + mips->level_offset[l], w * h * 4)) {
+            // a retry would create the texture again, so give up on it; the
+            // release waits for the levels already staged
+            printf("[ERROR]: could not stage mip level %d of %s\n", l, entry->path);
+            SDL_ReleaseGPUTexture(streamer->device, entry->texture);
+            entry->texture = NULL;
+            FreeTextureMips(&entry->mips);
+            publish_state(streamer, &entry->state, STREAM_FAILED);
+            return false;
+        }
+    }
+    printf("%-12s streamed in, %s %8.3f ms, %ux%u, %d mip levels\n", entry->path,
+           entry->cache_hit ? "warm (cache)" : "cold (built)", entry->load_seconds * 1000.0, mips->width, mips->height, mips->level_count);
+    FreeTextureMips(&entry->mips);
+    publish_state(streamer, &entry->state, STREAM_RESIDENT);
+    return true;
+}
+
+void UpdateAssetStreamer(AssetStreamer* streamer){
+    streamer->frame++;
+
+    // snapshot which entries the load jobs have finished; everything
+    // past LOADED is owned by this thread
+    bool meshReady[STREAM_MAX_MESHES];
+    bool textureReady[STREAM_MAX_TEXTURES];
+    SDL_LockMutex(streamer->mutex);
+    for (int i = 0; i < streamer->mesh_count; i++) {
+        meshReady[i] = streamer->meshes[i].state == STREAM_LOADED;
+    }
+    for (int i = 0; i < streamer->texture_count; i++) {
+        textureReady[i] = streamer->textures[i].state == STREAM_LOADED;
+    }
+    SDL_UnlockMutex(streamer->mutex);
+
+    // the first upload of a frame may exceed the budget, so an asset larger
+    // than the budget still gets in
+    Uint32 spent = 0;
+    bool waiting = false;
+    for (int i = 0; i < streamer->texture_count && !waiting; i++) {
+        StreamedTexture* entry = &streamer->textures[i];
+        if (!textureReady[i]) continue;
+        Uint32 bytes = (Uint32)entry->mips.size;
+        if (spent && spent + bytes > streamer->upload_budget) {
+            waiting = true;
+            break;
+        }
+        if (upload_texture(streamer, entry)) {
+            spent += bytes;
+            streamer->stats.uploads++;
+        }
+    }
+
+    for (int i = 0; i < streamer->mesh_count && !waiting; i++) {
+        StreamedMesh* entry = &streamer->meshes[i];
+        // evicted meshes only come back once something wants them
+        if (!meshReady[i] || (entry->evicted && entry->last_used_frame + 1 < streamer->frame)) continue;
+
+        Uint32 bytes = 0;
+        for (int l = 0; l < entry->lod_count; l++) {
+            bytes += GeometryPoolMeshBytes(streamer->pool, &entry->lods[l].mesh);
+        }
+        if (spent && spent + bytes > streamer->upload_budget) {
+            waiting = true;
+            break;
+        }
+        if (upload_mesh(streamer, entry, bytes)) {
+            spent += bytes;
+            streamer->stats.uploads++;
+        }
+    }
+
+    if (waiting) streamer->stats.budget_stalls++;
+    if (spent) {
+        streamer->stats.uploaded_bytes += spent;
+        FlushStagingUploads(streamer->uploader);
+    }
+}
+
+void TouchStreamedMesh(AssetStreamer* streamer, int handle){
+    streamer->meshes[handle].last_used_frame = streamer->frame;
+}
+
+static StreamState mesh_state(AssetStreamer* streamer, int handle){
+    SDL_LockMutex(streamer->mutex);
+    StreamState state = streamer->meshes[handle].state;
+    SDL_UnlockMutex(streamer->mutex);
+    return state;
+}
+
+const StreamedMesh* GetLoadedMesh(AssetStreamer* streamer, int handle){
+    StreamState state = mesh_state(streamer, handle);
+    return state == STREAM_LOADED || state == STREAM_RESIDENT ? &streamer->meshes[handle] : NULL;
+}
+
+const StreamedMesh* GetResidentMesh(AssetStreamer* streamer, int handle){
+    return mesh_state(streamer, handle) == STREAM_RESIDENT ? &streamer->meshes[handle] : NULL;
+}
+
+SDL_GPUTexture* GetStreamedTexture(AssetStreamer* streamer, int handle){
+    SDL_LockMutex(streamer->mutex);
+    StreamedTexture* entry = &streamer->textures[handle];
+    SDL_GPUTexture* texture = entry->state == STREAM_RESIDENT ? entry->texture : streamer->placeholder_texture;
+    SDL_UnlockMutex(streamer->mutex);
+    return texture;
+}
+
+bool AssetStreamerSettled(AssetStreamer* streamer){
+    bool settled = true;
+    SDL_LockMutex(streamer->mutex);
+    for (int i = 0; i < streamer->mesh_count && settled; i++) {
+        StreamState state = streamer->meshes[i].state;
+        settled = state == STREAM_RESIDENT || state == STREAM_FAILED || (state == STREAM_LOADED && streamer->meshes[i].evicted);
+    }
+    for (int i = 0; i < streamer->texture_count && settled; i++) {
+        StreamState state = streamer->textures[i].state;
+        settled = state == STREAM_RESIDENT || state == STREAM_FAILED;
+    }
+    SDL_UnlockMutex(streamer->mutex);
+    return settled;
+}
+
+void PrintAssetStreamerStats(const AssetStreamer* streamer){
+    int resident = 0;
+    for (int i = 0; i < streamer->mesh_count; i++) {
+        if (streamer->meshes[i].state == STREAM_RESIDENT) resident++;
+    }
+    printf("Streaming: %d/%d meshes resident, %.1f/%.1f MB, %u uploads (%.1f MB), %u evictions, %u budget-limited frames\n",
+        resident, streamer->mesh_count, streamer->resident_bytes / (1024.0 * 1024.0), streamer->gpu_budget / (1024.0 * 1024.0),
+        streamer->stats.uploads, streamer->stats.uploaded_bytes / (1024.0 * 1024.0), streamer->stats.evictions, streamer->stats.budget_stalls);
+}
@@ -0,0 +1,132 @@
+#ifndef ASSET_STREAMER_H
+#define ASSET_STREAMER_H
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_gpu.h>
+
+#include "mesh.h"
+#include "mesh_simplify.h"
+#include "geometry_pool.h"
+#include "staging_uploader.h"
+#include "job_system.h"
+#include "texture_mips.h"
+
+#define STREAM_MAX_MESHES 64
+#define STREAM_MAX_TEXTURES 16
+
+// Frames a mesh must go unused before its pool ranges may be freed, so no
+// frame still in flight draws from memory that is being overwritten.
+#define STREAM_EVICT_FRAMES 3
+
+typedef enum StreamState{
+    STREAM_QUEUED,    // waiting for a job worker
+    STREAM_LOADING,   // being parsed/decoded on a job worker
+    STREAM_LOADED,    // CPU data ready, waiting for upload budget
+    STREAM_RESIDENT,  // on the GPU and drawable
+    STREAM_FAILED
+} StreamState;
+
+struct AssetStreamer;
+
+// A mesh and its LOD chain. CPU data stays around after eviction (it is the
+// mapped mesh cache in the common case), so it streams back in without
+// another parse when it becomes visible again.
+typedef struct StreamedMesh{
+    struct AssetStreamer* owner;
+    char path[256];
+    Vec3 position;
+    StreamState state;
+    bool evicted;
+    Mesh mesh;
+    MeshLod lods[MESH_LOD_COUNT];
+    int lod_count;
+    GeometryAllocation allocations[MESH_LOD_COUNT];
+    Uint32 gpu_bytes;
+    Uint64 last_used_frame;
+    double load_seconds;
+    bool cache_hit;
+} StreamedMesh;
+
+typedef struct StreamedTexture{
+    struct AssetStreamer* owner;
+    char path[256];
+    StreamState state;
+    TextureMips mips;
+    SDL_GPUTexture* texture;
+    double load_seconds;
+    bool cache_hit;
+} StreamedTexture;
+
+typedef struct StreamerStats{
+    Uint64 uploaded_bytes;
+    Uint32 uploads;
+    Uint32 evictions;
+    Uint32 budget_stalls; // frames where a ready asset had to wait for the next one
+} StreamerStats;
+
+// Every asset is parsed or decoded by its own background job, so they load
+// in parallel on the job workers while frames keep coming. The main thread moves
+// finished assets to the GPU in UpdateAssetStreamer, at most upload_budget
+// bytes per frame, and evicts the least recently used meshes when the
+// resident geometry would exceed gpu_budget.
+typedef struct AssetStreamer{
+    SDL_GPUDevice* device;
+    GeometryPool* pool;
+    StagingUploader* uploader;
+    Uint32 upload_budget;
+    Uint64 gpu_budget;
+    Uint64 resident_bytes;
+    Uint64 frame;
+
+    StreamedMesh meshes[STREAM_MAX_MESHES];
+    int mesh_count;
+    StreamedTexture textures[STREAM_MAX_TEXTURES];
+    int texture_count;
+    SDL_GPUTexture* placeholder_texture;
+
+    JobSystem* jobs;
+    JobCounter loads;
+    SDL_Mutex* mutex;
+    bool quit;
+
+    StreamerStats stats;
+} AssetStreamer;
+
+// gpuBudget is in bytes of pool memory, 0 means the whole pool.
+bool InitAssetStreamer(AssetStreamer* streamer, SDL_GPUDevice* device, JobSystem* jobs, GeometryPool* pool, StagingUploader* uploader, Uint32 uploadBudget, Uint64 gpuBudget);
+
+// Cancels loads that have not started, waits for running ones and releases
+// everything the streamer owns, including pool ranges, so the GPU has to be
+// idle.
+void DestroyAssetStreamer(AssetStreamer* streamer);
+
+// Queue an asset for loading and return its handle, or -1 when full.
+int RequestStreamedMesh(AssetStreamer* streamer, const char* objPath, Vec3 pos);
+int RequestStreamedTexture(AssetStreamer* streamer, const char* bmpPath);
+
+// Once per frame, before recording draws: uploads what finished loading
+// within the byte budget, evicting idle meshes to make room, and flushes the
+// staged copies.
+void UpdateAssetStreamer(AssetStreamer* streamer);
+
+// Marks a mesh as wanted this frame. Resident meshes are kept, evicted ones
+// are queued to come back.
+void TouchStreamedMesh(AssetStreamer* streamer, int handle);
+
+// The mesh with its CPU data ready (bounds, LODs), or NULL while loading.
+const StreamedMesh* GetLoadedMesh(AssetStreamer* streamer, int handle);
+
+// The mesh if it can be drawn this frame, NULL otherwise.
+const StreamedMesh* GetResidentMesh(AssetStreamer* streamer, int handle);
+
+// The texture, or a 1x1 white placeholder until it is resident.
+SDL_GPUTexture* GetStreamedTexture(AssetStreamer* streamer, int handle);
+
+// True once nothing requested is still loading or waiting for upload, so
+// every frame from here on draws the same assets. Evicted meshes do not
+// count as waiting.
+bool AssetStreamerSettled(AssetStreamer* streamer);
+
+void PrintAssetStreamerStats(const AssetStreamer* streamer);
+
+#endif
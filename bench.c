@@ -0,0 +1,2829 @@
+// Headless benchmarks for the CPU side of the renderer. Needs no window or GPU.
+//
+//   cmake -S . -B build && cmake --build build --target bench
+//   cd build && ./bench [--quick] [--json results.json]
+//
+// Run it from the build directory, where the bundled .obj files are copied.
+// With --json every reported number is also written as a flat list of
+// {section, name, metric, value} records for regression tracking. ctest runs
+// it with --quick, which keeps every check but times each stage only once.
+
+#include "mesh.h"
+#include "obj_loader.h"
+#include "mesh_cache.h"
+#include "range_allocator.h"
+#include "vertex_pack.h"
+#include "mesh_optimize.h"
+#include "mesh_simplify.h"
+#include "frustum_cull.h"
+#include "occlusion_cull.h"
+#include "bvh.h"
+#include "meshlet.h"
+#include "mat4.h"
+#include "profiler.h"
+#include "job_system.h"
+#include "texture_mips.h"
+#include "texture_cache.h"
+#include "bmp_decode.h"
+#include "file_map.h"
+#include "render_queue.h"
+#include "draw_packets.h"
+#include "scene_instances.h"
+#include "memory_system.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <math.h>
+#include <pthread.h>
+
+#define MAX_VERT_COUNT 2048
+
+static const char* objFiles[] = {"ship.obj", "ship_2.obj", "monkey.obj", "sphere.obj"};
+#define OBJ_FILE_COUNT (int)(sizeof(objFiles) / sizeof(objFiles[0]))
+
+// --quick keeps every check but runs each timed loop once and skips the tiled
+// pipeline models, so ctest does not wait on the measurements.
+static bool quickRun;
+
+// Heap accounting. On glibc malloc and friends are interposed here and
+// forwarded to the __libc_ entry points; elsewhere the counters stay at zero.
+typedef struct AllocStats{
+    long long allocations;
+    long long live_bytes;
+    long long peak_bytes;
+} AllocStats;
+
+static AllocStats allocStats;
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static void track_alloc(void* ptr){
+    if (!ptr) return;
+    long long size = (long long)malloc_usable_size(ptr);
+    __atomic_add_fetch(&allocStats.allocations, 1, __ATOMIC_RELAXED);
+    long long live = __atomic_add_fetch(&allocStats.live_bytes, size, __ATOMIC_RELAXED);
+    long long peak = __atomic_load_n(&allocStats.peak_bytes, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&allocStats.peak_bytes, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void track_free(void* ptr){
+    if (ptr) __atomic_sub_fetch(&allocStats.live_bytes, (long long)malloc_usable_size(ptr), __ATOMIC_RELAXED);
+}
+
+void* malloc(size_t size){
+    void* ptr = __libc_malloc(size);
+    track_alloc(ptr);
+    return ptr;
+}
+
+void* calloc(size_t count, size_t size){
+    void* ptr = __libc_calloc(count, size);
+    track_alloc(ptr);
+    return ptr;
+}
+
+void* realloc(void* old, size_t size){
+    track_free(old);
+    void* ptr = __libc_realloc(old, size);
+    // a failed realloc leaves the old block alive
+    track_alloc(ptr ? ptr : (size ? old : NULL));
+    return ptr;
+}
+
+void free(void* ptr){
+    track_free(ptr);
+    __libc_free(ptr);
+}
+#endif
+
+static AllocStats alloc_snapshot(void){
+    AllocStats stats;
+    stats.allocations = __atomic_load_n(&allocStats.allocations, __ATOMIC_RELAXED);
+    stats.live_bytes = __atomic_load_n(&allocStats.live_bytes, __ATOMIC_RELAXED);
+    stats.peak_bytes = __atomic_load_n(&allocStats.peak_bytes, __ATOMIC_RELAXED);
+    return stats;
+}
+
+static void reset_alloc_peak(void){
+    __atomic_store_n(&allocStats.peak_bytes, __atomic_load_n(&allocStats.live_bytes, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+static size_t peak_rss_kb(void){
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return (size_t)usage.ru_maxrss / 1024;
+#else
+    return (size_t)usage.ru_maxrss;
+#endif
+}
+
+// Machine readable copy of the reported numbers, written by --json.
+typedef struct BenchResult{
+    char section[24];
+    char name[40];
+    char metric[24];
+    double value;
+} BenchResult;
+
+static BenchResult* results;
+static int resultCount, resultCapacity;
+
+static void record_result(const char* section, const char* name, const char* metric, double value){
+    if (resultCount == resultCapacity) {
+        resultCapacity = resultCapacity ? resultCapacity * 2 : 256;
+        results = realloc(results, (size_t)resultCapacity * sizeof(BenchResult));
+    }
+    BenchResult* result = &results[resultCount++];
+    snprintf(result->section, sizeof(result->section), "%s", section);
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    snprintf(result->metric, sizeof(result->metric), "%s", metric);
+    result->value = value;
+}
+
+static bool WriteResultsJson(const char* path, int failures){
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        printf("[ERROR]: could not write %s\n", path);
+        return false;
+    }
+    fprintf(file, "{\n  \"failures\": %d,\n  \"peak_rss_kb\": %zu,\n  \"results\": [\n", failures, peak_rss_kb());
+    for (int i = 0; i < resultCount; i++) {
+        fprintf(file, "    {\"section\": \"%s\", \"name\": \"%s\", \"metric\": \"%s\", \"value\": %.6g}%s\n",
+                results[i].section, results[i].name, results[i].metric, results[i].value,
+                i + 1 < resultCount ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static size_t file_size(const char* path){
+    struct stat st;
+    if(stat(path, &st) != 0) return 0;
+    return (size_t)st.st_size;
+}
+
+static int resolve_index(int idx, int count) {
+    if (idx < 0) return count + idx;
+    return idx - 1;
+}
+
+// The original fgets/sscanf loader, kept as the reference the fast parser has
+// to match byte for byte.
+static Mesh LoadObjReference(const char *filePath, Vec3 pos){
+    FILE *file = fopen(filePath, "r");
+    if(!file){
+        printf("[ERROR]: could not open file: %s\n", filePath);
+        return (Mesh){0};
+    }
+
+    Vec3* positions = malloc(MAX_VERT_COUNT * sizeof(Vec3));
+    Vec3* normals = malloc(MAX_VERT_COUNT * sizeof(Vec3));
+    Vec2* uvs = malloc(MAX_VERT_COUNT * sizeof(Vec2));
+
+    int pos_count = 0, pos_capacity = MAX_VERT_COUNT;
+    int norm_count = 0, norm_capacity = MAX_VERT_COUNT;
+    int uv_count = 0, uv_capacity = MAX_VERT_COUNT;
+
+    Vertex* vertices = AllocMeshData(MAX_VERT_COUNT * sizeof(Vertex), "mesh vertices");
+    int vert_count = 0, vert_cap = MAX_VERT_COUNT;
+
+    char line[256];
+    float x, y, z;
+
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == 'v' && line[1] == ' ') {
+            if (sscanf(line, "v %f %f %f", &x, &y, &z) == 3) {
+                if (pos_count >= pos_capacity) {
+                    pos_capacity *= 2;
+                    positions = realloc(positions, pos_capacity * sizeof(Vec3));
+                }
+                positions[pos_count++] = (Vec3){x, y, z};
+            }
+        }
+        else if (line[0] == 'v' && line[1] == 'n') {
+            if (sscanf(line, "vn %f %f %f", &x, &y, &z) == 3) {
+                if (norm_count >= norm_capacity) {
+                    norm_capacity *= 2;
+                    normals = realloc(normals, norm_capacity * sizeof(Vec3));
+                }
+                normals[norm_count++] = (Vec3){x, y, z};
+            }
+        }
+        else if (line[0] == 'v' && line[1] == 't') {
+            float u, v;
+            if (sscanf(line, "vt %f %f", &u, &v) == 2) {
+                if (uv_count >= uv_capacity) {
+                    uv_capacity *= 2;
+                    uvs = realloc(uvs, uv_capacity * sizeof(Vec2));
+                }
+                uvs[uv_count++] = (Vec2){u, v};
+            }
+        }
+        else if (line[0] == 'f' && line[1] == ' ') {
+            int v[3], vt[3], vn[3];
+            int matched = sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
+                                &v[0], &vt[0], &vn[0],
+                                &v[1], &vt[1], &vn[1],
+                                &v[2], &vt[2], &vn[2]);
+            if (matched != 9) continue;
+            for (int i = 0; i < 3; i++) {
+                if (vert_count >= vert_cap) {
+                    Vertex* grown = AllocMeshData(vert_cap * 2 * sizeof(Vertex), "mesh vertices");
+                    memcpy(grown, vertices, vert_cap * sizeof(Vertex));
+                    FreeMeshData(vertices);
+                    vertices = grown;
+                    vert_cap *= 2;
+                }
+                int vi = resolve_index(v[i], pos_count);
+                int vti = resolve_index(vt[i], uv_count);
+                int vni = resolve_index(vn[i], norm_count);
+                if (vi < 0 || vi >= pos_count) continue;
+                vertices[vert_count].position = positions[vi];
+                if (vni >= 0 && vni < norm_count) {
+                    vertices[vert_count].normal = normals[vni];
+                } else {
+                    vertices[vert_count].normal = (Vec3){0.0f, 1.0f, 0.0f};
+                }
+                if (vti >= 0 && vti < uv_count) {
+                    vertices[vert_count].uv = uvs[vti];
+                } else {
+                    vertices[vert_count].uv = (Vec2){0.0f, 0.0f};
+                }
+                vert_count++;
+            }
+        }
+    }
+
+    fclose(file);
+    free(positions);
+    free(normals);
+    free(uvs);
+
+    return (Mesh){
+        .position = pos,
+        .vertices = vertices,
+        .vertex_count = vert_count,
+        .size = vert_count * sizeof(Vertex)
+    };
+}
+
+// Compares an indexed mesh against the flat triangle list of the reference.
+static bool SameMesh(const Mesh* reference, const Mesh* indexed){
+    if (reference->vertex_count != indexed->index_count) return false;
+    for (int i = 0; i < indexed->index_count; i++) {
+        uint32_t index = GetMeshIndex(indexed, i);
+        if (index >= (uint32_t)indexed->vertex_count) return false;
+        if (memcmp(&reference->vertices[i], &indexed->vertices[index], sizeof(Vertex)) != 0) return false;
+    }
+    return true;
+}
+
+
+typedef Mesh (*ObjLoadFn)(const char* path, int threads);
+
+static Mesh load_reference(const char* path, int threads){ (void)threads; return LoadObjReference(path, (Vec3){0}); }
+static Mesh load_serial(const char* path, int threads){ (void)threads; return LoadObjFromFile(path, (Vec3){0}); }
+static Mesh load_threaded(const char* path, int threads){ return LoadObjFromFileThreaded(path, (Vec3){0}, threads); }
+
+// Loads the file until at least minSeconds have passed and returns MB/s.
+static double measure_load(ObjLoadFn load, const char* path, int threads, double minSeconds){
+    size_t bytes = file_size(path);
+    int iterations = 0;
+    double start = now_seconds(), elapsed;
+    do {
+        Mesh mesh = load(path, threads);
+        FreeMesh(&mesh);
+        iterations++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < minSeconds && !quickRun);
+    return (double)bytes * iterations / elapsed / (1024.0 * 1024.0);
+}
+
+static int BenchObjParser(void){
+    int failures = 0;
+
+    printf("== obj parser ==\n");
+    printf("%-12s %10s %10s %12s %12s %12s\n", "file", "KB", "verts", "sscanf MB/s", "mmap MB/s", "4 thr MB/s");
+
+    for (int i = 0; i < OBJ_FILE_COUNT; i++) {
+        const char* path = objFiles[i];
+        Mesh reference = LoadObjReference(path, (Vec3){0});
+        Mesh serial = LoadObjFromFile(path, (Vec3){0});
+        Mesh threaded = LoadObjFromFileThreaded(path, (Vec3){0}, 4);
+
+        if (!SameMesh(&reference, &serial) || !SameMesh(&reference, &threaded)) {
+            printf("[ERROR]: %s: parser output differs from the sscanf reference\n", path);
+            failures++;
+        }
+
+        double referenceRate = measure_load(load_reference, path, 0, 0.25);
+        double serialRate = measure_load(load_serial, path, 1, 0.25);
+        double threadedRate = measure_load(load_threaded, path, 4, 0.25);
+        printf("%-12s %10.1f %10d %12.1f %12.1f %12.1f\n", path,
+               file_size(path) / 1024.0, reference.vertex_count, referenceRate, serialRate, threadedRate);
+        record_result("obj_parser", path, "sscanf_mb_per_s", referenceRate);
+        record_result("obj_parser", path, "mmap_mb_per_s", serialRate);
+        record_result("obj_parser", path, "threaded_mb_per_s", threadedRate);
+
+        FreeMesh(&reference);
+        FreeMesh(&serial);
+        FreeMesh(&threaded);
+    }
+
+    return failures;
+}
+
+static void BenchIndexing(void){
+    printf("== vertex deduplication ==\n");
+    printf("%-12s %10s %10s %8s %12s %12s %8s\n", "file", "corners", "unique", "index", "flat KB", "indexed KB", "ratio");
+
+    for (int i = 0; i < OBJ_FILE_COUNT; i++) {
+        const char* path = objFiles[i];
+        Mesh mesh = LoadObjFromFile(path, (Vec3){0});
+        size_t flat = (size_t)mesh.index_count * sizeof(Vertex);
+        size_t indexed = mesh.size + mesh.index_size;
+
+        printf("%-12s %10d %10d %7d%s %12.1f %12.1f %7.2fx\n", path,
+               mesh.index_count, mesh.vertex_count, mesh.index_stride * 8, "b",
+               flat / 1024.0, indexed / 1024.0, (double)flat / (double)indexed);
+        FreeMesh(&mesh);
+    }
+}
+
+static void BenchMeshCache(void){
+    printf("== mesh cache ==\n");
+    printf("%-12s %12s %12s %10s\n", "file", "cold ms", "warm ms", "speedup");
+
+    for (int i = 0; i < OBJ_FILE_COUNT; i++) {
+        const char* path = objFiles[i];
+        char cachePath[1024];
+        snprintf(cachePath, sizeof(cachePath), "%s.meshcache", path);
+
+        remove(cachePath);
+        MeshLod lods[MESH_LOD_COUNT];
+        int lodCount;
+        MeshLoadInfo cold;
+        Mesh mesh = LoadMeshCached(path, (Vec3){0}, lods, &lodCount, &cold);
+        FreeMeshLods(lods, lodCount);
+        FreeMesh(&mesh);
+
+        double warmBest = 1e9;
+        for (int run = 0; run < 20; run++) {
+            MeshLoadInfo warm;
+            mesh = LoadMeshCached(path, (Vec3){0}, lods, &lodCount, &warm);
+            FreeMeshLods(lods, lodCount);
+            FreeMesh(&mesh);
+            if (warm.cache_hit && warm.seconds < warmBest) warmBest = warm.seconds;
+        }
+
+        printf("%-12s %12.3f %12.3f %9.1fx\n", path, cold.seconds * 1e3, warmBest * 1e3, cold.seconds / warmBest);
+        record_result("mesh_cache", path, "cold_ms", cold.seconds * 1e3);
+        record_result("mesh_cache", path, "warm_ms", warmBest * 1e3);
+    }
+}
+
+// Load/unload churn on the geometry pool allocator with mesh-like sizes.
+// Every live range is tracked in a shadow map to catch overlaps.
+static int BenchRangeAllocator(void){
+    enum { CAPACITY = 1 << 20, SLOTS = 256, OPS = 200000 };
+    int failures = 0;
+
+    RangeAllocator allocator;
+    InitRangeAllocator(&allocator, CAPACITY);
+    uint8_t* owner = calloc(CAPACITY, 1);
+    uint32_t offsets[SLOTS], sizes[SLOTS];
+    memset(sizes, 0, sizeof(sizes));
+
+    uint32_t seed = 12345;
+    int allocs = 0, frees = 0, misses = 0;
+    double start = now_seconds();
+    for (int op = 0; op < OPS; op++) {
+        seed = seed * 1664525u + 1013904223u;
+        int slot = (int)((seed >> 8) % SLOTS);
+        if (sizes[slot]) {
+            FreeRangeAt(&allocator, offsets[slot], sizes[slot]);
+            memset(owner + offsets[slot], 0, sizes[slot]);
+            sizes[slot] = 0;
+            frees++;
+        } else {
+            seed = seed * 1664525u + 1013904223u;
+            uint32_t size = 36 + (seed >> 8) % 12000;
+            if (AllocRange(&allocator, size, &offsets[slot])) {
+                for (uint32_t i = 0; i < size; i++) {
+                    if (owner[offsets[slot] + i]) failures++;
+                    owner[offsets[slot] + i] = 1;
+                }
+                sizes[slot] = size;
+                allocs++;
+            } else {
+                misses++;
+            }
+        }
+    }
+    double elapsed = now_seconds() - start;
+
+    RangeAllocatorStats stats = GetRangeAllocatorStats(&allocator);
+    printf("== geometry pool allocator ==\n");
+    printf("%d allocs, %d frees, %d misses in %.1f ms (shadow checks included)\n", allocs, frees, misses, elapsed * 1e3);
+    printf("occupancy %.1f%%, %u live ranges, %d free ranges, largest free %u, fragmentation %.1f%%\n",
+           stats.occupancy * 100.0f, stats.allocations, stats.free_ranges, stats.largest_free, stats.fragmentation * 100.0f);
+    if (failures) {
+        printf("[ERROR]: allocator handed out overlapping ranges\n");
+    }
+
+    for (int i = 0; i < SLOTS; i++) {
+        if (sizes[i]) FreeRangeAt(&allocator, offsets[i], sizes[i]);
+    }
+    stats = GetRangeAllocatorStats(&allocator);
+    if (stats.used != 0 || stats.free_ranges != 1) {
+        printf("[ERROR]: allocator did not coalesce back to one free range\n");
+        failures++;
+    }
+
+    free(owner);
+    DestroyRangeAllocator(&allocator);
+    return failures ? 1 : 0;
+}
+
+// Packs every bundled model, checks the SIMD encoder against the scalar one
+// and reports the worst reconstruction error of each attribute.
+static int BenchVertexPacking(void){
+    int failures = 0;
+
+    printf("== packed vertices ==\n");
+    printf("%-12s %8s %12s %12s %10s %10s %10s\n", "file", "bytes", "pos err", "pos err %", "normal deg", "uv err", "Mvert/s");
+
+    for (int f = 0; f < OBJ_FILE_COUNT; f++) {
+        const char* path = objFiles[f];
+        Mesh mesh = LoadObjFromFile(path, (Vec3){0});
+        PackedVertex* packed = malloc((size_t)mesh.vertex_count * sizeof(PackedVertex));
+        PackedVertex* reference = malloc((size_t)mesh.vertex_count * sizeof(PackedVertex));
+
+        PackVerticesScalar(&mesh, reference);
+        PackVertices(&mesh, packed);
+        if (memcmp(packed, reference, (size_t)mesh.vertex_count * sizeof(PackedVertex)) != 0) {
+            printf("[ERROR]: %s: SIMD packer differs from the scalar reference\n", path);
+            failures++;
+        }
+
+        VertexQuantization quant = GetVertexQuantization(&mesh);
+        float extent = fmaxf(quant.scale.x, fmaxf(quant.scale.y, quant.scale.z));
+        double posErr = 0.0, normalErr = 0.0, uvErr = 0.0;
+        for (int i = 0; i < mesh.vertex_count; i++) {
+            Vertex src = mesh.vertices[i];
+            Vertex dst = UnpackVertex(&packed[i], quant);
+
+            posErr = fmax(posErr, fabs(src.position.x - dst.position.x));
+            posErr = fmax(posErr, fabs(src.position.y - dst.position.y));
+            posErr = fmax(posErr, fabs(src.position.z - dst.position.z));
+
+            double len = sqrt(src.normal.x * src.normal.x + src.normal.y * src.normal.y + src.normal.z * src.normal.z);
+            if (len > 0.0) {
+                double d = (src.normal.x * dst.normal.x + src.normal.y * dst.normal.y + src.normal.z * dst.normal.z) / len;
+                normalErr = fmax(normalErr, acos(fmin(1.0, fmax(-1.0, d))) * 180.0 / 3.14159265358979);
+            }
+
+            uvErr = fmax(uvErr, fabs(src.uv.x - dst.uv.x));
+            uvErr = fmax(uvErr, fabs(src.uv.y - dst.uv.y));
+        }
+
+        int iterations = 0;
+        double start = now_seconds(), elapsed;
+        do {
+            PackVertices(&mesh, packed);
+            iterations++;
+            elapsed = now_seconds() - start;
+        } while (elapsed < 0.1);
+
+        printf("%-12s %5zu->%-2zu %12.6f %11.4f%% %10.4f %10.6f %10.1f\n", path,
+               sizeof(Vertex), sizeof(PackedVertex), posErr, posErr / extent * 100.0, normalErr, uvErr,
+               (double)mesh.vertex_count * iterations / elapsed / 1e6);
+
+        free(packed);
+        free(reference);
+        FreeMesh(&mesh);
+    }
+
+    return failures;
+}
+
+// Order independent fingerprint of the triangles of a mesh, by vertex value.
+static uint64_t TriangleSetHash(const Mesh* mesh){
+    uint64_t sum = 0;
+    for (int t = 0; t + 2 < mesh->index_count; t += 3) {
+        Vertex tri[3];
+        for (int c = 0; c < 3; c++) tri[c] = mesh->vertices[GetMeshIndex(mesh, t + c)];
+        sum += HashBytes64(tri, sizeof(tri));
+    }
+    return sum;
+}
+
+static int BenchMeshOptimize(void){
+    int failures = 0;
+
+    printf("== mesh optimization (FIFO cache %d) ==\n", VERTEX_CACHE_SIZE);
+    printf("%-12s %10s %10s %10s %10s %10s\n", "file", "ACMR", "-> ACMR", "ATVR", "-> ATVR", "ms");
+
+    for (int f = 0; f < OBJ_FILE_COUNT; f++) {
+        const char* path = objFiles[f];
+        Mesh mesh = LoadObjFromFile(path, (Vec3){0});
+        uint64_t hashBefore = TriangleSetHash(&mesh);
+
+        VertexCacheStats before, after;
+        double start = now_seconds();
+        OptimizeMesh(&mesh, &before, &after);
+        double elapsed = now_seconds() - start;
+
+        if (TriangleSetHash(&mesh) != hashBefore) {
+            printf("[ERROR]: %s: optimization changed the triangle set\n", path);
+            failures++;
+        }
+
+        printf("%-12s %10.3f %10.3f %10.3f %10.3f %10.3f\n", path,
+               before.acmr, after.acmr, before.atvr, after.atvr, elapsed * 1e3);
+        FreeMesh(&mesh);
+    }
+
+    return failures;
+}
+
+// Distance from p to triangle abc (Ericson, Real-Time Collision Detection 5.1.5).
+static float PointTriangleDistance(Vec3 p, Vec3 a, Vec3 b, Vec3 c){
+    Vec3 ab = {b.x - a.x, b.y - a.y, b.z - a.z};
+    Vec3 ac = {c.x - a.x, c.y - a.y, c.z - a.z};
+    Vec3 ap = {p.x - a.x, p.y - a.y, p.z - a.z};
+    #define DOT(u, v) ((u).x * (v).x + (u).y * (v).y + (u).z * (v).z)
+    float d1 = DOT(ab, ap), d2 = DOT(ac, ap);
+    Vec3 q;
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        q = a;
+    } else {
+        Vec3 bp = {p.x - b.x, p.y - b.y, p.z - b.z};
+        float d3 = DOT(ab, bp), d4 = DOT(ac, bp);
+        Vec3 cp = {p.x - c.x, p.y - c.y, p.z - c.z};
+        float d5 = DOT(ab, cp), d6 = DOT(ac, cp);
+        float vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+        if (d3 >= 0.0f && d4 <= d3) {
+            q = b;
+        } else if (d6 >= 0.0f && d5 <= d6) {
+            q = c;
+        } else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+            float v = d1 / (d1 - d3);
+            q = (Vec3){a.x + ab.x * v, a.y + ab.y * v, a.z + ab.z * v};
+        } else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+            float w = d2 / (d2 - d6);
+            q = (Vec3){a.x + ac.x * w, a.y + ac.y * w, a.z + ac.z * w};
+        } else if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+            float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            q = (Vec3){b.x + (c.x - b.x) * w, b.y + (c.y - b.y) * w, b.z + (c.z - b.z) * w};
+        } else {
+            float denom = 1.0f / (va + vb + vc);
+            float v = vb * denom, w = vc * denom;
+            q = (Vec3){a.x + ab.x * v + ac.x * w, a.y + ab.y * v + ac.y * w, a.z + ab.z * v + ac.z * w};
+        }
+    }
+    #undef DOT
+    Vec3 d = {p.x - q.x, p.y - q.y, p.z - q.z};
+    return sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+}
+
+// Largest distance from a vertex of the base mesh to the surface of the lod.
+static float MeasureLodDeviation(const Mesh* base, const Mesh* lod){
+    float worst = 0.0f;
+    for (int v = 0; v < base->vertex_count; v++) {
+        Vec3 p = base->vertices[v].position;
+        float nearest = INFINITY;
+        for (int t = 0; t + 2 < lod->index_count && nearest > worst; t += 3) {
+            float d = PointTriangleDistance(p, lod->vertices[GetMeshIndex(lod, t)].position,
+                                               lod->vertices[GetMeshIndex(lod, t + 1)].position,
+                                               lod->vertices[GetMeshIndex(lod, t + 2)].position);
+            if (d < nearest) nearest = d;
+        }
+        if (nearest > worst) worst = nearest;
+    }
+    return worst;
+}
+
+static int BenchLodChain(void){
+    int failures = 0;
+
+    printf("== lod chain (max error %.1f%% of extent) ==\n", MESH_LOD_MAX_ERROR * 100.0f);
+    printf("%-12s %4s %8s %8s %8s %10s %10s %10s\n", "file", "lod", "tris", "target", "verts", "error %", "measured %", "ms");
+
+    for (int f = 0; f < OBJ_FILE_COUNT; f++) {
+        const char* path = objFiles[f];
+        Mesh mesh = LoadObjFromFile(path, (Vec3){0});
+        float extent = fmaxf(mesh.bounds_max.x - mesh.bounds_min.x,
+                       fmaxf(mesh.bounds_max.y - mesh.bounds_min.y, mesh.bounds_max.z - mesh.bounds_min.z));
+
+        MeshLod lods[MESH_LOD_COUNT];
+        double start = now_seconds();
+        int lodCount = BuildMeshLods(&mesh, lods);
+        double elapsed = now_seconds() - start;
+
+        for (int i = 0; i < lodCount; i++) {
+            const Mesh* lod = &lods[i].mesh;
+            int target = (int)(mesh.index_count / 3 * MeshLodRatios[i]);
+            float measured = i ? MeasureLodDeviation(&mesh, lod) : 0.0f;
+
+            // a level may stop above its target when the error budget runs
+            // out, but it must never grow or exceed the budget
+            if (i > 0 && lod->index_count >= lods[i - 1].mesh.index_count) {
+                printf("[ERROR]: %s: lod %d is not smaller than lod %d\n", path, i, i - 1);
+                failures++;
+            }
+            if (lods[i].error > extent * MESH_LOD_MAX_ERROR * 1.001f) {
+                printf("[ERROR]: %s: lod %d error %f is over budget\n", path, i, lods[i].error);
+                failures++;
+            }
+
+            printf("%-12s %4d %8d %8d %8d %10.3f %10.3f %10.3f\n", path, i, lod->index_count / 3, target,
+                   lod->vertex_count, lods[i].error / extent * 100.0f, measured / extent * 100.0f, i ? 0.0 : elapsed * 1e3);
+        }
+
+        // selection has to coarsen monotonically with distance
+        int previous = 0;
+        for (float distance = 1.0f; distance < 1e5f; distance *= 1.5f) {
+            int selected = SelectMeshLod(lods, lodCount, distance, 1.0f / tanf(0.5f * 1.0472f), 600.0f, 1.0f);
+            if (selected < previous) {
+                printf("[ERROR]: %s: lod selection went finer at distance %f\n", path, distance);
+                failures++;
+                break;
+            }
+            previous = selected;
+        }
+
+        FreeMeshLods(lods, lodCount);
+        FreeMesh(&mesh);
+    }
+
+    // two corners weld together, so nothing is left to collapse
+    Vertex sliver[3] = { { .position = {0.0f, 0.0f, 0.0f} }, { .position = {0.0f, 0.0f, 0.0f} }, { .position = {1.0f, 0.0f, 0.0f} } };
+    const uint32_t sliverIndices[3] = {0, 1, 2};
+    Mesh degenerate = { .vertices = sliver, .vertex_count = 3, .size = sizeof(sliver) };
+    SetMeshIndices(&degenerate, sliverIndices, 3);
+    float sliverError = 0.0f;
+    Mesh simplified = SimplifyMesh(&degenerate, 0, 1.0f, &sliverError);
+    if (simplified.index_count > 3) {
+        printf("[ERROR]: simplifying a degenerate triangle gave %d indices\n", simplified.index_count);
+        failures++;
+    }
+    FreeMesh(&simplified);
+    FreeMeshData(degenerate.indices);
+
+    return failures;
+}
+
+// proj * view for a camera at eye turned by yaw, then pitched.
+static Mat4 CameraClipMatrix(Mat4 proj, Vec3 eye, float yaw, float pitch){
+    Mat4 view = Mat4Multiply(Mat4RotationX(-pitch), Mat4Multiply(Mat4RotationY(-yaw), Mat4Translation((Vec3){-eye.x, -eye.y, -eye.z})));
+    return Mat4Multiply(proj, view);
+}
+
+static Mesh BoundsOnlyMesh(Vec3 center, Vec3 extent){
+    return (Mesh){
+        .bounds_min = {center.x - extent.x, center.y - extent.y, center.z - extent.z},
+        .bounds_max = {center.x + extent.x, center.y + extent.y, center.z + extent.z},
+        .bounds_radius = sqrtf(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z)
+    };
+}
+
+static float random_range(uint32_t* state, float lo, float hi){
+    *state = *state * 1664525u + 1013904223u;
+    return lo + (hi - lo) * (float)(*state >> 8) / 16777216.0f;
+}
+
+static int BenchFrustumCulling(void){
+    int failures = 0;
+    Mat4 proj = Mat4Perspective(70.0f * 3.14159265f / 180.0f, 900.0f / 700.0f, 0.1f, 1000.0f);
+
+    // hand placed cases against a camera at the origin looking down -z
+    {
+        struct { Vec3 center; Vec3 extent; bool visible; } cases[] = {
+            {{0.0f, 0.0f, -10.0f}, {1.0f, 1.0f, 1.0f}, true},     // straight ahead
+            {{0.0f, 0.0f, 10.0f}, {1.0f, 1.0f, 1.0f}, false},     // behind
+            {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, true},       // around the eye, crosses near
+            {{0.0f, 0.0f, -2000.0f}, {1.0f, 1.0f, 1.0f}, false},  // past far
+            {{0.0f, 0.0f, -1000.5f}, {1.0f, 1.0f, 1.0f}, true},   // crosses far
+            {{100.0f, 0.0f, -10.0f}, {1.0f, 1.0f, 1.0f}, false},  // off to the right
+            {{-10.0f, 0.0f, -10.0f}, {1.0f, 1.0f, 1.0f}, true},   // crosses the left plane
+            {{0.0f, 60.0f, -10.0f}, {1.0f, 1.0f, 1.0f}, false},   // above
+        };
+        int caseCount = (int)(sizeof(cases) / sizeof(cases[0]));
+
+        CullBounds bounds;
+        InitCullBounds(&bounds, caseCount);
+        for (int i = 0; i < caseCount; i++) {
+            Mesh mesh = BoundsOnlyMesh(cases[i].center, cases[i].extent);
+            AddCullBounds(&bounds, &mesh);
+        }
+        Frustum frustum = ExtractFrustum(proj.m);
+        uint32_t visible[16];
+        int visibleCount = CullFrustum(&bounds, &frustum, visible);
+
+        int next = 0;
+        for (int i = 0; i < caseCount; i++) {
+            bool got = next < visibleCount && visible[next] == (uint32_t)i;
+            if (got) next++;
+            if (got != cases[i].visible) {
+                printf("[ERROR]: frustum case %d: expected %s\n", i, cases[i].visible ? "visible" : "culled");
+                failures++;
+            }
+        }
+        DestroyCullBounds(&bounds);
+    }
+
+    printf("== frustum culling ==\n");
+    printf("%8s %10s %12s %12s %9s\n", "objects", "visible", "scalar ns", "simd ns", "speedup");
+
+    const int counts[] = {1000, 10000, 100000};
+    for (int c = 0; c < 3; c++) {
+        int count = counts[c];
+        uint32_t seed = 12345u + (uint32_t)c;
+
+        CullBounds bounds;
+        InitCullBounds(&bounds, count);
+        for (int i = 0; i < count; i++) {
+            Vec3 center = {random_range(&seed, -500.0f, 500.0f), random_range(&seed, -50.0f, 50.0f), random_range(&seed, -500.0f, 500.0f)};
+            Vec3 extent = {random_range(&seed, 0.1f, 20.0f), random_range(&seed, 0.1f, 20.0f), random_range(&seed, 0.1f, 20.0f)};
+            Mesh mesh = BoundsOnlyMesh(center, extent);
+            AddCullBounds(&bounds, &mesh);
+        }
+
+        uint32_t* visible = malloc((size_t)bounds.capacity * sizeof(uint32_t));
+        uint32_t* reference = malloc((size_t)bounds.capacity * sizeof(uint32_t));
+
+        // a spin of cameras, every one checked against the scalar reference
+        int views = 64;
+        int totalVisible = 0;
+        double scalarTime = 0.0, simdTime = 0.0;
+        for (int v = 0; v < views; v++) {
+            float yaw = 6.2831853f * (float)v / (float)views;
+            Mat4 clip = CameraClipMatrix(proj, (Vec3){0.0f, 10.0f, 0.0f}, yaw, 0.2f * sinf(yaw * 3.0f));
+            Frustum frustum = ExtractFrustum(clip.m);
+
+            double start = now_seconds();
+            int referenceCount = CullFrustumScalar(&bounds, &frustum, reference);
+            scalarTime += now_seconds() - start;
+
+            start = now_seconds();
+            int visibleCount = CullFrustum(&bounds, &frustum, visible);
+            simdTime += now_seconds() - start;
+
+            if (visibleCount != referenceCount || memcmp(visible, reference, (size_t)visibleCount * sizeof(uint32_t)) != 0) {
+                printf("[ERROR]: %d objects, view %d: SIMD visible list differs from the scalar reference\n", count, v);
+                failures++;
+            }
+            totalVisible += visibleCount;
+        }
+
+        double scalarNs = scalarTime * 1e9 / ((double)views * count);
+        double simdNs = simdTime * 1e9 / ((double)views * count);
+        printf("%8d %9.1f%% %12.3f %12.3f %8.1fx\n", count, 100.0 * totalVisible / ((double)views * count),
+               scalarNs, simdNs, scalarNs / simdNs);
+        char name[32];
+        snprintf(name, sizeof(name), "%d objects", count);
+        record_result("frustum_cull", name, "scalar_ns", scalarNs);
+        record_result("frustum_cull", name, "simd_ns", simdNs);
+
+        free(visible);
+        free(reference);
+        DestroyCullBounds(&bounds);
+    }
+
+    return failures;
+}
+
+// Quad facing +z at depth z, counter-clockwise seen from the camera.
+static Mesh make_quad(float halfSize, float z){
+    Mesh mesh = {0};
+    mesh.vertex_count = 4;
+    mesh.vertices = AllocMeshData(4 * sizeof(Vertex), "mesh vertices");
+    memset(mesh.vertices, 0, 4 * sizeof(Vertex));
+    mesh.vertices[0].position = (Vec3){-halfSize, -halfSize, z};
+    mesh.vertices[1].position = (Vec3){halfSize, -halfSize, z};
+    mesh.vertices[2].position = (Vec3){halfSize, halfSize, z};
+    mesh.vertices[3].position = (Vec3){-halfSize, halfSize, z};
+    const uint32_t indices[6] = {0, 1, 2, 0, 2, 3};
+    SetMeshIndices(&mesh, indices, 6);
+    ComputeMeshBounds(&mesh);
+    return mesh;
+}
+
+static bool box_visible(const OcclusionBuffer* buffer, const Mat4* viewProj, Vec3 center, float half, bool simd){
+    Vec3 lo = {center.x - half, center.y - half, center.z - half};
+    Vec3 hi = {center.x + half, center.y + half, center.z + half};
+    return simd ? OcclusionTestBox(buffer, viewProj->m, lo, hi) : OcclusionTestBoxScalar(buffer, viewProj->m, lo, hi);
+}
+
+static int BenchOcclusionCulling(void){
+    int failures = 0;
+    OcclusionBuffer buffer, reference;
+    if (!InitOcclusionBuffer(&buffer, 320, 240) || !InitOcclusionBuffer(&reference, 320, 240)) return 1;
+
+    // a wall in front of the camera hides what is behind it and nothing else
+    Mat4 proj = Mat4Perspective(1.2f, 4.0f / 3.0f, 0.1f, 100.0f);
+    Mesh wall = make_quad(2.0f, -10.0f);
+    RasterizeOccluder(&buffer, proj.m, &wall);
+    struct { const char* name; Vec3 center; float half; bool visible; } boxes[] = {
+        {"behind the wall", {0.0f, 0.0f, -20.0f}, 1.0f, false},
+        {"in front of the wall", {0.0f, 0.0f, -5.0f}, 0.5f, true},
+        {"beside the wall", {5.0f, 0.0f, -20.0f}, 1.0f, true},
+        {"through the wall", {0.0f, 0.0f, -10.0f}, 0.5f, true},
+        {"larger than the wall", {0.0f, 0.0f, -30.0f}, 8.0f, true},
+        {"across the near plane", {0.0f, 0.0f, 0.0f}, 1.0f, true}
+    };
+    for (int i = 0; i < (int)(sizeof(boxes) / sizeof(boxes[0])); i++) {
+        for (int simd = 0; simd < 2; simd++) {
+            if (box_visible(&buffer, &proj, boxes[i].center, boxes[i].half, simd) != boxes[i].visible) {
+                printf("[ERROR]: %s occlusion test: box %s is %s\n", simd ? "SIMD" : "scalar", boxes[i].name, boxes[i].visible ? "hidden" : "visible");
+                failures++;
+            }
+        }
+    }
+    // seen from behind the wall is back facing and occludes nothing
+    ClearOcclusionBuffer(&buffer);
+    Mat4 turned = Mat4Multiply(proj, Mat4RotationY(3.14159265f));
+    RasterizeOccluder(&buffer, turned.m, &wall);
+    if (buffer.triangles != 0 || !box_visible(&buffer, &turned, (Vec3){0.0f, 0.0f, 20.0f}, 1.0f, true)) {
+        printf("[ERROR]: back facing occluder was rasterized\n");
+        failures++;
+    }
+    FreeMesh(&wall);
+
+    printf("== occlusion culling ==\n");
+    printf("%-12s %8s %14s %14s\n", "occluder", "tris", "scalar Mtri/s", "SIMD Mtri/s");
+    const char* paths[] = {"monkey.obj", "ship.obj"};
+    for (int f = 0; f < 2; f++) {
+        Mesh mesh = LoadObjFromFile(paths[f], (Vec3){0});
+        if (mesh.index_count == 0) {
+            printf("[ERROR]: could not load %s\n", paths[f]);
+            failures++;
+            continue;
+        }
+        // framed to fill most of the buffer
+        float distance = mesh.bounds_radius * 2.0f;
+        Vec3 center = {
+            (mesh.bounds_min.x + mesh.bounds_max.x) * 0.5f,
+            (mesh.bounds_min.y + mesh.bounds_max.y) * 0.5f,
+            (mesh.bounds_min.z + mesh.bounds_max.z) * 0.5f
+        };
+        Mat4 mvp = Mat4Multiply(proj, Mat4Multiply(Mat4Translation((Vec3){0.0f, 0.0f, -distance}),
+                                Mat4Multiply(Mat4RotationY(0.4f), Mat4Translation((Vec3){-center.x, -center.y, -center.z}))));
+
+        double best[2] = {1e9, 1e9};
+        for (int run = 0; run < 20; run++) {
+            for (int simd = 0; simd < 2; simd++) {
+                OcclusionBuffer* target = simd ? &buffer : &reference;
+                ClearOcclusionBuffer(target);
+                double start = now_seconds();
+                if (simd) {
+                    RasterizeOccluder(target, mvp.m, &mesh);
+                } else {
+                    RasterizeOccluderScalar(target, mvp.m, &mesh);
+                }
+                double elapsed = now_seconds() - start;
+                if (elapsed < best[simd]) best[simd] = elapsed;
+            }
+        }
+        if (buffer.triangles == 0 || memcmp(buffer.depth, reference.depth, (size_t)buffer.width * buffer.height * sizeof(float)) != 0) {
+            printf("[ERROR]: %s: SIMD occlusion buffer differs from the scalar one\n", paths[f]);
+            failures++;
+        }
+        // the mesh's own box is never hidden by the mesh
+        if (!OcclusionTestBox(&buffer, mvp.m, mesh.bounds_min, mesh.bounds_max) || !OcclusionTestBoxScalar(&buffer, mvp.m, mesh.bounds_min, mesh.bounds_max)) {
+            printf("[ERROR]: %s hides its own bounds\n", paths[f]);
+            failures++;
+        }
+
+        int triangles = mesh.index_count / 3;
+        printf("%-12s %8d %14.1f %14.1f\n", paths[f], triangles, triangles / best[0] * 1e-6, triangles / best[1] * 1e-6);
+        record_result("occlusion_cull", paths[f], "scalar_mtris_per_s", triangles / best[0] * 1e-6);
+        record_result("occlusion_cull", paths[f], "simd_mtris_per_s", triangles / best[1] * 1e-6);
+        FreeMesh(&mesh);
+    }
+
+    DestroyOcclusionBuffer(&buffer);
+    DestroyOcclusionBuffer(&reference);
+    return failures;
+}
+
+static Vec3 random_point(uint32_t* seed, BvhBounds b){
+    return (Vec3){random_range(seed, b.min.x, b.max.x), random_range(seed, b.min.y, b.max.y), random_range(seed, b.min.z, b.max.z)};
+}
+
+// Linear scan with the same triangle test the BVH uses.
+static bool brute_raycast(const Mesh* mesh, Vec3 o, Vec3 d, float maxT, float* tHit){
+    bool found = false;
+    for (int i = 0; i + 2 < mesh->index_count; i += 3) {
+        uint32_t idx[3];
+        for (int c = 0; c < 3; c++) {
+            idx[c] = mesh->index_stride == 2 ? ((const uint16_t*)mesh->indices)[i + c] : ((const uint32_t*)mesh->indices)[i + c];
+        }
+        Vec3 v0 = mesh->vertices[idx[0]].position, v1 = mesh->vertices[idx[1]].position, v2 = mesh->vertices[idx[2]].position;
+        Vec3 e1 = {v1.x - v0.x, v1.y - v0.y, v1.z - v0.z}, e2 = {v2.x - v0.x, v2.y - v0.y, v2.z - v0.z};
+        Vec3 p = {d.y * e2.z - d.z * e2.y, d.z * e2.x - d.x * e2.z, d.x * e2.y - d.y * e2.x};
+        float det = e1.x * p.x + e1.y * p.y + e1.z * p.z;
+        if (fabsf(det) < 1e-20f) continue;
+        float inv = 1.0f / det;
+        Vec3 s = {o.x - v0.x, o.y - v0.y, o.z - v0.z};
+        float u = (s.x * p.x + s.y * p.y + s.z * p.z) * inv;
+        if (u < 0.0f || u > 1.0f) continue;
+        Vec3 q = {s.y * e1.z - s.z * e1.y, s.z * e1.x - s.x * e1.z, s.x * e1.y - s.y * e1.x};
+        float v = (d.x * q.x + d.y * q.y + d.z * q.z) * inv;
+        if (v < 0.0f || u + v > 1.0f) continue;
+        float t = (e2.x * q.x + e2.y * q.y + e2.z * q.z) * inv;
+        if (t < 0.0f || t > maxT) continue;
+        maxT = t;
+        found = true;
+    }
+    *tHit = maxT;
+    return found;
+}
+
+static bool same_hit(bool a, float ta, bool b, float tb){
+    return a == b && (!a || fabsf(ta - tb) <= 1e-5f * fmaxf(1.0f, ta));
+}
+
+static bool box_touches_frustum(const BvhBounds* b, const Frustum* frustum){
+    for (int p = 0; p < 6; p++) {
+        const float* pl = frustum->planes[p];
+        float far = fmaxf(pl[0] * b->min.x, pl[0] * b->max.x) + fmaxf(pl[1] * b->min.y, pl[1] * b->max.y) +
+                    fmaxf(pl[2] * b->min.z, pl[2] * b->max.z) + pl[3];
+        if (far < 0.0f) return false;
+    }
+    return true;
+}
+
+static int compare_u32(const void* a, const void* b){
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Frustum query against a scan over the instance bounds, as sorted sets.
+static bool check_frustum_query(const SceneBvh* scene, const Frustum* frustum, uint32_t* found, uint32_t* expected){
+    int count = QuerySceneBvhFrustum(scene, frustum, found, scene->count);
+    int n = 0;
+    for (int i = 0; i < scene->count; i++) {
+        if (box_touches_frustum(&scene->bounds[i], frustum)) expected[n++] = (uint32_t)i;
+    }
+    if (count != n) return false;
+    qsort(found, (size_t)count, sizeof(uint32_t), compare_u32);
+    return memcmp(found, expected, (size_t)n * sizeof(uint32_t)) == 0;
+}
+
+static int BenchBvh(void){
+    int failures = 0;
+    uint32_t seed = 4242u;
+    const char* paths[] = {"ship.obj", "ship_2.obj"};
+    Mesh meshes[2];
+    MeshBvh bvhs[2];
+
+    printf("== bvh ==\n");
+    printf("%-12s %8s %8s %10s %14s %14s %10s\n", "mesh", "tris", "nodes", "build ms", "BVH Mrays/s", "scan Mrays/s", "box hits");
+    for (int f = 0; f < 2; f++) {
+        meshes[f] = LoadObjFromFile(paths[f], (Vec3){0});
+        Mesh* mesh = &meshes[f];
+        double buildTime = 1e9;
+        for (int run = 0; run < 5; run++) {
+            double start = now_seconds();
+            BuildMeshBvh(&bvhs[f], mesh);
+            double elapsed = now_seconds() - start;
+            if (elapsed < buildTime) buildTime = elapsed;
+            if (run < 4) FreeMeshBvh(&bvhs[f]);
+        }
+        MeshBvh* bvh = &bvhs[f];
+
+        // rays from a sphere around the mesh toward points inside its bounds
+        enum { RAYS = 100000, SCAN_RAYS = 1000, BOXES = 1000 };
+        Vec3* origins = malloc(RAYS * sizeof(Vec3));
+        Vec3* dirs = malloc(RAYS * sizeof(Vec3));
+        Vec3 center = {(bvh->bounds.min.x + bvh->bounds.max.x) * 0.5f, (bvh->bounds.min.y + bvh->bounds.max.y) * 0.5f, (bvh->bounds.min.z + bvh->bounds.max.z) * 0.5f};
+        for (int r = 0; r < RAYS; r++) {
+            Vec3 a = {random_range(&seed, -1, 1), random_range(&seed, -1, 1), random_range(&seed, -1, 1)};
+            float len = sqrtf(a.x * a.x + a.y * a.y + a.z * a.z) + 1e-6f;
+            float reach = mesh->bounds_radius * 2.0f / len;
+            origins[r] = (Vec3){center.x + a.x * reach, center.y + a.y * reach, center.z + a.z * reach};
+            Vec3 target = random_point(&seed, bvh->bounds);
+            dirs[r] = (Vec3){target.x - origins[r].x, target.y - origins[r].y, target.z - origins[r].z};
+        }
+
+        int hits = 0;
+        double start = now_seconds();
+        for (int r = 0; r < RAYS; r++) hits += RaycastMeshBvh(bvh, origins[r], dirs[r], INFINITY, NULL);
+        double bvhTime = now_seconds() - start;
+
+        float scanT[SCAN_RAYS];
+        bool scanHit[SCAN_RAYS];
+        start = now_seconds();
+        for (int r = 0; r < SCAN_RAYS; r++) scanHit[r] = brute_raycast(mesh, origins[r], dirs[r], INFINITY, &scanT[r]);
+        double scanTime = now_seconds() - start;
+        int mismatches = 0;
+        for (int r = 0; r < SCAN_RAYS; r++) {
+            BvhHit hit;
+            bool found = RaycastMeshBvh(bvh, origins[r], dirs[r], INFINITY, &hit);
+            mismatches += !same_hit(found, hit.t, scanHit[r], scanT[r]);
+        }
+        if (mismatches || hits == 0) {
+            printf("[ERROR]: %s: %d of %d rays differ from the linear scan, %d hits\n", paths[f], mismatches, SCAN_RAYS, hits);
+            failures++;
+        }
+
+        int boxHits = 0;
+        uint32_t* found = malloc((size_t)(mesh->index_count / 3) * sizeof(uint32_t));
+        for (int b = 0; b < BOXES; b++) {
+            Vec3 p = random_point(&seed, bvh->bounds);
+            float h = mesh->bounds_radius * 0.1f;
+            BvhBounds box = { {p.x - h, p.y - h, p.z - h}, {p.x + h, p.y + h, p.z + h} };
+            int count = QueryMeshBvhBox(bvh, box, found, mesh->index_count / 3);
+            int expected = 0;
+            for (int t = 0; t < mesh->index_count / 3; t++) {
+                BvhBounds tb = { {INFINITY, INFINITY, INFINITY}, {-INFINITY, -INFINITY, -INFINITY} };
+                for (int c = 0; c < 3; c++) {
+                    uint32_t i = mesh->index_stride == 2 ? ((const uint16_t*)mesh->indices)[t * 3 + c] : ((const uint32_t*)mesh->indices)[t * 3 + c];
+                    Vec3 v = mesh->vertices[i].position;
+                    tb.min = (Vec3){fminf(tb.min.x, v.x), fminf(tb.min.y, v.y), fminf(tb.min.z, v.z)};
+                    tb.max = (Vec3){fmaxf(tb.max.x, v.x), fmaxf(tb.max.y, v.y), fmaxf(tb.max.z, v.z)};
+                }
+                expected += tb.min.x <= box.max.x && tb.max.x >= box.min.x && tb.min.y <= box.max.y &&
+                            tb.max.y >= box.min.y && tb.min.z <= box.max.z && tb.max.z >= box.min.z;
+            }
+            if (count != expected) {
+                printf("[ERROR]: %s: box query found %d triangles, the scan %d\n", paths[f], count, expected);
+                failures++;
+                break;
+            }
+            boxHits += count;
+        }
+
+        double scanRate = SCAN_RAYS / scanTime * 1e-6;
+        printf("%-12s %8d %8d %10.3f %14.2f %14.3f %10d\n", paths[f], mesh->index_count / 3, bvh->bvh.node_count,
+               buildTime * 1e3, RAYS / bvhTime * 1e-6, scanRate, boxHits);
+        record_result("bvh", paths[f], "build_ms", buildTime * 1e3);
+        record_result("bvh", paths[f], "bvh_mrays_per_s", RAYS / bvhTime * 1e-6);
+        record_result("bvh", paths[f], "scan_mrays_per_s", scanRate);
+        free(found);
+        free(origins);
+        free(dirs);
+    }
+
+    // top level: a block of alternating ships
+    const int count = 10000;
+    InstanceData* grid = malloc((size_t)count * sizeof(InstanceData));
+    BuildInstanceGrid(grid, count, &meshes[0], 1.0f);
+    SceneBvh scene;
+    InitSceneBvh(&scene, count);
+    for (int i = 0; i < count; i++) {
+        Mat4 transform;
+        InstanceMatrix(&grid[i], transform.m);
+        AddBvhInstance(&scene, &bvhs[i & 1], transform);
+    }
+    double start = now_seconds();
+    RebuildSceneBvh(&scene);
+    double buildTime = now_seconds() - start;
+
+    uint32_t* found = malloc((size_t)count * sizeof(uint32_t));
+    uint32_t* expected = malloc((size_t)count * sizeof(uint32_t));
+    Mat4 view = Mat4Multiply(Mat4RotationY(0.5f), Mat4Translation((Vec3){0.0f, 0.0f, -40.0f}));
+    Mat4 viewProj = Mat4Multiply(Mat4Perspective(1.0f, 1.3f, 0.1f, 200.0f), view);
+    Frustum frustum = ExtractFrustum(viewProj.m);
+    if (!check_frustum_query(&scene, &frustum, found, expected)) {
+        printf("[ERROR]: scene frustum query differs from the scan\n");
+        failures++;
+    }
+
+    // move a tenth of the ships, refit, and check again
+    for (int i = 0; i < count; i += 10) {
+        Mat4 transform = Mat4Multiply(Mat4Translation((Vec3){random_range(&seed, -5, 5), random_range(&seed, -5, 5), random_range(&seed, -5, 5)}), scene.instances[i].transform);
+        SetBvhInstanceTransform(&scene, i, transform);
+    }
+    start = now_seconds();
+    RefitSceneBvh(&scene);
+    double refitTime = now_seconds() - start;
+    if (!check_frustum_query(&scene, &frustum, found, expected)) {
+        printf("[ERROR]: scene frustum query differs from the scan after refit\n");
+        failures++;
+    }
+
+    BvhBounds sceneBounds = { {INFINITY, INFINITY, INFINITY}, {-INFINITY, -INFINITY, -INFINITY} };
+    for (int i = 0; i < count; i++) {
+        sceneBounds.min = (Vec3){fminf(sceneBounds.min.x, scene.bounds[i].min.x), fminf(sceneBounds.min.y, scene.bounds[i].min.y), fminf(sceneBounds.min.z, scene.bounds[i].min.z)};
+        sceneBounds.max = (Vec3){fmaxf(sceneBounds.max.x, scene.bounds[i].max.x), fmaxf(sceneBounds.max.y, scene.bounds[i].max.y), fmaxf(sceneBounds.max.z, scene.bounds[i].max.z)};
+    }
+    enum { SCENE_RAYS = 20000, SCENE_SCAN_RAYS = 100 };
+    int mismatches = 0, hits = 0;
+    double rayTime = 0.0;
+    for (int r = 0; r < SCENE_RAYS; r++) {
+        Vec3 o = random_point(&seed, sceneBounds), t = random_point(&seed, sceneBounds);
+        Vec3 d = {t.x - o.x, t.y - o.y, t.z - o.z};
+        BvhHit hit;
+        double rayStart = now_seconds();
+        bool any = RaycastSceneBvh(&scene, o, d, INFINITY, &hit);
+        rayTime += now_seconds() - rayStart;
+        hits += any;
+        if (r >= SCENE_SCAN_RAYS) continue;
+
+        // every instance's own BVH, in object space
+        float best = INFINITY;
+        bool scan = false;
+        for (int i = 0; i < count; i++) {
+            const Mat4* inv = &scene.instances[i].inverse;
+            Vec3 lo = Mat4TransformPoint(*inv, o);
+            Vec3 ld = {inv->m[0] * d.x + inv->m[4] * d.y + inv->m[8] * d.z, inv->m[1] * d.x + inv->m[5] * d.y + inv->m[9] * d.z, inv->m[2] * d.x + inv->m[6] * d.y + inv->m[10] * d.z};
+            BvhHit local;
+            if (RaycastMeshBvh(scene.instances[i].mesh, lo, ld, best, &local)) {
+                best = local.t;
+                scan = true;
+            }
+        }
+        mismatches += !same_hit(any, hit.t, scan, best);
+    }
+    if (mismatches) {
+        printf("[ERROR]: %d of %d scene rays differ from testing every instance\n", mismatches, SCENE_SCAN_RAYS);
+        failures++;
+    }
+
+    start = now_seconds();
+    RebuildSceneBvh(&scene);
+    double rebuildTime = now_seconds() - start;
+
+    printf("%d instances: build %.3f ms, refit of %d moved %.3f ms, rebuild %.3f ms, %.2f Mrays/s (%d hits)\n",
+           count, buildTime * 1e3, count / 10, refitTime * 1e3, rebuildTime * 1e3, SCENE_RAYS / rayTime * 1e-6, hits);
+    record_result("bvh", "10k instances", "build_ms", buildTime * 1e3);
+    record_result("bvh", "10k instances", "refit_ms", refitTime * 1e3);
+    record_result("bvh", "10k instances", "mrays_per_s", SCENE_RAYS / rayTime * 1e-6);
+
+    free(found);
+    free(expected);
+    free(grid);
+    DestroySceneBvh(&scene);
+    for (int f = 0; f < 2; f++) {
+        FreeMeshBvh(&bvhs[f]);
+        FreeMesh(&meshes[f]);
+    }
+    return failures;
+}
+
+static int compare_triangles(const void* a, const void* b){
+    const uint32_t* x = a;
+    const uint32_t* y = b;
+    for (int i = 0; i < 3; i++) {
+        if (x[i] != y[i]) return x[i] < y[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// Structure of a meshlet split: ranges tile the index list in order, stay in
+// the limits and keep every vertex inside the bounding sphere, and the
+// triangles are the input triangles, only reordered.
+static int check_meshlets(const char* path, const Meshlet* meshlets, int count, const uint32_t* indices, const uint32_t* ordered, int indexCount, const Vertex* vertices, int vertexCount){
+    int failures = 0;
+    uint32_t* stamp = calloc((size_t)vertexCount, sizeof(uint32_t));
+    uint32_t next = 0;
+    for (int i = 0; i < count && failures == 0; i++) {
+        const Meshlet* m = &meshlets[i];
+        uint32_t unique = 0;
+        for (uint32_t c = 0; c < m->triangle_count * 3; c++) {
+            uint32_t v = ordered[m->first_index + c];
+            if (stamp[v] != (uint32_t)i + 1) {
+                stamp[v] = (uint32_t)i + 1;
+                unique++;
+            }
+            Vec3 d = {vertices[v].position.x - m->center.x, vertices[v].position.y - m->center.y, vertices[v].position.z - m->center.z};
+            if (sqrtf(d.x * d.x + d.y * d.y + d.z * d.z) > m->radius * 1.0001f + 1e-6f) {
+                printf("[ERROR]: %s: meshlet %d does not enclose vertex %u\n", path, i, v);
+                failures++;
+                break;
+            }
+        }
+        if (m->first_index != next || m->triangle_count == 0 || m->triangle_count > MESHLET_MAX_TRIANGLES ||
+            unique != m->vertex_count || m->vertex_count > MESHLET_MAX_VERTICES) {
+            printf("[ERROR]: %s: meshlet %d has range %u+%u, %u vertices (%u counted)\n", path, i, m->first_index, m->triangle_count, m->vertex_count, unique);
+            failures++;
+        }
+        next = m->first_index + m->triangle_count * 3;
+    }
+    if (failures == 0 && next != (uint32_t)indexCount) {
+        printf("[ERROR]: %s: meshlets cover %u of %d indices\n", path, next, indexCount);
+        failures++;
+    }
+
+    size_t bytes = (size_t)indexCount * sizeof(uint32_t);
+    uint32_t* a = malloc(bytes);
+    uint32_t* b = malloc(bytes);
+    memcpy(a, indices, bytes);
+    memcpy(b, ordered, bytes);
+    qsort(a, (size_t)indexCount / 3, 3 * sizeof(uint32_t), compare_triangles);
+    qsort(b, (size_t)indexCount / 3, 3 * sizeof(uint32_t), compare_triangles);
+    if (memcmp(a, b, bytes) != 0) {
+        printf("[ERROR]: %s: meshlet order lost or changed triangles\n", path);
+        failures++;
+    }
+    free(a);
+    free(b);
+    free(stamp);
+    return failures;
+}
+
+// True if no triangle of the meshlet faces the camera.
+static bool meshlet_back_facing(const Meshlet* m, const uint32_t* indices, const Vertex* vertices, Vec3 camera){
+    for (uint32_t t = 0; t < m->triangle_count; t++) {
+        const uint32_t* tri = &indices[m->first_index + t * 3];
+        Vec3 p0 = vertices[tri[0]].position, p1 = vertices[tri[1]].position, p2 = vertices[tri[2]].position;
+        Vec3 e1 = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+        Vec3 e2 = {p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+        Vec3 n = {e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x};
+        Vec3 d = {p0.x - camera.x, p0.y - camera.y, p0.z - camera.z};
+        float nd = n.x * d.x + n.y * d.y + n.z * d.z;
+        float scale = sqrtf((n.x * n.x + n.y * n.y + n.z * n.z) * (d.x * d.x + d.y * d.y + d.z * d.z));
+        if (nd < -1e-4f * scale) return false;
+    }
+    return true;
+}
+
+// Meshlet build on the optimized meshes, then culling from cameras circling
+// each mesh and looking past it at random. Every meshlet the cone test
+// drops is checked against its triangles, which all have to face away.
+static int BenchMeshlets(void){
+    int failures = 0;
+    uint32_t seed = 9001u;
+    Mat4 proj = Mat4Perspective(70.0f * 3.14159265f / 180.0f, 900.0f / 700.0f, 0.1f, 1000.0f);
+
+    printf("== meshlets (at most %d vertices, %d triangles) ==\n", MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+    printf("%-12s %8s %8s %8s %10s %8s %8s %10s %10s %12s\n", "file", "tris", "meshlets", "avg tris", "build ms", "acmr", "ordered",
+           "frustum %", "backface %", "cull ns/mlt");
+
+    for (int f = 0; f < OBJ_FILE_COUNT; f++) {
+        const char* path = objFiles[f];
+        Mesh mesh = LoadObjFromFile(path, (Vec3){0});
+        OptimizeMesh(&mesh, NULL, NULL);
+        int indexCount = mesh.index_count, triangleCount = indexCount / 3;
+        uint32_t* indices = malloc((size_t)indexCount * sizeof(uint32_t));
+        uint32_t* ordered = malloc((size_t)indexCount * sizeof(uint32_t));
+        for (int i = 0; i < indexCount; i++) indices[i] = GetMeshIndex(&mesh, i);
+        Meshlet* meshlets = malloc((size_t)triangleCount * sizeof(Meshlet));
+
+        int count = 0;
+        double buildTime = 1e9;
+        for (int run = 0; run < 5; run++) {
+            double start = now_seconds();
+            count = BuildMeshlets(meshlets, ordered, indices, indexCount, mesh.vertices, mesh.vertex_count);
+            double elapsed = now_seconds() - start;
+            if (elapsed < buildTime) buildTime = elapsed;
+        }
+        failures += check_meshlets(path, meshlets, count, indices, ordered, indexCount, mesh.vertices, mesh.vertex_count);
+        VertexCacheStats before = AnalyzeVertexCache(indices, indexCount, mesh.vertex_count, VERTEX_CACHE_SIZE);
+        VertexCacheStats after = AnalyzeVertexCache(ordered, indexCount, mesh.vertex_count, VERTEX_CACHE_SIZE);
+
+        // cameras on a circle around the mesh, each looking up to 40 degrees
+        // past the center so part of the mesh leaves the frustum
+        enum { VIEWS = 64, CULL_RUNS = 200 };
+        Vec3 center = {(mesh.bounds_min.x + mesh.bounds_max.x) * 0.5f, (mesh.bounds_min.y + mesh.bounds_max.y) * 0.5f, (mesh.bounds_min.z + mesh.bounds_max.z) * 0.5f};
+        Frustum frustums[VIEWS];
+        Vec3 cameras[VIEWS];
+        for (int v = 0; v < VIEWS; v++) {
+            float angle = 6.2831853f * (float)v / VIEWS;
+            float distance = mesh.bounds_radius * random_range(&seed, 1.2f, 3.0f);
+            cameras[v] = (Vec3){center.x + sinf(angle) * distance, center.y + random_range(&seed, -0.5f, 0.5f) * mesh.bounds_radius, center.z + cosf(angle) * distance};
+            Mat4 clip = CameraClipMatrix(proj, cameras[v], angle + random_range(&seed, -0.7f, 0.7f), 0.0f);
+            frustums[v] = ExtractFrustum(clip.m);
+        }
+
+        MeshletDraw* draws = malloc((size_t)count * sizeof(MeshletDraw));
+        bool* covered = malloc((size_t)count * sizeof(bool));
+        MeshletCullStats stats = {0};
+        for (int v = 0; v < VIEWS && failures == 0; v++) {
+            MeshletCullStats viewStats = {0};
+            int drawCount = CullMeshlets(meshlets, count, &frustums[v], cameras[v], draws, &viewStats);
+            stats.frustum_culled += viewStats.frustum_culled;
+            stats.backface_culled += viewStats.backface_culled;
+
+            // mark the meshlets the merged draws cover; everything else was
+            // culled and has to be outside the frustum or facing away
+            memset(covered, 0, (size_t)count * sizeof(bool));
+            uint32_t drawn = 0, expected = 0;
+            for (int d = 0, i = 0; d < drawCount; d++) {
+                while (i < count && meshlets[i].first_index < draws[d].first_index) i++;
+                for (; i < count && meshlets[i].first_index < draws[d].first_index + draws[d].index_count; i++) {
+                    covered[i] = true;
+                    expected += meshlets[i].triangle_count * 3;
+                }
+            }
+            for (int i = 0; i < count; i++) {
+                const Meshlet* m = &meshlets[i];
+                if (covered[i] || !SphereInFrustum(&frustums[v], m->center, m->radius)) continue;
+                if (!meshlet_back_facing(m, ordered, mesh.vertices, cameras[v])) {
+                    printf("[ERROR]: %s: view %d culled meshlet %d, which faces the camera\n", path, v, i);
+                    failures++;
+                    break;
+                }
+            }
+            for (int i = 0; i < drawCount; i++) drawn += draws[i].index_count;
+            if (failures == 0 && drawn != expected) {
+                printf("[ERROR]: %s: view %d draws %u indices, its meshlets hold %u\n", path, v, drawn, expected);
+                failures++;
+            }
+        }
+
+        volatile int sink = 0;
+        double start = now_seconds();
+        for (int run = 0; run < CULL_RUNS; run++) {
+            for (int v = 0; v < VIEWS; v++) sink += CullMeshlets(meshlets, count, &frustums[v], cameras[v], draws, NULL);
+        }
+        double cullTime = now_seconds() - start;
+        (void)sink;
+
+        double tests = (double)count * VIEWS;
+        double frustumPct = 100.0 * stats.frustum_culled / tests, backfacePct = 100.0 * stats.backface_culled / tests;
+        double nsPerMeshlet = cullTime * 1e9 / (tests * CULL_RUNS);
+        printf("%-12s %8d %8d %8.1f %10.3f %8.3f %8.3f %10.1f %10.1f %12.2f\n", path, triangleCount, count, (double)triangleCount / count,
+               buildTime * 1e3, before.acmr, after.acmr, frustumPct, backfacePct, nsPerMeshlet);
+        record_result("meshlets", path, "meshlets", count);
+        record_result("meshlets", path, "build_ms", buildTime * 1e3);
+        record_result("meshlets", path, "acmr_ordered", after.acmr);
+        record_result("meshlets", path, "frustum_culled_pct", frustumPct);
+        record_result("meshlets", path, "backface_culled_pct", backfacePct);
+        record_result("meshlets", path, "cull_ns_per_meshlet", nsPerMeshlet);
+
+        free(draws);
+        free(covered);
+        free(meshlets);
+        free(indices);
+        free(ordered);
+        FreeMesh(&mesh);
+    }
+    return failures;
+}
+
+static Mat4 random_matrix(uint32_t* state){
+    Mat4 m;
+    for (int i = 0; i < 16; i++) m.m[i] = random_range(state, -4.0f, 4.0f);
+    return m;
+}
+
+static float max_abs_difference(const float* a, const float* b, int count){
+    float worst = 0.0f;
+    for (int i = 0; i < count; i++) worst = fmaxf(worst, fabsf(a[i] - b[i]));
+    return worst;
+}
+
+static int BenchMat4(void){
+    int failures = 0;
+    uint32_t seed = 777u;
+
+    // the SIMD product sums in the same order as the scalar one, so the two
+    // have to agree bit for bit
+    for (int i = 0; i < 10000; i++) {
+        Mat4 a = random_matrix(&seed), b = random_matrix(&seed);
+        Mat4 simd = Mat4Multiply(a, b), scalar = Mat4MultiplyScalar(a, b);
+        if (memcmp(&simd, &scalar, sizeof(Mat4)) != 0) {
+            printf("[ERROR]: Mat4Multiply differs from the scalar reference at pair %d\n", i);
+            failures++;
+            break;
+        }
+
+        Vec3 p = {random_range(&seed, -10.0f, 10.0f), random_range(&seed, -10.0f, 10.0f), random_range(&seed, -10.0f, 10.0f)};
+        Vec3 q = Mat4TransformPoint(a, p);
+        Mat4 point = Mat4MultiplyScalar(a, Mat4Translation(p));
+        if (max_abs_difference(&q.x, &point.m[12], 3) > 1e-4f) {
+            printf("[ERROR]: Mat4TransformPoint differs from the reference at pair %d\n", i);
+            failures++;
+            break;
+        }
+
+        // transpose(upper 3x3 of a) * normal matrix has to be the identity
+        NormalMatrix n = Mat4NormalMatrix(a);
+        float det = a.m[0] * (a.m[5] * a.m[10] - a.m[9] * a.m[6]) - a.m[4] * (a.m[1] * a.m[10] - a.m[9] * a.m[2]) + a.m[8] * (a.m[1] * a.m[6] - a.m[5] * a.m[2]);
+        if (fabsf(det) < 1.0f) continue;
+        float product[9], identity[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                product[c * 3 + r] = a.m[r * 4 + 0] * n.m[c * 4 + 0] + a.m[r * 4 + 1] * n.m[c * 4 + 1] + a.m[r * 4 + 2] * n.m[c * 4 + 2];
+            }
+        }
+        if (max_abs_difference(product, identity, 9) > 1e-4f) {
+            printf("[ERROR]: Mat4NormalMatrix is not the inverse transpose at pair %d\n", i);
+            failures++;
+            break;
+        }
+    }
+
+    // rotations compose by adding angles and translations move points
+    Mat4 composed = Mat4Multiply(Mat4RotationY(0.3f), Mat4RotationY(0.4f));
+    Mat4 direct = Mat4RotationY(0.7f);
+    if (max_abs_difference(composed.m, direct.m, 16) > 1e-6f) {
+        printf("[ERROR]: Mat4RotationY does not compose\n");
+        failures++;
+    }
+    Vec3 moved = Mat4TransformPoint(Mat4Multiply(Mat4Translation((Vec3){1, 2, 3}), Mat4RotationX(1.5707963f)), (Vec3){0, 1, 0});
+    if (fabsf(moved.x - 1.0f) > 1e-6f || fabsf(moved.y - 2.0f) > 1e-6f || fabsf(moved.z - 4.0f) > 1e-6f) {
+        printf("[ERROR]: Mat4RotationX or Mat4Translation is wrong: %f %f %f\n", moved.x, moved.y, moved.z);
+        failures++;
+    }
+
+    // the perspective maps near to depth 0 and far to depth 1
+    Mat4 proj = Mat4Perspective(1.2217305f, 900.0f / 700.0f, 0.1f, 1000.0f);
+    float depths[2] = {0.1f, 1000.0f}, expected[2] = {0.0f, 1.0f};
+    for (int i = 0; i < 2; i++) {
+        float z = -depths[i];
+        float depth = (proj.m[10] * z + proj.m[14]) / (proj.m[11] * z + proj.m[15]);
+        if (fabsf(depth - expected[i]) > 1e-5f) {
+            printf("[ERROR]: Mat4Perspective maps z=%f to depth %f\n", z, depth);
+            failures++;
+        }
+    }
+
+    printf("== mat4 ==\n");
+    printf("%-14s %12s\n", "multiply", "ns");
+    // independent products, like building one MVP per draw
+    const int batch = 4096, rounds = 500;
+    Mat4* lhs = malloc(batch * sizeof(Mat4));
+    Mat4* rhs = malloc(batch * sizeof(Mat4));
+    Mat4* out = malloc(batch * sizeof(Mat4));
+    for (int i = 0; i < batch; i++) {
+        lhs[i] = random_matrix(&seed);
+        rhs[i] = random_matrix(&seed);
+    }
+
+    double start = now_seconds();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < batch; i++) out[i] = Mat4MultiplyScalar(lhs[i], rhs[(i + r) & (batch - 1)]);
+    }
+    double scalarTime = now_seconds() - start;
+    float scalarCheck = out[batch - 1].m[5];
+
+    start = now_seconds();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < batch; i++) out[i] = Mat4Multiply(lhs[i], rhs[(i + r) & (batch - 1)]);
+    }
+    double simdTime = now_seconds() - start;
+
+    double products = (double)batch * rounds;
+    printf("%-14s %12.3f\n", "scalar", scalarTime * 1e9 / products);
+    printf("%-14s %12.3f\n", "simd", simdTime * 1e9 / products);
+    record_result("mat4", "multiply", "scalar_ns", scalarTime * 1e9 / products);
+    record_result("mat4", "multiply", "simd_ns", simdTime * 1e9 / products);
+    if (out[batch - 1].m[5] != scalarCheck) {
+        printf("[ERROR]: batched SIMD and scalar products differ\n");
+        failures++;
+    }
+
+    free(lhs);
+    free(rhs);
+    free(out);
+    return failures;
+}
+
+static int BenchProfiler(void){
+    int failures = 0;
+
+    // frame times 1..100 ms in shuffled order, nearest-rank percentiles
+    Profiler profiler;
+    InitProfiler(&profiler, false);
+    for (int i = 0; i < 100; i++) {
+        profiler.frame_ms[i] = (float)((i * 37) % 100 + 1);
+    }
+    profiler.frame_count = 100;
+    FrameTimeStats stats = GetFrameTimeStats(&profiler);
+    if (stats.p50_ms != 50.0f || stats.p95_ms != 95.0f || stats.p99_ms != 99.0f || stats.max_ms != 100.0f) {
+        printf("[ERROR]: frame time percentiles %.1f/%.1f/%.1f/%.1f, expected 50/95/99/100\n",
+               stats.p50_ms, stats.p95_ms, stats.p99_ms, stats.max_ms);
+        failures++;
+    }
+    DestroyProfiler(&profiler);
+
+    // what a scope costs with and without the trace buffer
+    printf("== profiler ==\n");
+    printf("%-14s %12s\n", "scope", "ns");
+    for (int tracing = 0; tracing < 2; tracing++) {
+        InitProfiler(&profiler, tracing != 0);
+        const int scopes = 200000;
+        double start = now_seconds();
+        for (int i = 0; i < scopes; i++) {
+            PROFILE_SCOPE(&profiler, "bench scope") {
+            }
+        }
+        double elapsed = now_seconds() - start;
+        printf("%-14s %12.3f\n", tracing ? "tracing" : "stats only", elapsed * 1e9 / scopes);
+        record_result("profiler", tracing ? "tracing" : "stats only", "scope_ns", elapsed * 1e9 / scopes);
+
+        if (profiler.scope_count != 1 || profiler.scopes[0].count != (uint32_t)scopes) {
+            printf("[ERROR]: profiler counted %u scopes, expected %d\n", profiler.scope_count ? profiler.scopes[0].count : 0, scopes);
+            failures++;
+        }
+        if (tracing && profiler.event_count != scopes) {
+            printf("[ERROR]: trace holds %d events, expected %d\n", profiler.event_count, scopes);
+            failures++;
+        }
+        DestroyProfiler(&profiler);
+    }
+
+    return failures;
+}
+
+static void fill_noise(uint8_t* pixels, size_t bytes, uint32_t* state){
+    for (size_t i = 0; i < bytes; i++) {
+        *state = *state * 1664525u + 1013904223u;
+        pixels[i] = (uint8_t)(*state >> 24);
+    }
+}
+
+// Raw test images for the cache roundtrip: width, height, then RGBA8 rows.
+static int rawDecodes;
+
+static bool decode_raw(const void* data, size_t size, uint8_t* rgba, uint32_t pitch, uint32_t* width, uint32_t* height){
+    uint32_t dims[2];
+    if (size < sizeof(dims)) return false;
+    memcpy(dims, data, sizeof(dims));
+    size_t rowBytes = (size_t)dims[0] * 4;
+    if (size != sizeof(dims) + rowBytes * dims[1]) return false;
+    *width = dims[0];
+    *height = dims[1];
+    if (!rgba) return true;
+    for (uint32_t y = 0; y < dims[1]; y++) {
+        memcpy(rgba + (size_t)y * pitch, (const uint8_t*)data + sizeof(dims) + y * rowBytes, rowBytes);
+    }
+    rawDecodes++;
+    return true;
+}
+
+static bool same_mips(const TextureMips* a, const TextureMips* b){
+    return a->width == b->width && a->height == b->height && a->level_count == b->level_count &&
+           a->size == b->size && memcmp(a->pixels, b->pixels, a->size) == 0;
+}
+
+static int BenchTextureMips(void){
+    int failures = 0;
+    uint32_t seed = 4242u;
+
+    const uint32_t levelSizes[][3] = {{1, 1, 1}, {5, 3, 3}, {40, 40, 6}, {256, 256, 9}, {1024, 1, 11}, {257, 131, 9}};
+    for (size_t i = 0; i < sizeof(levelSizes) / sizeof(levelSizes[0]); i++) {
+        int levels = TextureMipLevelCount(levelSizes[i][0], levelSizes[i][1]);
+        if (levels != (int)levelSizes[i][2]) {
+            printf("[ERROR]: %ux%u has %d mip levels, expected %u\n", levelSizes[i][0], levelSizes[i][1], levels, levelSizes[i][2]);
+            failures++;
+        }
+    }
+
+    // odd sizes exercise the clamped edge samples and the scalar tail, and
+    // the padded pitch the row copy
+    const uint32_t sizes[][2] = {{1, 1}, {2, 2}, {3, 7}, {40, 40}, {257, 131}, {1000, 3}};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint32_t w = sizes[i][0], h = sizes[i][1], pitch = w * 4 + 12;
+        uint8_t* image = malloc((size_t)pitch * h);
+        fill_noise(image, (size_t)pitch * h, &seed);
+        TextureMips simd, scalar;
+        if (!BuildTextureMips(image, w, h, pitch, &simd) || !BuildTextureMipsScalar(image, w, h, pitch, &scalar)) {
+            printf("[ERROR]: could not build mips for %ux%u\n", w, h);
+            failures++;
+        } else {
+            if (!same_mips(&simd, &scalar)) {
+                printf("[ERROR]: SIMD mips differ from the scalar reference at %ux%u\n", w, h);
+                failures++;
+            }
+            for (uint32_t y = 0; y < h; y++) {
+                if (memcmp(simd.pixels + (size_t)y * w * 4, image + (size_t)y * pitch, (size_t)w * 4) != 0) {
+                    printf("[ERROR]: mip level 0 is not a copy of the image at %ux%u\n", w, h);
+                    failures++;
+                    break;
+                }
+            }
+            FreeTextureMips(&scalar);
+        }
+        FreeTextureMips(&simd);
+        free(image);
+    }
+
+    // a black and white checker has to average to half the light, which is
+    // sRGB 188, not the 128 a filter in gamma space would give
+    uint8_t checker[4 * 4 * 4];
+    for (int p = 0; p < 16; p++) {
+        uint8_t v = ((p & 1) ^ ((p >> 2) & 1)) ? 255 : 0;
+        checker[p * 4 + 0] = checker[p * 4 + 1] = checker[p * 4 + 2] = v;
+        checker[p * 4 + 3] = v;
+    }
+    TextureMips gamma;
+    if (BuildTextureMips(checker, 4, 4, 16, &gamma)) {
+        const uint8_t* last = gamma.pixels + gamma.level_offset[gamma.level_count - 1];
+        if (abs(last[0] - 188) > 1 || abs(last[3] - 128) > 1) {
+            printf("[ERROR]: checker averages to color %d alpha %d, expected 188 and 128\n", last[0], last[3]);
+            failures++;
+        }
+        FreeTextureMips(&gamma);
+    }
+
+    printf("== texture mips ==\n");
+    printf("%-14s %12s %12s\n", "size", "scalar MP/s", "simd MP/s");
+    const uint32_t benchSizes[] = {256, 1024, 2048};
+    for (size_t i = 0; i < sizeof(benchSizes) / sizeof(benchSizes[0]); i++) {
+        uint32_t size = benchSizes[i];
+        uint8_t* image = malloc((size_t)size * size * 4);
+        fill_noise(image, (size_t)size * size * 4, &seed);
+        int rounds = (int)(4096u * 4096u / (size * size));
+        if (rounds < 2) rounds = 2;
+
+        double best[2] = {1e9, 1e9};
+        for (int pass = 0; pass < 2; pass++) {
+            for (int r = 0; r < rounds; r++) {
+                TextureMips mips;
+                double start = now_seconds();
+                if (pass == 0) BuildTextureMipsScalar(image, size, size, size * 4, &mips);
+                else BuildTextureMips(image, size, size, size * 4, &mips);
+                double elapsed = now_seconds() - start;
+                if (elapsed < best[pass]) best[pass] = elapsed;
+                FreeTextureMips(&mips);
+            }
+        }
+        // rate in source megapixels, the unit texture budgets are set in
+        double megapixels = (double)size * size / 1e6;
+        char name[32];
+        snprintf(name, sizeof(name), "%ux%u", size, size);
+        printf("%-14s %12.1f %12.1f\n", name, megapixels / best[0], megapixels / best[1]);
+        record_result("texture_mips", name, "scalar_mpix_per_s", megapixels / best[0]);
+        record_result("texture_mips", name, "simd_mpix_per_s", megapixels / best[1]);
+        free(image);
+    }
+
+    // cold load builds and writes the cache, the warm one only maps it
+    const char* rawPath = "bench_texture.raw";
+    const char* cachePath = "bench_texture.raw.texcache";
+    uint32_t dims[2] = {512, 384};
+    size_t rawBytes = (size_t)dims[0] * dims[1] * 4;
+    uint8_t* raw = malloc(rawBytes);
+    fill_noise(raw, rawBytes, &seed);
+    FILE* file = fopen(rawPath, "wb");
+    if (file) {
+        fwrite(dims, sizeof(dims), 1, file);
+        fwrite(raw, 1, rawBytes, file);
+        fclose(file);
+    }
+    remove(cachePath);
+
+    rawDecodes = 0;
+    TextureMips cold = {0}, warm = {0}, reference = {0};
+    TextureLoadInfo coldInfo = {0}, warmInfo = {0};
+    bool loaded = LoadTextureCached(rawPath, decode_raw, &cold, &coldInfo) && LoadTextureCached(rawPath, decode_raw, &warm, &warmInfo);
+    BuildTextureMips(raw, dims[0], dims[1], dims[0] * 4, &reference);
+    if (!loaded || coldInfo.cache_hit || !warmInfo.cache_hit || rawDecodes != 1 || !warm.cache) {
+        printf("[ERROR]: texture cache roundtrip: cold hit %d, warm hit %d, %d decodes\n", coldInfo.cache_hit, warmInfo.cache_hit, rawDecodes);
+        failures++;
+    } else if (!same_mips(&cold, &reference) || !same_mips(&warm, &reference)) {
+        printf("[ERROR]: cached mips differ from freshly built ones\n");
+        failures++;
+    }
+    printf("%-14s %9.3f ms cold, %9.3f ms warm\n", "texture cache", coldInfo.seconds * 1e3, warmInfo.seconds * 1e3);
+    record_result("texture_cache", "512x384", "cold_ms", coldInfo.seconds * 1e3);
+    record_result("texture_cache", "512x384", "warm_ms", warmInfo.seconds * 1e3);
+    FreeTextureMips(&cold);
+    FreeTextureMips(&warm);
+    FreeTextureMips(&reference);
+
+    // an edited source must not be served from the stale cache
+    raw[0] ^= 0xFF;
+    file = fopen(rawPath, "wb");
+    if (file) {
+        fwrite(dims, sizeof(dims), 1, file);
+        fwrite(raw, 1, rawBytes, file);
+        fclose(file);
+    }
+    TextureMips edited = {0};
+    TextureLoadInfo editedInfo = {0};
+    if (!LoadTextureCached(rawPath, decode_raw, &edited, &editedInfo) || editedInfo.cache_hit || edited.pixels[0] != raw[0]) {
+        printf("[ERROR]: texture cache served a stale image\n");
+        failures++;
+    }
+    FreeTextureMips(&edited);
+    free(raw);
+    remove(rawPath);
+    remove(cachePath);
+
+    return failures;
+}
+
+// BMP writer for the decoder checks. layout: 24 and 32 are BI_RGB, 'V' is a
+// 32-bit BI_BITFIELDS file with a V4 header in BGRA order, 'R' a 40-byte
+// header with RGBA BI_ALPHABITFIELDS, which has no vector path.
+static size_t write_bmp(uint8_t* out, const uint8_t* rgba, uint32_t w, uint32_t h, int layout, bool topDown){
+    int bits = layout == 24 ? 24 : 32;
+    uint32_t headerSize = layout == 'V' ? 108 : 40;
+    uint32_t masksSize = layout == 'R' ? 16 : 0;
+    uint32_t offset = 14 + headerSize + masksSize;
+    uint32_t stride = (w * bits + 31) / 32 * 4;
+    uint32_t fileSize = offset + stride * h;
+    memset(out, 0, fileSize);
+
+    uint32_t fields[] = {fileSize, 0, offset, headerSize, w, topDown ? (uint32_t)-(int32_t)h : h};
+    out[0] = 'B';
+    out[1] = 'M';
+    memcpy(out + 2, &fields[0], 4);
+    memcpy(out + 10, &fields[2], 4);
+    memcpy(out + 14, &fields[3], 4);
+    memcpy(out + 18, &fields[4], 4);
+    memcpy(out + 22, &fields[5], 4);
+    out[26] = 1;
+    out[28] = (uint8_t)bits;
+    out[30] = layout == 'V' ? 3 : layout == 'R' ? 6 : 0;
+    uint32_t masks[4] = {0x00FF0000u, 0x0000FF00u, 0x000000FFu, 0xFF000000u};
+    if (layout == 'R') {
+        masks[0] = 0x000000FFu;
+        masks[2] = 0x00FF0000u;
+    }
+    if (layout == 'V' || layout == 'R') memcpy(out + 54, masks, 16);
+
+    for (uint32_t y = 0; y < h; y++) {
+        uint8_t* row = out + offset + (size_t)(topDown ? y : h - 1 - y) * stride;
+        for (uint32_t x = 0; x < w; x++) {
+            const uint8_t* p = rgba + ((size_t)y * w + x) * 4;
+            if (layout == 'R') {
+                memcpy(row + x * 4, p, 4);
+            } else {
+                uint8_t* d = row + x * (bits / 8);
+                d[0] = p[2];
+                d[1] = p[1];
+                d[2] = p[0];
+                if (bits == 32) d[3] = p[3];
+            }
+        }
+    }
+    return fileSize;
+}
+
+// The decode path the streamer used before DecodeBmp: the file becomes a
+// BGR(A) surface, is converted into a second RGBA surface and that is copied
+// to its destination.
+static void decode_bmp_three_copies(const uint8_t* file, const BmpInfo* info, uint8_t* dst){
+    uint32_t w = info->width, h = info->height, bytes = (uint32_t)info->bits_per_pixel / 8;
+    uint8_t* surface = malloc(info->row_stride * h);
+    for (uint32_t y = 0; y < h; y++) {
+        uint32_t row = info->top_down ? y : h - 1 - y;
+        memcpy(surface + (size_t)y * info->row_stride, file + info->pixel_offset + (size_t)row * info->row_stride, info->row_stride);
+    }
+    uint8_t* converted = malloc((size_t)w * h * 4);
+    for (uint32_t y = 0; y < h; y++) {
+        const uint8_t* s = surface + (size_t)y * info->row_stride;
+        uint8_t* d = converted + (size_t)y * w * 4;
+        for (uint32_t x = 0; x < w; x++) {
+            d[x * 4 + 0] = s[x * bytes + 2];
+            d[x * 4 + 1] = s[x * bytes + 1];
+            d[x * 4 + 2] = s[x * bytes + 0];
+            d[x * 4 + 3] = bytes == 4 ? s[x * bytes + 3] : 0xFF;
+        }
+    }
+    free(surface);
+    memcpy(dst, converted, (size_t)w * h * 4);
+    free(converted);
+}
+
+static int BenchBmpDecode(void){
+    int failures = 0;
+    uint32_t seed = 99u;
+
+    // odd widths leave row padding and scalar tails on every vector path
+    const uint32_t sizes[][2] = {{1, 1}, {3, 2}, {17, 5}, {40, 40}, {123, 77}};
+    const int layouts[] = {24, 32, 'V', 'R'};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint32_t w = sizes[s][0], h = sizes[s][1], pitch = w * 4 + 20;
+        uint8_t* rgba = malloc((size_t)w * h * 4);
+        uint8_t* file = malloc(256 + (size_t)w * h * 4);
+        uint8_t* simd = malloc((size_t)pitch * h);
+        uint8_t* scalar = malloc((size_t)pitch * h);
+        fill_noise(rgba, (size_t)w * h * 4, &seed);
+        for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+            for (int topDown = 0; topDown < 2; topDown++) {
+                size_t size = write_bmp(file, rgba, w, h, layouts[l], topDown);
+                BmpInfo info;
+                // cutting the last pixel short has to be rejected
+                int bits = layouts[l] == 24 ? 24 : 32;
+                size_t truncated = size - ((w * bits + 31) / 32 * 4 - (size_t)w * bits / 8) - 1;
+                if (!ParseBmpHeader(file, size, &info) || info.width != w || info.height != h || ParseBmpHeader(file, truncated, &info)) {
+                    printf("[ERROR]: BMP header %ux%u layout %d not parsed as written\n", w, h, layouts[l]);
+                    failures++;
+                    continue;
+                }
+                DecodeBmp(file, &info, simd, pitch);
+                DecodeBmpScalar(file, &info, scalar, pitch);
+                for (uint32_t y = 0; y < h; y++) {
+                    bool same = memcmp(simd + (size_t)y * pitch, scalar + (size_t)y * pitch, (size_t)w * 4) == 0;
+                    for (uint32_t x = 0; same && x < w; x++) {
+                        const uint8_t* expected = rgba + ((size_t)y * w + x) * 4;
+                        const uint8_t* got = simd + (size_t)y * pitch + x * 4;
+                        same = memcmp(got, expected, 3) == 0 && got[3] == (layouts[l] == 24 ? 0xFF : expected[3]);
+                    }
+                    if (!same) {
+                        printf("[ERROR]: BMP %ux%u layout %d top-down %d decodes wrong in row %u\n", w, h, layouts[l], topDown, y);
+                        failures++;
+                        break;
+                    }
+                }
+            }
+        }
+        free(rgba);
+        free(file);
+        free(simd);
+        free(scalar);
+    }
+
+    // 32-bit files without any alpha set are opaque
+    uint8_t clear[4 * 4] = {10, 20, 30, 0, 40, 50, 60, 0, 70, 80, 90, 0, 1, 2, 3, 0};
+    uint8_t clearFile[256], decoded[16];
+    BmpInfo clearInfo;
+    if (!ParseBmpHeader(clearFile, write_bmp(clearFile, clear, 2, 2, 32, false), &clearInfo)) {
+        printf("[ERROR]: could not parse the zero-alpha BMP\n");
+        failures++;
+    } else {
+        DecodeBmp(clearFile, &clearInfo, decoded, 8);
+        if (decoded[3] != 0xFF || decoded[15] != 0xFF || decoded[4] != 40) {
+            printf("[ERROR]: zero-alpha BMP decoded to alpha %d\n", decoded[3]);
+            failures++;
+        }
+    }
+
+    MappedFile texture;
+    if (MapFile("texture.bmp", &texture)) {
+        BmpInfo info;
+        if (!ParseBmpHeader(texture.data, texture.size, &info)) {
+            printf("[ERROR]: texture.bmp is not handled by DecodeBmp\n");
+            failures++;
+        } else {
+            size_t bytes = (size_t)info.width * info.height * 4;
+            uint8_t* a = malloc(bytes);
+            uint8_t* b = malloc(bytes);
+            DecodeBmp(texture.data, &info, a, info.width * 4);
+            decode_bmp_three_copies((const uint8_t*)texture.data, &info, b);
+            if (memcmp(a, b, bytes) != 0) {
+                printf("[ERROR]: texture.bmp decodes differently than through a converted surface\n");
+                failures++;
+            }
+            free(a);
+            free(b);
+        }
+        UnmapFile(&texture);
+    }
+
+    printf("== bmp decode ==\n");
+    printf("%-14s %-12s %10s %10s %10s\n", "size", "path", "ms", "MPix/s", "peak KB");
+    const uint32_t benchSizes[] = {512, 2048};
+    for (size_t s = 0; s < sizeof(benchSizes) / sizeof(benchSizes[0]); s++) {
+        for (int bits = 24; bits <= 32; bits += 8) {
+            uint32_t size = benchSizes[s];
+            uint8_t* rgba = malloc((size_t)size * size * 4);
+            uint8_t* file = malloc(256 + (size_t)size * size * 4);
+            uint8_t* dst = malloc((size_t)size * size * 4);
+            fill_noise(rgba, (size_t)size * size * 4, &seed);
+            BmpInfo info;
+            ParseBmpHeader(file, write_bmp(file, rgba, size, size, bits, false), &info);
+            free(rgba);
+
+            const char* paths[] = {"three copies", "scalar", "direct"};
+            for (int p = 0; p < 3; p++) {
+                double best = 1e9;
+                long long peak = 0;
+                for (int r = 0; r < 5; r++) {
+                    reset_alloc_peak();
+                    AllocStats start = alloc_snapshot();
+                    double t = now_seconds();
+                    if (p == 0) decode_bmp_three_copies(file, &info, dst);
+                    else if (p == 1) DecodeBmpScalar(file, &info, dst, size * 4);
+                    else DecodeBmp(file, &info, dst, size * 4);
+                    double elapsed = now_seconds() - t;
+                    if (elapsed < best) best = elapsed;
+                    peak = alloc_snapshot().peak_bytes - start.live_bytes;
+                }
+                char name[40];
+                snprintf(name, sizeof(name), "%ux%u %dbpp %s", size, size, bits, paths[p]);
+                char label[24];
+                snprintf(label, sizeof(label), "%ux%u %d", size, size, bits);
+                printf("%-14s %-12s %10.3f %10.1f %10.1f\n", label, paths[p], best * 1e3, (double)size * size / 1e6 / best, peak / 1024.0);
+                record_result("bmp_decode", name, "ms", best * 1e3);
+                record_result("bmp_decode", name, "peak_heap_kb", peak / 1024.0);
+            }
+            free(file);
+            free(dst);
+        }
+    }
+    return failures;
+}
+
+typedef struct FakeDraw{
+    uint32_t pipeline, material, texture, mesh;
+    float depth;
+} FakeDraw;
+
+static int compare_items(const void* a, const void* b){
+    const RenderItem* x = a;
+    const RenderItem* y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return x->draw < y->draw ? -1 : x->draw > y->draw;
+}
+
+// Same bind decisions as the emitter in main.c, without the GPU calls.
+static void emit_fake_draws(const RenderQueue* queue, const FakeDraw* draws, RenderBinds* binds){
+    InvalidateRenderBinds(binds);
+    for (int i = 0; i < queue->count; i++) {
+        const FakeDraw* draw = &draws[queue->items[i].draw];
+        RenderBindChanged(binds, RENDER_BIND_PIPELINE, draw->pipeline);
+        RenderBindChanged(binds, RENDER_BIND_TEXTURE, (uintptr_t)draw->material << 16 | draw->texture);
+        RenderBindChanged(binds, RENDER_BIND_INDEX_BUFFER, draw->mesh & 1);
+    }
+}
+
+static void gather_fake_draws(RenderQueue* queue, const FakeDraw* draws, int count){
+    ClearRenderQueue(queue);
+    for (int i = 0; i < count; i++) {
+        const FakeDraw* d = &draws[i];
+        PushRenderItem(queue, MakeRenderKey(RENDER_PASS_OPAQUE, d->pipeline, d->material, d->texture, d->mesh, d->depth), (uint32_t)i);
+    }
+}
+
+static int BenchRenderQueue(void){
+    int failures = 0;
+    uint32_t seed = 31337u;
+
+    // state outranks depth, nearer goes first, transparent goes last and far
+    // to near
+    uint64_t nearKey = MakeRenderKey(RENDER_PASS_OPAQUE, 1, 2, 3, 4, 1.0f);
+    uint64_t farKey = MakeRenderKey(RENDER_PASS_OPAQUE, 1, 2, 3, 4, 500.0f);
+    uint64_t otherTexture = MakeRenderKey(RENDER_PASS_OPAQUE, 1, 2, 4, 4, 0.5f);
+    uint64_t otherPipeline = MakeRenderKey(RENDER_PASS_OPAQUE, 0, 9, 9, 9, 900.0f);
+    uint64_t glassNear = MakeRenderKey(RENDER_PASS_TRANSPARENT, 0, 0, 0, 0, 2.0f);
+    uint64_t glassFar = MakeRenderKey(RENDER_PASS_TRANSPARENT, 9, 0, 0, 0, 20.0f);
+    if (!(otherPipeline < nearKey && nearKey < farKey && farKey < otherTexture && otherTexture < glassFar && glassFar < glassNear)) {
+        printf("[ERROR]: render keys do not order state, depth and pass\n");
+        failures++;
+    }
+    if (MakeRenderKey(RENDER_PASS_OPAQUE, 0, 0, 0, 0, -3.0f) != MakeRenderKey(RENDER_PASS_OPAQUE, 0, 0, 0, 0, 0.0f)) {
+        printf("[ERROR]: depths behind the camera are not clamped\n");
+        failures++;
+    }
+
+    const int count = 100000;
+    FakeDraw* draws = malloc((size_t)count * sizeof(FakeDraw));
+    for (int i = 0; i < count; i++) {
+        draws[i] = (FakeDraw){
+            .pipeline = (uint32_t)random_range(&seed, 0.0f, 4.0f),
+            .material = (uint32_t)random_range(&seed, 0.0f, 32.0f),
+            .texture = (uint32_t)random_range(&seed, 0.0f, 128.0f),
+            .mesh = (uint32_t)random_range(&seed, 0.0f, 2048.0f),
+            .depth = random_range(&seed, 0.1f, 1000.0f)
+        };
+    }
+
+    RenderQueue queue = {0};
+    gather_fake_draws(&queue, draws, count);
+    RenderItem* expected = malloc((size_t)count * sizeof(RenderItem));
+    memcpy(expected, queue.items, (size_t)count * sizeof(RenderItem));
+    qsort(expected, (size_t)count, sizeof(RenderItem), compare_items);
+    SortRenderQueue(&queue);
+    // the radix sort is stable, so ties keep draw order exactly like the
+    // tie-broken qsort
+    if (queue.count != count || memcmp(queue.items, expected, (size_t)count * sizeof(RenderItem)) != 0) {
+        printf("[ERROR]: radix sorted render queue differs from qsort\n");
+        failures++;
+    }
+
+    RenderBinds unsorted = {0}, sorted = {0};
+    gather_fake_draws(&queue, draws, count);
+    emit_fake_draws(&queue, draws, &unsorted);
+    SortRenderQueue(&queue);
+    emit_fake_draws(&queue, draws, &sorted);
+    if (RenderBindsIssued(&sorted) >= RenderBindsIssued(&unsorted) || RenderBindsIssued(&sorted) + RenderBindsSkipped(&sorted) != (uint32_t)count * 3) {
+        printf("[ERROR]: sorting did not cut binds: %u sorted, %u unsorted\n", RenderBindsIssued(&sorted), RenderBindsIssued(&unsorted));
+        failures++;
+    }
+
+    double best[4] = {1e9, 1e9, 1e9, 1e9};
+    for (int r = 0; r < 10; r++) {
+        double t0 = now_seconds();
+        gather_fake_draws(&queue, draws, count);
+        double t1 = now_seconds();
+        SortRenderQueue(&queue);
+        double t2 = now_seconds();
+        RenderBinds binds = {0};
+        emit_fake_draws(&queue, draws, &binds);
+        double t3 = now_seconds();
+        if (RenderBindsIssued(&binds) != RenderBindsIssued(&sorted)) {
+            printf("[ERROR]: render queue binds differ between runs\n");
+            failures++;
+            break;
+        }
+        gather_fake_draws(&queue, draws, count);
+        double t4 = now_seconds();
+        qsort(queue.items, (size_t)queue.count, sizeof(RenderItem), compare_items);
+        double t5 = now_seconds();
+        double times[4] = {t1 - t0, t2 - t1, t3 - t2, t5 - t4};
+        for (int i = 0; i < 4; i++) {
+            if (times[i] < best[i]) best[i] = times[i];
+        }
+    }
+
+    printf("== render queue ==\n");
+    printf("%-14s %10s %10s\n", "100k items", "ms", "ns/item");
+    const char* stages[] = {"gather", "radix sort", "emit", "qsort"};
+    const char* metrics[] = {"gather_ms", "radix_sort_ms", "emit_ms", "qsort_ms"};
+    for (int i = 0; i < 4; i++) {
+        printf("%-14s %10.3f %10.2f\n", stages[i], best[i] * 1e3, best[i] * 1e9 / count);
+        record_result("render_queue", "100k items", metrics[i], best[i] * 1e3);
+    }
+    printf("%-14s %10u issued %10u skipped\n", "array order", RenderBindsIssued(&unsorted), RenderBindsSkipped(&unsorted));
+    printf("%-14s %10u issued %10u skipped\n", "sorted", RenderBindsIssued(&sorted), RenderBindsSkipped(&sorted));
+    record_result("render_queue", "array order", "binds_issued", RenderBindsIssued(&unsorted));
+    record_result("render_queue", "sorted", "binds_issued", RenderBindsIssued(&sorted));
+
+    // uniforms are pushed by value, so only equal contents may be skipped,
+    // wherever they are stored
+    DrawUniforms pushes[3] = { { .mvp = Mat4Identity() }, { .mvp = Mat4Identity() }, { .mvp = Mat4Translation((Vec3){1.0f, 0.0f, 0.0f}) } };
+    DrawUniforms lastUniforms;
+    RenderBinds uniformBinds = {0};
+    InvalidateRenderBinds(&uniformBinds);
+    for (int i = 0; i < 3; i++) {
+        RenderBindDataChanged(&uniformBinds, RENDER_BIND_UNIFORMS, &lastUniforms, &pushes[i], sizeof(DrawUniforms));
+    }
+    if (uniformBinds.issued[RENDER_BIND_UNIFORMS] != 2 || uniformBinds.skipped[RENDER_BIND_UNIFORMS] != 1) {
+        printf("[ERROR]: uniform pushes: %u issued, %u skipped, expected 2 and 1\n", uniformBinds.issued[RENDER_BIND_UNIFORMS], uniformBinds.skipped[RENDER_BIND_UNIFORMS]);
+        failures++;
+    }
+
+    FreeRenderQueue(&queue);
+    free(expected);
+    free(draws);
+    return failures;
+}
+
+typedef struct JobBenchState{
+    JobSystem* jobs;
+    atomic_int executed;
+    int* hits;
+} JobBenchState;
+
+static void count_job(void* data){
+    JobBenchState* state = data;
+    atomic_fetch_add_explicit(&state->executed, 1, memory_order_relaxed);
+}
+
+static void mark_range(void* data, int begin, int end){
+    JobBenchState* state = data;
+    for (int i = begin; i < end; i++) state->hits[i]++;
+}
+
+// Spawns children and waits for them from inside a job, which only works if
+// waiting threads keep running jobs.
+static void nested_job(void* data){
+    JobBenchState* state = data;
+    enum { CHILDREN = 64 };
+    void* children[CHILDREN];
+    for (int i = 0; i < CHILDREN; i++) children[i] = state;
+    JobCounter counter = {0};
+    RunJobs(state->jobs, count_job, children, CHILDREN, &counter);
+    WaitForCounter(state->jobs, &counter);
+    count_job(state);
+}
+
+typedef struct BackgroundJob{
+    JobSystem* jobs;
+    atomic_int* executed;
+    int worker; // queue index of the thread that ran it
+} BackgroundJob;
+
+static void background_job(void* data){
+    BackgroundJob* job = data;
+    job->worker = JobWorkerIndex(job->jobs);
+    atomic_fetch_add_explicit(job->executed, 1, memory_order_relaxed);
+}
+
+typedef struct ForeignSubmit{
+    JobSystem* jobs;
+    JobBenchState* state;
+    int count;
+} ForeignSubmit;
+
+// A thread that is not a worker, like an asset loader outside the pool.
+static void* foreign_submit_thread(void* arg){
+    ForeignSubmit* submit = arg;
+    JobCounter counter = {0};
+    for (int i = 0; i < submit->count; i++) RunJob(submit->jobs, count_job, submit->state, &counter);
+    WaitForCounter(submit->jobs, &counter);
+    return NULL;
+}
+
+static int check_job_system(int threads){
+    enum { TINY_JOBS = 200000, NESTED_PARENTS = 64, FOR_ITEMS = 1000003, FOREIGN_JOBS = 10000 };
+    int failures = 0;
+    JobSystem jobs;
+    InitJobSystem(&jobs, threads);
+    JobBenchState state = { .jobs = &jobs };
+
+    // many tiny jobs, submitted in one call
+    void** args = malloc(TINY_JOBS * sizeof(void*));
+    for (int i = 0; i < TINY_JOBS; i++) args[i] = &state;
+    JobCounter counter = {0};
+    RunJobs(&jobs, count_job, args, TINY_JOBS, &counter);
+    WaitForCounter(&jobs, &counter);
+    if (atomic_load(&state.executed) != TINY_JOBS) {
+        printf("[ERROR]: %d threads: %d of %d tiny jobs ran\n", threads, atomic_load(&state.executed), TINY_JOBS);
+        failures++;
+    }
+
+    atomic_store(&state.executed, 0);
+    RunJobs(&jobs, nested_job, args, NESTED_PARENTS, &counter);
+    WaitForCounter(&jobs, &counter);
+    if (atomic_load(&state.executed) != NESTED_PARENTS * 65) {
+        printf("[ERROR]: %d threads: nested jobs ran %d times, expected %d\n", threads, atomic_load(&state.executed), NESTED_PARENTS * 65);
+        failures++;
+    }
+    free(args);
+
+    state.hits = calloc(FOR_ITEMS, sizeof(int));
+    ParallelFor(&jobs, FOR_ITEMS, 4096, mark_range, &state);
+    for (int i = 0; i < FOR_ITEMS; i++) {
+        if (state.hits[i] != 1) {
+            printf("[ERROR]: %d threads: ParallelFor visited item %d %d times\n", threads, i, state.hits[i]);
+            failures++;
+            break;
+        }
+    }
+    free(state.hits);
+
+    // background jobs never run on the main thread while it waits for a
+    // ParallelFor or anything else, unless it is the only thread
+    enum { BACKGROUND_JOBS = 256 };
+    BackgroundJob background[BACKGROUND_JOBS];
+    JobCounter backgroundCounter = {0};
+    atomic_store(&state.executed, 0);
+    for (int i = 0; i < BACKGROUND_JOBS; i++) {
+        background[i] = (BackgroundJob){ .jobs = &jobs, .executed = &state.executed, .worker = -1 };
+        RunBackgroundJob(&jobs, background_job, &background[i], &backgroundCounter);
+    }
+    state.hits = calloc(FOR_ITEMS, sizeof(int));
+    ParallelFor(&jobs, FOR_ITEMS, 4096, mark_range, &state);
+    free(state.hits);
+    WaitForCounter(&jobs, &backgroundCounter);
+    int onMain = 0;
+    for (int i = 0; i < BACKGROUND_JOBS; i++) onMain += background[i].worker == 0;
+    if (atomic_load(&state.executed) != BACKGROUND_JOBS || (threads > 1 && onMain > 0)) {
+        printf("[ERROR]: %d threads: %d of %d background jobs ran, %d on the main thread\n", threads,
+            atomic_load(&state.executed), BACKGROUND_JOBS, onMain);
+        failures++;
+    }
+
+    atomic_store(&state.executed, 0);
+    ForeignSubmit submit = { .jobs = &jobs, .state = &state, .count = FOREIGN_JOBS };
+    pthread_t foreign;
+    pthread_create(&foreign, NULL, foreign_submit_thread, &submit);
+    pthread_join(foreign, NULL);
+    if (atomic_load(&state.executed) != FOREIGN_JOBS) {
+        printf("[ERROR]: %d threads: %d of %d jobs from a foreign thread ran\n", threads, atomic_load(&state.executed), FOREIGN_JOBS);
+        failures++;
+    }
+
+    // fire and forget work is finished by DestroyJobSystem
+    atomic_store(&state.executed, 0);
+    for (int i = 0; i < 1000; i++) RunJob(&jobs, count_job, &state, NULL);
+    DestroyJobSystem(&jobs);
+    if (atomic_load(&state.executed) != 1000) {
+        printf("[ERROR]: %d threads: shutdown dropped %d queued jobs\n", threads, 1000 - atomic_load(&state.executed));
+        failures++;
+    }
+    return failures;
+}
+
+typedef struct LoadJob{
+    const char* path;
+    int vertex_count;
+} LoadJob;
+
+static void load_obj_job(void* data){
+    LoadJob* job = data;
+    Mesh mesh = LoadObjFromFile(job->path, (Vec3){0});
+    job->vertex_count = mesh.vertex_count;
+    FreeMesh(&mesh);
+}
+
+typedef struct TransformBatch{
+    Mat4 matrix;
+    const Vec3* in;
+    Vec3* out;
+} TransformBatch;
+
+static void transform_range(void* data, int begin, int end){
+    TransformBatch* batch = data;
+    for (int i = begin; i < end; i++) batch->out[i] = Mat4TransformPoint(batch->matrix, batch->in[i]);
+}
+
+static int BenchJobSystem(void){
+    int failures = 0;
+    int maxThreads = DefaultJobThreadCount();
+
+    // oversubscribed counts too, the races are what is being tested
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        failures += check_job_system(threads);
+    }
+    if (maxThreads > 8) failures += check_job_system(maxThreads);
+    // init/destroy churn with work in flight
+    for (int round = 0; round < 50 && !failures; round++) {
+        JobSystem jobs;
+        InitJobSystem(&jobs, maxThreads > 4 ? maxThreads : 4);
+        JobBenchState state = { .jobs = &jobs };
+        for (int i = 0; i < 100; i++) RunJob(&jobs, nested_job, &state, NULL);
+        DestroyJobSystem(&jobs);
+        if (atomic_load(&state.executed) != 100 * 65) {
+            printf("[ERROR]: init/destroy round %d ran %d of %d jobs\n", round, atomic_load(&state.executed), 100 * 65);
+            failures++;
+        }
+    }
+
+    enum { LOAD_ROUNDS = 4, POINTS = 1 << 21 };
+    Vec3* in = malloc(POINTS * sizeof(Vec3));
+    Vec3* out = malloc(POINTS * sizeof(Vec3));
+    uint32_t seed = 7;
+    for (int i = 0; i < POINTS; i++) {
+        in[i] = (Vec3){random_range(&seed, -10, 10), random_range(&seed, -10, 10), random_range(&seed, -10, 10)};
+    }
+    TransformBatch batch = { .matrix = Mat4Multiply(Mat4RotationY(0.3f), Mat4Translation((Vec3){1, 2, 3})), .in = in, .out = out };
+
+    printf("== job system ==\n");
+    printf("%8s %12s %9s %14s %9s %10s\n", "threads", "load ms", "speedup", "transform ms", "speedup", "stolen %");
+    double loadBase = 0.0, transformBase = 0.0;
+    for (int threads = 1; threads <= maxThreads; threads = threads * 2 <= maxThreads || threads == maxThreads ? threads * 2 : maxThreads) {
+        JobSystem jobs;
+        InitJobSystem(&jobs, threads);
+
+        LoadJob loads[LOAD_ROUNDS * OBJ_FILE_COUNT];
+        void* args[LOAD_ROUNDS * OBJ_FILE_COUNT];
+        for (int i = 0; i < LOAD_ROUNDS * OBJ_FILE_COUNT; i++) {
+            loads[i] = (LoadJob){ .path = objFiles[i % OBJ_FILE_COUNT] };
+            args[i] = &loads[i];
+        }
+        JobCounter counter = {0};
+        double start = now_seconds();
+        RunJobs(&jobs, load_obj_job, args, LOAD_ROUNDS * OBJ_FILE_COUNT, &counter);
+        WaitForCounter(&jobs, &counter);
+        double loadTime = now_seconds() - start;
+        for (int i = 0; i < LOAD_ROUNDS * OBJ_FILE_COUNT; i++) {
+            if (loads[i].vertex_count == 0) {
+                printf("[ERROR]: %d threads: parallel load of %s failed\n", threads, loads[i].path);
+                failures++;
+            }
+        }
+
+        double transformTime = 1e9;
+        for (int run = 0; run < 5; run++) {
+            start = now_seconds();
+            ParallelFor(&jobs, POINTS, 16384, transform_range, &batch);
+            double elapsed = now_seconds() - start;
+            if (elapsed < transformTime) transformTime = elapsed;
+        }
+
+        uint64_t executed = 0, stolen = 0;
+        for (int i = 0; i < jobs.thread_count; i++) {
+            executed += jobs.stats[i].executed;
+            stolen += jobs.stats[i].stolen;
+        }
+        DestroyJobSystem(&jobs);
+
+        if (threads == 1) {
+            loadBase = loadTime;
+            transformBase = transformTime;
+        }
+        printf("%8d %12.3f %8.2fx %14.3f %8.2fx %9.1f%%\n", threads, loadTime * 1e3, loadBase / loadTime,
+               transformTime * 1e3, transformBase / transformTime, executed ? 100.0 * stolen / executed : 0.0);
+        char name[32];
+        snprintf(name, sizeof(name), "%d threads", threads);
+        record_result("job_system", name, "load_ms", loadTime * 1e3);
+        record_result("job_system", name, "transform_ms", transformTime * 1e3);
+        if (threads == maxThreads) break;
+    }
+
+    Vec3 expected = Mat4TransformPoint(batch.matrix, in[POINTS - 1]);
+    if (memcmp(&expected, &out[POINTS - 1], sizeof(Vec3)) != 0) {
+        printf("[ERROR]: ParallelFor transform result differs\n");
+        failures++;
+    }
+    free(in);
+    free(out);
+    return failures;
+}
+
+static int compare_keys(const void* a, const void* b){
+    const RenderItem* x = a;
+    const RenderItem* y = b;
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+// Build, merge and sort, then the bind walk the emitter does, without the
+// GPU calls. Returns the binds issued so runs can be compared.
+static uint32_t record_packets(JobSystem* jobs, PacketBuilder* builder, RenderQueue* queue, const InstancePackets* scene, double times[3]){
+    double t0 = now_seconds();
+    BeginPackets(builder, jobs);
+    BuildInstancePackets(jobs, builder, scene, 256);
+    double t1 = now_seconds();
+    ClearRenderQueue(queue);
+    MergePackets(builder, queue);
+    SortRenderQueue(queue);
+    double t2 = now_seconds();
+    RenderBinds binds = {0};
+    InvalidateRenderBinds(&binds);
+    DrawUniforms lastUniforms;
+    for (int i = 0; i < queue->count; i++) {
+        const DrawPacket* packet = GetDrawPacket(builder, queue->items[i].draw);
+        RenderBindChanged(&binds, RENDER_BIND_PIPELINE, packet->state);
+        RenderBindDataChanged(&binds, RENDER_BIND_UNIFORMS, &lastUniforms, &packet->uniforms, sizeof(DrawUniforms));
+    }
+    double t3 = now_seconds();
+    times[0] = t1 - t0;
+    times[1] = t2 - t1;
+    times[2] = t3 - t2;
+    return RenderBindsIssued(&binds);
+}
+
+static int BenchDrawPackets(void){
+    int failures = 0;
+    int maxThreads = DefaultJobThreadCount();
+    if (maxThreads < 4) maxThreads = 4;
+
+    const int count = 100000;
+    Mesh mesh = { .bounds_min = {-1.0f, -0.5f, -2.0f}, .bounds_max = {1.0f, 0.5f, 2.0f}, .bounds_radius = 2.3f };
+    InstanceData* instances = malloc((size_t)count * sizeof(InstanceData));
+    BuildInstanceGrid(instances, count, &mesh, 1.0f);
+
+    // the camera sits inside the front of the block, so a good part of it
+    // is culled
+    Mat4 view = Mat4Translation((Vec3){0.0f, 0.0f, -60.0f});
+    Mat4 viewProj = Mat4Multiply(Mat4Perspective(1.2f, 1.3f, 0.1f, 1000.0f), view);
+    InstancePackets scene = {
+        .view = view,
+        .view_proj = viewProj,
+        .frustum = ExtractFrustum(viewProj.m),
+        .model = Mat4RotationY(0.3f),
+        .vertex_decode = Mat4Identity(),
+        .center = {0.0f, 0.0f, 0.0f},
+        .radius = mesh.bounds_radius,
+        .instances = instances,
+        .count = count,
+        .texture = 3
+    };
+
+    int expectedVisible = 0;
+    for (int i = 0; i < count; i++) {
+        Mat4 instance;
+        InstanceMatrix(&instances[i], instance.m);
+        Mat4 model = Mat4Multiply(scene.model, instance);
+        expectedVisible += SphereInFrustum(&scene.frustum, Mat4TransformPoint(model, scene.center), mesh.bounds_radius * instances[i].scale);
+    }
+
+    printf("== draw packets ==\n");
+    printf("%d instances, %d visible\n", count, expectedVisible);
+    printf("%8s %10s %10s %10s %10s %9s\n", "threads", "build ms", "sort ms", "emit ms", "total ms", "speedup");
+    RenderItem* reference = NULL;
+    uint32_t referenceBinds = 0;
+    double totalBase = 0.0;
+    for (int threads = 1; threads <= maxThreads; threads = threads * 2 <= maxThreads || threads == maxThreads ? threads * 2 : maxThreads) {
+        JobSystem jobs;
+        InitJobSystem(&jobs, threads);
+        PacketBuilder builder = {0};
+        RenderQueue queue = {0};
+
+        double best[3] = {1e9, 1e9, 1e9};
+        uint32_t binds = 0;
+        for (int run = 0; run < 5; run++) {
+            double times[3];
+            binds = record_packets(&jobs, &builder, &queue, &scene, times);
+            for (int i = 0; i < 3; i++) {
+                if (times[i] < best[i]) best[i] = times[i];
+            }
+        }
+        DestroyJobSystem(&jobs);
+
+        // lists split differently with every thread count, but the sorted
+        // keys and what each item points at must not change
+        bool same = queue.count == expectedVisible;
+        for (int i = 0; same && i < queue.count; i++) {
+            const DrawPacket* packet = GetDrawPacket(&builder, queue.items[i].draw);
+            same = packet->state == scene.state && packet->uniforms.mvp.m[15] != 0.0f;
+        }
+        qsort(queue.items, (size_t)queue.count, sizeof(RenderItem), compare_keys);
+        if (!reference) {
+            reference = malloc((size_t)queue.count * sizeof(RenderItem));
+            memcpy(reference, queue.items, (size_t)queue.count * sizeof(RenderItem));
+            referenceBinds = binds;
+        } else {
+            for (int i = 0; same && i < queue.count; i++) same = queue.items[i].key == reference[i].key;
+            same = same && binds == referenceBinds;
+        }
+        if (!same) {
+            printf("[ERROR]: %d threads: packets differ from the single-threaded build\n", threads);
+            failures++;
+        }
+        FreePacketBuilder(&builder);
+        FreeRenderQueue(&queue);
+
+        double total = best[0] + best[1] + best[2];
+        if (threads == 1) totalBase = total;
+        printf("%8d %10.3f %10.3f %10.3f %10.3f %8.2fx\n", threads, best[0] * 1e3, best[1] * 1e3, best[2] * 1e3, total * 1e3, totalBase / total);
+        char name[32];
+        snprintf(name, sizeof(name), "%d threads", threads);
+        record_result("draw_packets", name, "build_ms", best[0] * 1e3);
+        record_result("draw_packets", name, "total_ms", total * 1e3);
+        if (threads == maxThreads) break;
+    }
+
+    free(reference);
+    free(instances);
+    return failures;
+}
+
+// Writes copies side by side as .obj text, each shifted along x by 1.5x the
+// mesh width, with one v/vt/vn triple per vertex so nothing dedups across
+// copies.
+static bool check_pattern(const uint8_t* bytes, size_t size, uint8_t value){
+    for (size_t i = 0; i < size; i++) {
+        if (bytes[i] != value) return false;
+    }
+    return true;
+}
+
+// Arena and pool behaviour, then repeated load/unload cycles: once the
+// scratch arenas and the mesh pool are warm, a load should not grow the heap.
+static int BenchMemory(void){
+    int failures = 0;
+
+    Arena arena;
+    InitArena(&arena, "bench", 4096);
+    uint8_t* a = ArenaAlloc(&arena, 100);
+    uint8_t* b = ArenaAlloc(&arena, 3);
+    uint8_t* c = ArenaAlloc(&arena, 5000);
+    memset(a, 0xA5, 100);
+    memset(b, 0x5A, 3);
+    memset(c, 0x33, 5000);
+    if ((uintptr_t)a % ARENA_ALIGN || (uintptr_t)b % ARENA_ALIGN || (uintptr_t)c % ARENA_ALIGN ||
+        !check_pattern(a, 100, 0xA5) || !check_pattern(b, 3, 0x5A) || arena.stats.bytes != 112 + 16 + 5008) {
+        printf("[ERROR]: arena allocations are misaligned or overlap\n");
+        failures++;
+    }
+    for (int i = 0; i < 8; i++) ArenaAlloc(&arena, 3000);
+    size_t reserved = arena.reserved;
+    ResetArena(&arena);
+    AllocStats before = alloc_snapshot();
+    for (int i = 0; i < 8; i++) ArenaAlloc(&arena, 3000);
+    AllocStats after = alloc_snapshot();
+    if (arena.reserved != reserved || after.allocations != before.allocations) {
+        printf("[ERROR]: arena grew from %zu to %zu bytes after a reset\n", reserved, arena.reserved);
+        failures++;
+    }
+    DestroyArena(&arena);
+
+    Pool pool = POOL_INIT("bench pool", 16 * 1024 * 1024);
+    void* blocks[64];
+    for (int round = 0; round < 2; round++) {
+        before = alloc_snapshot();
+        for (int i = 0; i < 64; i++) {
+            size_t size = (size_t)1 << (i % 20);
+            size += (size_t)i * 7;
+            blocks[i] = PoolAlloc(&pool, size, "bench block");
+            memset(blocks[i], i, size);
+        }
+        for (int i = 0; i < 64; i++) {
+            size_t size = ((size_t)1 << (i % 20)) + (size_t)i * 7;
+            if ((uintptr_t)blocks[i] % 16 || !check_pattern(blocks[i], size, (uint8_t)i)) {
+                printf("[ERROR]: pool block %d is misaligned or overlaps another\n", i);
+                failures++;
+                break;
+            }
+        }
+        for (int i = 0; i < 64; i++) PoolFree(&pool, blocks[i]);
+        after = alloc_snapshot();
+        if (round == 1 && after.allocations != before.allocations) {
+            printf("[ERROR]: pool went back to malloc %lld times for sizes it had cached\n", after.allocations - before.allocations);
+            failures++;
+        }
+    }
+    MemoryStats poolStats = GetPoolStats(&pool);
+    if (poolStats.bytes != 0 || poolStats.allocations != poolStats.frees || ReportPoolLeaks(&pool) != 0) {
+        printf("[ERROR]: pool holds %zu bytes after every block was freed\n", poolStats.bytes);
+        failures++;
+    }
+    TrimPool(&pool);
+
+    printf("== memory ==\n");
+    printf("%-14s %-8s %10s %12s %12s %12s\n", "model", "load", "ms", "heap allocs", "heap KB", "pool KB");
+    const int CYCLES = 8;
+    for (int f = 0; f < OBJ_FILE_COUNT; f++) {
+        for (int threads = 1; threads <= 4; threads += 3) {
+            Mesh mesh = LoadObjFromFileThreaded(objFiles[f], (Vec3){0}, threads);
+            FreeMesh(&mesh);
+
+            before = alloc_snapshot();
+            double start = now_seconds();
+            size_t poolPeak = 0;
+            for (int c = 0; c < CYCLES; c++) {
+                mesh = LoadObjFromFileThreaded(objFiles[f], (Vec3){0}, threads);
+                size_t live = GetPoolStats(MeshDataPool()).bytes;
+                if (live > poolPeak) poolPeak = live;
+                FreeMesh(&mesh);
+            }
+            double ms = (now_seconds() - start) * 1e3 / CYCLES;
+            after = alloc_snapshot();
+
+            const char* load = threads == 1 ? "serial" : "4 thr";
+            double heapAllocs = (double)(after.allocations - before.allocations) / CYCLES;
+            double heapKB = (after.live_bytes - before.live_bytes) / 1024.0;
+            printf("%-14s %-8s %10.3f %12.1f %12.1f %12.1f\n", objFiles[f], load, ms, heapAllocs, heapKB, poolPeak / 1024.0);
+            record_result("memory", objFiles[f], threads == 1 ? "serial_heap_allocs_per_load" : "threaded_heap_allocs_per_load", heapAllocs);
+            if (after.live_bytes != before.live_bytes) {
+                printf("[ERROR]: %s: %s loads left %.1f KB more on the heap\n", objFiles[f], load, heapKB);
+                failures++;
+            }
+            if (threads == 1 && after.allocations != before.allocations) {
+                printf("[ERROR]: %s: a warm serial load still calls malloc\n", objFiles[f]);
+                failures++;
+            }
+        }
+    }
+
+    // a frame's transient arrays: after the first frame the arena is one
+    // block and frames stop allocating
+    Arena frame;
+    InitArena(&frame, "frame", 16 * 1024);
+    uint32_t seed = 1;
+    before = alloc_snapshot();
+    AllocStats warm = before;
+    for (int i = 0; i < 100; i++) {
+        ResetArena(&frame);
+        if (i == 1) warm = alloc_snapshot();
+        for (int d = 0; d < 40; d++) {
+            seed = seed * 1664525u + 1013904223u;
+            ArenaAlloc(&frame, (seed >> 22) * sizeof(MeshletDraw));
+        }
+        seed = 1;
+    }
+    after = alloc_snapshot();
+    printf("frame arena: %.1f KB reserved, %lld heap allocations in the first frame, %lld after\n",
+           frame.reserved / 1024.0, warm.allocations - before.allocations, after.allocations - warm.allocations);
+    if (after.allocations != warm.allocations) {
+        printf("[ERROR]: the frame arena kept allocating after the first frame\n");
+        failures++;
+    }
+    DestroyArena(&frame);
+
+    MemoryStats meshStats = GetPoolStats(MeshDataPool());
+    MemoryStats scratchStats = GetObjScratchStats();
+    PrintMemoryStats("mesh data", &meshStats);
+    PrintMemoryStats("obj scratch", &scratchStats);
+    record_result("memory", "mesh data", "peak_kb", meshStats.peak_bytes / 1024.0);
+    record_result("memory", "obj scratch", "peak_kb", scratchStats.peak_bytes / 1024.0);
+
+    return failures;
+}
+
+static char* WriteScaledObj(const Mesh* mesh, int copies, size_t* size){
+    size_t capacity = ((size_t)mesh->vertex_count * 160 + (size_t)mesh->index_count / 3 * 96) * copies + 64;
+    char* text = malloc(capacity);
+    char* p = text;
+    float step = (mesh->bounds_max.x - mesh->bounds_min.x) * 1.5f + 1.0f;
+
+    for (int k = 0; k < copies; k++) {
+        for (int i = 0; i < mesh->vertex_count; i++) {
+            const Vertex* v = &mesh->vertices[i];
+            p += sprintf(p, "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                         v->position.x + step * k, v->position.y, v->position.z,
+                         v->uv.x, v->uv.y, v->normal.x, v->normal.y, v->normal.z);
+        }
+    }
+    for (int k = 0; k < copies; k++) {
+        uint32_t base = (uint32_t)k * (uint32_t)mesh->vertex_count + 1;
+        for (int t = 0; t + 2 < mesh->index_count; t += 3) {
+            uint32_t a = base + GetMeshIndex(mesh, t), b = base + GetMeshIndex(mesh, t + 1), c = base + GetMeshIndex(mesh, t + 2);
+            p += sprintf(p, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+        }
+    }
+
+    *size = (size_t)(p - text);
+    return text;
+}
+
+static Mesh clone_mesh(const Mesh* mesh){
+    Mesh clone = *mesh;
+    clone.vertices = AllocMeshData(mesh->size, "mesh vertices");
+    clone.indices = AllocMeshData(mesh->index_size, "mesh indices");
+    clone.cache = NULL;
+    memcpy(clone.vertices, mesh->vertices, mesh->size);
+    memcpy(clone.indices, mesh->indices, mesh->index_size);
+    return clone;
+}
+
+// Time and heap use of one pipeline stage, summed over its runs. Short stages
+// repeat until STAGE_MIN_SECONDS, long ones run once.
+#define STAGE_MIN_SECONDS 0.1
+
+typedef struct StageMeasure{
+    double seconds;
+    double start_time;
+    int runs;
+    long long allocations;
+    long long peak_bytes;
+    AllocStats start;
+} StageMeasure;
+
+static bool stage_running(const StageMeasure* m){
+    return m->runs == 0 || (m->seconds < STAGE_MIN_SECONDS && !quickRun);
+}
+
+static void stage_begin(StageMeasure* m){
+    reset_alloc_peak();
+    m->start = alloc_snapshot();
+    m->start_time = now_seconds();
+}
+
+static void stage_end(StageMeasure* m){
+    m->seconds += now_seconds() - m->start_time;
+    AllocStats end = alloc_snapshot();
+    m->allocations += end.allocations - m->start.allocations;
+    if (end.peak_bytes - m->start.live_bytes > m->peak_bytes) {
+        m->peak_bytes = end.peak_bytes - m->start.live_bytes;
+    }
+    m->runs++;
+}
+
+// work is the amount processed per run, in millions of unit.
+static void report_stage(const char* model, const char* stage, const StageMeasure* m, double work, const char* unit){
+    double ms = m->seconds * 1e3 / m->runs;
+    double rate = work * m->runs / m->seconds;
+    char metric[24];
+    snprintf(metric, sizeof(metric), "%s_per_s", unit);
+
+    printf("%-16s %-10s %10.3f %10.3f %-7s %10lld %10.1f\n", model, stage, ms, rate, unit,
+           m->allocations / m->runs, m->peak_bytes / 1024.0);
+
+    char name[40];
+    snprintf(name, sizeof(name), "%s %s", model, stage);
+    record_result("pipeline", name, "ms", ms);
+    record_result("pipeline", name, metric, rate);
+    record_result("pipeline", name, "allocations", (double)(m->allocations / m->runs));
+    record_result("pipeline", name, "peak_heap_kb", m->peak_bytes / 1024.0);
+}
+
+// Runs the whole CPU side of asset loading (parse, optimize, LOD chain,
+// vertex packing) over the cube and every bundled model, and over copies of
+// them tiled up to 16x, reporting time, allocations and peak heap per stage.
+static int BenchPipeline(void){
+    static const int scales[] = {1, 4, 16};
+    int failures = 0;
+
+    printf("== asset pipeline ==\n");
+    printf("%-16s %-10s %10s %10s %-7s %10s %10s\n", "model", "stage", "ms", "rate", "unit", "allocs", "peak KB");
+
+    for (int f = -1; f < OBJ_FILE_COUNT; f++) {
+        const char* path = f < 0 ? "cube" : objFiles[f];
+        Mesh source;
+        StageMeasure m = {0};
+        while (stage_running(&m)) {
+            stage_begin(&m);
+            source = f < 0 ? CreateDefaultCube((Vec3){0}) : LoadObjFromFile(path, (Vec3){0});
+            stage_end(&m);
+            if (stage_running(&m)) FreeMesh(&source);
+        }
+        if (f < 0) {
+            report_stage(path, "source", &m, source.vertex_count / 1e6, "Mvert");
+        } else {
+            report_stage(path, "source", &m, file_size(path) / (1024.0 * 1024.0), "MB");
+        }
+
+        int scaleCount = quickRun ? 1 : (int)(sizeof(scales) / sizeof(scales[0]));
+        for (int s = 0; s < scaleCount; s++) {
+            char model[32];
+            snprintf(model, sizeof(model), "%s x%d", path, scales[s]);
+            size_t textSize;
+            char* text = WriteScaledObj(&source, scales[s], &textSize);
+            double megabytes = textSize / (1024.0 * 1024.0);
+
+            Mesh mesh;
+            m = (StageMeasure){0};
+            while (stage_running(&m)) {
+                stage_begin(&m);
+                mesh = LoadObjFromMemory(text, textSize, (Vec3){0}, 1);
+                stage_end(&m);
+                FreeMesh(&mesh);
+            }
+            report_stage(model, "parse", &m, megabytes, "MB");
+
+            m = (StageMeasure){0};
+            while (stage_running(&m)) {
+                stage_begin(&m);
+                mesh = LoadObjFromMemory(text, textSize, (Vec3){0}, 4);
+                stage_end(&m);
+                if (stage_running(&m)) FreeMesh(&mesh);
+            }
+            report_stage(model, "parse 4thr", &m, megabytes, "MB");
+            free(text);
+
+            if (mesh.vertex_count != source.vertex_count * scales[s] || mesh.index_count != source.index_count * scales[s]) {
+                printf("[ERROR]: %s: parsed %d vertices and %d indices, expected %d and %d\n", model,
+                       mesh.vertex_count, mesh.index_count, source.vertex_count * scales[s], source.index_count * scales[s]);
+                failures++;
+            }
+            double megaTris = mesh.index_count / 3 / 1e6;
+
+            m = (StageMeasure){0};
+            while (stage_running(&m)) {
+                Mesh work = clone_mesh(&mesh);
+                stage_begin(&m);
+                OptimizeMesh(&work, NULL, NULL);
+                stage_end(&m);
+                FreeMesh(&mesh);
+                mesh = work;
+            }
+            report_stage(model, "optimize", &m, megaTris, "Mtri");
+
+            MeshLod lods[MESH_LOD_COUNT];
+            m = (StageMeasure){0};
+            while (stage_running(&m)) {
+                stage_begin(&m);
+                int lodCount = BuildMeshLods(&mesh, lods);
+                stage_end(&m);
+                FreeMeshLods(lods, lodCount);
+            }
+            report_stage(model, "lods", &m, megaTris, "Mtri");
+
+            PackedVertex* packed = malloc((size_t)mesh.vertex_count * sizeof(PackedVertex));
+            m = (StageMeasure){0};
+            while (stage_running(&m)) {
+                stage_begin(&m);
+                PackVertices(&mesh, packed);
+                stage_end(&m);
+            }
+            report_stage(model, "pack", &m, mesh.vertex_count / 1e6, "Mvert");
+            free(packed);
+
+            FreeMesh(&mesh);
+        }
+
+        FreeMesh(&source);
+    }
+
+    AllocStats heap = alloc_snapshot();
+    printf("%lld allocations, %.1f KB still live, peak RSS %zu KB\n", heap.allocations, heap.live_bytes / 1024.0, peak_rss_kb());
+    record_result("process", "bench", "peak_rss_kb", (double)peak_rss_kb());
+    return failures;
+}
+
+int main(int argc, char* argv[]){
+    const char* jsonPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            quickRun = true;
+        } else {
+            printf("[ERROR]: unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    int failures = 0;
+    failures += BenchObjParser();
+    BenchIndexing();
+    BenchMeshCache();
+    failures += BenchRangeAllocator();
+    failures += BenchVertexPacking();
+    failures += BenchMeshOptimize();
+    failures += BenchLodChain();
+    failures += BenchFrustumCulling();
+    failures += BenchOcclusionCulling();
+    failures += BenchBvh();
+    failures += BenchMeshlets();
+    failures += BenchMat4();
+    failures += BenchProfiler();
+    failures += BenchTextureMips();
+    failures += BenchBmpDecode();
+    failures += BenchRenderQueue();
+    failures += BenchJobSystem();
+    failures += BenchDrawPackets();
+    failures += BenchMemory();
+    failures += BenchPipeline();
+
+    FreeObjScratch();
+    if (ReportPoolLeaks(MeshDataPool()) != 0) failures++;
+
+    if (jsonPath && !WriteResultsJson(jsonPath, failures)) {
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
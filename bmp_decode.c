@@ -0,0 +1,197 @@
+#include "bmp_decode.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BMP_DECODE_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BMP_DECODE_NEON 1
+#endif
+
+#define BMP_FILE_HEADER_SIZE 14
+#define BMP_INFO_HEADER_SIZE 40
+#define BMP_MAX_DIMENSION 32768
+
+enum {
+    BMP_RGB = 0,
+    BMP_BITFIELDS = 3,
+    BMP_ALPHABITFIELDS = 6
+};
+
+static uint16_t read16(const uint8_t* p){
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t read32(const uint8_t* p){
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// Masks have to cover a whole byte; anything else goes to the general decoder.
+static bool mask_shift(uint32_t mask, int* shift){
+    if (mask == 0) {
+        *shift = -1;
+        return true;
+    }
+    for (int s = 0; s < 32; s += 8) {
+        if (mask == 0xFFu << s) {
+            *shift = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseBmpHeader(const void* data, size_t size, BmpInfo* out){
+    const uint8_t* p = data;
+    if (size < BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE || p[0] != 'B' || p[1] != 'M') return false;
+
+    uint32_t pixelOffset = read32(p + 10);
+    uint32_t headerSize = read32(p + 14);
+    int32_t width = (int32_t)read32(p + 18);
+    int32_t height = (int32_t)read32(p + 22);
+    int bits = read16(p + 28);
+    uint32_t compression = read32(p + 30);
+    if (headerSize < BMP_INFO_HEADER_SIZE || read16(p + 26) != 1) return false;
+    if (width <= 0 || width > BMP_MAX_DIMENSION || height == 0 || height < -BMP_MAX_DIMENSION || height > BMP_MAX_DIMENSION) return false;
+    if (bits != 24 && bits != 32) return false;
+
+    *out = (BmpInfo){
+        .width = (uint32_t)width,
+        .height = (uint32_t)(height < 0 ? -height : height),
+        .bits_per_pixel = bits,
+        .top_down = height < 0,
+        .pixel_offset = pixelOffset,
+        .row_stride = ((size_t)width * bits + 31) / 32 * 4,
+        .shift = {16, 8, 0, bits == 32 ? 24 : -1}
+    };
+
+    if (compression == BMP_BITFIELDS || compression == BMP_ALPHABITFIELDS) {
+        // the masks follow a 40-byte header and live inside the larger ones
+        size_t masksEnd = BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE + 16;
+        if (bits != 32 || size < masksEnd) return false;
+        bool hasAlpha = headerSize >= 56 || compression == BMP_ALPHABITFIELDS;
+        uint32_t alphaMask = hasAlpha ? read32(p + 66) : 0;
+        if (!mask_shift(read32(p + 54), &out->shift[0]) || !mask_shift(read32(p + 58), &out->shift[1]) ||
+            !mask_shift(read32(p + 62), &out->shift[2]) || !mask_shift(alphaMask, &out->shift[3])) {
+            return false;
+        }
+        if (out->shift[0] < 0 || out->shift[1] < 0 || out->shift[2] < 0) return false;
+    } else if (compression != BMP_RGB) {
+        return false;
+    }
+
+    size_t lastRow = (size_t)(out->height - 1) * out->row_stride + (size_t)out->width * (bits / 8);
+    return pixelOffset <= size && lastRow <= size - pixelOffset;
+}
+
+static const uint8_t* source_row(const void* data, const BmpInfo* info, uint32_t y){
+    uint32_t row = info->top_down ? y : info->height - 1 - y;
+    return (const uint8_t*)data + info->pixel_offset + (size_t)row * info->row_stride;
+}
+
+// Files that store zero in every alpha byte mean "no alpha" in practice.
+static bool alpha_is_empty(const void* data, const BmpInfo* info){
+    if (info->shift[3] < 0) return true;
+    for (uint32_t y = 0; y < info->height; y++) {
+        const uint8_t* src = source_row(data, info, y);
+        for (uint32_t x = 0; x < info->width; x++) {
+            if ((read32(src + x * 4) >> info->shift[3]) & 0xFF) return false;
+        }
+    }
+    return true;
+}
+
+static void decode_pixels_scalar(const uint8_t* src, const BmpInfo* info, bool opaque, uint32_t begin, uint32_t end, uint8_t* dst){
+    int bytes = info->bits_per_pixel / 8;
+    for (uint32_t x = begin; x < end; x++) {
+        const uint8_t* s = src + (size_t)x * bytes;
+        uint32_t px = bytes == 4 ? read32(s) : (uint32_t)(s[0] | s[1] << 8 | s[2] << 16);
+        dst[x * 4 + 0] = (uint8_t)(px >> info->shift[0]);
+        dst[x * 4 + 1] = (uint8_t)(px >> info->shift[1]);
+        dst[x * 4 + 2] = (uint8_t)(px >> info->shift[2]);
+        dst[x * 4 + 3] = opaque ? 0xFF : (uint8_t)(px >> info->shift[3]);
+    }
+}
+
+void DecodeBmpScalar(const void* data, const BmpInfo* info, uint8_t* dst, uint32_t pitch){
+    bool opaque = alpha_is_empty(data, info);
+    for (uint32_t y = 0; y < info->height; y++) {
+        decode_pixels_scalar(source_row(data, info, y), info, opaque, 0, info->width, dst + (size_t)y * pitch);
+    }
+}
+
+#if defined(BMP_DECODE_SSE2)
+// Pixels held as 0xAARRGGBB (or 0x??RRGGBB) in 32-bit lanes; swapping R and
+// B gives RGBA bytes in memory.
+static inline __m128i swap_red_blue(__m128i px, __m128i keep, __m128i alpha){
+    __m128i rb = _mm_and_si128(px, _mm_set1_epi32(0x00FF00FF));
+    __m128i swapped = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+    return _mm_or_si128(_mm_or_si128(_mm_and_si128(px, keep), swapped), alpha);
+}
+#endif
+
+// Returns how many leading pixels of the row were converted.
+static uint32_t decode_pixels_simd(const uint8_t* src, const BmpInfo* info, bool opaque, uint8_t* dst){
+    uint32_t x = 0;
+    uint32_t width = info->width;
+#if defined(BMP_DECODE_SSE2)
+    __m128i keep = _mm_set1_epi32(opaque ? 0x0000FF00 : (int)0xFF00FF00);
+    __m128i alpha = _mm_set1_epi32(opaque ? (int)0xFF000000 : 0);
+    if (info->bits_per_pixel == 32) {
+        for (; x + 4 <= width; x += 4) {
+            __m128i px = _mm_loadu_si128((const __m128i*)(src + x * 4));
+            _mm_storeu_si128((__m128i*)(dst + x * 4), swap_red_blue(px, keep, alpha));
+        }
+    } else {
+        // four unaligned 32-bit loads; the last one reads a byte past the
+        // pixel, so stop one pixel early to stay inside the row
+        for (; x + 5 <= width; x += 4) {
+            const uint8_t* s = src + x * 3;
+            __m128i px = _mm_setr_epi32((int)read32(s), (int)read32(s + 3), (int)read32(s + 6), (int)read32(s + 9));
+            _mm_storeu_si128((__m128i*)(dst + x * 4), swap_red_blue(px, keep, alpha));
+        }
+    }
+#elif defined(BMP_DECODE_NEON)
+    uint8x16_t opaqueAlpha = vdupq_n_u8(0xFF);
+    if (info->bits_per_pixel == 32) {
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x4_t bgra = vld4q_u8(src + x * 4);
+            uint8x16x4_t rgba = {{bgra.val[2], bgra.val[1], bgra.val[0], opaque ? opaqueAlpha : bgra.val[3]}};
+            vst4q_u8(dst + x * 4, rgba);
+        }
+    } else {
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x3_t bgr = vld3q_u8(src + x * 3);
+            uint8x16x4_t rgba = {{bgr.val[2], bgr.val[1], bgr.val[0], opaqueAlpha}};
+            vst4q_u8(dst + x * 4, rgba);
+        }
+    }
+#else
+    (void)src;
+    (void)opaque;
+    (void)dst;
+    (void)width;
+#endif
+    return x;
+}
+
+void DecodeBmp(const void* data, const BmpInfo* info, uint8_t* dst, uint32_t pitch){
+    bool opaque = alpha_is_empty(data, info);
+    // the vector paths assume the standard BGR(A) byte order
+    bool bgra = info->shift[0] == 16 && info->shift[1] == 8 && info->shift[2] == 0 &&
+                (info->shift[3] == 24 || info->shift[3] < 0 || opaque);
+    if (!bgra) {
+        DecodeBmpScalar(data, info, dst, pitch);
+        return;
+    }
+    for (uint32_t y = 0; y < info->height; y++) {
+        const uint8_t* src = source_row(data, info, y);
+        uint8_t* out = dst + (size_t)y * pitch;
+        uint32_t done = decode_pixels_simd(src, info, opaque, out);
+        decode_pixels_scalar(src, info, opaque, done, info->width, out);
+    }
+}
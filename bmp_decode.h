@@ -0,0 +1,33 @@
+#ifndef BMP_DECODE_H
+#define BMP_DECODE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Layout of an uncompressed 24- or 32-bit BMP, as read by ParseBmpHeader.
+// Palettized, 16-bit and RLE files are rejected so the caller can fall back
+// to a general decoder.
+typedef struct BmpInfo{
+    uint32_t width;
+    uint32_t height;
+    int bits_per_pixel;
+    bool top_down;
+    size_t pixel_offset;
+    size_t row_stride;    // source bytes per row, padded to 4
+    int shift[4];         // bit position of R, G, B, A in a pixel, -1 if absent
+} BmpInfo;
+
+bool ParseBmpHeader(const void* data, size_t size, BmpInfo* out);
+
+// Writes the image as RGBA8, top row first, rows pitch bytes apart, in one
+// pass straight from the file bytes, so dst can be the final destination
+// (a mip chain, a mapped transfer buffer). 24-bit files and the BGRA layout
+// of 32-bit ones are swizzled with SSE2/NEON. A 32-bit file whose alpha is
+// zero everywhere is treated as opaque, like SDL_LoadBMP does.
+void DecodeBmp(const void* data, const BmpInfo* info, uint8_t* dst, uint32_t pitch);
+
+// Same output one pixel at a time, as a reference.
+void DecodeBmpScalar(const void* data, const BmpInfo* info, uint8_t* dst, uint32_t pitch);
+
+#endif
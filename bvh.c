@@ -0,0 +1,819 @@
+#include "bvh.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BVH_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BVH_NEON 1
+#endif
+
+#define BVH_EMPTY 0xFFFFFFFFu
+#define BVH_BINS 16
+// Deeper subtrees become leaves, which bounds the traversal stacks.
+#define BVH_MAX_DEPTH 64
+#define BVH_STACK_SIZE (BVH_MAX_DEPTH * (BVH_WIDTH - 1) + 1)
+
+static float axis_of(Vec3 v, int axis){
+    return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+static BvhBounds empty_bounds(void){
+    return (BvhBounds){ {INFINITY, INFINITY, INFINITY}, {-INFINITY, -INFINITY, -INFINITY} };
+}
+
+// Plain compares instead of fminf/fmaxf, which are library calls unless NaN
+// handling is off; the build spends most of its time growing bounds.
+static inline float min_f(float a, float b){ return a < b ? a : b; }
+static inline float max_f(float a, float b){ return a > b ? a : b; }
+
+static void grow_bounds(BvhBounds* b, const BvhBounds* other){
+    b->min.x = min_f(b->min.x, other->min.x);
+    b->min.y = min_f(b->min.y, other->min.y);
+    b->min.z = min_f(b->min.z, other->min.z);
+    b->max.x = max_f(b->max.x, other->max.x);
+    b->max.y = max_f(b->max.y, other->max.y);
+    b->max.z = max_f(b->max.z, other->max.z);
+}
+
+static void grow_point(BvhBounds* b, Vec3 p){
+    BvhBounds point = {p, p};
+    grow_bounds(b, &point);
+}
+
+// Half the surface area, which is all SAH needs.
+static float half_area(const BvhBounds* b){
+    float dx = b->max.x - b->min.x, dy = b->max.y - b->min.y, dz = b->max.z - b->min.z;
+    if (!(dx >= 0.0f)) return 0.0f;
+    return dx * dy + dy * dz + dz * dx;
+}
+
+typedef struct BuildNode{
+    BvhBounds bounds;
+    int left; // -1 for leaves
+    int right;
+    int first;
+    int count;
+} BuildNode;
+
+typedef struct BuildState{
+    const BvhBounds* bounds;
+    Vec3* centroids;
+    uint32_t* prims;
+    BuildNode* nodes;
+    int node_count;
+} BuildState;
+
+typedef struct Bin{
+    BvhBounds bounds;
+    int count;
+} Bin;
+
+static int bin_of(float c, float lo, float scale, int binCount){
+    int b = (int)((c - lo) * scale);
+    return b < 0 ? 0 : b >= binCount ? binCount - 1 : b;
+}
+
+// Binned SAH over centroids, on all three axes. Leaves stop at
+// BVH_LEAF_SIZE unless no split separates the primitives.
+static int build_node(BuildState* s, int first, int count, int depth){
+    int index = s->node_count++;
+    BvhBounds bounds = empty_bounds(), centroids = empty_bounds();
+    for (int i = first; i < first + count; i++) {
+        grow_bounds(&bounds, &s->bounds[s->prims[i]]);
+        grow_point(&centroids, s->centroids[s->prims[i]]);
+    }
+    s->nodes[index] = (BuildNode){ .bounds = bounds, .left = -1, .right = -1, .first = first, .count = count };
+    if (count <= 1 || depth >= BVH_MAX_DEPTH) return index;
+
+    // small nodes do not need more bins than primitives, and they are most
+    // of the nodes
+    int binCount = count < BVH_BINS ? count : BVH_BINS;
+    int bestAxis = -1, bestSplit = 0;
+    float bestCost = INFINITY;
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = axis_of(centroids.min, axis), extent = axis_of(centroids.max, axis) - lo;
+        if (!(extent > 0.0f)) continue;
+        float scale = (float)binCount / extent;
+
+        Bin bins[BVH_BINS];
+        for (int b = 0; b < binCount; b++) bins[b] = (Bin){ empty_bounds(), 0 };
+        for (int i = first; i < first + count; i++) {
+            uint32_t p = s->prims[i];
+            Bin* bin = &bins[bin_of(axis_of(s->centroids[p], axis), lo, scale, binCount)];
+            grow_bounds(&bin->bounds, &s->bounds[p]);
+            bin->count++;
+        }
+
+        // cost of splitting after bin b, swept from both ends
+        float rightCost[BVH_BINS];
+        BvhBounds acc = empty_bounds();
+        int n = 0;
+        for (int b = binCount - 1; b > 0; b--) {
+            grow_bounds(&acc, &bins[b].bounds);
+            n += bins[b].count;
+            rightCost[b - 1] = n ? half_area(&acc) * (float)n : INFINITY;
+        }
+        acc = empty_bounds();
+        n = 0;
+        for (int b = 0; b < binCount - 1; b++) {
+            grow_bounds(&acc, &bins[b].bounds);
+            n += bins[b].count;
+            if (n == 0 || n == count) continue;
+            float cost = half_area(&acc) * (float)n + rightCost[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    // one unit to traverse a node against one per primitive tested
+    float area = half_area(&bounds);
+    float leafCost = area * (float)count;
+    float splitCost = area + bestCost;
+    if (count <= BVH_LEAF_SIZE && leafCost <= splitCost) return index;
+
+    int mid;
+    if (bestAxis < 0) {
+        // every centroid in one spot, split by position in the list
+        mid = first + count / 2;
+    } else {
+        float lo = axis_of(centroids.min, bestAxis);
+        float scale = (float)binCount / (axis_of(centroids.max, bestAxis) - lo);
+        int i = first, j = first + count - 1;
+        while (i <= j) {
+            if (bin_of(axis_of(s->centroids[s->prims[i]], bestAxis), lo, scale, binCount) <= bestSplit) {
+                i++;
+            } else {
+                uint32_t t = s->prims[i];
+                s->prims[i] = s->prims[j];
+                s->prims[j--] = t;
+            }
+        }
+        mid = i;
+    }
+    int left = build_node(s, first, mid - first, depth + 1);
+    int right = build_node(s, mid, first + count - mid, depth + 1);
+    s->nodes[index].left = left;
+    s->nodes[index].right = right;
+    return index;
+}
+
+// Pulls the largest inner descendants of a binary node up until it has four
+// children, then emits those as one wide node.
+static uint32_t collapse(Bvh* bvh, const BuildState* s, int buildIndex, int32_t parent){
+    uint32_t index = (uint32_t)bvh->node_count++;
+    bvh->parents[index] = parent;
+
+    int children[BVH_WIDTH];
+    int n = 0;
+    const BuildNode* b = &s->nodes[buildIndex];
+    if (b->left < 0) {
+        if (b->count > 0) children[n++] = buildIndex;
+    } else {
+        children[n++] = b->left;
+        children[n++] = b->right;
+        while (n < BVH_WIDTH) {
+            int widest = -1;
+            float widestArea = -1.0f;
+            for (int k = 0; k < n; k++) {
+                const BuildNode* c = &s->nodes[children[k]];
+                if (c->left >= 0 && half_area(&c->bounds) > widestArea) {
+                    widest = k;
+                    widestArea = half_area(&c->bounds);
+                }
+            }
+            if (widest < 0) break;
+            const BuildNode* c = &s->nodes[children[widest]];
+            children[widest] = c->left;
+            children[n++] = c->right;
+        }
+    }
+
+    BvhNode* node = &bvh->nodes[index];
+    for (int k = 0; k < BVH_WIDTH; k++) {
+        node->min_x[k] = node->min_y[k] = node->min_z[k] = INFINITY;
+        node->max_x[k] = node->max_y[k] = node->max_z[k] = -INFINITY;
+        node->first[k] = BVH_EMPTY;
+        node->count[k] = 0;
+    }
+    for (int k = 0; k < n; k++) {
+        const BuildNode* c = &s->nodes[children[k]];
+        node->min_x[k] = c->bounds.min.x;
+        node->min_y[k] = c->bounds.min.y;
+        node->min_z[k] = c->bounds.min.z;
+        node->max_x[k] = c->bounds.max.x;
+        node->max_y[k] = c->bounds.max.y;
+        node->max_z[k] = c->bounds.max.z;
+        if (c->left < 0) {
+            node->first[k] = (uint32_t)c->first;
+            node->count[k] = (uint32_t)c->count;
+            for (int i = c->first; i < c->first + c->count; i++) bvh->prim_nodes[s->prims[i]] = index;
+        }
+    }
+    for (int k = 0; k < n; k++) {
+        if (s->nodes[children[k]].left >= 0) {
+            uint32_t child = collapse(bvh, s, children[k], (int32_t)index);
+            bvh->nodes[index].first[k] = child;
+        }
+    }
+    return index;
+}
+
+bool BuildBvh(Bvh* bvh, const BvhBounds* primBounds, int primCount){
+    *bvh = (Bvh){0};
+    int capacity = primCount > 1 ? primCount : 1;
+    bvh->nodes = malloc((size_t)capacity * sizeof(BvhNode));
+    bvh->parents = malloc((size_t)capacity * sizeof(int32_t));
+    bvh->refit = calloc((size_t)capacity, 1);
+    bvh->prims = malloc((size_t)capacity * sizeof(uint32_t));
+    bvh->prim_nodes = malloc((size_t)capacity * sizeof(uint32_t));
+    BuildState s = {
+        .bounds = primBounds,
+        .centroids = malloc((size_t)capacity * sizeof(Vec3)),
+        .prims = bvh->prims,
+        .nodes = malloc((size_t)(2 * capacity - 1) * sizeof(BuildNode))
+    };
+    if (!bvh->nodes || !bvh->parents || !bvh->refit || !bvh->prims || !bvh->prim_nodes || !s.centroids || !s.nodes) {
+        printf("[ERROR]: could not allocate a BVH over %d primitives\n", primCount);
+        free(s.centroids);
+        free(s.nodes);
+        FreeBvh(bvh);
+        return false;
+    }
+
+    for (int i = 0; i < primCount; i++) {
+        const BvhBounds* b = &primBounds[i];
+        s.centroids[i] = (Vec3){ (b->min.x + b->max.x) * 0.5f, (b->min.y + b->max.y) * 0.5f, (b->min.z + b->max.z) * 0.5f };
+        s.prims[i] = (uint32_t)i;
+    }
+    bvh->prim_count = primCount;
+    build_node(&s, 0, primCount, 0);
+    collapse(bvh, &s, 0, -1);
+
+    free(s.centroids);
+    free(s.nodes);
+    return true;
+}
+
+void FreeBvh(Bvh* bvh){
+    free(bvh->nodes);
+    free(bvh->prims);
+    free(bvh->parents);
+    free(bvh->prim_nodes);
+    free(bvh->refit);
+    *bvh = (Bvh){0};
+}
+
+static void set_slot(BvhNode* node, int k, const BvhBounds* b){
+    node->min_x[k] = b->min.x;
+    node->min_y[k] = b->min.y;
+    node->min_z[k] = b->min.z;
+    node->max_x[k] = b->max.x;
+    node->max_y[k] = b->max.y;
+    node->max_z[k] = b->max.z;
+}
+
+static BvhBounds node_bounds(const BvhNode* node){
+    BvhBounds b = empty_bounds();
+    for (int k = 0; k < BVH_WIDTH; k++) {
+        BvhBounds slot = { {node->min_x[k], node->min_y[k], node->min_z[k]}, {node->max_x[k], node->max_y[k], node->max_z[k]} };
+        grow_bounds(&b, &slot);
+    }
+    return b;
+}
+
+void RefitBvh(Bvh* bvh, const BvhBounds* primBounds, const uint32_t* changed, int changedCount){
+    if (changed) {
+        for (int i = 0; i < changedCount; i++) {
+            for (int32_t n = (int32_t)bvh->prim_nodes[changed[i]]; n >= 0 && !bvh->refit[n]; n = bvh->parents[n]) {
+                bvh->refit[n] = 1;
+            }
+        }
+    } else {
+        for (int n = 0; n < bvh->node_count; n++) bvh->refit[n] = 1;
+    }
+
+    for (int n = bvh->node_count - 1; n >= 0; n--) {
+        if (!bvh->refit[n]) continue;
+        bvh->refit[n] = 0;
+        BvhNode* node = &bvh->nodes[n];
+        for (int k = 0; k < BVH_WIDTH; k++) {
+            if (node->first[k] == BVH_EMPTY) continue;
+            BvhBounds b = empty_bounds();
+            if (node->count[k]) {
+                for (uint32_t i = node->first[k]; i < node->first[k] + node->count[k]; i++) grow_bounds(&b, &primBounds[bvh->prims[i]]);
+            } else {
+                b = node_bounds(&bvh->nodes[node->first[k]]);
+            }
+            set_slot(node, k, &b);
+        }
+    }
+}
+
+static int valid_mask(const BvhNode* node){
+    int mask = 0;
+    for (int k = 0; k < BVH_WIDTH; k++) mask |= (node->first[k] != BVH_EMPTY) << k;
+    return mask;
+}
+
+typedef struct Ray{
+    Vec3 origin;
+    Vec3 dir;
+    Vec3 inv_dir;
+} Ray;
+
+// Zero direction components become tiny ones, so the slab test never
+// multiplies zero by infinity.
+static Ray make_ray(Vec3 origin, Vec3 dir){
+    float d[3] = {dir.x, dir.y, dir.z};
+    for (int i = 0; i < 3; i++) {
+        if (fabsf(d[i]) < 1e-30f) d[i] = d[i] < 0.0f ? -1e-30f : 1e-30f;
+    }
+    return (Ray){ origin, dir, {1.0f / d[0], 1.0f / d[1], 1.0f / d[2]} };
+}
+
+// Slab test against the four children; tmin gets the entry distances.
+static int ray_children(const BvhNode* node, const Ray* ray, float maxT, float tmin[BVH_WIDTH]){
+#if defined(BVH_SSE2)
+    __m128 ox = _mm_set1_ps(ray->origin.x), oy = _mm_set1_ps(ray->origin.y), oz = _mm_set1_ps(ray->origin.z);
+    __m128 ix = _mm_set1_ps(ray->inv_dir.x), iy = _mm_set1_ps(ray->inv_dir.y), iz = _mm_set1_ps(ray->inv_dir.z);
+    __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node->min_x), ox), ix);
+    __m128 t2x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node->max_x), ox), ix);
+    __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node->min_y), oy), iy);
+    __m128 t2y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node->max_y), oy), iy);
+    __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node->min_z), oz), iz);
+    __m128 t2z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node->max_z), oz), iz);
+    __m128 tnear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)), _mm_max_ps(_mm_min_ps(t1z, t2z), _mm_setzero_ps()));
+    __m128 tfar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)), _mm_min_ps(_mm_max_ps(t1z, t2z), _mm_set1_ps(maxT)));
+    _mm_storeu_ps(tmin, tnear);
+    return _mm_movemask_ps(_mm_cmple_ps(tnear, tfar));
+#elif defined(BVH_NEON)
+    float32x4_t ox = vdupq_n_f32(ray->origin.x), oy = vdupq_n_f32(ray->origin.y), oz = vdupq_n_f32(ray->origin.z);
+    float32x4_t ix = vdupq_n_f32(ray->inv_dir.x), iy = vdupq_n_f32(ray->inv_dir.y), iz = vdupq_n_f32(ray->inv_dir.z);
+    float32x4_t t1x = vmulq_f32(vsubq_f32(vld1q_f32(node->min_x), ox), ix);
+    float32x4_t t2x = vmulq_f32(vsubq_f32(vld1q_f32(node->max_x), ox), ix);
+    float32x4_t t1y = vmulq_f32(vsubq_f32(vld1q_f32(node->min_y), oy), iy);
+    float32x4_t t2y = vmulq_f32(vsubq_f32(vld1q_f32(node->max_y), oy), iy);
+    float32x4_t t1z = vmulq_f32(vsubq_f32(vld1q_f32(node->min_z), oz), iz);
+    float32x4_t t2z = vmulq_f32(vsubq_f32(vld1q_f32(node->max_z), oz), iz);
+    float32x4_t tnear = vmaxq_f32(vmaxq_f32(vminq_f32(t1x, t2x), vminq_f32(t1y, t2y)), vmaxq_f32(vminq_f32(t1z, t2z), vdupq_n_f32(0.0f)));
+    float32x4_t tfar = vminq_f32(vminq_f32(vmaxq_f32(t1x, t2x), vmaxq_f32(t1y, t2y)), vminq_f32(vmaxq_f32(t1z, t2z), vdupq_n_f32(maxT)));
+    vst1q_f32(tmin, tnear);
+    const uint32_t laneBitsInit[4] = {1, 2, 4, 8};
+    return (int)vaddvq_u32(vandq_u32(vcleq_f32(tnear, tfar), vld1q_u32(laneBitsInit)));
+#else
+    int mask = 0;
+    for (int k = 0; k < BVH_WIDTH; k++) {
+        float t1x = (node->min_x[k] - ray->origin.x) * ray->inv_dir.x, t2x = (node->max_x[k] - ray->origin.x) * ray->inv_dir.x;
+        float t1y = (node->min_y[k] - ray->origin.y) * ray->inv_dir.y, t2y = (node->max_y[k] - ray->origin.y) * ray->inv_dir.y;
+        float t1z = (node->min_z[k] - ray->origin.z) * ray->inv_dir.z, t2z = (node->max_z[k] - ray->origin.z) * ray->inv_dir.z;
+        float tnear = fmaxf(fmaxf(fminf(t1x, t2x), fminf(t1y, t2y)), fmaxf(fminf(t1z, t2z), 0.0f));
+        float tfar = fminf(fminf(fmaxf(t1x, t2x), fmaxf(t1y, t2y)), fminf(fmaxf(t1z, t2z), maxT));
+        tmin[k] = tnear;
+        mask |= (tnear <= tfar) << k;
+    }
+    return mask;
+#endif
+}
+
+static int box_children(const BvhNode* node, const BvhBounds* box){
+#if defined(BVH_SSE2)
+    __m128 x = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node->min_x), _mm_set1_ps(box->max.x)), _mm_cmpge_ps(_mm_loadu_ps(node->max_x), _mm_set1_ps(box->min.x)));
+    __m128 y = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node->min_y), _mm_set1_ps(box->max.y)), _mm_cmpge_ps(_mm_loadu_ps(node->max_y), _mm_set1_ps(box->min.y)));
+    __m128 z = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node->min_z), _mm_set1_ps(box->max.z)), _mm_cmpge_ps(_mm_loadu_ps(node->max_z), _mm_set1_ps(box->min.z)));
+    return _mm_movemask_ps(_mm_and_ps(x, _mm_and_ps(y, z)));
+#elif defined(BVH_NEON)
+    uint32x4_t x = vandq_u32(vcleq_f32(vld1q_f32(node->min_x), vdupq_n_f32(box->max.x)), vcgeq_f32(vld1q_f32(node->max_x), vdupq_n_f32(box->min.x)));
+    uint32x4_t y = vandq_u32(vcleq_f32(vld1q_f32(node->min_y), vdupq_n_f32(box->max.y)), vcgeq_f32(vld1q_f32(node->max_y), vdupq_n_f32(box->min.y)));
+    uint32x4_t z = vandq_u32(vcleq_f32(vld1q_f32(node->min_z), vdupq_n_f32(box->max.z)), vcgeq_f32(vld1q_f32(node->max_z), vdupq_n_f32(box->min.z)));
+    const uint32_t laneBitsInit[4] = {1, 2, 4, 8};
+    return (int)vaddvq_u32(vandq_u32(vandq_u32(x, vandq_u32(y, z)), vld1q_u32(laneBitsInit)));
+#else
+    int mask = 0;
+    for (int k = 0; k < BVH_WIDTH; k++) {
+        bool overlap = node->min_x[k] <= box->max.x && node->max_x[k] >= box->min.x &&
+                       node->min_y[k] <= box->max.y && node->max_y[k] >= box->min.y &&
+                       node->min_z[k] <= box->max.z && node->max_z[k] >= box->min.z;
+        mask |= overlap << k;
+    }
+    return mask;
+#endif
+}
+
+// Children touching the frustum, and in *inside those entirely within it.
+static int frustum_children(const BvhNode* node, const Frustum* frustum, int* inside){
+#if defined(BVH_SSE2)
+    __m128 minX = _mm_loadu_ps(node->min_x), minY = _mm_loadu_ps(node->min_y), minZ = _mm_loadu_ps(node->min_z);
+    __m128 maxX = _mm_loadu_ps(node->max_x), maxY = _mm_loadu_ps(node->max_y), maxZ = _mm_loadu_ps(node->max_z);
+    __m128 touch = _mm_castsi128_ps(_mm_set1_epi32(-1)), within = touch;
+    for (int p = 0; p < 6; p++) {
+        const float* pl = frustum->planes[p];
+        __m128 a = _mm_set1_ps(pl[0]), b = _mm_set1_ps(pl[1]), c = _mm_set1_ps(pl[2]);
+        __m128 ax0 = _mm_mul_ps(a, minX), ax1 = _mm_mul_ps(a, maxX);
+        __m128 by0 = _mm_mul_ps(b, minY), by1 = _mm_mul_ps(b, maxY);
+        __m128 cz0 = _mm_mul_ps(c, minZ), cz1 = _mm_mul_ps(c, maxZ);
+        __m128 far = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_max_ps(ax0, ax1), _mm_max_ps(by0, by1)), _mm_max_ps(cz0, cz1)), _mm_set1_ps(pl[3]));
+        __m128 near = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_min_ps(ax0, ax1), _mm_min_ps(by0, by1)), _mm_min_ps(cz0, cz1)), _mm_set1_ps(pl[3]));
+        touch = _mm_and_ps(touch, _mm_cmpge_ps(far, _mm_setzero_ps()));
+        within = _mm_and_ps(within, _mm_cmpge_ps(near, _mm_setzero_ps()));
+    }
+    *inside = _mm_movemask_ps(within);
+    return _mm_movemask_ps(touch);
+#elif defined(BVH_NEON)
+    float32x4_t minX = vld1q_f32(node->min_x), minY = vld1q_f32(node->min_y), minZ = vld1q_f32(node->min_z);
+    float32x4_t maxX = vld1q_f32(node->max_x), maxY = vld1q_f32(node->max_y), maxZ = vld1q_f32(node->max_z);
+    uint32x4_t touch = vdupq_n_u32(0xFFFFFFFFu), within = touch;
+    for (int p = 0; p < 6; p++) {
+        const float* pl = frustum->planes[p];
+        float32x4_t a = vdupq_n_f32(pl[0]), b = vdupq_n_f32(pl[1]), c = vdupq_n_f32(pl[2]);
+        float32x4_t ax0 = vmulq_f32(a, minX), ax1 = vmulq_f32(a, maxX);
+        float32x4_t by0 = vmulq_f32(b, minY), by1 = vmulq_f32(b, maxY);
+        float32x4_t cz0 = vmulq_f32(c, minZ), cz1 = vmulq_f32(c, maxZ);
+        float32x4_t far = vaddq_f32(vaddq_f32(vaddq_f32(vmaxq_f32(ax0, ax1), vmaxq_f32(by0, by1)), vmaxq_f32(cz0, cz1)), vdupq_n_f32(pl[3]));
+        float32x4_t near = vaddq_f32(vaddq_f32(vaddq_f32(vminq_f32(ax0, ax1), vminq_f32(by0, by1)), vminq_f32(cz0, cz1)), vdupq_n_f32(pl[3]));
+        touch = vandq_u32(touch, vcgeq_f32(far, vdupq_n_f32(0.0f)));
+        within = vandq_u32(within, vcgeq_f32(near, vdupq_n_f32(0.0f)));
+    }
+    const uint32_t laneBitsInit[4] = {1, 2, 4, 8};
+    uint32x4_t laneBits = vld1q_u32(laneBitsInit);
+    *inside = (int)vaddvq_u32(vandq_u32(within, laneBits));
+    return (int)vaddvq_u32(vandq_u32(touch, laneBits));
+#else
+    int touch = 0, within = 0;
+    for (int k = 0; k < BVH_WIDTH; k++) {
+        bool t = true, w = true;
+        for (int p = 0; p < 6; p++) {
+            const float* pl = frustum->planes[p];
+            float ax0 = pl[0] * node->min_x[k], ax1 = pl[0] * node->max_x[k];
+            float by0 = pl[1] * node->min_y[k], by1 = pl[1] * node->max_y[k];
+            float cz0 = pl[2] * node->min_z[k], cz1 = pl[2] * node->max_z[k];
+            t = t && fmaxf(ax0, ax1) + fmaxf(by0, by1) + fmaxf(cz0, cz1) + pl[3] >= 0.0f;
+            w = w && fminf(ax0, ax1) + fminf(by0, by1) + fminf(cz0, cz1) + pl[3] >= 0.0f;
+        }
+        touch |= t << k;
+        within |= w << k;
+    }
+    *inside = within;
+    return touch;
+#endif
+}
+
+// Tests the primitives of one leaf, lowering *maxT on a closer hit.
+typedef bool (*RayLeafFn)(const void* ctx, uint32_t first, uint32_t count, const Ray* ray, float* maxT, BvhHit* hit);
+
+typedef struct StackEntry{
+    uint32_t node;
+    float t;
+} StackEntry;
+
+// Children nearest first: leaves are tested in that order, inner nodes are
+// pushed so the nearest is popped next, and anything entered beyond the
+// closest hit so far is skipped.
+static bool traverse_ray(const Bvh* bvh, const Ray* ray, float maxT, RayLeafFn leaf, const void* ctx, BvhHit* hit){
+    if (bvh->node_count == 0) return false;
+    StackEntry stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = (StackEntry){0, 0.0f};
+    bool found = false;
+
+    while (top > 0) {
+        StackEntry entry = stack[--top];
+        if (entry.t > maxT) continue;
+        const BvhNode* node = &bvh->nodes[entry.node];
+        float tmin[BVH_WIDTH];
+        int mask = ray_children(node, ray, maxT, tmin) & valid_mask(node);
+
+        int order[BVH_WIDTH], n = 0;
+        for (int k = 0; k < BVH_WIDTH; k++) {
+            if (!(mask >> k & 1)) continue;
+            int i = n++;
+            while (i > 0 && tmin[order[i - 1]] > tmin[k]) {
+                order[i] = order[i - 1];
+                i--;
+            }
+            order[i] = k;
+        }
+        for (int i = 0; i < n; i++) {
+            int k = order[i];
+            if (node->count[k] && tmin[k] <= maxT && leaf(ctx, node->first[k], node->count[k], ray, &maxT, hit)) found = true;
+        }
+        for (int i = n - 1; i >= 0; i--) {
+            int k = order[i];
+            if (!node->count[k]) stack[top++] = (StackEntry){node->first[k], tmin[k]};
+        }
+    }
+    return found;
+}
+
+// Möller-Trumbore, both faces.
+static bool ray_triangle(const Ray* ray, const float* tri, float maxT, float* t, float* u, float* v){
+    Vec3 v0 = {tri[0], tri[1], tri[2]};
+    Vec3 e1 = Vec3Sub((Vec3){tri[3], tri[4], tri[5]}, v0);
+    Vec3 e2 = Vec3Sub((Vec3){tri[6], tri[7], tri[8]}, v0);
+    Vec3 p = Vec3Cross(ray->dir, e2);
+    float det = Vec3Dot(e1, p);
+    if (fabsf(det) < 1e-20f) return false;
+    float inv = 1.0f / det;
+    Vec3 s = Vec3Sub(ray->origin, v0);
+    float bu = Vec3Dot(s, p) * inv;
+    if (bu < 0.0f || bu > 1.0f) return false;
+    Vec3 q = Vec3Cross(s, e1);
+    float bv = Vec3Dot(ray->dir, q) * inv;
+    if (bv < 0.0f || bu + bv > 1.0f) return false;
+    float bt = Vec3Dot(e2, q) * inv;
+    if (bt < 0.0f || bt > maxT) return false;
+    *t = bt;
+    *u = bu;
+    *v = bv;
+    return true;
+}
+
+static bool mesh_leaf(const void* ctx, uint32_t first, uint32_t count, const Ray* ray, float* maxT, BvhHit* hit){
+    const MeshBvh* mesh = ctx;
+    bool found = false;
+    for (uint32_t i = first; i < first + count; i++) {
+        float t, u, v;
+        if (ray_triangle(ray, mesh->triangles + (size_t)i * 9, *maxT, &t, &u, &v)) {
+            *maxT = t;
+            *hit = (BvhHit){ .t = t, .u = u, .v = v, .triangle = mesh->bvh.prims[i], .instance = -1 };
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool BuildMeshBvh(MeshBvh* out, const Mesh* mesh){
+    *out = (MeshBvh){0};
+    int count = mesh->index_count / 3;
+    BvhBounds* bounds = malloc((size_t)(count ? count : 1) * sizeof(BvhBounds));
+    out->triangles = malloc((size_t)(count ? count : 1) * 9 * sizeof(float));
+    if (!bounds || !out->triangles) {
+        printf("[ERROR]: could not allocate a BVH over %d triangles\n", count);
+        free(bounds);
+        free(out->triangles);
+        out->triangles = NULL;
+        return false;
+    }
+
+    out->bounds = empty_bounds();
+    for (int t = 0; t < count; t++) {
+        bounds[t] = empty_bounds();
+        for (int c = 0; c < 3; c++) grow_point(&bounds[t], mesh->vertices[GetMeshIndex(mesh, t * 3 + c)].position);
+        grow_bounds(&out->bounds, &bounds[t]);
+    }
+    if (!BuildBvh(&out->bvh, bounds, count)) {
+        free(bounds);
+        FreeMeshBvh(out);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        uint32_t t = out->bvh.prims[i];
+        for (int c = 0; c < 3; c++) {
+            Vec3 p = mesh->vertices[GetMeshIndex(mesh, (int)t * 3 + c)].position;
+            out->triangles[i * 9 + c * 3 + 0] = p.x;
+            out->triangles[i * 9 + c * 3 + 1] = p.y;
+            out->triangles[i * 9 + c * 3 + 2] = p.z;
+        }
+    }
+    free(bounds);
+    return true;
+}
+
+void FreeMeshBvh(MeshBvh* bvh){
+    FreeBvh(&bvh->bvh);
+    free(bvh->triangles);
+    *bvh = (MeshBvh){0};
+}
+
+bool RaycastMeshBvh(const MeshBvh* bvh, Vec3 origin, Vec3 dir, float maxT, BvhHit* hit){
+    BvhHit local;
+    Ray ray = make_ray(origin, dir);
+    return traverse_ray(&bvh->bvh, &ray, maxT, mesh_leaf, bvh, hit ? hit : &local);
+}
+
+static bool bounds_overlap(const BvhBounds* a, const BvhBounds* b){
+    return a->min.x <= b->max.x && a->max.x >= b->min.x &&
+           a->min.y <= b->max.y && a->max.y >= b->min.y &&
+           a->min.z <= b->max.z && a->max.z >= b->min.z;
+}
+
+static BvhBounds triangle_bounds(const float* tri){
+    BvhBounds b = empty_bounds();
+    for (int c = 0; c < 3; c++) grow_point(&b, (Vec3){tri[c * 3], tri[c * 3 + 1], tri[c * 3 + 2]});
+    return b;
+}
+
+static int emit(uint32_t* out, int maxOut, int n, uint32_t id){
+    if (n < maxOut) out[n] = id;
+    return n + 1;
+}
+
+int QueryMeshBvhBox(const MeshBvh* bvh, BvhBounds box, uint32_t* out, int maxOut){
+    if (bvh->bvh.node_count == 0) return 0;
+    uint32_t stack[BVH_STACK_SIZE];
+    int top = 0, n = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode* node = &bvh->bvh.nodes[stack[--top]];
+        int mask = box_children(node, &box) & valid_mask(node);
+        for (int k = 0; k < BVH_WIDTH; k++) {
+            if (!(mask >> k & 1)) continue;
+            if (!node->count[k]) {
+                stack[top++] = node->first[k];
+                continue;
+            }
+            for (uint32_t i = node->first[k]; i < node->first[k] + node->count[k]; i++) {
+                BvhBounds tb = triangle_bounds(bvh->triangles + (size_t)i * 9);
+                if (bounds_overlap(&tb, &box)) n = emit(out, maxOut, n, bvh->bvh.prims[i]);
+            }
+        }
+    }
+    return n;
+}
+
+// World bounds of a box under an affine transform (Arvo).
+static BvhBounds transform_bounds(const BvhBounds* b, const Mat4* m){
+    Vec3 center = {(b->min.x + b->max.x) * 0.5f, (b->min.y + b->max.y) * 0.5f, (b->min.z + b->max.z) * 0.5f};
+    Vec3 extent = {(b->max.x - b->min.x) * 0.5f, (b->max.y - b->min.y) * 0.5f, (b->max.z - b->min.z) * 0.5f};
+    Vec3 c = Mat4TransformPoint(*m, center);
+    Vec3 e = {
+        fabsf(m->m[0]) * extent.x + fabsf(m->m[4]) * extent.y + fabsf(m->m[8]) * extent.z,
+        fabsf(m->m[1]) * extent.x + fabsf(m->m[5]) * extent.y + fabsf(m->m[9]) * extent.z,
+        fabsf(m->m[2]) * extent.x + fabsf(m->m[6]) * extent.y + fabsf(m->m[10]) * extent.z
+    };
+    return (BvhBounds){ {c.x - e.x, c.y - e.y, c.z - e.z}, {c.x + e.x, c.y + e.y, c.z + e.z} };
+}
+
+bool InitSceneBvh(SceneBvh* scene, int capacity){
+    *scene = (SceneBvh){
+        .instances = malloc((size_t)capacity * sizeof(BvhInstance)),
+        .bounds = malloc((size_t)capacity * sizeof(BvhBounds)),
+        .moved = malloc((size_t)capacity * sizeof(uint32_t)),
+        .capacity = capacity
+    };
+    if (!scene->instances || !scene->bounds || !scene->moved) {
+        printf("[ERROR]: could not allocate a scene BVH for %d instances\n", capacity);
+        DestroySceneBvh(scene);
+        return false;
+    }
+    return true;
+}
+
+void DestroySceneBvh(SceneBvh* scene){
+    FreeBvh(&scene->bvh);
+    free(scene->instances);
+    free(scene->bounds);
+    free(scene->moved);
+    *scene = (SceneBvh){0};
+}
+
+int AddBvhInstance(SceneBvh* scene, const MeshBvh* mesh, Mat4 transform){
+    if (scene->count == scene->capacity) return -1;
+    int index = scene->count++;
+    scene->instances[index] = (BvhInstance){ .mesh = mesh, .transform = transform, .inverse = Mat4InverseAffine(transform) };
+    scene->bounds[index] = transform_bounds(&mesh->bounds, &transform);
+    return index;
+}
+
+void SetBvhInstanceTransform(SceneBvh* scene, int index, Mat4 transform){
+    BvhInstance* instance = &scene->instances[index];
+    instance->transform = transform;
+    instance->inverse = Mat4InverseAffine(transform);
+    scene->bounds[index] = transform_bounds(&instance->mesh->bounds, &transform);
+    // past capacity the list stays full, which RefitSceneBvh takes as
+    // everything moved
+    if (index < scene->bvh.prim_count && scene->moved_count < scene->capacity) scene->moved[scene->moved_count++] = (uint32_t)index;
+}
+
+bool RebuildSceneBvh(SceneBvh* scene){
+    FreeBvh(&scene->bvh);
+    scene->moved_count = 0;
+    return BuildBvh(&scene->bvh, scene->bounds, scene->count);
+}
+
+void RefitSceneBvh(SceneBvh* scene){
+    if (scene->moved_count == 0) return;
+    RefitBvh(&scene->bvh, scene->bounds, scene->moved_count < scene->capacity ? scene->moved : NULL, scene->moved_count);
+    scene->moved_count = 0;
+}
+
+// Tests the instance's mesh with the ray in object space. Affine transforms
+// keep t, so hits compare across instances directly.
+static bool instance_leaf(const void* ctx, uint32_t first, uint32_t count, const Ray* ray, float* maxT, BvhHit* hit){
+    const SceneBvh* scene = ctx;
+    bool found = false;
+    for (uint32_t i = first; i < first + count; i++) {
+        uint32_t id = scene->bvh.prims[i];
+        const BvhInstance* instance = &scene->instances[id];
+        const float* m = instance->inverse.m;
+        Vec3 d = ray->dir;
+        Vec3 dir = {
+            m[0] * d.x + m[4] * d.y + m[8] * d.z,
+            m[1] * d.x + m[5] * d.y + m[9] * d.z,
+            m[2] * d.x + m[6] * d.y + m[10] * d.z
+        };
+        Ray local = make_ray(Mat4TransformPoint(instance->inverse, ray->origin), dir);
+        if (traverse_ray(&instance->mesh->bvh, &local, *maxT, mesh_leaf, instance->mesh, hit)) {
+            *maxT = hit->t;
+            hit->instance = (int)id;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool RaycastSceneBvh(const SceneBvh* scene, Vec3 origin, Vec3 dir, float maxT, BvhHit* hit){
+    BvhHit local;
+    Ray ray = make_ray(origin, dir);
+    return traverse_ray(&scene->bvh, &ray, maxT, instance_leaf, scene, hit ? hit : &local);
+}
+
+int QuerySceneBvhBox(const SceneBvh* scene, BvhBounds box, uint32_t* out, int maxOut){
+    const Bvh* bvh = &scene->bvh;
+    if (bvh->node_count == 0) return 0;
+    uint32_t stack[BVH_STACK_SIZE];
+    int top = 0, n = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode* node = &bvh->nodes[stack[--top]];
+        int mask = box_children(node, &box) & valid_mask(node);
+        for (int k = 0; k < BVH_WIDTH; k++) {
+            if (!(mask >> k & 1)) continue;
+            if (!node->count[k]) {
+                stack[top++] = node->first[k];
+                continue;
+            }
+            for (uint32_t i = node->first[k]; i < node->first[k] + node->count[k]; i++) {
+                if (bounds_overlap(&scene->bounds[bvh->prims[i]], &box)) n = emit(out, maxOut, n, bvh->prims[i]);
+            }
+        }
+    }
+    return n;
+}
+
+static bool bounds_touch_frustum(const BvhBounds* b, const Frustum* frustum){
+    for (int p = 0; p < 6; p++) {
+        const float* pl = frustum->planes[p];
+        float far = fmaxf(pl[0] * b->min.x, pl[0] * b->max.x) + fmaxf(pl[1] * b->min.y, pl[1] * b->max.y) +
+                    fmaxf(pl[2] * b->min.z, pl[2] * b->max.z) + pl[3];
+        if (far < 0.0f) return false;
+    }
+    return true;
+}
+
+// Everything below a node that is entirely inside, without further tests.
+static int emit_subtree(const Bvh* bvh, uint32_t root, uint32_t* out, int maxOut, int n){
+    uint32_t stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = root;
+    while (top > 0) {
+        const BvhNode* node = &bvh->nodes[stack[--top]];
+        for (int k = 0; k < BVH_WIDTH; k++) {
+            if (node->first[k] == BVH_EMPTY) continue;
+            if (!node->count[k]) {
+                stack[top++] = node->first[k];
+                continue;
+            }
+            for (uint32_t i = node->first[k]; i < node->first[k] + node->count[k]; i++) n = emit(out, maxOut, n, bvh->prims[i]);
+        }
+    }
+    return n;
+}
+
+int QuerySceneBvhFrustum(const SceneBvh* scene, const Frustum* frustum, uint32_t* out, int maxOut){
+    const Bvh* bvh = &scene->bvh;
+    if (bvh->node_count == 0) return 0;
+    uint32_t stack[BVH_STACK_SIZE];
+    int top = 0, n = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode* node = &bvh->nodes[stack[--top]];
+        int inside;
+        int valid = valid_mask(node);
+        int mask = frustum_children(node, frustum, &inside) & valid;
+        inside &= valid;
+        for (int k = 0; k < BVH_WIDTH; k++) {
+            if (!(mask >> k & 1)) continue;
+            if (!node->count[k]) {
+                if (inside >> k & 1) {
+                    n = emit_subtree(bvh, node->first[k], out, maxOut, n);
+                } else {
+                    stack[top++] = node->first[k];
+                }
+                continue;
+            }
+            for (uint32_t i = node->first[k]; i < node->first[k] + node->count[k]; i++) {
+                uint32_t id = bvh->prims[i];
+                if ((inside >> k & 1) || bounds_touch_frustum(&scene->bounds[id], frustum)) n = emit(out, maxOut, n, id);
+            }
+        }
+    }
+    return n;
+}
@@ -0,0 +1,107 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "mesh.h"
+#include "mat4.h"
+#include "frustum_cull.h"
+
+#define BVH_WIDTH 4
+#define BVH_LEAF_SIZE 4 // most primitives the binned SAH build puts in a leaf
+
+typedef struct BvhBounds{
+    Vec3 min;
+    Vec3 max;
+} BvhBounds;
+
+// Four children in structure-of-arrays form, so one SIMD test covers the
+// whole node. A child with count > 0 is a leaf over prims[first ..
+// first + count), count 0 is an inner node at nodes[first], and an unused
+// slot has inverted bounds that no query touches.
+typedef struct BvhNode{
+    float min_x[BVH_WIDTH], min_y[BVH_WIDTH], min_z[BVH_WIDTH];
+    float max_x[BVH_WIDTH], max_y[BVH_WIDTH], max_z[BVH_WIDTH];
+    uint32_t first[BVH_WIDTH];
+    uint32_t count[BVH_WIDTH];
+} BvhNode;
+
+// 4-wide BVH over any primitives given as boxes: built as a binary tree with
+// binned SAH, then collapsed. Children always come after their parent, so a
+// reverse walk over the nodes refits bottom up.
+typedef struct Bvh{
+    BvhNode* nodes;
+    int node_count;
+    uint32_t* prims; // primitive ids in leaf order
+    int prim_count;
+    int32_t* parents; // parent node per node, -1 for the root
+    uint32_t* prim_nodes; // node whose leaf holds each primitive id
+    uint8_t* refit; // nodes RefitBvh has to update
+} Bvh;
+
+bool BuildBvh(Bvh* bvh, const BvhBounds* primBounds, int primCount);
+void FreeBvh(Bvh* bvh);
+
+// Updates the node bounds above changed primitives, keeping the tree. Query
+// cost grows as primitives drift away from where they were built.
+void RefitBvh(Bvh* bvh, const BvhBounds* primBounds, const uint32_t* changed, int changedCount);
+
+// Triangle BVH of one mesh, in object space.
+typedef struct MeshBvh{
+    Bvh bvh;
+    float* triangles; // v0, v1 - v0, v2 - v0 per triangle, in leaf order
+    BvhBounds bounds;
+} MeshBvh;
+
+bool BuildMeshBvh(MeshBvh* out, const Mesh* mesh);
+void FreeMeshBvh(MeshBvh* bvh);
+
+typedef struct BvhHit{
+    float t; // along the ray direction as given, not normalized
+    float u, v; // barycentrics of v1 and v2
+    uint32_t triangle; // index of the triangle's first index / 3
+    int instance; // -1 for mesh queries
+} BvhHit;
+
+// Nearest hit with t in [0, maxT]. hit may be NULL to only test.
+bool RaycastMeshBvh(const MeshBvh* bvh, Vec3 origin, Vec3 dir, float maxT, BvhHit* hit);
+
+// Writes up to maxOut triangles whose bounds overlap box, returns how many
+// overlap in total.
+int QueryMeshBvhBox(const MeshBvh* bvh, BvhBounds box, uint32_t* out, int maxOut);
+
+typedef struct BvhInstance{
+    const MeshBvh* mesh;
+    Mat4 transform;
+    Mat4 inverse;
+} BvhInstance;
+
+// Top level over mesh BVH instances. Move instances with
+// SetBvhInstanceTransform and call RefitSceneBvh once before querying;
+// RebuildSceneBvh is needed after adding instances.
+typedef struct SceneBvh{
+    Bvh bvh;
+    BvhInstance* instances;
+    BvhBounds* bounds; // world bounds per instance
+    uint32_t* moved;
+    int moved_count;
+    int count;
+    int capacity;
+} SceneBvh;
+
+bool InitSceneBvh(SceneBvh* scene, int capacity);
+void DestroySceneBvh(SceneBvh* scene);
+
+// Returns the instance index, or -1 when full.
+int AddBvhInstance(SceneBvh* scene, const MeshBvh* mesh, Mat4 transform);
+void SetBvhInstanceTransform(SceneBvh* scene, int index, Mat4 transform);
+
+bool RebuildSceneBvh(SceneBvh* scene);
+void RefitSceneBvh(SceneBvh* scene);
+
+bool RaycastSceneBvh(const SceneBvh* scene, Vec3 origin, Vec3 dir, float maxT, BvhHit* hit);
+
+// Instances whose world bounds overlap box or touch the frustum; same
+// counting as QueryMeshBvhBox.
+int QuerySceneBvhBox(const SceneBvh* scene, BvhBounds box, uint32_t* out, int maxOut);
+int QuerySceneBvhFrustum(const SceneBvh* scene, const Frustum* frustum, uint32_t* out, int maxOut);
+
+#endif
@@ -0,0 +1,112 @@
+#include "draw_packets.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PACKET_LIST_INITIAL 256
+
+void BeginPackets(PacketBuilder* builder, const JobSystem* jobs){
+    builder->list_count = jobs->thread_count + 1;
+    for (int i = 0; i < builder->list_count; i++) {
+        builder->lists[i].count = 0;
+        builder->lists[i].index = (uint32_t)i;
+    }
+}
+
+PacketList* WorkerPacketList(PacketBuilder* builder, const JobSystem* jobs){
+    return &builder->lists[JobWorkerIndex(jobs)];
+}
+
+static bool grow_list(PacketList* list){
+    int capacity = list->capacity ? list->capacity * 2 : PACKET_LIST_INITIAL;
+    if (capacity > (1 << PACKET_LIST_BITS)) {
+        printf("[ERROR]: packet list is full at %d packets\n", list->capacity);
+        return false;
+    }
+    DrawPacket* packets = realloc(list->packets, (size_t)capacity * sizeof(DrawPacket));
+    if (packets) list->packets = packets;
+    RenderItem* items = packets ? realloc(list->items, (size_t)capacity * sizeof(RenderItem)) : NULL;
+    if (!items) {
+        printf("[ERROR]: could not grow packet list to %d packets\n", capacity);
+        return false;
+    }
+    list->items = items;
+    list->capacity = capacity;
+    return true;
+}
+
+bool PushDrawPacket(PacketList* list, uint64_t key, const DrawUniforms* uniforms, uint32_t state){
+    if (list->count == list->capacity && !grow_list(list)) return false;
+    list->packets[list->count] = (DrawPacket){ .uniforms = *uniforms, .state = state };
+    list->items[list->count] = (RenderItem){ .key = key, .draw = list->index << PACKET_LIST_BITS | (uint32_t)list->count };
+    list->count++;
+    return true;
+}
+
+typedef struct InstanceBatch{
+    PacketBuilder* builder;
+    const JobSystem* jobs;
+    const InstancePackets* params;
+} InstanceBatch;
+
+// Longest axis of the upper 3x3, so a sphere stays enclosing under scale.
+static float max_axis_scale(const Mat4* m){
+    float best = 0.0f;
+    for (int c = 0; c < 3; c++) {
+        const float* col = &m->m[c * 4];
+        float len = col[0] * col[0] + col[1] * col[1] + col[2] * col[2];
+        if (len > best) best = len;
+    }
+    return sqrtf(best);
+}
+
+static void build_instance_range(void* data, int begin, int end){
+    InstanceBatch* batch = data;
+    const InstancePackets* p = batch->params;
+    PacketList* list = WorkerPacketList(batch->builder, batch->jobs);
+
+    for (int s = begin; s < end; s++) {
+        Mat4 instance;
+        InstanceMatrix(&p->instances[s], instance.m);
+        Mat4 model = Mat4Multiply(p->model, instance);
+        Vec3 center = Mat4TransformPoint(model, p->center);
+        if (!SphereInFrustum(&p->frustum, center, p->radius * max_axis_scale(&model))) continue;
+
+        DrawUniforms uniforms = {
+            .mvp = Mat4Multiply(p->view_proj, Mat4Multiply(model, p->vertex_decode)),
+            .normal = Mat4NormalMatrix(model)
+        };
+        float depth = -Mat4TransformPoint(p->view, center).z;
+        uint64_t key = MakeRenderKey(RENDER_PASS_OPAQUE, p->pipeline, p->material, p->texture, p->mesh, depth);
+        if (!PushDrawPacket(list, key, &uniforms, p->state)) return;
+    }
+}
+
+static int packet_total(const PacketBuilder* builder){
+    int total = 0;
+    for (int i = 0; i < builder->list_count; i++) total += builder->lists[i].count;
+    return total;
+}
+
+int BuildInstancePackets(JobSystem* jobs, PacketBuilder* builder, const InstancePackets* params, int grain){
+    int before = packet_total(builder);
+    InstanceBatch batch = { .builder = builder, .jobs = jobs, .params = params };
+    ParallelFor(jobs, params->count, grain, build_instance_range, &batch);
+    return packet_total(builder) - before;
+}
+
+bool MergePackets(const PacketBuilder* builder, RenderQueue* queue){
+    for (int i = 0; i < builder->list_count; i++) {
+        if (!AppendRenderItems(queue, builder->lists[i].items, builder->lists[i].count)) return false;
+    }
+    return true;
+}
+
+void FreePacketBuilder(PacketBuilder* builder){
+    for (int i = 0; i < JOB_MAX_THREADS + 1; i++) {
+        free(builder->lists[i].packets);
+        free(builder->lists[i].items);
+    }
+    *builder = (PacketBuilder){0};
+}
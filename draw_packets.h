@@ -0,0 +1,83 @@
+#ifndef DRAW_PACKETS_H
+#define DRAW_PACKETS_H
+
+#include "mat4.h"
+#include "frustum_cull.h"
+#include "job_system.h"
+#include "render_queue.h"
+#include "scene_instances.h"
+
+// Vertex uniform slot 1, pushed per draw. The shader gets the finished MVP
+// instead of multiplying model, view and proj for every vertex.
+typedef struct DrawUniforms{
+    Mat4 mvp;
+    NormalMatrix normal;
+} DrawUniforms;
+
+// Everything one draw needs that differs per object. state indexes the
+// caller's table of GPU state (pipeline, texture, geometry), which workers
+// never touch, so packets can be built without the GPU API.
+typedef struct DrawPacket{
+    DrawUniforms uniforms;
+    uint32_t state;
+} DrawPacket;
+
+// Packets and their sort items, written by one thread only. Each list gets
+// its own cache line so workers pushing side by side do not share one.
+typedef struct PacketList{
+    _Alignas(64) DrawPacket* packets;
+    RenderItem* items;
+    int count;
+    int capacity;
+    uint32_t index; // position in the builder, stamped into the item draw ids
+} PacketList;
+
+// Render item draw ids carry the list in the top bits and the packet in the
+// low PACKET_LIST_BITS.
+#define PACKET_LIST_BITS 24
+
+// One list per job worker plus one for other threads. The lists keep their
+// memory between frames.
+typedef struct PacketBuilder{
+    PacketList lists[JOB_MAX_THREADS + 1];
+    int list_count;
+} PacketBuilder;
+
+// Empties the lists at the start of a frame, sized for every queue of jobs.
+void BeginPackets(PacketBuilder* builder, const JobSystem* jobs);
+
+// The list of the calling thread. Only that thread may push to it.
+PacketList* WorkerPacketList(PacketBuilder* builder, const JobSystem* jobs);
+
+bool PushDrawPacket(PacketList* list, uint64_t key, const DrawUniforms* uniforms, uint32_t state);
+
+// One mesh drawn once per instance, each culled and keyed on its own.
+typedef struct InstancePackets{
+    Mat4 view;
+    Mat4 view_proj;
+    Frustum frustum; // world space, from view_proj
+    Mat4 model;
+    Mat4 vertex_decode; // applied before model, for packed vertices
+    Vec3 center;
+    float radius;
+    const InstanceData* instances;
+    int count;
+    uint32_t pipeline, material, texture, mesh;
+    uint32_t state;
+} InstancePackets;
+
+// Culls and builds the packets of every instance in parallel on jobs, grain
+// instances per job, each worker into its own list. Returns the number of
+// packets built.
+int BuildInstancePackets(JobSystem* jobs, PacketBuilder* builder, const InstancePackets* params, int grain);
+
+// Appends the items of every list to queue, in list order.
+bool MergePackets(const PacketBuilder* builder, RenderQueue* queue);
+
+static inline const DrawPacket* GetDrawPacket(const PacketBuilder* builder, uint32_t draw){
+    return &builder->lists[draw >> PACKET_LIST_BITS].packets[draw & ((1u << PACKET_LIST_BITS) - 1)];
+}
+
+void FreePacketBuilder(PacketBuilder* builder);
+
+#endif
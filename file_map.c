@@ -0,0 +1,93 @@
+#include "file_map.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+bool MapFile(const char* filePath, MappedFile* out){
+    *out = (MappedFile){0};
+
+    HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE){
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size)){
+        CloseHandle(file);
+        return false;
+    }
+    if(size.QuadPart == 0){
+        CloseHandle(file);
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if(!mapping){
+        return false;
+    }
+
+    const char* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!data){
+        CloseHandle(mapping);
+        return false;
+    }
+
+    out->data = data;
+    out->size = (size_t)size.QuadPart;
+    out->handle = mapping;
+    return true;
+}
+
+void UnmapFile(MappedFile* file){
+    if(file->data){
+        UnmapViewOfFile(file->data);
+        CloseHandle(file->handle);
+    }
+    *file = (MappedFile){0};
+}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MapFile(const char* filePath, MappedFile* out){
+    *out = (MappedFile){0};
+
+    int fd = open(filePath, O_RDONLY);
+    if(fd < 0){
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        close(fd);
+        return false;
+    }
+    if(st.st_size == 0){
+        close(fd);
+        return true;
+    }
+
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED){
+        return false;
+    }
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    out->data = data;
+    out->size = (size_t)st.st_size;
+    return true;
+}
+
+void UnmapFile(MappedFile* file){
+    if(file->data){
+        munmap((void*)file->data, file->size);
+    }
+    *file = (MappedFile){0};
+}
+
+#endif
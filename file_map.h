@@ -0,0 +1,18 @@
+#ifndef FILE_MAP_H
+#define FILE_MAP_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct MappedFile{
+    const char* data;
+    size_t size;
+    void* handle;
+} MappedFile;
+
+// Maps a whole file read-only. Returns false if the file could not be opened.
+// An empty file maps successfully with data == NULL and size == 0.
+bool MapFile(const char* filePath, MappedFile* out);
+void UnmapFile(MappedFile* file);
+
+#endif
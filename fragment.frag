@@ -1,6 +1,7 @@
 #version 450
 
-layout(set = 0, binding = 0) uniform sampler2D Sampler;
+// SDL GPU puts fragment sampler N at set 2, binding N.
+layout(set = 2, binding = 0) uniform sampler2D Sampler;
 
 layout(location = 0) in vec3 fragNormal;
 layout(location = 1) in vec2 fragTexCoord;
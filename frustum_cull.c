@@ -0,0 +1,201 @@
+#include "frustum_cull.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRUSTUM_CULL_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define FRUSTUM_CULL_NEON 1
+#endif
+
+#define CULL_LANES 4
+
+static void normalize_plane(float* plane){
+    float len = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+    if (len > 0.0f) {
+        for (int i = 0; i < 4; i++) plane[i] /= len;
+    }
+}
+
+Frustum ExtractFrustum(const float clip[16]){
+    float rows[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) rows[r][c] = clip[c * 4 + r];
+    }
+
+    Frustum frustum;
+    for (int i = 0; i < 4; i++) {
+        frustum.planes[0][i] = rows[3][i] + rows[0][i]; // left
+        frustum.planes[1][i] = rows[3][i] - rows[0][i]; // right
+        frustum.planes[2][i] = rows[3][i] + rows[1][i]; // bottom
+        frustum.planes[3][i] = rows[3][i] - rows[1][i]; // top
+        frustum.planes[4][i] = rows[2][i];              // near, z >= 0
+        frustum.planes[5][i] = rows[3][i] - rows[2][i]; // far
+    }
+    for (int p = 0; p < 6; p++) normalize_plane(frustum.planes[p]);
+    return frustum;
+}
+
+bool InitCullBounds(CullBounds* bounds, int capacity){
+    // whole SIMD groups so the kernel never reads past the arrays
+    capacity = (capacity + CULL_LANES - 1) / CULL_LANES * CULL_LANES;
+    float* block = calloc((size_t)capacity * 7, sizeof(float));
+    if (!block) {
+        printf("[ERROR]: could not allocate cull bounds for %d objects\n", capacity);
+        return false;
+    }
+
+    *bounds = (CullBounds){
+        .center_x = block,
+        .center_y = block + capacity,
+        .center_z = block + capacity * 2,
+        .radius = block + capacity * 3,
+        .extent_x = block + capacity * 4,
+        .extent_y = block + capacity * 5,
+        .extent_z = block + capacity * 6,
+        .count = 0,
+        .capacity = capacity
+    };
+    return true;
+}
+
+void DestroyCullBounds(CullBounds* bounds){
+    free(bounds->center_x);
+    *bounds = (CullBounds){0};
+}
+
+int AddCullBounds(CullBounds* bounds, const Mesh* mesh){
+    if (bounds->count >= bounds->capacity) {
+        return -1;
+    }
+    int i = bounds->count++;
+    SetCullBounds(bounds, i, mesh);
+    return i;
+}
+
+void SetCullBounds(CullBounds* bounds, int index, const Mesh* mesh){
+    bounds->center_x[index] = (mesh->bounds_min.x + mesh->bounds_max.x) * 0.5f;
+    bounds->center_y[index] = (mesh->bounds_min.y + mesh->bounds_max.y) * 0.5f;
+    bounds->center_z[index] = (mesh->bounds_min.z + mesh->bounds_max.z) * 0.5f;
+    bounds->radius[index] = mesh->bounds_radius;
+    bounds->extent_x[index] = (mesh->bounds_max.x - mesh->bounds_min.x) * 0.5f;
+    bounds->extent_y[index] = (mesh->bounds_max.y - mesh->bounds_min.y) * 0.5f;
+    bounds->extent_z[index] = (mesh->bounds_max.z - mesh->bounds_min.z) * 0.5f;
+}
+
+bool SphereInFrustum(const Frustum* frustum, Vec3 center, float radius){
+    for (int p = 0; p < 6; p++) {
+        const float* pl = frustum->planes[p];
+        if (pl[0] * center.x + pl[1] * center.y + pl[2] * center.z + pl[3] + radius < 0.0f) return false;
+    }
+    return true;
+}
+
+int CullFrustumScalar(const CullBounds* bounds, const Frustum* frustum, uint32_t* visible){
+    int visibleCount = 0;
+    for (int i = 0; i < bounds->count; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6; p++) {
+            const float* pl = frustum->planes[p];
+            float dist = pl[0] * bounds->center_x[i] + pl[1] * bounds->center_y[i] + pl[2] * bounds->center_z[i] + pl[3];
+            float reach = fabsf(pl[0]) * bounds->extent_x[i] + fabsf(pl[1]) * bounds->extent_y[i] + fabsf(pl[2]) * bounds->extent_z[i];
+            inside = inside && (dist + bounds->radius[i] >= 0.0f) && (dist + reach >= 0.0f);
+        }
+        if (inside) visible[visibleCount++] = (uint32_t)i;
+    }
+    return visibleCount;
+}
+
+// Appends the set lanes of mask without branching on it. May write up to
+// three entries past the returned count, still inside the capacity.
+static inline int append_visible(uint32_t* visible, int visibleCount, int first, int mask){
+    visible[visibleCount] = (uint32_t)first;
+    visibleCount += mask & 1;
+    visible[visibleCount] = (uint32_t)first + 1;
+    visibleCount += (mask >> 1) & 1;
+    visible[visibleCount] = (uint32_t)first + 2;
+    visibleCount += (mask >> 2) & 1;
+    visible[visibleCount] = (uint32_t)first + 3;
+    visibleCount += (mask >> 3) & 1;
+    return visibleCount;
+}
+
+int CullFrustum(const CullBounds* bounds, const Frustum* frustum, uint32_t* visible){
+#if defined(FRUSTUM_CULL_SSE2)
+    __m128 planes[6][7];
+    for (int p = 0; p < 6; p++) {
+        const float* pl = frustum->planes[p];
+        for (int k = 0; k < 4; k++) planes[p][k] = _mm_set1_ps(pl[k]);
+        for (int k = 0; k < 3; k++) planes[p][4 + k] = _mm_set1_ps(fabsf(pl[k]));
+    }
+    const __m128 zero = _mm_setzero_ps();
+
+    int visibleCount = 0;
+    for (int i = 0; i < bounds->count; i += CULL_LANES) {
+        __m128 cx = _mm_loadu_ps(bounds->center_x + i);
+        __m128 cy = _mm_loadu_ps(bounds->center_y + i);
+        __m128 cz = _mm_loadu_ps(bounds->center_z + i);
+        __m128 r = _mm_loadu_ps(bounds->radius + i);
+        __m128 ex = _mm_loadu_ps(bounds->extent_x + i);
+        __m128 ey = _mm_loadu_ps(bounds->extent_y + i);
+        __m128 ez = _mm_loadu_ps(bounds->extent_z + i);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            const __m128* pl = planes[p];
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(pl[0], cx), _mm_mul_ps(pl[1], cy)), _mm_mul_ps(pl[2], cz)), pl[3]);
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pl[4], ex), _mm_mul_ps(pl[5], ey)), _mm_mul_ps(pl[6], ez));
+            __m128 sphere = _mm_cmpge_ps(_mm_add_ps(dist, r), zero);
+            __m128 box = _mm_cmpge_ps(_mm_add_ps(dist, reach), zero);
+            inside = _mm_and_ps(inside, _mm_and_ps(sphere, box));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        if (bounds->count - i < CULL_LANES) mask &= (1 << (bounds->count - i)) - 1;
+        visibleCount = append_visible(visible, visibleCount, i, mask);
+    }
+    return visibleCount;
+#elif defined(FRUSTUM_CULL_NEON)
+    float32x4_t planes[6][7];
+    for (int p = 0; p < 6; p++) {
+        const float* pl = frustum->planes[p];
+        for (int k = 0; k < 4; k++) planes[p][k] = vdupq_n_f32(pl[k]);
+        for (int k = 0; k < 3; k++) planes[p][4 + k] = vdupq_n_f32(fabsf(pl[k]));
+    }
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const uint32_t laneBitsInit[4] = {1, 2, 4, 8};
+    const uint32x4_t laneBits = vld1q_u32(laneBitsInit);
+
+    int visibleCount = 0;
+    for (int i = 0; i < bounds->count; i += CULL_LANES) {
+        float32x4_t cx = vld1q_f32(bounds->center_x + i);
+        float32x4_t cy = vld1q_f32(bounds->center_y + i);
+        float32x4_t cz = vld1q_f32(bounds->center_z + i);
+        float32x4_t r = vld1q_f32(bounds->radius + i);
+        float32x4_t ex = vld1q_f32(bounds->extent_x + i);
+        float32x4_t ey = vld1q_f32(bounds->extent_y + i);
+        float32x4_t ez = vld1q_f32(bounds->extent_z + i);
+
+        uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFu);
+        for (int p = 0; p < 6; p++) {
+            const float32x4_t* pl = planes[p];
+            float32x4_t dist = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(pl[0], cx), vmulq_f32(pl[1], cy)), vmulq_f32(pl[2], cz)), pl[3]);
+            float32x4_t reach = vaddq_f32(vaddq_f32(vmulq_f32(pl[4], ex), vmulq_f32(pl[5], ey)), vmulq_f32(pl[6], ez));
+            uint32x4_t sphere = vcgeq_f32(vaddq_f32(dist, r), zero);
+            uint32x4_t box = vcgeq_f32(vaddq_f32(dist, reach), zero);
+            inside = vandq_u32(inside, vandq_u32(sphere, box));
+        }
+
+        int mask = (int)vaddvq_u32(vandq_u32(inside, laneBits));
+        if (bounds->count - i < CULL_LANES) mask &= (1 << (bounds->count - i)) - 1;
+        visibleCount = append_visible(visible, visibleCount, i, mask);
+    }
+    return visibleCount;
+#else
+    return CullFrustumScalar(bounds, frustum, visible);
+#endif
+}
@@ -0,0 +1,54 @@
+#ifndef FRUSTUM_CULL_H
+#define FRUSTUM_CULL_H
+
+#include "mesh.h"
+
+// Planes point inwards and are normalized: a point p is inside plane i when
+// dot(planes[i].xyz, p) + planes[i].w >= 0.
+typedef struct Frustum{
+    float planes[6][4];
+} Frustum;
+
+// Gribb/Hartmann extraction from a column-major clip matrix (proj * view, or
+// proj * view * model to get the planes in model space). Expects the [0, 1]
+// depth range SDL GPU uses.
+Frustum ExtractFrustum(const float clip[16]);
+
+// Sphere test for a single object, for callers that compute bounds on the
+// fly (per-instance transforms) instead of keeping a CullBounds.
+bool SphereInFrustum(const Frustum* frustum, Vec3 center, float radius);
+
+// Structure-of-arrays bounds so the culling kernel loads four or more objects
+// per instruction. Every object has a sphere and an AABB (center + half
+// extents); both share the center.
+typedef struct CullBounds{
+    float* center_x;
+    float* center_y;
+    float* center_z;
+    float* radius;
+    float* extent_x;
+    float* extent_y;
+    float* extent_z;
+    int count;
+    int capacity;
+} CullBounds;
+
+bool InitCullBounds(CullBounds* bounds, int capacity);
+void DestroyCullBounds(CullBounds* bounds);
+
+// Appends the bounds of a mesh, returns its index or -1 when full.
+int AddCullBounds(CullBounds* bounds, const Mesh* mesh);
+
+// Replaces the bounds of an existing object, e.g. once its mesh has loaded.
+void SetCullBounds(CullBounds* bounds, int index, const Mesh* mesh);
+
+// Writes the indices of all objects whose sphere and AABB both touch the
+// frustum to visible, in increasing order, and returns how many there are.
+// visible needs room for bounds->capacity entries.
+int CullFrustum(const CullBounds* bounds, const Frustum* frustum, uint32_t* visible);
+
+// One object at a time with the same arithmetic as CullFrustum, as a
+// reference for tests and benchmarks.
+int CullFrustumScalar(const CullBounds* bounds, const Frustum* frustum, uint32_t* visible);
+
+#endif
@@ -0,0 +1,117 @@
+#include "geometry_pool.h"
+
+#include <stdio.h>
+
+bool InitGeometryPool(GeometryPool* pool, SDL_GPUDevice* device, Uint32 maxVertices, Uint32 maxIndexBytes, bool packedVertices){
+    *pool = (GeometryPool){
+        .device = device,
+        .packed_vertices = packedVertices,
+        .vertex_stride = packedVertices ? sizeof(PackedVertex) : sizeof(Vertex)
+    };
+
+    SDL_GPUBufferCreateInfo vertexInfo = {
+        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
+        .size = maxVertices * pool->vertex_stride,
+        .props = 0
+    };
+    pool->vertex_buffer = SDL_CreateGPUBuffer(device, &vertexInfo);
+
+    Uint32 indexUnits = maxIndexBytes / GEOMETRY_INDEX_UNIT;
+    SDL_GPUBufferCreateInfo indexInfo = {
+        .usage = SDL_GPU_BUFFERUSAGE_INDEX,
+        .size = indexUnits * GEOMETRY_INDEX_UNIT,
+        .props = 0
+    };
+    pool->index_buffer = SDL_CreateGPUBuffer(device, &indexInfo);
+
+    if(!pool->vertex_buffer || !pool->index_buffer){
+        printf("[ERROR]: could not create geometry pool buffers, %s\n", SDL_GetError());
+        return false;
+    }
+
+    InitRangeAllocator(&pool->vertices, maxVertices);
+    InitRangeAllocator(&pool->indices, indexUnits);
+    return true;
+}
+
+void DestroyGeometryPool(GeometryPool* pool){
+    SDL_ReleaseGPUBuffer(pool->device, pool->vertex_buffer);
+    SDL_ReleaseGPUBuffer(pool->device, pool->index_buffer);
+    DestroyRangeAllocator(&pool->vertices);
+    DestroyRangeAllocator(&pool->indices);
+    *pool = (GeometryPool){0};
+}
+
+Uint32 GeometryPoolIndexUnits(const Mesh* mesh){
+    return (Uint32)((mesh->index_size + GEOMETRY_INDEX_UNIT - 1) / GEOMETRY_INDEX_UNIT);
+}
+
+bool UploadMeshToPool(GeometryPool* pool, StagingUploader* uploader, const Mesh* mesh, GeometryAllocation* out){
+    *out = (GeometryAllocation){0};
+
+    Uint32 indexUnits = GeometryPoolIndexUnits(mesh);
+    Uint32 vertexOffset, indexUnitOffset;
+    if (!AllocRange(&pool->vertices, (Uint32)mesh->vertex_count, &vertexOffset)) {
+        printf("[ERROR]: geometry pool is out of vertex space (%d vertices requested)\n", mesh->vertex_count);
+        return false;
+    }
+    if (!AllocRange(&pool->indices, indexUnits, &indexUnitOffset)) {
+        printf("[ERROR]: geometry pool is out of index space (%zu bytes requested)\n", mesh->index_size);
+        FreeRangeAt(&pool->vertices, vertexOffset, (Uint32)mesh->vertex_count);
+        return false;
+    }
+
+    *out = (GeometryAllocation){
+        .vertex_offset = vertexOffset,
+        .vertex_count = (Uint32)mesh->vertex_count,
+        .index_unit_offset = indexUnitOffset,
+        .index_units = indexUnits,
+        .first_index = indexUnitOffset * GEOMETRY_INDEX_UNIT / (Uint32)mesh->index_stride,
+        .index_count = (Uint32)mesh->index_count,
+        .index_element_size = mesh->index_stride == 2 ? SDL_GPU_INDEXELEMENTSIZE_16BIT : SDL_GPU_INDEXELEMENTSIZE_32BIT,
+        .valid = true
+    };
+
+    bool ok;
+    if (pool->packed_vertices) {
+        PackedVertex* packed = StageBufferUpload(uploader, pool->vertex_buffer, vertexOffset * pool->vertex_stride, out->vertex_count * pool->vertex_stride);
+        ok = packed != NULL;
+        if (ok) PackVertices(mesh, packed);
+    } else {
+        ok = StageBufferData(uploader, pool->vertex_buffer, vertexOffset * pool->vertex_stride, mesh->vertices, (Uint32)mesh->size);
+    }
+    ok = ok && StageBufferData(uploader, pool->index_buffer, indexUnitOffset * GEOMETRY_INDEX_UNIT, mesh->indices, (Uint32)mesh->index_size);
+    if (!ok) {
+        FreeMeshFromPool(pool, out);
+    }
+    return ok;
+}
+
+Uint32 GeometryPoolMeshBytes(const GeometryPool* pool, const Mesh* mesh){
+    Uint32 indexUnits = GeometryPoolIndexUnits(mesh);
+    return (Uint32)mesh->vertex_count * pool->vertex_stride + indexUnits * GEOMETRY_INDEX_UNIT;
+}
+
+bool GeometryPoolHasRoom(const GeometryPool* pool, const Mesh* mesh){
+    Uint32 indexUnits = GeometryPoolIndexUnits(mesh);
+    return GetRangeAllocatorStats(&pool->vertices).largest_free >= (Uint32)mesh->vertex_count &&
+           GetRangeAllocatorStats(&pool->indices).largest_free >= indexUnits;
+}
+
+void FreeMeshFromPool(GeometryPool* pool, GeometryAllocation* allocation){
+    if (!allocation->valid) {
+        return;
+    }
+    FreeRangeAt(&pool->vertices, allocation->vertex_offset, allocation->vertex_count);
+    FreeRangeAt(&pool->indices, allocation->index_unit_offset, allocation->index_units);
+    *allocation = (GeometryAllocation){0};
+}
+
+void PrintGeometryPoolStats(const GeometryPool* pool){
+    RangeAllocatorStats v = GetRangeAllocatorStats(&pool->vertices);
+    RangeAllocatorStats i = GetRangeAllocatorStats(&pool->indices);
+    printf("Geometry pool vertices: %u/%u (%.1f%%), %u meshes, %d free ranges, fragmentation %.1f%%\n",
+        v.used, v.capacity, v.occupancy * 100.0f, v.allocations, v.free_ranges, v.fragmentation * 100.0f);
+    printf("Geometry pool indices: %u/%u bytes (%.1f%%), %d free ranges, fragmentation %.1f%%\n",
+        i.used * GEOMETRY_INDEX_UNIT, i.capacity * GEOMETRY_INDEX_UNIT, i.occupancy * 100.0f, i.free_ranges, i.fragmentation * 100.0f);
+}
@@ -0,0 +1,64 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_gpu.h>
+
+#include "mesh.h"
+#include "range_allocator.h"
+#include "staging_uploader.h"
+#include "vertex_pack.h"
+
+// Index ranges are allocated in 4-byte units so both 16 and 32-bit index
+// lists can be addressed with first_index from the same buffer.
+#define GEOMETRY_INDEX_UNIT 4
+
+// Where a mesh lives inside the pool. Pass vertex_offset as the draw's
+// vertex offset and first_index as its first index.
+typedef struct GeometryAllocation{
+    Uint32 vertex_offset;
+    Uint32 vertex_count;
+    Uint32 index_unit_offset;
+    Uint32 index_units;
+    Uint32 first_index;
+    Uint32 index_count;
+    SDL_GPUIndexElementSize index_element_size;
+    bool valid;
+} GeometryAllocation;
+
+// One vertex buffer and one index buffer shared by every mesh, so they are
+// bound once per frame instead of once per draw. With packed vertices the
+// pool stores PackedVertex instead of Vertex.
+typedef struct GeometryPool{
+    SDL_GPUDevice* device;
+    bool packed_vertices;
+    Uint32 vertex_stride;
+    SDL_GPUBuffer* vertex_buffer;
+    SDL_GPUBuffer* index_buffer;
+    RangeAllocator vertices;
+    RangeAllocator indices;
+} GeometryPool;
+
+bool InitGeometryPool(GeometryPool* pool, SDL_GPUDevice* device, Uint32 maxVertices, Uint32 maxIndexBytes, bool packedVertices);
+void DestroyGeometryPool(GeometryPool* pool);
+
+// Index units the mesh's index list takes up in the pool.
+Uint32 GeometryPoolIndexUnits(const Mesh* mesh);
+
+// Reserves space for the mesh and stages its vertex and index data. Packed
+// vertices are encoded straight into the staging buffer.
+bool UploadMeshToPool(GeometryPool* pool, StagingUploader* uploader, const Mesh* mesh, GeometryAllocation* out);
+
+// Bytes the mesh occupies in the pool's buffers.
+Uint32 GeometryPoolMeshBytes(const GeometryPool* pool, const Mesh* mesh);
+
+// Whether UploadMeshToPool would find contiguous space for the mesh right now.
+bool GeometryPoolHasRoom(const GeometryPool* pool, const Mesh* mesh);
+
+// Returns the ranges to the pool. The caller must make sure no frame that is
+// still in flight draws from them before they are reused.
+void FreeMeshFromPool(GeometryPool* pool, GeometryAllocation* allocation);
+
+void PrintGeometryPoolStats(const GeometryPool* pool);
+
+#endif
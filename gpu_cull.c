@@ -0,0 +1,164 @@
+#include "gpu_cull.h"
+#include "file_map.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static SDL_GPUComputePipeline* load_pipeline(SDL_GPUDevice* device, const char* shaderPath){
+    MappedFile code;
+    if (!MapFile(shaderPath, &code) || code.size == 0) {
+        printf("[ERROR]: could not open file: %s\n", shaderPath);
+        return NULL;
+    }
+    SDL_GPUComputePipelineCreateInfo info = {
+        .code_size = code.size,
+        .code = (const Uint8*)code.data,
+        .entrypoint = "main",
+        .format = SDL_GPU_SHADERFORMAT_SPIRV,
+        .num_readonly_storage_buffers = 1,
+        .num_readwrite_storage_buffers = 2,
+        .num_uniform_buffers = 1,
+        .threadcount_x = GPU_CULL_GROUP_SIZE,
+        .threadcount_y = 1,
+        .threadcount_z = 1
+    };
+    SDL_GPUComputePipeline* pipeline = SDL_CreateGPUComputePipeline(device, &info);
+    if (!pipeline) {
+        printf("[ERROR]: could not create cull pipeline from %s, %s\n", shaderPath, SDL_GetError());
+    }
+    UnmapFile(&code);
+    return pipeline;
+}
+
+bool InitGpuCuller(GpuCuller* culler, SDL_GPUDevice* device, const char* shaderPath, Uint32 capacity){
+    *culler = (GpuCuller){0};
+    culler->device = device;
+    culler->capacity = capacity;
+
+    culler->pipeline = load_pipeline(device, shaderPath);
+    if (!culler->pipeline) {
+        return false;
+    }
+
+    SDL_GPUBufferCreateInfo visibleInfo = {
+        .usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE | SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ,
+        .size = capacity * (Uint32)sizeof(InstanceData)
+    };
+    SDL_GPUBufferCreateInfo argsInfo = {
+        .usage = SDL_GPU_BUFFERUSAGE_INDIRECT | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE,
+        .size = sizeof(SDL_GPUIndexedIndirectDrawCommand)
+    };
+    SDL_GPUTransferBufferCreateInfo resetInfo = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = sizeof(SDL_GPUIndexedIndirectDrawCommand)
+    };
+    culler->visible = SDL_CreateGPUBuffer(device, &visibleInfo);
+    culler->args = SDL_CreateGPUBuffer(device, &argsInfo);
+    culler->reset = SDL_CreateGPUTransferBuffer(device, &resetInfo);
+    if (!culler->visible || !culler->args || !culler->reset) {
+        printf("[ERROR]: could not create cull buffers for %u instances, %s\n", capacity, SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+void DestroyGpuCuller(GpuCuller* culler){
+    if (culler->pipeline) SDL_ReleaseGPUComputePipeline(culler->device, culler->pipeline);
+    if (culler->visible) SDL_ReleaseGPUBuffer(culler->device, culler->visible);
+    if (culler->args) SDL_ReleaseGPUBuffer(culler->device, culler->args);
+    if (culler->reset) SDL_ReleaseGPUTransferBuffer(culler->device, culler->reset);
+    *culler = (GpuCuller){0};
+}
+
+bool SetGpuCullGeometry(GpuCuller* culler, const GeometryAllocation* geometry){
+    SDL_GPUIndexedIndirectDrawCommand draw = {
+        .num_indices = geometry->index_count,
+        .num_instances = 0,
+        .first_index = geometry->first_index,
+        .vertex_offset = (Sint32)geometry->vertex_offset,
+        .first_instance = 0
+    };
+    if (memcmp(&draw, &culler->draw, sizeof(draw)) == 0) {
+        return true;
+    }
+
+    // cycled, so a frame still in flight keeps resetting to its own range
+    SDL_GPUIndexedIndirectDrawCommand* mapped = SDL_MapGPUTransferBuffer(culler->device, culler->reset, true);
+    if (!mapped) {
+        printf("[ERROR]: could not map cull arguments, %s\n", SDL_GetError());
+        return false;
+    }
+    *mapped = draw;
+    SDL_UnmapGPUTransferBuffer(culler->device, culler->reset);
+    culler->draw = draw;
+    return true;
+}
+
+void DispatchGpuCull(GpuCuller* culler, SDL_GPUCommandBuffer* cmd, SDL_GPUBuffer* instances, Uint32 count, const Frustum* frustum, Vec3 center, float radius){
+    if (count > culler->capacity) count = culler->capacity;
+
+    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmd);
+    SDL_GPUTransferBufferLocation source = { .transfer_buffer = culler->reset, .offset = 0 };
+    SDL_GPUBufferRegion destination = { .buffer = culler->args, .offset = 0, .size = sizeof(SDL_GPUIndexedIndirectDrawCommand) };
+    SDL_UploadToGPUBuffer(copyPass, &source, &destination, true);
+    SDL_EndGPUCopyPass(copyPass);
+
+    GpuCullUniforms uniforms = {
+        .sphere = {center.x, center.y, center.z, radius},
+        .instance_count = count
+    };
+    memcpy(uniforms.planes, frustum->planes, sizeof(uniforms.planes));
+
+    // the arguments keep the reset the copy pass just wrote, the visible list
+    // may move on to a fresh buffer while the last frame still reads the old
+    SDL_GPUStorageBufferReadWriteBinding outputs[2] = {
+        { .buffer = culler->visible, .cycle = true },
+        { .buffer = culler->args, .cycle = false }
+    };
+    SDL_GPUComputePass* pass = SDL_BeginGPUComputePass(cmd, NULL, 0, outputs, 2);
+    SDL_BindGPUComputePipeline(pass, culler->pipeline);
+    SDL_BindGPUComputeStorageBuffers(pass, 0, &instances, 1);
+    SDL_PushGPUComputeUniformData(cmd, 0, &uniforms, sizeof(uniforms));
+    SDL_DispatchGPUCompute(pass, (count + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+    SDL_EndGPUComputePass(pass);
+}
+
+bool ReadGpuCullResults(GpuCuller* culler, SDL_GPUIndexedIndirectDrawCommand* args, InstanceData* out){
+    Uint32 argsSize = sizeof(SDL_GPUIndexedIndirectDrawCommand);
+    Uint32 visibleSize = culler->capacity * (Uint32)sizeof(InstanceData);
+    SDL_GPUTransferBufferCreateInfo info = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD,
+        .size = argsSize + visibleSize
+    };
+    SDL_GPUTransferBuffer* readback = SDL_CreateGPUTransferBuffer(culler->device, &info);
+    if (!readback) {
+        printf("[ERROR]: could not create readback buffer, %s\n", SDL_GetError());
+        return false;
+    }
+
+    SDL_GPUCommandBuffer* cmd = SDL_AcquireGPUCommandBuffer(culler->device);
+    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmd);
+    SDL_GPUBufferRegion argsRegion = { .buffer = culler->args, .offset = 0, .size = argsSize };
+    SDL_GPUTransferBufferLocation argsLocation = { .transfer_buffer = readback, .offset = 0 };
+    SDL_DownloadFromGPUBuffer(copyPass, &argsRegion, &argsLocation);
+    SDL_GPUBufferRegion visibleRegion = { .buffer = culler->visible, .offset = 0, .size = visibleSize };
+    SDL_GPUTransferBufferLocation visibleLocation = { .transfer_buffer = readback, .offset = argsSize };
+    SDL_DownloadFromGPUBuffer(copyPass, &visibleRegion, &visibleLocation);
+    SDL_EndGPUCopyPass(copyPass);
+
+    SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd);
+    bool ok = fence && SDL_WaitForGPUFences(culler->device, true, &fence, 1);
+    if (fence) SDL_ReleaseGPUFence(culler->device, fence);
+
+    const Uint8* mapped = ok ? SDL_MapGPUTransferBuffer(culler->device, readback, false) : NULL;
+    if (mapped) {
+        memcpy(args, mapped, argsSize);
+        Uint32 count = args->num_instances < culler->capacity ? args->num_instances : culler->capacity;
+        memcpy(out, mapped + argsSize, (size_t)count * sizeof(InstanceData));
+        SDL_UnmapGPUTransferBuffer(culler->device, readback);
+    } else {
+        printf("[ERROR]: could not read back cull results, %s\n", SDL_GetError());
+    }
+    SDL_ReleaseGPUTransferBuffer(culler->device, readback);
+    return mapped != NULL;
+}
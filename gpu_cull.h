@@ -0,0 +1,59 @@
+#ifndef GPU_CULL_H
+#define GPU_CULL_H
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_gpu.h>
+
+#include "frustum_cull.h"
+#include "geometry_pool.h"
+#include "scene_instances.h"
+
+#define GPU_CULL_GROUP_SIZE 64 // local_size_x of cull_instances.comp
+
+// Compute uniform slot 0 of cull_instances.comp (std140).
+typedef struct GpuCullUniforms{
+    float planes[6][4]; // Frustum planes in the space the instances are placed in
+    float sphere[4];    // mesh bounding sphere, center and radius in object space
+    Uint32 instance_count;
+    Uint32 pad[3];
+} GpuCullUniforms;
+
+// GPU-driven instanced drawing: a compute pass tests every instance's
+// bounding sphere against the frustum and appends the survivors to visible,
+// counting them in the instance count of an indirect draw. The CPU records
+// one SDL_DrawGPUIndexedPrimitivesIndirect no matter how many instances
+// there are, and never learns how many were visible.
+//
+// The compute shader is cull_instances.comp, compiled to SPIR-V.
+typedef struct GpuCuller{
+    SDL_GPUDevice* device;
+    SDL_GPUComputePipeline* pipeline;
+    SDL_GPUBuffer* visible; // InstanceData of the survivors, for vertex_instanced.vert
+    SDL_GPUBuffer* args;    // one SDL_GPUIndexedIndirectDrawCommand
+    SDL_GPUTransferBuffer* reset; // the draw arguments with zero instances
+    SDL_GPUIndexedIndirectDrawCommand draw; // what reset holds
+    Uint32 capacity;
+} GpuCuller;
+
+bool InitGpuCuller(GpuCuller* culler, SDL_GPUDevice* device, const char* shaderPath, Uint32 capacity);
+void DestroyGpuCuller(GpuCuller* culler);
+
+// The pool range every instance draws. Cheap when it has not changed, so it
+// can be called every frame.
+bool SetGpuCullGeometry(GpuCuller* culler, const GeometryAllocation* geometry);
+
+// Records a copy pass that resets the draw arguments and the culling compute
+// pass, so it has to be called outside of a render pass. instances holds
+// count InstanceData (at most capacity) and needs compute storage read
+// usage. Draw afterwards with
+//   SDL_BindGPUVertexStorageBuffers(pass, 0, &culler->visible, 1);
+//   SDL_DrawGPUIndexedPrimitivesIndirect(pass, culler->args, 0, 1);
+void DispatchGpuCull(GpuCuller* culler, SDL_GPUCommandBuffer* cmd, SDL_GPUBuffer* instances, Uint32 count, const Frustum* frustum, Vec3 center, float radius);
+
+// Waits for the GPU and copies the last dispatch's results back: the draw
+// arguments and args->num_instances entries of visible to out, which needs
+// room for capacity. Stalls, so it is meant for tests. The dispatch's
+// command buffer must already be submitted.
+bool ReadGpuCullResults(GpuCuller* culler, SDL_GPUIndexedIndirectDrawCommand* args, InstanceData* out);
+
+#endif
@@ -0,0 +1,59 @@
+#include "gpu_timer.h"
+
+#include <stdio.h>
+
+void InitGpuFrameTimer(GpuFrameTimer* timer, SDL_GPUDevice* device){
+    *timer = (GpuFrameTimer){ .device = device };
+}
+
+static void retire_oldest(GpuFrameTimer* timer, Profiler* profiler){
+    int slot = timer->first;
+    uint64_t now = ProfilerNow();
+    timer->last_ns = now - timer->inflight[slot].submit_ns;
+    if (profiler) {
+        RecordProfileEvent(profiler, "gpu frame", PROFILE_TRACK_GPU, timer->inflight[slot].submit_ns, now - timer->inflight[slot].submit_ns);
+    }
+    SDL_ReleaseGPUFence(timer->device, timer->inflight[slot].fence);
+    timer->first = (timer->first + 1) % GPU_TIMER_MAX_INFLIGHT;
+    timer->count--;
+}
+
+void DestroyGpuFrameTimer(GpuFrameTimer* timer){
+    while (timer->count > 0) {
+        SDL_WaitForGPUFences(timer->device, true, &timer->inflight[timer->first].fence, 1);
+        retire_oldest(timer, NULL);
+    }
+}
+
+bool SubmitTimedCommandBuffer(GpuFrameTimer* timer, Profiler* profiler, SDL_GPUCommandBuffer* cmd){
+    if (timer->count == GPU_TIMER_MAX_INFLIGHT) {
+        SDL_WaitForGPUFences(timer->device, true, &timer->inflight[timer->first].fence, 1);
+        retire_oldest(timer, profiler);
+    }
+
+    uint64_t submitNs = ProfilerNow();
+    SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd);
+    if (!fence) {
+        printf("[ERROR]: could not submit command buffer, %s\n", SDL_GetError());
+        return false;
+    }
+
+    int slot = (timer->first + timer->count) % GPU_TIMER_MAX_INFLIGHT;
+    timer->inflight[slot].fence = fence;
+    timer->inflight[slot].submit_ns = submitNs;
+    timer->count++;
+    return true;
+}
+
+void WaitGpuFrameTimes(GpuFrameTimer* timer, Profiler* profiler){
+    while (timer->count > 0) {
+        SDL_WaitForGPUFences(timer->device, true, &timer->inflight[timer->first].fence, 1);
+        retire_oldest(timer, profiler);
+    }
+}
+
+void CollectGpuFrameTimes(GpuFrameTimer* timer, Profiler* profiler){
+    while (timer->count > 0 && SDL_QueryGPUFence(timer->device, timer->inflight[timer->first].fence)) {
+        retire_oldest(timer, profiler);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_gpu.h>
+
+#include "profiler.h"
+
+#define GPU_TIMER_MAX_INFLIGHT 8
+
+// SDL GPU has no timestamp queries, so GPU time is taken from fences: the
+// span from submit until the fence is seen signaled. That includes queue
+// latency and is only as fine as the polling, so treat it as an upper bound
+// on the GPU work of a frame.
+typedef struct GpuFrameTimer{
+    SDL_GPUDevice* device;
+    struct {
+        SDL_GPUFence* fence;
+        uint64_t submit_ns;
+    } inflight[GPU_TIMER_MAX_INFLIGHT];
+    int first;
+    int count;
+    uint64_t last_ns; // GPU time of the most recently retired submit
+} GpuFrameTimer;
+
+void InitGpuFrameTimer(GpuFrameTimer* timer, SDL_GPUDevice* device);
+void DestroyGpuFrameTimer(GpuFrameTimer* timer);
+
+// Submits cmd with a fence. Waits for the oldest submit if all slots are busy.
+bool SubmitTimedCommandBuffer(GpuFrameTimer* timer, Profiler* profiler, SDL_GPUCommandBuffer* cmd);
+
+// Records a "gpu frame" event for every submit that finished since the last call.
+void CollectGpuFrameTimes(GpuFrameTimer* timer, Profiler* profiler);
+
+// Waits for every submit in flight and records them like
+// CollectGpuFrameTimes. Called right after each submit it serializes the CPU
+// and the GPU, so last_ns is the GPU time of that one frame.
+void WaitGpuFrameTimes(GpuFrameTimer* timer, Profiler* profiler);
+
+#endif
@@ -0,0 +1,306 @@
+#include "job_system.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#define JOB_QUEUE_INITIAL 256
+
+// Which system and queue the current thread works on. Threads that are not
+// workers of the system they submit to use the shared queue.
+static _Thread_local JobSystem* currentSystem;
+static _Thread_local int currentWorker;
+
+int DefaultJobThreadCount(void){
+#ifndef _WIN32
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > JOB_MAX_THREADS) n = JOB_MAX_THREADS;
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+int JobWorkerIndex(const JobSystem* jobs){
+    return currentSystem == jobs ? currentWorker : jobs->thread_count;
+}
+
+static void finish_job(const Job* job){
+    job->fn(job->data);
+    if (job->counter) {
+        atomic_fetch_sub_explicit(&job->counter->pending, 1, memory_order_release);
+    }
+}
+
+#ifndef _WIN32
+
+static void push_jobs(JobQueue* queue, const Job* list, int count){
+    pthread_mutex_lock(&queue->lock);
+    uint32_t size = atomic_load_explicit(&queue->count, memory_order_relaxed);
+    if (size + (uint32_t)count > queue->capacity) {
+        uint32_t capacity = queue->capacity ? queue->capacity : JOB_QUEUE_INITIAL;
+        while (capacity < size + (uint32_t)count) capacity *= 2;
+        Job* grown = malloc((size_t)capacity * sizeof(Job));
+        for (uint32_t i = 0; i < size; i++) {
+            grown[i] = queue->jobs[(queue->head + i) & (queue->capacity - 1)];
+        }
+        free(queue->jobs);
+        queue->jobs = grown;
+        queue->head = 0;
+        queue->capacity = capacity;
+    }
+    for (int i = 0; i < count; i++) {
+        queue->jobs[(queue->head + size++) & (queue->capacity - 1)] = list[i];
+    }
+    atomic_store_explicit(&queue->count, size, memory_order_relaxed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static bool pop_job(JobQueue* queue, Job* out){
+    pthread_mutex_lock(&queue->lock);
+    uint32_t size = atomic_load_explicit(&queue->count, memory_order_relaxed);
+    if (size > 0) {
+        *out = queue->jobs[(queue->head + size - 1) & (queue->capacity - 1)];
+        atomic_store_explicit(&queue->count, size - 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return size > 0;
+}
+
+static bool steal_job(JobQueue* queue, Job* out){
+    // peek first so idle thieves do not hammer the locks of empty queues
+    if (atomic_load_explicit(&queue->count, memory_order_relaxed) == 0) return false;
+    pthread_mutex_lock(&queue->lock);
+    uint32_t size = atomic_load_explicit(&queue->count, memory_order_relaxed);
+    if (size > 0) {
+        *out = queue->jobs[queue->head];
+        queue->head = (queue->head + 1) & (queue->capacity - 1);
+        atomic_store_explicit(&queue->count, size - 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return size > 0;
+}
+
+static int background_queue(const JobSystem* jobs){
+    return jobs->thread_count + 1;
+}
+
+// Background jobs are left to the background workers, unless there are none.
+static bool takes_background(const JobSystem* jobs, int self){
+    return (self > 0 && self < jobs->thread_count) || jobs->thread_count == 1;
+}
+
+// Own queue first, then the other queues in order starting after our own,
+// then the background queue when allowed.
+static bool run_one_job(JobSystem* jobs, int self, bool background){
+    Job job;
+    int queueCount = jobs->thread_count + 1;
+    bool found = pop_job(&jobs->queues[self], &job);
+    bool stolen = !found;
+    for (int i = 1; !found && i < queueCount; i++) {
+        found = steal_job(&jobs->queues[(self + i) % queueCount], &job);
+    }
+    if (!found && background) {
+        found = steal_job(&jobs->queues[background_queue(jobs)], &job);
+    }
+    if (!found) return false;
+
+    atomic_fetch_sub_explicit(&jobs->queued, 1, memory_order_relaxed);
+    // counted before the job can release a waiter, and never for the shared
+    // queue whose threads would race on it
+    if (self < jobs->thread_count) {
+        jobs->stats[self].executed++;
+        jobs->stats[self].stolen += stolen;
+    }
+    finish_job(&job);
+    return true;
+}
+
+static void* worker_thread(void* arg){
+    JobWorker* worker = arg;
+    JobSystem* jobs = worker->system;
+    currentSystem = jobs;
+    currentWorker = worker->index;
+
+    for (;;) {
+        if (run_one_job(jobs, currentWorker, true)) continue;
+
+        pthread_mutex_lock(&jobs->sleep_lock);
+        while (atomic_load(&jobs->queued) == 0 && !atomic_load(&jobs->quit)) {
+            pthread_cond_wait(&jobs->wake, &jobs->sleep_lock);
+        }
+        bool quit = atomic_load(&jobs->quit) && atomic_load(&jobs->queued) == 0;
+        pthread_mutex_unlock(&jobs->sleep_lock);
+        if (quit) break;
+    }
+    return NULL;
+}
+
+bool InitJobSystem(JobSystem* jobs, int threadCount){
+    *jobs = (JobSystem){0};
+    if (threadCount <= 0) threadCount = DefaultJobThreadCount();
+    if (threadCount > JOB_MAX_THREADS) threadCount = JOB_MAX_THREADS;
+    jobs->thread_count = threadCount;
+
+    for (int i = 0; i <= threadCount + 1; i++) {
+        pthread_mutex_init(&jobs->queues[i].lock, NULL);
+    }
+    pthread_mutex_init(&jobs->sleep_lock, NULL);
+    pthread_cond_init(&jobs->wake, NULL);
+
+    currentSystem = jobs;
+    currentWorker = 0;
+    for (int i = 1; i < threadCount; i++) {
+        jobs->workers[i] = (JobWorker){ .system = jobs, .index = i };
+        if (pthread_create(&jobs->threads[i], NULL, worker_thread, &jobs->workers[i]) != 0) {
+            printf("[ERROR]: could not start job worker %d\n", i);
+            atomic_store(&jobs->quit, true);
+            pthread_mutex_lock(&jobs->sleep_lock);
+            pthread_cond_broadcast(&jobs->wake);
+            pthread_mutex_unlock(&jobs->sleep_lock);
+            while (--i > 0) pthread_join(jobs->threads[i], NULL);
+            return false;
+        }
+    }
+    return true;
+}
+
+void DestroyJobSystem(JobSystem* jobs){
+    // the calling thread drains what it can reach, the workers the rest
+    int self = JobWorkerIndex(jobs);
+    while (run_one_job(jobs, self, takes_background(jobs, self))) {
+    }
+    pthread_mutex_lock(&jobs->sleep_lock);
+    atomic_store(&jobs->quit, true);
+    pthread_cond_broadcast(&jobs->wake);
+    pthread_mutex_unlock(&jobs->sleep_lock);
+    for (int i = 1; i < jobs->thread_count; i++) {
+        pthread_join(jobs->threads[i], NULL);
+    }
+
+    for (int i = 0; i <= jobs->thread_count + 1; i++) {
+        pthread_mutex_destroy(&jobs->queues[i].lock);
+        free(jobs->queues[i].jobs);
+    }
+    pthread_mutex_destroy(&jobs->sleep_lock);
+    pthread_cond_destroy(&jobs->wake);
+    if (currentSystem == jobs) currentSystem = NULL;
+    *jobs = (JobSystem){0};
+}
+
+static void submit(JobSystem* jobs, const Job* list, int count, bool background){
+    // counted before they are visible, so queued never goes negative
+    atomic_fetch_add(&jobs->queued, count);
+    push_jobs(&jobs->queues[background ? background_queue(jobs) : JobWorkerIndex(jobs)], list, count);
+
+    // sleepers check queued under sleep_lock, so this cannot miss one
+    pthread_mutex_lock(&jobs->sleep_lock);
+    if (count == 1) pthread_cond_signal(&jobs->wake);
+    else pthread_cond_broadcast(&jobs->wake);
+    pthread_mutex_unlock(&jobs->sleep_lock);
+}
+
+void WaitForCounter(JobSystem* jobs, JobCounter* counter){
+    int self = JobWorkerIndex(jobs);
+    bool background = takes_background(jobs, self);
+    while (atomic_load_explicit(&counter->pending, memory_order_acquire) > 0) {
+        if (!run_one_job(jobs, self, background)) sched_yield();
+    }
+}
+
+#else
+
+bool InitJobSystem(JobSystem* jobs, int threadCount){
+    (void)threadCount;
+    *jobs = (JobSystem){0};
+    jobs->thread_count = 1;
+    currentSystem = jobs;
+    return true;
+}
+
+void DestroyJobSystem(JobSystem* jobs){
+    *jobs = (JobSystem){0};
+}
+
+static void submit(JobSystem* jobs, const Job* list, int count, bool background){
+    (void)background;
+    for (int i = 0; i < count; i++) {
+        finish_job(&list[i]);
+        jobs->stats[0].executed++;
+    }
+}
+
+void WaitForCounter(JobSystem* jobs, JobCounter* counter){
+    (void)jobs;
+    (void)counter;
+}
+
+#endif
+
+#define JOB_SUBMIT_BATCH 64
+
+static void run_jobs(JobSystem* jobs, JobFn fn, void* const* data, int count, JobCounter* counter, bool background){
+    if (count <= 0) return;
+    if (counter) {
+        atomic_fetch_add_explicit(&counter->pending, count, memory_order_relaxed);
+    }
+    Job batch[JOB_SUBMIT_BATCH];
+    for (int first = 0; first < count; first += JOB_SUBMIT_BATCH) {
+        int n = count - first < JOB_SUBMIT_BATCH ? count - first : JOB_SUBMIT_BATCH;
+        for (int i = 0; i < n; i++) {
+            batch[i] = (Job){ .fn = fn, .data = data[first + i], .counter = counter };
+        }
+        submit(jobs, batch, n, background);
+    }
+}
+
+void RunJobs(JobSystem* jobs, JobFn fn, void* const* data, int count, JobCounter* counter){
+    run_jobs(jobs, fn, data, count, counter, false);
+}
+
+void RunJob(JobSystem* jobs, JobFn fn, void* data, JobCounter* counter){
+    run_jobs(jobs, fn, &data, 1, counter, false);
+}
+
+void RunBackgroundJob(JobSystem* jobs, JobFn fn, void* data, JobCounter* counter){
+    run_jobs(jobs, fn, &data, 1, counter, true);
+}
+
+typedef struct ParallelRange{
+    ParallelForFn fn;
+    void* data;
+    int begin, end;
+} ParallelRange;
+
+static void parallel_range_job(void* arg){
+    ParallelRange* range = arg;
+    range->fn(range->data, range->begin, range->end);
+}
+
+void ParallelFor(JobSystem* jobs, int count, int grain, ParallelForFn fn, void* data){
+    if (count <= 0) return;
+    if (grain < 1) grain = 1;
+    int rangeCount = (count + grain - 1) / grain;
+    if (rangeCount == 1 || jobs->thread_count == 1) {
+        fn(data, 0, count);
+        return;
+    }
+
+    ParallelRange* ranges = malloc((size_t)rangeCount * sizeof(ParallelRange));
+    void** args = malloc((size_t)rangeCount * sizeof(void*));
+    for (int i = 0; i < rangeCount; i++) {
+        int begin = i * grain;
+        ranges[i] = (ParallelRange){ .fn = fn, .data = data, .begin = begin, .end = begin + grain < count ? begin + grain : count };
+        args[i] = &ranges[i];
+    }
+
+    JobCounter counter = {0};
+    RunJobs(jobs, parallel_range_job, args, rangeCount, &counter);
+    WaitForCounter(jobs, &counter);
+    free(ranges);
+    free(args);
+}
@@ -0,0 +1,104 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#define JOB_MAX_THREADS 64
+
+typedef void (*JobFn)(void* data);
+
+// Counts the unfinished jobs of a batch. Zero-initialize it, pass it to
+// RunJobs and wait on it with WaitForCounter; any number of batches may
+// share one counter.
+typedef struct JobCounter{
+    atomic_int pending;
+} JobCounter;
+
+typedef struct Job{
+    JobFn fn;
+    void* data;
+    JobCounter* counter;
+} Job;
+
+// Ring of jobs, owned by one worker. The owner pushes and pops at the tail
+// (newest first, for cache locality), thieves take from the head.
+typedef struct JobQueue{
+#ifndef _WIN32
+    pthread_mutex_t lock;
+#endif
+    Job* jobs;
+    uint32_t head, capacity;
+    atomic_uint count; // written under lock, read without it to skip empty queues
+} JobQueue;
+
+struct JobSystem;
+
+typedef struct JobWorker{
+    struct JobSystem* system;
+    int index;
+} JobWorker;
+
+typedef struct JobWorkerStats{
+    uint64_t executed;
+    uint64_t stolen;
+} JobWorkerStats;
+
+// Work-stealing scheduler. The thread that calls InitJobSystem is worker 0
+// and only runs jobs while it waits; thread_count - 1 background workers run
+// them all the time. Threads that are not workers submit through an extra
+// shared queue. Long-running jobs go to one more queue that only background
+// workers take from, once the others are empty. Without pthreads (_WIN32)
+// jobs run inline in RunJobs.
+typedef struct JobSystem{
+    int thread_count;
+    JobWorker workers[JOB_MAX_THREADS];
+    JobQueue queues[JOB_MAX_THREADS + 2]; // workers, shared, background
+    JobWorkerStats stats[JOB_MAX_THREADS + 1];
+#ifndef _WIN32
+    pthread_t threads[JOB_MAX_THREADS];
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t wake;
+#endif
+    atomic_int queued;
+    atomic_bool quit;
+} JobSystem;
+
+// threadCount counts the calling thread, 0 means one per core.
+bool InitJobSystem(JobSystem* jobs, int threadCount);
+
+// Finishes every queued job, then stops the workers.
+void DestroyJobSystem(JobSystem* jobs);
+
+// Queues count jobs. counter may be NULL for fire-and-forget work.
+void RunJobs(JobSystem* jobs, JobFn fn, void* const* data, int count, JobCounter* counter);
+void RunJob(JobSystem* jobs, JobFn fn, void* data, JobCounter* counter);
+
+// Queues a long-running job, such as loading an asset, that only background
+// workers pick up, so a thread waiting on short work like a ParallelFor never
+// ends up running it. With a single thread it runs like any other job.
+void RunBackgroundJob(JobSystem* jobs, JobFn fn, void* data, JobCounter* counter);
+
+// Runs queued jobs on the calling thread until counter reaches zero, so
+// waiting inside a job never deadlocks the pool.
+void WaitForCounter(JobSystem* jobs, JobCounter* counter);
+
+typedef void (*ParallelForFn)(void* data, int begin, int end);
+
+// Calls fn over [0, count) in ranges of at most grain items, spread over all
+// workers, and returns when every range is done.
+void ParallelFor(JobSystem* jobs, int count, int grain, ParallelForFn fn, void* data);
+
+// Index of the calling thread's queue: 0 .. thread_count - 1 on workers,
+// thread_count on any other thread. Jobs use it to pick per-worker scratch;
+// threads that are not workers all share the last index.
+int JobWorkerIndex(const JobSystem* jobs);
+
+int DefaultJobThreadCount(void);
+
+#endif
@@ -5,46 +5,102 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+
+#include "mesh.h"
+#include "obj_loader.h"
+#include "mesh_cache.h"
+#include "staging_uploader.h"
+#include "geometry_pool.h"
+#include "mesh_simplify.h"
+#include "frustum_cull.h"
+#include "occlusion_cull.h"
+#include "scene_instances.h"
+#include "mat4.h"
+#include "profiler.h"
+#include "gpu_timer.h"
+#include "asset_streamer.h"
+#include "job_system.h"
+#include "bmp_decode.h"
+#include "render_queue.h"
+#include "draw_packets.h"
+#include "bvh.h"
+#include "meshlet.h"
+#include "gpu_cull.h"
+#include "file_map.h"
+#include "memory_system.h"
+#include "offscreen_target.h"
 
 #define WDITH 900
 #define HIGHT 700
-#define MAX_VERT_COUNT 2048
 
-typedef struct Vec3{
-    float x,y,z;
-} Vec3;
+// Scale of the ships in the --stress scene, so thousands fit the frustum.
+#define STRESS_SHIP_SCALE 0.05f
+#define FRAME_REPORT_SECONDS 2.0
 
-typedef struct Vec2{
-    float x,y;
-} Vec2;
+// How long --offscreen waits for streaming to settle before it measures
+// anyway, and how far a pixel may be from the --reference image.
+#define OFFSCREEN_SETTLE_SECONDS 60.0
+#define OFFSCREEN_TOLERANCE 8
 
-typedef struct Vertex{
-    Vec3 position;
-    Vec3 normal;
-    Vec2 uv;
-} Vertex;
+// Exit code of the headless checks when there is no GPU device to run them
+// on, which ctest reports as skipped rather than failed.
+#define EXIT_NO_GPU 77
 
-typedef struct {
-    float m[16];
-} Mat4;
+// Largest on-screen error a coarser LOD may introduce, in pixels.
+#define LOD_PIXEL_ERROR 1.0f
 
-typedef struct CameraUBO{
-    Mat4 model;
-    Mat4 view;
-    Mat4 proj;
-} CameraUBO;
+// Streamed scene meshes plus the resident default cube.
+#define SCENE_MESHES 4
+#define CUBE_OBJECT SCENE_MESHES
+#define UPLOAD_BUDGET_KB 1024
 
-typedef struct Mesh{
-    Vec3 position;
-    Vertex* vertices;
-    int vertex_count;
-    size_t size;
-} Mesh;
+// Occlusion buffer at a quarter of the window, and the projected radius in
+// its pixels from which a resident scene mesh is rasterized as an occluder.
+#define OCCLUSION_WIDTH (WDITH / 4)
+#define OCCLUSION_HEIGHT (HIGHT / 4)
+#define OCCLUDER_MIN_RADIUS 8.0f
 
-Mesh Meshes[5];
-SDL_GPUBuffer* vertexBuffers[5];
+// Pipeline ids in the render queue sort keys.
+#define PIPELINE_ID_DEFAULT 0
+#define PIPELINE_ID_INSTANCED 1
 
-SDL_GPUShader* LoadTexture(SDL_GPUDevice *device, const char *filePath, SDL_GPUShaderStage stage){
+// Vertex uniform slot 0, pushed once per frame.
+typedef struct FrameUniforms{
+    Mat4 view;
+    Mat4 proj;
+    Mat4 view_proj;
+} FrameUniforms;
+
+// GPU state shared by the draws of one object; draw packets index these.
+typedef struct SceneDraw{
+    SDL_GPUGraphicsPipeline* pipeline;
+    SDL_GPUTexture* texture;
+    SDL_GPUBuffer* instances; // vertex storage buffer of instanced draws
+    Uint32 instance_count;
+    const GeometryAllocation* geometry;
+    const MeshletDraw* clusters; // index ranges to draw, NULL for all of geometry
+    Uint32 cluster_count;
+    SDL_GPUBuffer* indirect; // draw arguments written on the GPU, replace all of the above
+} SceneDraw;
+
+int sceneMeshes[SCENE_MESHES];
+bool sceneBoundsLoaded[SCENE_MESHES];
+Mat4 placeholderModels[SCENE_MESHES];
+Mesh cubeMesh;
+GeometryPool geometryPool;
+GeometryAllocation cubeAllocation;
+AssetStreamer streamer;
+JobSystem jobSystem;
+CullBounds cullBounds;
+OcclusionBuffer occlusionBuffer;
+MeshBvh sceneBvhs[SCENE_MESHES];
+SceneBvh sceneBvh;
+int bvhMeshes[SCENE_MESHES]; // scene mesh of each BVH instance
+Arena frameArena; // reset at the start of every frame
+uint32_t* visibleMeshes; // cullBounds.capacity entries, CullFrustum writes past the count
+
+SDL_GPUShader* LoadTexture(SDL_GPUDevice *device, const char *filePath, SDL_GPUShaderStage stage, Uint32 storageBuffers){
     FILE *file = fopen(filePath, "rb");
     if(!file){
         printf("[ERROR]: could not open file: %s", filePath);
@@ -68,8 +124,8 @@ SDL_GPUShader* LoadTexture(SDL_GPUDevice *device, const char *filePath, SDL_GPUS
     createInfo.stage = stage; // or SDL_GPU_SHADER_TYPE_VERTEX, SDL_GPU_SHADER_TYPE_FRAGMENT
     createInfo.num_samplers = (stage == SDL_GPU_SHADERSTAGE_FRAGMENT) ? 1 : 0;
     createInfo.num_storage_textures = 0;
-    createInfo.num_storage_buffers = 0;
-    createInfo.num_uniform_buffers = (stage == SDL_GPU_SHADERSTAGE_VERTEX) ? 1 : 0;
+    createInfo.num_storage_buffers = storageBuffers;
+    createInfo.num_uniform_buffers = (stage == SDL_GPU_SHADERSTAGE_VERTEX) ? 2 : 0;
 
     SDL_GPUShader *shader = SDL_CreateGPUShader(device, &createInfo);
     if (!shader) {
@@ -80,301 +136,455 @@ SDL_GPUShader* LoadTexture(SDL_GPUDevice *device, const char *filePath, SDL_GPUS
     return shader;
 }
 
-static int resolve_index(int idx, int count) {
-    if (idx < 0) return count + idx;
-    return idx - 1;
+// Folds the packed-vertex dequantization (offset + unorm * scale) into the
+// model matrix: model * translate(offset) * scale(scale).
+static Mat4 DequantizeModel(Mat4 model, VertexQuantization q){
+    return Mat4Multiply(model, Mat4Multiply(Mat4Translation(q.offset), Mat4Scale(q.scale)));
 }
 
-Mesh LoadObjFromFile(const char *filePath, Vec3 pos){
-    FILE *file = fopen(filePath, "r");
-    if(!file){
-        printf("[ERROR]: could not open file: %s\n", filePath);
-        return (Mesh){0};
-    }
+// Normals are not quantized, so the normal matrix comes from model alone.
+static DrawUniforms MakeDrawUniforms(const FrameUniforms* frame, Mat4 model, const Mesh* mesh, bool packedVertices){
+    Mat4 vertexModel = packedVertices ? DequantizeModel(model, GetVertexQuantization(mesh)) : model;
+    return (DrawUniforms){
+        .mvp = Mat4Multiply(frame->view_proj, vertexModel),
+        .normal = Mat4NormalMatrix(model)
+    };
+}
 
-    Vec3* positions = malloc(MAX_VERT_COUNT * sizeof(Vec3));
-    Vec3* normals = malloc(MAX_VERT_COUNT * sizeof(Vec3));
-    Vec2* uvs = malloc(MAX_VERT_COUNT * sizeof(Vec2));
+// Distance from the camera to p along the view direction, p in model space.
+static float ViewDistance(Mat4 modelView, Vec3 p){
+    return -Mat4TransformPoint(modelView, p).z;
+}
 
-    int pos_count = 0, pos_capacity = MAX_VERT_COUNT;
-    int norm_count = 0, norm_capacity = MAX_VERT_COUNT;
-    int uv_count = 0, uv_capacity = MAX_VERT_COUNT;
+static Vec3 MeshCenter(const Mesh* mesh){
+    return (Vec3){
+        (mesh->bounds_min.x + mesh->bounds_max.x) * 0.5f,
+        (mesh->bounds_min.y + mesh->bounds_max.y) * 0.5f,
+        (mesh->bounds_min.z + mesh->bounds_max.z) * 0.5f
+    };
+}
 
-    Vertex* vertices = malloc(MAX_VERT_COUNT * sizeof(Vertex));
-    int vert_count = 0, vert_cap = MAX_VERT_COUNT;
+// Stretches the unit cube over the mesh bounds, so a mesh that is not on the
+// GPU yet still shows up where and how big it will be.
+static Mat4 PlaceholderModel(const Mesh* mesh){
+    Vec3 center = MeshCenter(mesh);
+    Vec3 size = {
+        mesh->bounds_max.x - mesh->bounds_min.x,
+        mesh->bounds_max.y - mesh->bounds_min.y,
+        mesh->bounds_max.z - mesh->bounds_min.z
+    };
+    return Mat4Multiply(Mat4Translation(center), Mat4Scale(size));
+}
 
-    char line[256];
-    float x, y, z;
+// Casts a ray from the camera through pixel x, y of a width by height
+// window against the loaded scene meshes, which all share model, and prints
+// the nearest hit.
+static void PickSceneMesh(const FrameUniforms* frame, const char* const* meshFiles, Mat4 model, float x, float y, float width, float height){
+    for(int i=0;i<sceneBvh.count;i++){
+        SetBvhInstanceTransform(&sceneBvh, i, model);
+    }
+    RefitSceneBvh(&sceneBvh);
+
+    float ndcX = 2.0f * x / width - 1.0f;
+    float ndcY = 1.0f - 2.0f * y / height;
+    Mat4 camera = Mat4InverseAffine(frame->view);
+    Vec3 origin = Mat4TransformPoint(camera, (Vec3){0.0f, 0.0f, 0.0f});
+    Vec3 target = Mat4TransformPoint(camera, (Vec3){ndcX / frame->proj.m[0], ndcY / frame->proj.m[5], -1.0f});
+    Vec3 dir = {target.x - origin.x, target.y - origin.y, target.z - origin.z};
+
+    BvhHit hit;
+    if (RaycastSceneBvh(&sceneBvh, origin, dir, INFINITY, &hit)) {
+        printf("Picked %s, triangle %u at depth %.2f\n", meshFiles[bvhMeshes[hit.instance]], hit.triangle, hit.t);
+    } else {
+        printf("Picked nothing\n");
+    }
+}
 
-    while (fgets(line, sizeof(line), file)) {
-        if (line[0] == 'v' && line[1] == ' ') {
-            if (sscanf(line, "v %f %f %f", &x, &y, &z) == 3) {
-                if (pos_count >= pos_capacity) {
-                    pos_capacity *= 2;
-                    positions = realloc(positions, pos_capacity * sizeof(Vec3));
-                }
-                positions[pos_count++] = (Vec3){x, y, z};
-            }
+// Records the sorted queue, binding only state that differs from the
+// previous draw. SDL GPU command buffers are not thread safe, so this is the
+// one single-threaded pass after the workers built the packets. Returns the
+// number of draws.
+static int EmitRenderQueue(SDL_GPUCommandBuffer* cmd, SDL_GPURenderPass* renderPass, const RenderQueue* queue, const PacketBuilder* packets,
+                           const SceneDraw* draws, SDL_GPUSampler* sampler, const SDL_GPUBufferBinding* indexBinding, RenderBinds* binds){
+    InvalidateRenderBinds(binds);
+    DrawUniforms lastUniforms;
+    int drawCount = 0;
+    for (int i = 0; i < queue->count; i++) {
+        const DrawPacket* packet = GetDrawPacket(packets, queue->items[i].draw);
+        const SceneDraw* draw = &draws[packet->state];
+        const GeometryAllocation* geometry = draw->geometry;
+        if (RenderBindChanged(binds, RENDER_BIND_PIPELINE, (uintptr_t)draw->pipeline)) {
+            SDL_BindGPUGraphicsPipeline(renderPass, draw->pipeline);
         }
-        else if (line[0] == 'v' && line[1] == 'n') {
-            if (sscanf(line, "vn %f %f %f", &x, &y, &z) == 3) {
-                if (norm_count >= norm_capacity) {
-                    norm_capacity *= 2;
-                    normals = realloc(normals, norm_capacity * sizeof(Vec3));
-                }
-                normals[norm_count++] = (Vec3){x, y, z};
-            }
+        if (RenderBindChanged(binds, RENDER_BIND_TEXTURE, (uintptr_t)draw->texture)) {
+            SDL_GPUTextureSamplerBinding textureBinding = { .texture = draw->texture, .sampler = sampler };
+            SDL_BindGPUFragmentSamplers(renderPass, 0, &textureBinding, 1);
         }
-        else if (line[0] == 'v' && line[1] == 't') {
-            float u, v;
-            if (sscanf(line, "vt %f %f", &u, &v) == 2) {
-                if (uv_count >= uv_capacity) {
-                    uv_capacity *= 2;
-                    uvs = realloc(uvs, uv_capacity * sizeof(Vec2));
-                }
-                uvs[uv_count++] = (Vec2){u, v};
-            }
+        if (draw->instances && RenderBindChanged(binds, RENDER_BIND_STORAGE_BUFFER, (uintptr_t)draw->instances)) {
+            SDL_BindGPUVertexStorageBuffers(renderPass, 0, &draw->instances, 1);
         }
-        else if (line[0] == 'f' && line[1] == ' ') {
-            int v[3], vt[3], vn[3];
-            int matched = sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
-                                &v[0], &vt[0], &vn[0],
-                                &v[1], &vt[1], &vn[1],
-                                &v[2], &vt[2], &vn[2]);
-            if (matched != 9) continue;
-            for (int i = 0; i < 3; i++) {
-                if (vert_count >= vert_cap) {
-                    vert_cap *= 2;
-                    vertices = realloc(vertices, vert_cap * sizeof(Vertex));
-                }
-                int vi = resolve_index(v[i], pos_count);
-                int vti = resolve_index(vt[i], uv_count);
-                int vni = resolve_index(vn[i], norm_count);
-                if (vi < 0 || vi >= pos_count) continue;
-                vertices[vert_count].position.x = positions[vi].x;
-                vertices[vert_count].position.y = positions[vi].y;
-                vertices[vert_count].position.z = positions[vi].z;
-                if (vni >= 0 && vni < norm_count) {
-                    vertices[vert_count].normal.x = normals[vni].x;
-                    vertices[vert_count].normal.y = normals[vni].y;
-                    vertices[vert_count].normal.z = normals[vni].z;
-                } else {
-                    vertices[vert_count].normal.x = 0.0f;
-                    vertices[vert_count].normal.y = 1.0f;
-                    vertices[vert_count].normal.z = 0.0f;
-                }
-                if (vti >= 0 && vti < uv_count) {
-                    vertices[vert_count].uv.x = uvs[vti].x;
-                    vertices[vert_count].uv.y = uvs[vti].y;
-                } else {
-                    vertices[vert_count].uv.x = 0.0f;
-                    vertices[vert_count].uv.y = 0.0f;
-                }
-                vert_count++;
+        if (RenderBindChanged(binds, RENDER_BIND_INDEX_BUFFER, (uintptr_t)geometry->index_element_size)) {
+            SDL_BindGPUIndexBuffer(renderPass, indexBinding, geometry->index_element_size);
+        }
+        if (RenderBindDataChanged(binds, RENDER_BIND_UNIFORMS, &lastUniforms, &packet->uniforms, sizeof(DrawUniforms))) {
+            SDL_PushGPUVertexUniformData(cmd, 1, &packet->uniforms, sizeof(DrawUniforms));
+        }
+        if (draw->indirect) {
+            SDL_DrawGPUIndexedPrimitivesIndirect(renderPass, draw->indirect, 0, 1);
+            drawCount++;
+            continue;
+        }
+        if (!draw->clusters) {
+            SDL_DrawGPUIndexedPrimitives(renderPass, geometry->index_count, draw->instance_count, geometry->first_index, (Sint32)geometry->vertex_offset, 0);
+            drawCount++;
+            continue;
+        }
+        for (Uint32 c = 0; c < draw->cluster_count; c++) {
+            const MeshletDraw* cluster = &draw->clusters[c];
+            SDL_DrawGPUIndexedPrimitives(renderPass, cluster->index_count, draw->instance_count, geometry->first_index + cluster->first_index, (Sint32)geometry->vertex_offset, 0);
+        }
+        drawCount += (int)draw->cluster_count;
+    }
+    return drawCount;
+}
+
+// Decodes a BMP with DecodeBmp and with SDL_LoadBMP + SDL_ConvertSurface and
+// compares the bytes. Rows are written with a padded pitch so the pitch
+// handling is checked as well.
+static int CheckBmpDecode(const char* path){
+    MappedFile file;
+    if (!MapFile(path, &file)) {
+        printf("[ERROR]: could not open file: %s\n", path);
+        return 1;
+    }
+    BmpInfo info;
+    if (!ParseBmpHeader(file.data, file.size, &info)) {
+        printf("[ERROR]: %s is not an uncompressed 24 or 32 bit BMP\n", path);
+        UnmapFile(&file);
+        return 1;
+    }
+    SDL_Surface* loaded = SDL_LoadBMP(path);
+    SDL_Surface* reference = loaded ? SDL_ConvertSurface(loaded, SDL_PIXELFORMAT_RGBA32) : NULL;
+    if (loaded) SDL_DestroySurface(loaded);
+    if (!reference || (uint32_t)reference->w != info.width || (uint32_t)reference->h != info.height) {
+        printf("[ERROR]: SDL could not load %s the same size: %s\n", path, SDL_GetError());
+        if (reference) SDL_DestroySurface(reference);
+        UnmapFile(&file);
+        return 1;
+    }
+
+    uint32_t rowBytes = info.width * 4, pitch = rowBytes + 64;
+    uint8_t* pixels = malloc((size_t)pitch * info.height);
+    int mismatches = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        memset(pixels, 0xCD, (size_t)pitch * info.height);
+        if (pass == 0) DecodeBmp(file.data, &info, pixels, pitch);
+        else DecodeBmpScalar(file.data, &info, pixels, pitch);
+        for (uint32_t y = 0; y < info.height; y++) {
+            const uint8_t* expected = (const uint8_t*)reference->pixels + (size_t)reference->pitch * y;
+            if (memcmp(pixels + (size_t)pitch * y, expected, rowBytes) != 0) {
+                printf("[ERROR]: %s decode of %s differs from SDL in row %u\n", pass == 0 ? "SIMD" : "scalar", path, y);
+                mismatches++;
+                break;
             }
         }
     }
+    printf("%s: %ux%u, %d bpp, %s SDL_LoadBMP + SDL_ConvertSurface\n", path, info.width, info.height, info.bits_per_pixel,
+        mismatches ? "differs from" : "byte-identical to");
 
-    fclose(file);
-    free(positions);
-    free(normals);
-    free(uvs);
-
-    return (Mesh){
-        .position = pos,
-        .vertices = vertices,
-        .vertex_count = vert_count,
-        .size = vert_count * sizeof(Vertex)
-    };
+    free(pixels);
+    SDL_DestroySurface(reference);
+    UnmapFile(&file);
+    return mismatches ? 1 : 0;
 }
 
-Mesh CreateDefaultCube(Vec3 pos){
-
-    static Vertex vertices[] = {
-
-        // ===== Front (+Z) =====
-        {{-0.5f,-0.5f, 0.5f}, {0,0,1}, {0,0}},
-        {{ 0.5f,-0.5f, 0.5f}, {0,0,1}, {1,0}},
-        {{ 0.5f, 0.5f, 0.5f}, {0,0,1}, {1,1}},
-        {{-0.5f,-0.5f, 0.5f}, {0,0,1}, {0,0}},
-        {{ 0.5f, 0.5f, 0.5f}, {0,0,1}, {1,1}},
-        {{-0.5f, 0.5f, 0.5f}, {0,0,1}, {0,1}},
-
-        // ===== Back (-Z) =====
-        {{ 0.5f,-0.5f,-0.5f}, {0,0,-1}, {0,0}},
-        {{-0.5f,-0.5f,-0.5f}, {0,0,-1}, {1,0}},
-        {{-0.5f, 0.5f,-0.5f}, {0,0,-1}, {1,1}},
-        {{ 0.5f,-0.5f,-0.5f}, {0,0,-1}, {0,0}},
-        {{-0.5f, 0.5f,-0.5f}, {0,0,-1}, {1,1}},
-        {{ 0.5f, 0.5f,-0.5f}, {0,0,-1}, {0,1}},
-
-        // ===== Left (-X) =====
-        {{-0.5f,-0.5f,-0.5f}, {-1,0,0}, {0,0}},
-        {{-0.5f,-0.5f, 0.5f}, {-1,0,0}, {1,0}},
-        {{-0.5f, 0.5f, 0.5f}, {-1,0,0}, {1,1}},
-        {{-0.5f,-0.5f,-0.5f}, {-1,0,0}, {0,0}},
-        {{-0.5f, 0.5f, 0.5f}, {-1,0,0}, {1,1}},
-        {{-0.5f, 0.5f,-0.5f}, {-1,0,0}, {0,1}},
-
-        // ===== Right (+X) =====
-        {{ 0.5f,-0.5f, 0.5f}, {1,0,0}, {0,0}},
-        {{ 0.5f,-0.5f,-0.5f}, {1,0,0}, {1,0}},
-        {{ 0.5f, 0.5f,-0.5f}, {1,0,0}, {1,1}},
-        {{ 0.5f,-0.5f, 0.5f}, {1,0,0}, {0,0}},
-        {{ 0.5f, 0.5f,-0.5f}, {1,0,0}, {1,1}},
-        {{ 0.5f, 0.5f, 0.5f}, {1,0,0}, {0,1}},
-
-        // ===== Top (+Y) =====
-        {{-0.5f, 0.5f, 0.5f}, {0,1,0}, {0,0}},
-        {{ 0.5f, 0.5f, 0.5f}, {0,1,0}, {1,0}},
-        {{ 0.5f, 0.5f,-0.5f}, {0,1,0}, {1,1}},
-        {{-0.5f, 0.5f, 0.5f}, {0,1,0}, {0,0}},
-        {{ 0.5f, 0.5f,-0.5f}, {0,1,0}, {1,1}},
-        {{-0.5f, 0.5f,-0.5f}, {0,1,0}, {0,1}},
-
-        // ===== Bottom (-Y) =====
-        {{-0.5f,-0.5f,-0.5f}, {0,-1,0}, {0,0}},
-        {{ 0.5f, 0.5f,-0.5f}, {0,-1,0}, {1,0}},
-        {{ 0.5f,-0.5f, 0.5f}, {0,-1,0}, {1,1}},
-        {{-0.5f,-0.5f,-0.5f}, {0,-1,0}, {0,0}},
-        {{ 0.5f,-0.5f, 0.5f}, {0,-1,0}, {1,1}},
-        {{-0.5f,-0.5f, 0.5f}, {0,-1,0}, {0,1}},
-    };
+static int compare_instances(const void* a, const void* b){
+    return memcmp(a, b, sizeof(InstanceData));
+}
 
-    return (Mesh){
-        .position = pos,
-        .vertices = vertices,
-        .vertex_count = sizeof(vertices) / sizeof(Vertex),
-        .size = sizeof(vertices)
-    };
+// Culls a block of stress ships on the GPU from cameras circling it, reads
+// the survivors back and compares them with the CPU sphere test. Spheres
+// within a hair of a plane may go either way; everything else has to match
+// exactly, without duplicates. Needs no window, so it runs headless under
+// a software Vulkan driver such as lavapipe.
+static int CheckGpuCull(int count){
+    if (count <= 0) {
+        printf("[ERROR]: --check-gpu-cull needs an instance count\n");
+        return 1;
+    }
+    if (!SDL_GetHint(SDL_HINT_VIDEO_DRIVER)) {
+        SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+    }
+    SDL_Init(SDL_INIT_VIDEO);
+    SDL_GPUDevice* device = SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV, true, NULL);
+    if (!device) {
+        printf("[ERROR]: Did not create GPU device, %s\n", SDL_GetError());
+        SDL_Quit();
+        return EXIT_NO_GPU;
+    }
+    Mesh ship = LoadMeshCached("ship.obj", (Vec3){0.0f, 0.0f, 0.0f}, NULL, NULL, NULL);
+    InstanceData* instances = malloc((size_t)count * sizeof(InstanceData));
+    InstanceData* sorted = malloc((size_t)count * sizeof(InstanceData));
+    InstanceData* visible = malloc((size_t)count * sizeof(InstanceData));
+    bool* seen = malloc((size_t)count);
+    BuildInstanceGrid(instances, count, &ship, STRESS_SHIP_SCALE);
+    memcpy(sorted, instances, (size_t)count * sizeof(InstanceData));
+    qsort(sorted, (size_t)count, sizeof(InstanceData), compare_instances);
+    Vec3 center = MeshCenter(&ship);
+
+    Uint32 bytes = (Uint32)count * (Uint32)sizeof(InstanceData);
+    SDL_GPUBufferCreateInfo instanceInfo = { .usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ, .size = bytes };
+    SDL_GPUBuffer* instanceBuffer = SDL_CreateGPUBuffer(device, &instanceInfo);
+    StagingUploader uploader;
+    GpuCuller culler = {0};
+    bool ready = ship.vertices && instanceBuffer && InitStagingUploader(&uploader, device, bytes);
+    if (ready) {
+        StageBufferData(&uploader, instanceBuffer, 0, instances, bytes);
+        FlushStagingUploads(&uploader);
+        WaitStagingUploads(&uploader);
+        DestroyStagingUploader(&uploader);
+        ready = InitGpuCuller(&culler, device, "cull_instances.spv", (Uint32)count);
+    }
+
+    int failures = ready ? 0 : 1;
+    GeometryAllocation geometry = { .first_index = 3, .index_count = (Uint32)ship.index_count, .vertex_offset = 7 };
+    Mat4 proj = Mat4Perspective(70.0f * (3.14159265f / 180.0f), (float)WDITH / (float)HIGHT, 0.1f, 1000.0f);
+    float reach = ship.bounds_radius * STRESS_SHIP_SCALE * 2.2f * cbrtf((float)count);
+    for (int view = 0; ready && view < 8 && failures == 0; view++) {
+        float yaw = 0.8f * (float)view;
+        Vec3 eye = {sinf(yaw) * reach, 0.3f * reach * (float)(view % 3 - 1), cosf(yaw) * reach};
+        Mat4 viewMatrix = Mat4Multiply(Mat4RotationY(-yaw - 0.3f), Mat4Translation((Vec3){-eye.x, -eye.y, -eye.z}));
+        Frustum frustum = ExtractFrustum(Mat4Multiply(proj, viewMatrix).m);
+
+        SetGpuCullGeometry(&culler, &geometry);
+        SDL_GPUCommandBuffer* cmd = SDL_AcquireGPUCommandBuffer(device);
+        DispatchGpuCull(&culler, cmd, instanceBuffer, (Uint32)count, &frustum, center, ship.bounds_radius);
+        SDL_SubmitGPUCommandBuffer(cmd);
+        SDL_GPUIndexedIndirectDrawCommand args;
+        if (!ReadGpuCullResults(&culler, &args, visible)) {
+            failures++;
+            break;
+        }
+        if (args.num_indices != geometry.index_count || args.first_index != geometry.first_index ||
+            args.vertex_offset != (Sint32)geometry.vertex_offset || args.first_instance != 0 || args.num_instances > (Uint32)count) {
+            printf("[ERROR]: view %d: GPU wrote draw arguments %u %u %u %d %u\n", view,
+                args.num_indices, args.num_instances, args.first_index, args.vertex_offset, args.first_instance);
+            failures++;
+            break;
+        }
+
+        memset(seen, 0, (size_t)count);
+        for (Uint32 v = 0; v < args.num_instances; v++) {
+            const InstanceData* found = bsearch(&visible[v], sorted, (size_t)count, sizeof(InstanceData), compare_instances);
+            size_t index = found ? (size_t)(found - sorted) : 0;
+            if (!found || seen[index]) {
+                printf("[ERROR]: view %d: GPU result %u is %s\n", view, v, found ? "a duplicate" : "not an instance");
+                failures++;
+                break;
+            }
+            seen[index] = true;
+        }
+
+        int borderline = 0, mismatches = 0;
+        for (int i = 0; i < count; i++) {
+            Mat4 instance;
+            InstanceMatrix(&sorted[i], instance.m);
+            Vec3 c = Mat4TransformPoint(instance, center);
+            float r = ship.bounds_radius * sorted[i].scale;
+            float distance = 1e30f;
+            for (int p = 0; p < 6; p++) {
+                const float* pl = frustum.planes[p];
+                distance = fminf(distance, pl[0] * c.x + pl[1] * c.y + pl[2] * c.z + pl[3] + r);
+            }
+            if (fabsf(distance) < 1e-3f * reach) {
+                borderline++;
+            } else if ((distance >= 0.0f) != seen[i]) {
+                mismatches++;
+            }
+        }
+        printf("view %d: %u of %d visible on the GPU, %d disagree with the CPU, %d borderline\n",
+            view, args.num_instances, count, mismatches, borderline);
+        failures += mismatches > 0;
+    }
+
+    DestroyGpuCuller(&culler);
+    if (instanceBuffer) SDL_ReleaseGPUBuffer(device, instanceBuffer);
+    free(instances);
+    free(sorted);
+    free(visible);
+    free(seen);
+    FreeMesh(&ship);
+    SDL_DestroyGPUDevice(device);
+    SDL_Quit();
+    printf("GPU cull readback %s\n", failures ? "FAILED" : "matches the CPU");
+    return failures ? 1 : 0;
 }
 
-int main(){
+// One measured --offscreen frame.
+typedef struct FrameSample{
+    float cpu_ms, gpu_ms;
+    int draws;
+} FrameSample;
 
-    SDL_Init(SDL_INIT_VIDEO);
+static void PrintFrameSampleStats(const char* name, float* ms, int count){
+    FrameTimeStats stats = ComputeFrameTimeStats(ms, count);
+    printf("%s: %d frames, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, avg %.3f ms, max %.3f ms\n",
+        name, stats.frames, stats.p50_ms, stats.p95_ms, stats.p99_ms, stats.avg_ms, stats.max_ms);
+}
 
-    SDL_Window *window = SDL_CreateWindow("GPU test", WDITH, HIGHT, 0);
-    if(!window){
-        printf("[ERROR]: Did not create window, %s\n", SDL_GetError());
-        return -1;
+static bool WriteFrameSamples(const char* path, const FrameSample* samples, int count){
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        printf("[ERROR]: could not open file: %s\n", path);
+        return false;
+    }
+    fprintf(file, "frame,cpu_ms,gpu_ms,draws\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%d,%.4f,%.4f,%d\n", i, samples[i].cpu_ms, samples[i].gpu_ms, samples[i].draws);
     }
+    fclose(file);
+    return true;
+}
 
-    SDL_GPUDevice *gpuDevice =  SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV , false, NULL);
-    if(!gpuDevice){
-        printf("[ERROR]: Did not create GPU device, %s\n", SDL_GetError());
+int main(int argc, char* argv[]){
+
+    bool packedVertices = false;
+    bool instancing = true;
+    bool profile = false;
+    const char* tracePath = NULL;
+    int stressShips = 0;
+    int uploadBudgetKB = UPLOAD_BUDGET_KB;
+    int gpuBudgetMB = 0;
+    int jobThreads = 0;
+    bool occlusion = true;
+    bool meshlets = true;
+    bool gpuCull = false;
+    int offscreenFrames = 0;
+    int width = WDITH;
+    int height = HIGHT;
+    const char* outputPath = "offscreen.bmp";
+    const char* referencePath = NULL;
+    const char* frameStatsPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--packed-vertices") == 0) {
+            packedVertices = true;
+        } else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc) {
+            stressShips = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-instancing") == 0) {
+            instancing = false;
+        } else if (strcmp(argv[i], "--no-occlusion") == 0) {
+            occlusion = false;
+        } else if (strcmp(argv[i], "--no-meshlets") == 0) {
+            meshlets = false;
+        } else if (strcmp(argv[i], "--gpu-cull") == 0) {
+            gpuCull = true;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--upload-budget") == 0 && i + 1 < argc) {
+            uploadBudgetKB = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--gpu-budget") == 0 && i + 1 < argc) {
+            gpuBudgetMB = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            jobThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--offscreen") == 0 && i + 1 < argc) {
+            offscreenFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2) width = 0;
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--reference") == 0 && i + 1 < argc) {
+            referencePath = argv[++i];
+        } else if (strcmp(argv[i], "--frame-stats") == 0 && i + 1 < argc) {
+            frameStatsPath = argv[++i];
+        } else if (strcmp(argv[i], "--check-bmp") == 0 && i + 1 < argc) {
+            return CheckBmpDecode(argv[++i]);
+        } else if (strcmp(argv[i], "--check-gpu-cull") == 0 && i + 1 < argc) {
+            return CheckGpuCull(atoi(argv[++i]));
+        } else {
+            printf("[ERROR]: unknown option %s\n", argv[i]);
+            return -1;
+        }
+    }
+    if (stressShips < 0) {
+        printf("[ERROR]: --stress needs a ship count\n");
         return -1;
     }
-
-    if(!SDL_ClaimWindowForGPUDevice(gpuDevice, window)){
-        printf("[ERROR]: Did not claim a window, %s\n", SDL_GetError());
+    if (uploadBudgetKB <= 0 || gpuBudgetMB < 0) {
+        printf("[ERROR]: --upload-budget needs KB per frame and --gpu-budget MB\n");
         return -1;
     }
-
-    SDL_GPUSwapchainComposition swapchainComposition = SDL_GPU_SWAPCHAINCOMPOSITION_SDR;
-    if (!SDL_SetGPUSwapchainParameters(
-        gpuDevice,
-        window,
-        swapchainComposition,
-        SDL_GPU_PRESENTMODE_IMMEDIATE
-    )) {
-        printf("SDL_SetGPUSwapchainParameters failed: %s\n", SDL_GetError());
+    if (gpuCull && (stressShips == 0 || !instancing)) {
+        printf("[ERROR]: --gpu-cull culls the instanced stress scene, add --stress\n");
+        return -1;
     }
-
-    SDL_Surface *textureSurface_ = SDL_LoadBMP("texture.bmp");
-    if(!textureSurface_){
-        printf("[ERROR]: Could not load texture.png\n");
+    if (stressShips > 0 && instancing && packedVertices) {
+        printf("[ERROR]: the instanced stress scene has no packed vertex shader, add --no-instancing\n");
         return -1;
     }
-    if(textureSurface_->w < 0 || textureSurface_->h < 0){
-        printf("Surface size invalid: \ntx w: %i , tx h: %i\n", textureSurface_->w, textureSurface_->h);
+    if (offscreenFrames < 0 || width <= 0 || height <= 0) {
+        printf("[ERROR]: --offscreen needs a frame count and --size WIDTHxHEIGHT\n");
         return -1;
     }
-
-    SDL_Surface *textureSurface = SDL_ConvertSurface(textureSurface_, SDL_PIXELFORMAT_RGBA32);
-    if (!textureSurface) {
-        printf("[ERROR]: Could not convert surface: %s\n", SDL_GetError());
+    bool offscreen = offscreenFrames > 0;
+    if (!offscreen && (referencePath || frameStatsPath)) {
+        printf("[ERROR]: --reference and --frame-stats measure --offscreen frames\n");
         return -1;
     }
-
-    uint8_t* pixels = (uint8_t*)textureSurface->pixels;
-    printf("First 16 bytes: ");
-    for (int i = 0; i < 16; i++) {
-        printf("%02X ", pixels[i]);
+    // the stress scene exists to be measured
+    profile = profile || stressShips > 0;
+
+    uint64_t startNS = ProfilerNow();
+    // headless machines and CI have no display to open, and offscreen
+    // rendering never needs one
+    if (offscreen && !SDL_GetHint(SDL_HINT_VIDEO_DRIVER)) {
+        SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
     }
-    printf("\n");
+    SDL_Init(SDL_INIT_VIDEO);
 
-    printf("Creatin GPU texture\n");
+    SDL_Window *window = NULL;
+    if (!offscreen) {
+        window = SDL_CreateWindow("GPU test", width, height, 0);
+        if(!window){
+            printf("[ERROR]: Did not create window, %s\n", SDL_GetError());
+            return -1;
+        }
+    }
 
-    SDL_GPUTextureCreateInfo texture_info = {
-        .type = SDL_GPU_TEXTURETYPE_2D,
-        .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
-        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
-        .width = textureSurface->w,
-        .height = textureSurface->h,
-        .layer_count_or_depth = 1,
-        .num_levels = 1,
-        .sample_count = SDL_GPU_SAMPLECOUNT_1,
-        .props = 0
-    };
-    SDL_GPUTexture* texture = SDL_CreateGPUTexture(gpuDevice, &texture_info);
-
-    printf("GPU texture created\n");
-
-    SDL_GPUTextureRegion transfer_dst = {
-        .texture = texture,
-        .mip_level = 0,
-        .layer = 0,
-        .x = 0, .y = 0, .z = 0,
-        .w = textureSurface->w,
-        .h = textureSurface->h,
-        .d = 1
-    };
+    SDL_GPUDevice *gpuDevice =  SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV , false, NULL);
+    if(!gpuDevice){
+        printf("[ERROR]: Did not create GPU device, %s\n", SDL_GetError());
+        return offscreen ? EXIT_NO_GPU : -1;
+    }
 
-    SDL_GPUTransferBufferCreateInfo xfer_info = {
-        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-        .size = textureSurface->w * textureSurface->h * 4,
-        .props = 0
-    };
-    SDL_GPUTransferBuffer* transfer_buffer = SDL_CreateGPUTransferBuffer(gpuDevice, &xfer_info);
+    OffscreenTarget offscreenTarget = {0};
+    if (offscreen) {
+        if(!InitOffscreenTarget(&offscreenTarget, gpuDevice, (Uint32)width, (Uint32)height)){
+            return -1;
+        }
+    } else {
+        if(!SDL_ClaimWindowForGPUDevice(gpuDevice, window)){
+            printf("[ERROR]: Did not claim a window, %s\n", SDL_GetError());
+            return -1;
+        }
 
-    if (!transfer_buffer) {
-        printf("Failed to create transfer buffer: %s\n", SDL_GetError());
-        return 1;
+        SDL_GPUSwapchainComposition swapchainComposition = SDL_GPU_SWAPCHAINCOMPOSITION_SDR;
+        if (!SDL_SetGPUSwapchainParameters(
+            gpuDevice,
+            window,
+            swapchainComposition,
+            SDL_GPU_PRESENTMODE_IMMEDIATE
+        )) {
+            printf("SDL_SetGPUSwapchainParameters failed: %s\n", SDL_GetError());
+        }
     }
 
-    printf("Mapping transfer_buffer\n");
-
-    void* textureData = SDL_MapGPUTransferBuffer(gpuDevice, transfer_buffer, false);
-    if(!textureData){
-        printf("[ERROR]: dod not map tansfBuf, %s", SDL_GetError());
+    StagingUploader uploader;
+    if(!InitStagingUploader(&uploader, gpuDevice, 4 * 1024 * 1024)){
         return -1;
     }
 
-    printf("Surface format: %s\n", SDL_GetPixelFormatName(textureSurface->format));
-
-    SDL_memcpy(textureData, textureSurface->pixels, textureSurface->w * textureSurface->h * 4);
-    SDL_UnmapGPUTransferBuffer(gpuDevice, transfer_buffer);
-    SDL_DestroySurface(textureSurface);
-
-    printf("Mapped transfer_buffer\n");
-
-    SDL_GPUCommandBuffer* upload_cmd = SDL_AcquireGPUCommandBuffer(gpuDevice);
-    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(upload_cmd);
-
-    SDL_GPUTextureTransferInfo textureSrc = {
-        .transfer_buffer = transfer_buffer,
-        .offset = 0,
-        .pixels_per_row = texture_info.width,
-        .rows_per_layer = texture_info.height
-    };
-    SDL_UploadToGPUTexture(copy_pass, &textureSrc, &transfer_dst, false);
-    SDL_EndGPUCopyPass(copy_pass);
-    SDL_SubmitGPUCommandBuffer(upload_cmd);
-    SDL_WaitForGPUIdle(gpuDevice);
-    SDL_ReleaseGPUTransferBuffer(gpuDevice, transfer_buffer);
-
-    printf("Texture loaded and setup\n");
-
     SDL_GPUSamplerCreateInfo sampler_info = {
         .min_filter = SDL_GPU_FILTER_LINEAR,
         .mag_filter = SDL_GPU_FILTER_LINEAR,
@@ -395,58 +605,70 @@ int main(){
 
     printf("Sampler created\n");
 
-    Meshes[0] = LoadObjFromFile("ship.obj",(Vec3){0.0f, 0.0f, 15.0f});
-    Meshes[1] = LoadObjFromFile("monkey.obj",(Vec3){0.0f, 0.0f, 15.0f});
-    Meshes[2] = LoadObjFromFile("ship_2.obj",(Vec3){0.0f, 0.0f, -15.0f});
-    Meshes[3] = LoadObjFromFile("sphere.obj",(Vec3){0.0f, 0.0f, -15.0f});
-    Meshes[4] = CreateDefaultCube((Vec3){0.0f, -2.0f, 4.0f});
-
-    printf("Meshes created\n");
-
-    for(int i=0;i<5;i++){
-        SDL_GPUBufferCreateInfo bufferInfo = {
-            .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
-            .size = Meshes[i].size,
-            .props = 0
-        };
-        vertexBuffers[i] = SDL_CreateGPUBuffer(gpuDevice, &bufferInfo);
-
-        SDL_GPUTransferBufferCreateInfo transferInfo = {
-            .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-            .size = Meshes[i].size,
-            .props = 0
-        };
-        SDL_GPUTransferBuffer* transferBuffer = SDL_CreateGPUTransferBuffer(gpuDevice, &transferInfo);
-
-        void* data = SDL_MapGPUTransferBuffer(gpuDevice, transferBuffer, false);
-        SDL_memcpy(data, Meshes[i].vertices, Meshes[i].size);
-        SDL_UnmapGPUTransferBuffer(gpuDevice, transferBuffer);
-
-        SDL_GPUCommandBuffer* uploadCmd = SDL_AcquireGPUCommandBuffer(gpuDevice);
-        SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(uploadCmd);
-
-        SDL_GPUTransferBufferLocation vertSrc = {
-            .transfer_buffer = transferBuffer,
-            .offset = 0
-        };
-        SDL_GPUBufferRegion vertDst = {
-            .buffer = vertexBuffers[i],
-            .offset = 0,
-            .size = Meshes[i].size
-        };
+    if(!InitGeometryPool(&geometryPool, gpuDevice, 256 * 1024, 4 * 1024 * 1024, packedVertices)){
+        return -1;
+    }
 
-        SDL_UploadToGPUBuffer(copyPass, &vertSrc, &vertDst, false);
+    // the cube is both a scene object and the stand-in for meshes that are
+    // still streaming, so it is resident from the start
+    cubeMesh = CreateDefaultCube((Vec3){0.0f, -2.0f, 4.0f});
+    if(!UploadMeshToPool(&geometryPool, &uploader, &cubeMesh, &cubeAllocation)){
+        return -1;
+    }
 
-        SDL_EndGPUCopyPass(copyPass);
-        SDL_SubmitGPUCommandBuffer(uploadCmd);
+    // at least one worker besides the main thread, or nothing would load
+    // while frames are being drawn
+    if (jobThreads <= 0) jobThreads = DefaultJobThreadCount();
+    if(!InitJobSystem(&jobSystem, jobThreads > 1 ? jobThreads : 2)){
+        return -1;
+    }
+    printf("Job system: %d threads\n", jobSystem.thread_count);
 
-        SDL_ReleaseGPUTransferBuffer(gpuDevice, transferBuffer);
+    if(!InitAssetStreamer(&streamer, gpuDevice, &jobSystem, &geometryPool, &uploader, (Uint32)uploadBudgetKB * 1024, (Uint64)gpuBudgetMB * 1024 * 1024)){
+        return -1;
+    }
+    int sceneTexture = RequestStreamedTexture(&streamer, "texture.bmp");
+    const char* meshFiles[SCENE_MESHES] = {"ship.obj", "monkey.obj", "ship_2.obj", "sphere.obj"};
+    Vec3 meshPositions[SCENE_MESHES] = {
+        {0.0f, 0.0f, 15.0f},
+        {0.0f, 0.0f, 15.0f},
+        {0.0f, 0.0f, -15.0f},
+        {0.0f, 0.0f, -15.0f}
+    };
+    for(int i=0;i<SCENE_MESHES;i++){
+        sceneMeshes[i] = RequestStreamedMesh(&streamer, meshFiles[i], meshPositions[i]);
     }
 
+    // until a mesh has loaded its bounds are those of the unit cube
+    if(!InitCullBounds(&cullBounds, SCENE_MESHES + 1)){
+        return -1;
+    }
+    for(int i=0;i<SCENE_MESHES;i++){
+        AddCullBounds(&cullBounds, &cubeMesh);
+        placeholderModels[i] = Mat4Identity();
+    }
+    AddCullBounds(&cullBounds, &cubeMesh);
+    visibleMeshes = malloc((size_t)cullBounds.capacity * sizeof(uint32_t));
+    if(!visibleMeshes){
+        printf("[ERROR]: could not allocate the visible mesh list\n");
+        return -1;
+    }
+    if(!InitOcclusionBuffer(&occlusionBuffer, OCCLUSION_WIDTH, OCCLUSION_HEIGHT)){
+        return -1;
+    }
+    if(!InitSceneBvh(&sceneBvh, SCENE_MESHES)){
+        return -1;
+    }
+    InitArena(&frameArena, "frame", 64 * 1024);
+
     printf("Verticles loaded\n");
 
-    SDL_GPUShader *vertShader = LoadTexture(gpuDevice, "vert.spv", SDL_GPU_SHADERSTAGE_VERTEX);
-    SDL_GPUShader *fragShader = LoadTexture(gpuDevice, "frag.spv", SDL_GPU_SHADERSTAGE_FRAGMENT);
+    SDL_GPUShader *vertShader = LoadTexture(gpuDevice, packedVertices ? "vert_packed.spv" : "vert.spv", SDL_GPU_SHADERSTAGE_VERTEX, 0);
+    SDL_GPUShader *fragShader = LoadTexture(gpuDevice, "frag.spv", SDL_GPU_SHADERSTAGE_FRAGMENT, 0);
+    SDL_GPUShader *instancedVertShader = NULL;
+    if (stressShips > 0 && instancing) {
+        instancedVertShader = LoadTexture(gpuDevice, "vert_instanced.spv", SDL_GPU_SHADERSTAGE_VERTEX, 1);
+    }
 
     printf("Shaders loaded\n");
 
@@ -471,9 +693,30 @@ int main(){
         }
     };
 
+    SDL_GPUVertexAttribute packed_vertex_attributes[] = {
+        {
+            .location = 0,
+            .buffer_slot = 0,
+            .format = SDL_GPU_VERTEXELEMENTFORMAT_USHORT4_NORM,
+            .offset = offsetof(PackedVertex, position)
+        },
+        {
+            .location = 1,
+            .buffer_slot = 0,
+            .format = SDL_GPU_VERTEXELEMENTFORMAT_SHORT2_NORM,
+            .offset = offsetof(PackedVertex, normal)
+        },
+        {
+            .location = 2,
+            .buffer_slot = 0,
+            .format = SDL_GPU_VERTEXELEMENTFORMAT_HALF2,
+            .offset = offsetof(PackedVertex, uv)
+        }
+    };
+
     SDL_GPUVertexBufferDescription vertex_buffer_desc = {
         .slot = 0,
-        .pitch = sizeof(Vertex),
+        .pitch = geometryPool.vertex_stride,
         .input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX,
         .instance_step_rate = 0
     };
@@ -481,12 +724,12 @@ int main(){
     SDL_GPUVertexInputState vertex_input_state = {
         .vertex_buffer_descriptions = &vertex_buffer_desc,
         .num_vertex_buffers = 1,
-        .vertex_attributes = vertex_attributes,
+        .vertex_attributes = packedVertices ? packed_vertex_attributes : vertex_attributes,
         .num_vertex_attributes = 3
     };
 
     SDL_GPUColorTargetDescription color_target = {
-        .format = SDL_GetGPUSwapchainTextureFormat(gpuDevice, window),
+        .format = offscreen ? OFFSCREEN_FORMAT : SDL_GetGPUSwapchainTextureFormat(gpuDevice, window),
         .blend_state = {
             .enable_blend = false,
             .alpha_blend_op = SDL_GPU_BLENDOP_ADD,
@@ -552,106 +795,190 @@ int main(){
         .type = SDL_GPU_TEXTURETYPE_2D,
         .format = SDL_GPU_TEXTUREFORMAT_D32_FLOAT,
         .usage = SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET,
-        .width = WDITH,
-        .height = HIGHT,
+        .width = (Uint32)width,
+        .height = (Uint32)height,
         .layer_count_or_depth = 1,
         .num_levels = 1,
         .sample_count = SDL_GPU_SAMPLECOUNT_1
     };
     SDL_GPUTexture* depthTexture = SDL_CreateGPUTexture(gpuDevice, &depth_info);
 
-    printf("Setting up UBO\n");
+    printf("Setting up uniforms\n");
 
     float fov = 70.0f * (3.14159265f / 180.0f);
-    float aspect = (float)WDITH / (float)HIGHT;
+    float aspect = (float)width / (float)height;
     float near = 0.1f;
     float far  = 1000.0f;
-    float f = 1.0f / tanf(fov * 0.5f);
-
-    CameraUBO cameraData = {
-        .view = {
-            .m = {
-                1.0f, 0.0f, 0.0f, 0.0f,
-                0.0f, 1.0f, 0.0f, 0.0f,
-                0.0f, 0.0f, 1.0f, 0.0f,
-                0.0f, 0.0f, -8.0f, 1.0f
-            }
-        },
-        .proj = {
-            .m = {
-                f / aspect, 0, 0, 0,
-                0, f, 0, 0,
-                0, 0, far / (near-far), -1,
-                0, 0, (near * far) / (near-far), 0
-            }
-        }
-    };
 
-    SDL_GPUBufferCreateInfo uboInfo = {
-        .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ,
-        .size = sizeof(CameraUBO)
+    FrameUniforms frameData = {
+        .view = Mat4Translation((Vec3){0.0f, 0.0f, -8.0f}),
+        .proj = Mat4Perspective(fov, aspect, near, far)
     };
-    SDL_GPUBuffer *cameraBuffer = SDL_CreateGPUBuffer(gpuDevice, &uboInfo);
-
-    SDL_GPUTransferBufferCreateInfo transfer_info = {
-        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-        .size = sizeof(CameraUBO)
-    };
-    SDL_GPUTransferBuffer* transfer = SDL_CreateGPUTransferBuffer(gpuDevice, &transfer_info);
-
-    void *mapped = SDL_MapGPUTransferBuffer(gpuDevice, transfer, false);
-    SDL_memcpy(mapped, &cameraData, sizeof(CameraUBO));
-    SDL_UnmapGPUTransferBuffer(gpuDevice, transfer);
-
-    SDL_GPUCommandBuffer *cmd = SDL_AcquireGPUCommandBuffer(gpuDevice);
-    SDL_GPUCopyPass *uboCopyPass = SDL_BeginGPUCopyPass(cmd);
+    frameData.view_proj = Mat4Multiply(frameData.proj, frameData.view);
+
+    // the stress scene is static, but its grid is spaced by the ship bounds,
+    // so the transforms go up once the ship has streamed in
+    InstanceData* stressInstances = NULL;
+    SDL_GPUBuffer* instanceBuffer = NULL;
+    bool stressReady = false;
+    if (stressShips > 0) {
+        stressInstances = malloc((size_t)stressShips * sizeof(InstanceData));
+
+        if (instancing) {
+            SDL_GPUBufferCreateInfo instanceInfo = {
+                .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ | (gpuCull ? SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ : 0),
+                .size = (Uint32)(stressShips * sizeof(InstanceData))
+            };
+            instanceBuffer = SDL_CreateGPUBuffer(gpuDevice, &instanceInfo);
+            if (!instanceBuffer) {
+                printf("[ERROR]: could not create instance buffer, %s\n", SDL_GetError());
+                return -1;
+            }
+        }
+        printf("Stress scene: %d ships, %s\n", stressShips,
+            gpuCull ? "culled on the GPU into one indirect draw" : instancing ? "one instanced draw" : "one draw per visible ship");
+    }
 
-    SDL_GPUTransferBufferLocation uboSrc = {
-        .transfer_buffer = transfer,
-        .offset = 0
-    };
-    SDL_GPUBufferRegion uboDst = {
-        .buffer = cameraBuffer,
-        .offset = 0,
-        .size = sizeof(CameraUBO)
-    };
+    // the stress ship plus every scene mesh and the cube
+    SceneDraw sceneDraws[SCENE_MESHES + 2];
+    PacketBuilder drawPackets = {0};
+    RenderQueue renderQueue = {0};
+    RenderBinds renderBinds = {0};
 
-    SDL_UploadToGPUBuffer(uboCopyPass, &uboSrc, &uboDst, false);
-    SDL_EndGPUCopyPass(uboCopyPass);
-    SDL_SubmitGPUCommandBuffer(cmd);
-    SDL_WaitForGPUIdle(gpuDevice);
+    FlushStagingUploads(&uploader);
+    printf("Uploads: %u staged, %llu bytes, %u submits, %u stalls\n",
+        uploader.stats.uploads, (unsigned long long)uploader.stats.bytes_staged,
+        uploader.stats.submits, uploader.stats.stalls);
 
     printf("Creating graphics pipeline\n");
 
     SDL_GPUGraphicsPipeline* pipeline = SDL_CreateGPUGraphicsPipeline(gpuDevice, &pipeline_info);
+    SDL_GPUGraphicsPipeline* instancedPipeline = NULL;
+    if (instancedVertShader) {
+        SDL_GPUGraphicsPipelineCreateInfo instanced_info = pipeline_info;
+        instanced_info.vertex_shader = instancedVertShader;
+        instancedPipeline = SDL_CreateGPUGraphicsPipeline(gpuDevice, &instanced_info);
+    }
+    GpuCuller gpuCuller = {0};
+    if (gpuCull && !InitGpuCuller(&gpuCuller, gpuDevice, "cull_instances.spv", (Uint32)stressShips)) {
+        return -1;
+    }
 
     printf("All setup done\n");
 
     bool quit = false;
     SDL_Event event;
-    float rotation;
+    float rotation = 0.0f;
+    bool pickPending = false;
+    float pickX = 0.0f, pickY = 0.0f;
+
+    Profiler profiler;
+    if(!InitProfiler(&profiler, tracePath != NULL)){
+        return -1;
+    }
+    GpuFrameTimer gpuTimer;
+    InitGpuFrameTimer(&gpuTimer, gpuDevice);
+    uint64_t reportStartNS = ProfilerNow();
+    int drawCalls = 0;
+    int occludedDraws = 0;
+    int clusterCount = 0;
+    int clustersCulled = 0;
+    bool firstFrame = true;
+
+    // --offscreen draws until streaming has settled, then measures each
+    // frame on its own: the CPU waits for every submit, so the GPU time is
+    // that of one frame and not of several overlapping ones
+    FrameSample* frameSamples = NULL;
+    int measuredFrames = 0;
+    bool measuring = false;
+    if (offscreen) {
+        frameSamples = malloc((size_t)offscreenFrames * sizeof(FrameSample));
+    }
 
     while(!quit){
-        float startTickNS = SDL_GetTicksNS();
+        uint64_t frameStartNS = ProfilerNow();
+        drawCalls = 0;
+        occludedDraws = 0;
+        clusterCount = 0;
+        clustersCulled = 0;
+        renderBinds = (RenderBinds){0};
+        ResetArena(&frameArena);
+
+        PROFILE_SCOPE(&profiler, "poll events") {
+            while (SDL_PollEvent(&event)){
+                if (event.type == SDL_EVENT_QUIT) {
+                    quit = true;
+                }
+                if (event.type == SDL_EVENT_MOUSE_BUTTON_DOWN && event.button.button == SDL_BUTTON_LEFT) {
+                    pickPending = true;
+                    pickX = event.button.x;
+                    pickY = event.button.y;
+                }
+            }
+        }
 
-        while (SDL_PollEvent(&event)){
-            if (event.type == SDL_EVENT_QUIT) {
-                quit = true;
+        if (offscreen && !measuring) {
+            bool timedOut = (double)(ProfilerNow() - startNS) * 1e-9 >= OFFSCREEN_SETTLE_SECONDS;
+            if (AssetStreamerSettled(&streamer) || timedOut) {
+                if (timedOut) printf("[ERROR]: assets still streaming after %.0f s, measuring anyway\n", OFFSCREEN_SETTLE_SECONDS);
+                // every run renders the same poses, so the last one matches a reference
+                measuring = true;
+                rotation = 0.0f;
             }
         }
+        bool lastFrame = measuring && measuredFrames == offscreenFrames - 1;
 
         rotation += 0.0005f;
-        float cos_y = cosf(rotation);
-        float sin_y = sinf(rotation);
+
+        PROFILE_SCOPE(&profiler, "retire uploads") {
+            RetireStagingUploads(&uploader);
+            CollectGpuFrameTimes(&gpuTimer, &profiler);
+        }
+
+        PROFILE_SCOPE(&profiler, "stream assets") {
+            UpdateAssetStreamer(&streamer);
+        }
+        for(int i=0;i<SCENE_MESHES;i++){
+            const StreamedMesh* loaded = sceneBoundsLoaded[i] ? NULL : GetLoadedMesh(&streamer, sceneMeshes[i]);
+            if (loaded) {
+                SetCullBounds(&cullBounds, i, &loaded->mesh);
+                placeholderModels[i] = PlaceholderModel(&loaded->mesh);
+                sceneBoundsLoaded[i] = true;
+                if (BuildMeshBvh(&sceneBvhs[i], &loaded->mesh)) {
+                    int instance = AddBvhInstance(&sceneBvh, &sceneBvhs[i], Mat4Identity());
+                    if (instance >= 0) bvhMeshes[instance] = i;
+                    RebuildSceneBvh(&sceneBvh);
+                }
+            }
+        }
+        const StreamedMesh* ship = GetResidentMesh(&streamer, sceneMeshes[0]);
+        if (stressShips > 0 && ship && !stressReady) {
+            BuildInstanceGrid(stressInstances, stressShips, &ship->mesh, STRESS_SHIP_SCALE);
+            if (instanceBuffer) {
+                StageBufferData(&uploader, instanceBuffer, 0, stressInstances, (Uint32)(stressShips * sizeof(InstanceData)));
+                FlushStagingUploads(&uploader);
+            }
+            stressReady = true;
+        }
+        if (stressShips > 0) {
+            TouchStreamedMesh(&streamer, sceneMeshes[0]);
+        }
 
         SDL_GPUCommandBuffer* cmd = SDL_AcquireGPUCommandBuffer(gpuDevice);
 
-        SDL_GPUTexture* swapchainTexture;
-        if (!SDL_WaitAndAcquireGPUSwapchainTexture(cmd, window, &swapchainTexture, NULL, NULL)){
+        SDL_GPUTexture* swapchainTexture = offscreenTarget.color;
+        bool acquired = true;
+        if (!offscreen) {
+            PROFILE_SCOPE(&profiler, "acquire swapchain") {
+                acquired = SDL_WaitAndAcquireGPUSwapchainTexture(cmd, window, &swapchainTexture, NULL, NULL);
+            }
+        }
+        if (!acquired){
             printf("[ERROR]: WaitAndAcquireGPUSwapchainTexture failed, %s\n", SDL_GetError());
             return -1;
         }
 
+        ProfileScope recordScope = BeginProfileScope("record");
         if (swapchainTexture){
             SDL_GPUColorTargetInfo colorTargetInfo = {0};
             colorTargetInfo.texture = swapchainTexture;
@@ -669,61 +996,283 @@ int main(){
                 .cycle = false
             };
 
-            SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass(cmd, &colorTargetInfo, 1, &depthTarget);
+            Mat4 model = Mat4Multiply(Mat4Translation((Vec3){0.0f, 0.0f, -120.0f}), Mat4RotationY(-rotation));
+            Mat4 modelView = Mat4Multiply(frameData.view, model);
+
+            // every mesh shares the model matrix, so cull against the
+            // frustum in model space and skip transforming the bounds
+            Mat4 clip = Mat4Multiply(frameData.view_proj, model);
+            Frustum frustum = ExtractFrustum(clip.m);
+
+            // the stress ships are placed in model space too; compute passes
+            // cannot run inside a render pass, so they are culled first
+            const GeometryAllocation* shipGeometry = stressReady ? &ship->allocations[0] : NULL;
+            bool gpuShips = gpuCull && shipGeometry && SetGpuCullGeometry(&gpuCuller, shipGeometry);
+            if (gpuShips) {
+                PROFILE_SCOPE(&profiler, "gpu cull") {
+                    DispatchGpuCull(&gpuCuller, cmd, instanceBuffer, (Uint32)stressShips, &frustum, MeshCenter(&ship->mesh), ship->mesh.bounds_radius);
+                }
+            }
 
-            SDL_BindGPUGraphicsPipeline(renderPass, pipeline);
+            SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass(cmd, &colorTargetInfo, 1, &depthTarget);
 
-            SDL_GPUTextureSamplerBinding texture_binding = {
-                .texture = texture,
-                .sampler = sampler
+            SDL_GPUBufferBinding vertex_binding = {
+                .buffer = geometryPool.vertex_buffer,
+                .offset = 0
             };
+            SDL_GPUBufferBinding index_binding = {
+                .buffer = geometryPool.index_buffer,
+                .offset = 0
+            };
+            SDL_BindGPUVertexBuffers(renderPass, 0, &vertex_binding, 1);
+            SDL_GPUTexture* texture = GetStreamedTexture(&streamer, sceneTexture);
 
-            for(int i=0; i<5;i++){
-
-                cameraData.model = (Mat4){
-                    .m = {
-                        cos_y,  0.0f, sin_y, 0.0f,
-                        0.0f,   1.0f, 0.0f,  0.0f,
-                        -sin_y,  0.0f, cos_y, 0.0f,
-                        0.0f, 0.0f, -120.0f, 1.0f
+            if (pickPending) {
+                PROFILE_SCOPE(&profiler, "pick") {
+                    PickSceneMesh(&frameData, meshFiles, model, pickX, pickY, (float)width, (float)height);
+                }
+                pickPending = false;
+            }
+            SDL_PushGPUVertexUniformData(cmd, 0, &frameData, sizeof(FrameUniforms));
+
+            int visibleCount = stressShips > 0 ? 0 : CullFrustum(&cullBounds, &frustum, visibleMeshes);
+
+            // large resident meshes go into the occlusion buffer, then every
+            // visible object whose bounds are behind them is dropped
+            if (occlusion && visibleCount > 0) {
+                PROFILE_SCOPE(&profiler, "occlusion") {
+                    ClearOcclusionBuffer(&occlusionBuffer);
+                    for(int v=0; v<visibleCount;v++){
+                        int i = (int)visibleMeshes[v];
+                        if (i == CUBE_OBJECT) continue;
+                        TouchStreamedMesh(&streamer, sceneMeshes[i]);
+                        const StreamedMesh* entry = GetResidentMesh(&streamer, sceneMeshes[i]);
+                        if (!entry) continue;
+                        float depth = ViewDistance(modelView, MeshCenter(&entry->mesh));
+                        float radius = entry->mesh.bounds_radius * frameData.proj.m[5] / depth * (float)OCCLUSION_HEIGHT * 0.5f;
+                        if (depth <= 0.0f || radius < OCCLUDER_MIN_RADIUS) continue;
+                        int lod = SelectMeshLod(entry->lods, entry->lod_count, depth, frameData.proj.m[5], (float)OCCLUSION_HEIGHT, 1.0f);
+                        RasterizeOccluder(&occlusionBuffer, clip.m, &entry->lods[lod].mesh);
                     }
-                };
+                    int kept = 0;
+                    for(int v=0; v<visibleCount;v++){
+                        uint32_t i = visibleMeshes[v];
+                        Vec3 center = {cullBounds.center_x[i], cullBounds.center_y[i], cullBounds.center_z[i]};
+                        Vec3 extent = {cullBounds.extent_x[i], cullBounds.extent_y[i], cullBounds.extent_z[i]};
+                        Vec3 lo = {center.x - extent.x, center.y - extent.y, center.z - extent.z};
+                        Vec3 hi = {center.x + extent.x, center.y + extent.y, center.z + extent.z};
+                        if (OcclusionTestBox(&occlusionBuffer, clip.m, lo, hi)) visibleMeshes[kept++] = i;
+                    }
+                    occludedDraws = visibleCount - kept;
+                    visibleCount = kept;
+                }
+            }
 
-                SDL_PushGPUVertexUniformData(cmd, 1, &cameraData, sizeof(CameraUBO));
-                SDL_GPUBufferBinding vertex_binding = {
-                    .buffer = vertexBuffers[i],
-                    .offset = 0
+            // workers fill their own packet lists; the main thread's list
+            // takes the scene meshes
+            int drawCount = 0;
+            BeginPackets(&drawPackets, &jobSystem);
+            PacketList* mainPackets = WorkerPacketList(&drawPackets, &jobSystem);
+            if (gpuShips) {
+                DrawUniforms drawData = MakeDrawUniforms(&frameData, model, &ship->mesh, false);
+                sceneDraws[drawCount] = (SceneDraw){ instancedPipeline, texture, gpuCuller.visible, 0, shipGeometry, NULL, 0, gpuCuller.args };
+                PushDrawPacket(mainPackets, MakeRenderKey(RENDER_PASS_OPAQUE, PIPELINE_ID_INSTANCED, 0, (uint32_t)sceneTexture, 0, 0.0f), &drawData, (uint32_t)drawCount++);
+            } else if (shipGeometry && instancing) {
+                DrawUniforms drawData = MakeDrawUniforms(&frameData, model, &ship->mesh, false);
+                sceneDraws[drawCount] = (SceneDraw){ instancedPipeline, texture, instanceBuffer, (Uint32)stressShips, shipGeometry, NULL, 0, NULL };
+                PushDrawPacket(mainPackets, MakeRenderKey(RENDER_PASS_OPAQUE, PIPELINE_ID_INSTANCED, 0, (uint32_t)sceneTexture, 0, 0.0f), &drawData, (uint32_t)drawCount++);
+            } else if (shipGeometry) {
+                VertexQuantization q = GetVertexQuantization(&ship->mesh);
+                InstancePackets stress = {
+                    .view = frameData.view,
+                    .view_proj = frameData.view_proj,
+                    .frustum = ExtractFrustum(frameData.view_proj.m),
+                    .model = model,
+                    .vertex_decode = packedVertices ? Mat4Multiply(Mat4Translation(q.offset), Mat4Scale(q.scale)) : Mat4Identity(),
+                    .center = MeshCenter(&ship->mesh),
+                    .radius = ship->mesh.bounds_radius,
+                    .instances = stressInstances,
+                    .count = stressShips,
+                    .pipeline = PIPELINE_ID_DEFAULT,
+                    .texture = (uint32_t)sceneTexture,
+                    .state = (uint32_t)drawCount
                 };
-                SDL_BindGPUVertexBuffers(renderPass, 0, &vertex_binding, 1);
-                SDL_BindGPUFragmentSamplers(renderPass, 0, &texture_binding, 1);
-                SDL_DrawGPUPrimitives(renderPass, Meshes[i].vertex_count, 1, 0, 0);
+                sceneDraws[drawCount++] = (SceneDraw){ pipeline, texture, NULL, 1, shipGeometry, NULL, 0, NULL };
+                PROFILE_SCOPE(&profiler, "build draws") {
+                    BuildInstancePackets(&jobSystem, &drawPackets, &stress, 256);
+                }
+            }
+
+            // meshlets are culled in model space too, from the camera
+            // position there
+            Vec3 modelCamera = Mat4TransformPoint(Mat4InverseAffine(modelView), (Vec3){0.0f, 0.0f, 0.0f});
+            for(int v=0; v<visibleCount;v++){
+                int i = (int)visibleMeshes[v];
+                DrawUniforms drawData;
+                const GeometryAllocation* geometry;
+                MeshletDraw* clusters = NULL;
+                int clusterDraws = 0;
+                float depth;
+
+                const StreamedMesh* entry = NULL;
+                if (i != CUBE_OBJECT) {
+                    TouchStreamedMesh(&streamer, sceneMeshes[i]);
+                    entry = GetResidentMesh(&streamer, sceneMeshes[i]);
+                }
+                if (entry) {
+                    depth = ViewDistance(modelView, MeshCenter(&entry->mesh));
+                    int lod = SelectMeshLod(entry->lods, entry->lod_count, depth, frameData.proj.m[5], (float)height, LOD_PIXEL_ERROR);
+                    const Mesh* lodMesh = &entry->lods[lod].mesh;
+                    drawData = MakeDrawUniforms(&frameData, model, lodMesh, packedVertices);
+                    geometry = &entry->allocations[lod];
+                    if (meshlets && lodMesh->meshlet_count > 0) {
+                        clusters = ArenaAlloc(&frameArena, (size_t)lodMesh->meshlet_count * sizeof(MeshletDraw));
+                    }
+                    if (clusters) {
+                        MeshletCullStats culled = {0};
+                        clusterDraws = CullMeshlets(lodMesh->meshlets, lodMesh->meshlet_count, &frustum, modelCamera, clusters, &culled);
+                        clusterCount += lodMesh->meshlet_count;
+                        clustersCulled += culled.frustum_culled + culled.backface_culled;
+                        if (clusterDraws == 0) continue;
+                    }
+                } else {
+                    Mat4 cubeModel = i == CUBE_OBJECT ? model : Mat4Multiply(model, placeholderModels[i]);
+                    depth = ViewDistance(frameData.view, Mat4TransformPoint(cubeModel, (Vec3){0.0f, 0.0f, 0.0f}));
+                    drawData = MakeDrawUniforms(&frameData, cubeModel, &cubeMesh, packedVertices);
+                    geometry = &cubeAllocation;
+                }
+                sceneDraws[drawCount] = (SceneDraw){ pipeline, texture, NULL, 1, geometry, clusters, (Uint32)clusterDraws, NULL };
+                PushDrawPacket(mainPackets, MakeRenderKey(RENDER_PASS_OPAQUE, PIPELINE_ID_DEFAULT, 0, (uint32_t)sceneTexture, (uint32_t)i, depth), &drawData, (uint32_t)drawCount++);
             }
 
+            PROFILE_SCOPE(&profiler, "sort draws") {
+                ClearRenderQueue(&renderQueue);
+                MergePackets(&drawPackets, &renderQueue);
+                SortRenderQueue(&renderQueue);
+            }
+            drawCalls = EmitRenderQueue(cmd, renderPass, &renderQueue, &drawPackets, sceneDraws, sampler, &index_binding, &renderBinds);
+
             SDL_EndGPURenderPass(renderPass);
+            if (lastFrame) {
+                RecordOffscreenReadback(&offscreenTarget, cmd);
+            }
         }
+        EndProfileScope(&profiler, recordScope);
 
-        SDL_SubmitGPUCommandBuffer(cmd);
+        PROFILE_SCOPE(&profiler, "submit") {
+            SubmitTimedCommandBuffer(&gpuTimer, &profiler, cmd);
+        }
+
+        ProfilerEndFrame(&profiler, frameStartNS);
 
-        //float tickDeltaNS = SDL_GetTicksNS() - startTickNS;
-        //if(tickDeltaNS > 0){
-        //    int Fps = 1000000000.0f/tickDeltaNS;
-        //    printf("FPS: %i\n", Fps);
-        //}
+        if (measuring) {
+            FrameSample* sample = &frameSamples[measuredFrames++];
+            sample->cpu_ms = (float)((double)(ProfilerNow() - frameStartNS) * 1e-6);
+            WaitGpuFrameTimes(&gpuTimer, &profiler);
+            sample->gpu_ms = (float)((double)gpuTimer.last_ns * 1e-6);
+            sample->draws = drawCalls;
+            quit = quit || measuredFrames == offscreenFrames;
+        }
+
+        if (firstFrame) {
+            printf("First frame after %.3f ms\n", (double)(ProfilerNow() - startNS) * 1e-6);
+            firstFrame = false;
+        }
+
+        uint64_t frameEndNS = ProfilerNow();
+        if (profile && (double)(frameEndNS - reportStartNS) * 1e-9 >= FRAME_REPORT_SECONDS) {
+            printf("%d draws", drawCalls);
+            if (stressShips > 0) printf(", %d ships", stressShips);
+            if (occlusion) printf(", %d occluded", occludedDraws);
+            if (clusterCount > 0) printf(", %d of %d clusters culled (%.0f%%)", clustersCulled, clusterCount, 100.0 * clustersCulled / clusterCount);
+            printf(", %u binds issued, %u skipped\n", RenderBindsIssued(&renderBinds), RenderBindsSkipped(&renderBinds));
+            PrintProfilerReport(&profiler);
+            PrintAssetStreamerStats(&streamer);
+            PrintGeometryPoolStats(&geometryPool);
+            MemoryStats meshMemory = GetPoolStats(MeshDataPool());
+            PrintMemoryStats("mesh data", &meshMemory);
+            PrintMemoryStats("frame", &frameArena.stats);
+            reportStartNS = frameEndNS;
+        }
+    }
+
+    int result = 0;
+    if (offscreen && measuredFrames == offscreenFrames) {
+        // the readback was recorded with the last frame, which has finished
+        if (!SaveOffscreenImage(&offscreenTarget, outputPath)) {
+            result = -1;
+        } else {
+            printf("Image written to %s\n", outputPath);
+        }
+        if (referencePath) {
+            int different = CompareOffscreenImage(&offscreenTarget, referencePath, OFFSCREEN_TOLERANCE);
+            int allowed = width * height / 1000;
+            printf("%d of %d pixels differ from %s\n", different, width * height, referencePath);
+            if (different < 0 || different > allowed) result = -1;
+        }
+        if (frameStatsPath && WriteFrameSamples(frameStatsPath, frameSamples, measuredFrames)) {
+            printf("Frame stats written to %s\n", frameStatsPath);
+        }
+        float* ms = malloc((size_t)measuredFrames * sizeof(float));
+        for (int i = 0; i < measuredFrames; i++) ms[i] = frameSamples[i].cpu_ms;
+        PrintFrameSampleStats("CPU", ms, measuredFrames);
+        for (int i = 0; i < measuredFrames; i++) ms[i] = frameSamples[i].gpu_ms;
+        PrintFrameSampleStats("GPU", ms, measuredFrames);
+        free(ms);
+    } else if (offscreen) {
+        printf("[ERROR]: quit after %d of %d offscreen frames\n", measuredFrames, offscreenFrames);
+        result = -1;
+    }
+    free(frameSamples);
+
+    DestroyGpuFrameTimer(&gpuTimer);
+    if (tracePath && WriteChromeTrace(&profiler, tracePath)) {
+        printf("Trace written to %s (%d events)\n", tracePath, profiler.event_count);
     }
+    DestroyProfiler(&profiler);
 
     SDL_ReleaseGPUGraphicsPipeline(gpuDevice, pipeline);
+    if (instancedPipeline) {
+        SDL_ReleaseGPUGraphicsPipeline(gpuDevice, instancedPipeline);
+        SDL_ReleaseGPUShader(gpuDevice, instancedVertShader);
+    }
+    if (instanceBuffer) {
+        SDL_ReleaseGPUBuffer(gpuDevice, instanceBuffer);
+    }
+    DestroyGpuCuller(&gpuCuller);
+    free(stressInstances);
+    FreePacketBuilder(&drawPackets);
+    FreeRenderQueue(&renderQueue);
     SDL_ReleaseGPUShader(gpuDevice, vertShader);
     SDL_ReleaseGPUShader(gpuDevice, fragShader);
     SDL_ReleaseGPUSampler(gpuDevice, sampler);
-    SDL_ReleaseGPUTexture(gpuDevice, texture);
-    SDL_ReleaseGPUTransferBuffer(gpuDevice, transfer);
-    for(int i=0;i<5;i++){
-        SDL_ReleaseGPUBuffer(gpuDevice, vertexBuffers[i]);
+    SDL_WaitForGPUIdle(gpuDevice);
+    DestroyOffscreenTarget(&offscreenTarget);
+    DestroyAssetStreamer(&streamer);
+    DestroyJobSystem(&jobSystem);
+    DestroyStagingUploader(&uploader);
+    FreeMeshFromPool(&geometryPool, &cubeAllocation);
+    FreeMesh(&cubeMesh);
+    DestroyGeometryPool(&geometryPool);
+    DestroyCullBounds(&cullBounds);
+    free(visibleMeshes);
+    DestroyOcclusionBuffer(&occlusionBuffer);
+    DestroySceneBvh(&sceneBvh);
+    for(int i=0;i<SCENE_MESHES;i++) FreeMeshBvh(&sceneBvhs[i]);
+    if (profile) {
+        MemoryStats scratch = GetObjScratchStats();
+        MemoryStats meshMemory = GetPoolStats(MeshDataPool());
+        PrintMemoryStats("obj scratch", &scratch);
+        PrintMemoryStats("mesh data", &meshMemory);
+        PrintMemoryStats("frame", &frameArena.stats);
     }
-    SDL_ReleaseGPUBuffer(gpuDevice, cameraBuffer);
+    DestroyArena(&frameArena);
+    FreeObjScratch();
+    ReportPoolLeaks(MeshDataPool());
+    TrimPool(MeshDataPool());
     SDL_DestroyGPUDevice(gpuDevice);
-    SDL_DestroyWindow(window);
+    if (window) SDL_DestroyWindow(window);
     SDL_Quit();
 
-    return 0;
+    return result;
 }
@@ -0,0 +1,145 @@
+#include "mat4.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MAT4_SSE2 1
+#endif
+
+Mat4 Mat4Identity(void){
+    return (Mat4){ .m = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    }};
+}
+
+Mat4 Mat4Translation(Vec3 t){
+    Mat4 out = Mat4Identity();
+    out.m[12] = t.x;
+    out.m[13] = t.y;
+    out.m[14] = t.z;
+    return out;
+}
+
+Mat4 Mat4Scale(Vec3 s){
+    Mat4 out = Mat4Identity();
+    out.m[0] = s.x;
+    out.m[5] = s.y;
+    out.m[10] = s.z;
+    return out;
+}
+
+Mat4 Mat4RotationX(float radians){
+    float c = cosf(radians), s = sinf(radians);
+    Mat4 out = Mat4Identity();
+    out.m[5] = c;
+    out.m[6] = s;
+    out.m[9] = -s;
+    out.m[10] = c;
+    return out;
+}
+
+Mat4 Mat4RotationY(float radians){
+    float c = cosf(radians), s = sinf(radians);
+    Mat4 out = Mat4Identity();
+    out.m[0] = c;
+    out.m[2] = -s;
+    out.m[8] = s;
+    out.m[10] = c;
+    return out;
+}
+
+Mat4 Mat4Perspective(float fovY, float aspect, float near, float far){
+    float f = 1.0f / tanf(fovY * 0.5f);
+    return (Mat4){ .m = {
+        f / aspect, 0.0f, 0.0f, 0.0f,
+        0.0f, f, 0.0f, 0.0f,
+        0.0f, 0.0f, far / (near - far), -1.0f,
+        0.0f, 0.0f, (near * far) / (near - far), 0.0f
+    }};
+}
+
+Mat4 Mat4MultiplyScalar(Mat4 a, Mat4 b){
+    Mat4 out;
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+            out.m[c * 4 + r] = a.m[0 + r] * b.m[c * 4 + 0] + a.m[4 + r] * b.m[c * 4 + 1]
+                             + a.m[8 + r] * b.m[c * 4 + 2] + a.m[12 + r] * b.m[c * 4 + 3];
+        }
+    }
+    return out;
+}
+
+Mat4 Mat4Multiply(Mat4 a, Mat4 b){
+#ifdef MAT4_SSE2
+    // each output column is the columns of a weighted by one column of b
+    __m128 a0 = _mm_loadu_ps(a.m + 0);
+    __m128 a1 = _mm_loadu_ps(a.m + 4);
+    __m128 a2 = _mm_loadu_ps(a.m + 8);
+    __m128 a3 = _mm_loadu_ps(a.m + 12);
+
+    Mat4 out;
+    for (int c = 0; c < 4; c++) {
+        __m128 col = _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b.m[c * 4 + 0])), _mm_mul_ps(a1, _mm_set1_ps(b.m[c * 4 + 1])));
+        col = _mm_add_ps(col, _mm_mul_ps(a2, _mm_set1_ps(b.m[c * 4 + 2])));
+        col = _mm_add_ps(col, _mm_mul_ps(a3, _mm_set1_ps(b.m[c * 4 + 3])));
+        _mm_storeu_ps(out.m + c * 4, col);
+    }
+    return out;
+#else
+    return Mat4MultiplyScalar(a, b);
+#endif
+}
+
+Vec3 Mat4TransformPoint(Mat4 m, Vec3 p){
+    return (Vec3){
+        m.m[0] * p.x + m.m[4] * p.y + m.m[8] * p.z + m.m[12],
+        m.m[1] * p.x + m.m[5] * p.y + m.m[9] * p.z + m.m[13],
+        m.m[2] * p.x + m.m[6] * p.y + m.m[10] * p.z + m.m[14]
+    };
+}
+
+NormalMatrix Mat4NormalMatrix(Mat4 m){
+    // for columns a, b, c the inverse transpose is (b x c, c x a, a x b) / det
+    Vec3 a = {m.m[0], m.m[1], m.m[2]};
+    Vec3 b = {m.m[4], m.m[5], m.m[6]};
+    Vec3 c = {m.m[8], m.m[9], m.m[10]};
+    Vec3 bc = Vec3Cross(b, c), ca = Vec3Cross(c, a), ab = Vec3Cross(a, b);
+
+    float det = a.x * bc.x + a.y * bc.y + a.z * bc.z;
+    float inv = det != 0.0f ? 1.0f / det : 0.0f;
+
+    return (NormalMatrix){ .m = {
+        bc.x * inv, bc.y * inv, bc.z * inv, 0.0f,
+        ca.x * inv, ca.y * inv, ca.z * inv, 0.0f,
+        ab.x * inv, ab.y * inv, ab.z * inv, 0.0f
+    }};
+}
+
+Mat4 Mat4InverseAffine(Mat4 m){
+    // rows of the inverse 3x3 are (b x c, c x a, a x b) / det
+    Vec3 a = {m.m[0], m.m[1], m.m[2]};
+    Vec3 b = {m.m[4], m.m[5], m.m[6]};
+    Vec3 c = {m.m[8], m.m[9], m.m[10]};
+    Vec3 bc = Vec3Cross(b, c), ca = Vec3Cross(c, a), ab = Vec3Cross(a, b);
+
+    float det = a.x * bc.x + a.y * bc.y + a.z * bc.z;
+    float inv = det != 0.0f ? 1.0f / det : 0.0f;
+    Vec3 rows[3] = {
+        {bc.x * inv, bc.y * inv, bc.z * inv},
+        {ca.x * inv, ca.y * inv, ca.z * inv},
+        {ab.x * inv, ab.y * inv, ab.z * inv}
+    };
+
+    Mat4 out = Mat4Identity();
+    for (int r = 0; r < 3; r++) {
+        out.m[0 + r] = rows[r].x;
+        out.m[4 + r] = rows[r].y;
+        out.m[8 + r] = rows[r].z;
+        out.m[12 + r] = -(rows[r].x * m.m[12] + rows[r].y * m.m[13] + rows[r].z * m.m[14]);
+    }
+    return out;
+}
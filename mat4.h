@@ -0,0 +1,43 @@
+#ifndef MAT4_H
+#define MAT4_H
+
+#include "mesh.h"
+
+// Column-major like GLSL: m[column * 4 + row], vectors multiply on the right.
+typedef struct Mat4{
+    float m[16];
+} Mat4;
+
+// Inverse transpose of the upper 3x3, stored as three vec4 columns so it
+// can be copied straight into a std140 mat3.
+typedef struct NormalMatrix{
+    float m[12];
+} NormalMatrix;
+
+static inline Vec3 Vec3Sub(Vec3 a, Vec3 b){ return (Vec3){a.x - b.x, a.y - b.y, a.z - b.z}; }
+static inline Vec3 Vec3Cross(Vec3 a, Vec3 b){ return (Vec3){a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+static inline float Vec3Dot(Vec3 a, Vec3 b){ return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+Mat4 Mat4Identity(void);
+Mat4 Mat4Translation(Vec3 t);
+Mat4 Mat4Scale(Vec3 s);
+Mat4 Mat4RotationX(float radians);
+Mat4 Mat4RotationY(float radians);
+
+// Right handed, looking down -z, depth mapped to [0, 1] as SDL GPU expects.
+Mat4 Mat4Perspective(float fovY, float aspect, float near, float far);
+
+// a * b, SSE2 when available.
+Mat4 Mat4Multiply(Mat4 a, Mat4 b);
+// Plain loops with the same summation order, as a reference.
+Mat4 Mat4MultiplyScalar(Mat4 a, Mat4 b);
+
+Vec3 Mat4TransformPoint(Mat4 m, Vec3 p);
+
+NormalMatrix Mat4NormalMatrix(Mat4 m);
+
+// Inverse of a matrix whose last row is 0 0 0 1 (rotation, scale,
+// translation), e.g. to bring rays into object space.
+Mat4 Mat4InverseAffine(Mat4 m);
+
+#endif
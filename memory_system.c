@@ -0,0 +1,263 @@
+#include "memory_system.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sched.h>
+#endif
+
+#define ALIGN_UP(size, align) (((size) + (align) - 1) & ~(size_t)((align) - 1))
+
+struct ArenaBlock{
+    ArenaBlock* prev;
+    size_t capacity;
+    size_t used;
+};
+
+#define ARENA_HEADER_SIZE ALIGN_UP(sizeof(ArenaBlock), ARENA_ALIGN)
+
+static unsigned char* block_data(ArenaBlock* block){
+    return (unsigned char*)block + ARENA_HEADER_SIZE;
+}
+
+static ArenaBlock* new_block(Arena* arena, size_t capacity){
+    ArenaBlock* block = malloc(ARENA_HEADER_SIZE + capacity);
+    if (!block) {
+        printf("[ERROR]: %s arena: out of memory for a %zu byte block\n", arena->name, capacity);
+        return NULL;
+    }
+    block->prev = arena->block;
+    block->capacity = capacity;
+    block->used = 0;
+    arena->block = block;
+    arena->reserved += capacity;
+    return block;
+}
+
+static void free_blocks(Arena* arena){
+    ArenaBlock* block = arena->block;
+    while (block) {
+        ArenaBlock* prev = block->prev;
+        free(block);
+        block = prev;
+    }
+    arena->block = NULL;
+    arena->reserved = 0;
+}
+
+static void count_bytes(MemoryStats* stats, size_t grown){
+    stats->bytes += grown;
+    stats->total_bytes += grown;
+    if (stats->bytes > stats->peak_bytes) stats->peak_bytes = stats->bytes;
+}
+
+void InitArena(Arena* arena, const char* name, size_t blockSize){
+    *arena = (Arena){0};
+    arena->name = name;
+    arena->block_size = blockSize > 0 ? ALIGN_UP(blockSize, ARENA_ALIGN) : 64 * 1024;
+}
+
+void DestroyArena(Arena* arena){
+    free_blocks(arena);
+    *arena = (Arena){0};
+}
+
+void* ArenaAlloc(Arena* arena, size_t size){
+    size_t aligned = ALIGN_UP(size, ARENA_ALIGN);
+    ArenaBlock* block = arena->block;
+    if (!block || block->capacity - block->used < aligned) {
+        block = new_block(arena, aligned > arena->block_size ? aligned : arena->block_size);
+        if (!block) return NULL;
+    }
+    void* ptr = block_data(block) + block->used;
+    block->used += aligned;
+    arena->stats.allocations++;
+    count_bytes(&arena->stats, aligned);
+    return ptr;
+}
+
+void ResetArena(Arena* arena){
+    if (arena->block && arena->block->prev) {
+        size_t capacity = arena->reserved;
+        free_blocks(arena);
+        new_block(arena, capacity);
+    } else if (arena->block) {
+        arena->block->used = 0;
+    }
+    arena->resets++;
+    arena->stats.frees = arena->stats.allocations;
+    arena->stats.bytes = 0;
+}
+
+void TrimArena(Arena* arena){
+    free_blocks(arena);
+    arena->resets++;
+    arena->stats.frees = arena->stats.allocations;
+    arena->stats.bytes = 0;
+}
+
+#define POOL_MAGIC 0x4C4F4F50u // "POOL"
+#define POOL_MIN_SHIFT 6
+
+struct PoolHeader{
+    PoolHeader* prev;
+    PoolHeader* next;
+    const char* tag;
+    size_t size;    // as requested
+    int size_class; // -1 for blocks that bypass the free lists
+    uint32_t magic;
+};
+
+#define POOL_HEADER_SIZE ALIGN_UP(sizeof(PoolHeader), 16)
+
+static size_t class_size(int sizeClass){
+    int octave = POOL_MIN_SHIFT + sizeClass / 4;
+    return ((size_t)1 << octave) + (size_t)(sizeClass % 4) * ((size_t)1 << (octave - 2));
+}
+
+static int size_class(size_t size){
+    if (size <= ((size_t)1 << POOL_MIN_SHIFT)) return 0;
+    if (size > class_size(POOL_CLASS_COUNT - 1)) return -1;
+
+    // 2^octave < size <= 2^(octave + 1), then the quarter step above 2^octave
+    int octave = POOL_MIN_SHIFT;
+    while (((size_t)2 << octave) < size) octave++;
+    size_t quarter = (size_t)1 << (octave - 2);
+    int step = (int)((size - ((size_t)1 << octave) + quarter - 1) / quarter);
+    return (octave - POOL_MIN_SHIFT) * 4 + step;
+}
+
+void AcquireSpinLock(atomic_flag* lock){
+    while (atomic_flag_test_and_set_explicit(lock, memory_order_acquire)) {
+#ifndef _WIN32
+        sched_yield();
+#endif
+    }
+}
+
+void ReleaseSpinLock(atomic_flag* lock){
+    atomic_flag_clear_explicit(lock, memory_order_release);
+}
+
+static void lock_pool(Pool* pool){
+    AcquireSpinLock(&pool->lock);
+}
+
+static void unlock_pool(Pool* pool){
+    ReleaseSpinLock(&pool->lock);
+}
+
+void* PoolAlloc(Pool* pool, size_t size, const char* tag){
+    int sizeClass = size_class(size);
+    PoolHeader* header = NULL;
+    if (sizeClass >= 0) {
+        lock_pool(pool);
+        header = pool->free_lists[sizeClass];
+        if (header) {
+            pool->free_lists[sizeClass] = header->next;
+            pool->cached_bytes -= class_size(sizeClass);
+        }
+        unlock_pool(pool);
+    }
+    if (!header) {
+        header = malloc(POOL_HEADER_SIZE + (sizeClass >= 0 ? class_size(sizeClass) : size));
+        if (!header) {
+            printf("[ERROR]: %s: out of memory for %zu bytes of %s\n", pool->name, size, tag);
+            return NULL;
+        }
+    }
+    header->prev = NULL;
+    header->tag = tag;
+    header->size = size;
+    header->size_class = sizeClass;
+    header->magic = POOL_MAGIC;
+
+    lock_pool(pool);
+    header->next = pool->live;
+    if (pool->live) pool->live->prev = header;
+    pool->live = header;
+    pool->stats.allocations++;
+    count_bytes(&pool->stats, size);
+    unlock_pool(pool);
+    return (unsigned char*)header + POOL_HEADER_SIZE;
+}
+
+void PoolFree(Pool* pool, void* ptr){
+    if (!ptr) return;
+    PoolHeader* header = (PoolHeader*)((unsigned char*)ptr - POOL_HEADER_SIZE);
+    if (header->magic != POOL_MAGIC) {
+        printf("[ERROR]: %s: %p was not allocated from this pool or is already free\n", pool->name, ptr);
+        return;
+    }
+    header->magic = 0;
+
+    lock_pool(pool);
+    if (header->prev) header->prev->next = header->next;
+    else pool->live = header->next;
+    if (header->next) header->next->prev = header->prev;
+    pool->stats.bytes -= header->size;
+    pool->stats.frees++;
+    if (header->size_class >= 0 && pool->cached_bytes + class_size(header->size_class) <= pool->max_cached) {
+        header->next = pool->free_lists[header->size_class];
+        pool->free_lists[header->size_class] = header;
+        pool->cached_bytes += class_size(header->size_class);
+        header = NULL;
+    }
+    unlock_pool(pool);
+    free(header);
+}
+
+void TrimPool(Pool* pool){
+    PoolHeader* lists[POOL_CLASS_COUNT];
+    lock_pool(pool);
+    memcpy(lists, pool->free_lists, sizeof(lists));
+    memset(pool->free_lists, 0, sizeof(pool->free_lists));
+    pool->cached_bytes = 0;
+    unlock_pool(pool);
+
+    for (int i = 0; i < POOL_CLASS_COUNT; i++) {
+        PoolHeader* header = lists[i];
+        while (header) {
+            PoolHeader* next = header->next;
+            free(header);
+            header = next;
+        }
+    }
+}
+
+int ReportPoolLeaks(Pool* pool){
+    int count = 0;
+    size_t bytes = 0;
+    lock_pool(pool);
+    for (const PoolHeader* header = pool->live; header; header = header->next) {
+        if (count < 16) printf("[ERROR]: %s: %zu bytes of %s were never freed\n", pool->name, header->size, header->tag);
+        count++;
+        bytes += header->size;
+    }
+    unlock_pool(pool);
+    if (count > 16) printf("[ERROR]: %s: ... and %d more\n", pool->name, count - 16);
+    if (count > 0) printf("[ERROR]: %s: %d blocks, %.1f KB leaked\n", pool->name, count, bytes / 1024.0);
+    return count;
+}
+
+MemoryStats GetPoolStats(Pool* pool){
+    lock_pool(pool);
+    MemoryStats stats = pool->stats;
+    unlock_pool(pool);
+    return stats;
+}
+
+size_t GetPoolCachedBytes(Pool* pool){
+    lock_pool(pool);
+    size_t bytes = pool->cached_bytes;
+    unlock_pool(pool);
+    return bytes;
+}
+
+void PrintMemoryStats(const char* name, const MemoryStats* stats){
+    printf("Memory %-12s %.1f KB live, %.1f KB peak, %llu allocations (%.1f MB), %llu freed\n", name,
+        stats->bytes / 1024.0, stats->peak_bytes / 1024.0, (unsigned long long)stats->allocations,
+        stats->total_bytes / (1024.0 * 1024.0), (unsigned long long)stats->frees);
+}
@@ -0,0 +1,98 @@
+#ifndef MEMORY_SYSTEM_H
+#define MEMORY_SYSTEM_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_ALIGN 16
+
+typedef struct MemoryStats{
+    size_t bytes;          // live right now
+    size_t peak_bytes;
+    size_t total_bytes;    // handed out over the whole lifetime
+    uint64_t allocations;
+    uint64_t frees;
+} MemoryStats;
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Linear allocator for data that dies all at once. Allocations bump a cursor
+// through malloc'ed blocks and are never freed one by one; ResetArena drops
+// everything. A reset that finds more than one block replaces them with a
+// single block as large as all of them, so a workload that repeats settles
+// into one block and stops calling malloc. Not thread safe.
+typedef struct Arena{
+    const char* name;
+    ArenaBlock* block; // the one being filled, links to the older ones
+    size_t block_size;
+    size_t reserved;   // bytes held in blocks
+    uint64_t resets;
+    MemoryStats stats; // bytes is what was handed out since the last reset
+} Arena;
+
+// Allocates nothing until the first ArenaAlloc.
+void InitArena(Arena* arena, const char* name, size_t blockSize);
+void DestroyArena(Arena* arena);
+
+// ARENA_ALIGN aligned, uninitialized. Returns NULL when malloc fails.
+void* ArenaAlloc(Arena* arena, size_t size);
+
+void ResetArena(Arena* arena);
+
+// Resets and returns every block to malloc, for an arena that just served
+// an outlier it should not keep memory for.
+void TrimArena(Arena* arena);
+
+// Lock for the short critical sections shared across threads, such as a
+// pool's free lists. Works from static initializers, unlike a mutex. A
+// waiter yields its time slice between tries, so a holder that was preempted
+// gets to finish instead of competing with a spinning thread.
+void AcquireSpinLock(atomic_flag* lock);
+void ReleaseSpinLock(atomic_flag* lock);
+
+typedef struct PoolHeader PoolHeader;
+
+#define POOL_CLASS_COUNT 96 // 4 classes per power of two, 64 bytes to 896 MB
+
+// Thread safe allocator for long-lived data that comes and goes in blocks of
+// any size, such as mesh arrays. Sizes are rounded up to one of four classes
+// per power of two (at most 25% slack) and freed blocks are kept on a list
+// per class, so loading and unloading the same data again reuses the same
+// blocks instead of going back to malloc. Larger requests, and freed blocks
+// that would take the cache past max_cached, go straight to malloc and free.
+// Every live block is linked into a list with the tag it was
+// allocated with, for ReportPoolLeaks.
+typedef struct Pool{
+    const char* name;
+    atomic_flag lock;
+    PoolHeader* free_lists[POOL_CLASS_COUNT];
+    PoolHeader* live;
+    size_t cached_bytes; // held on the free lists
+    size_t max_cached;
+    MemoryStats stats;
+} Pool;
+
+#define POOL_INIT(poolName, maxCached) { .name = (poolName), .lock = ATOMIC_FLAG_INIT, .max_cached = (maxCached) }
+
+// 16 byte aligned, uninitialized. tag has to outlive the block, a string
+// literal naming what it holds. Returns NULL when malloc fails.
+void* PoolAlloc(Pool* pool, size_t size, const char* tag);
+// ptr may be NULL.
+void PoolFree(Pool* pool, void* ptr);
+
+// Returns the cached free blocks to malloc.
+void TrimPool(Pool* pool);
+
+// Prints every block that is still allocated and returns how many there are.
+int ReportPoolLeaks(Pool* pool);
+
+// Thread safe copies of the counters.
+MemoryStats GetPoolStats(Pool* pool);
+size_t GetPoolCachedBytes(Pool* pool);
+
+// One line: live, peak and lifetime bytes and allocation counts.
+void PrintMemoryStats(const char* name, const MemoryStats* stats);
+
+#endif
@@ -0,0 +1,187 @@
+#include "mesh.h"
+#include "file_map.h"
+#include "memory_system.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// enough to keep a few scenes' worth of arrays around between loads
+static Pool meshPool = POOL_INIT("mesh data", 32 * 1024 * 1024);
+
+void* AllocMeshData(size_t size, const char* tag){
+    return PoolAlloc(&meshPool, size, tag);
+}
+
+void FreeMeshData(void* ptr){
+    PoolFree(&meshPool, ptr);
+}
+
+Pool* MeshDataPool(void){
+    return &meshPool;
+}
+
+void SetMeshIndices(Mesh* mesh, const uint32_t* indices, int indexCount){
+    FreeMeshData(mesh->indices);
+
+    mesh->index_stride = mesh->vertex_count <= 0xFFFF ? 2 : 4;
+    mesh->index_count = indexCount;
+    mesh->index_size = (size_t)indexCount * mesh->index_stride;
+    mesh->indices = AllocMeshData(mesh->index_size + 4, "mesh indices");
+
+    if (mesh->index_stride == 2) {
+        uint16_t* dst = mesh->indices;
+        for (int i = 0; i < indexCount; i++) dst[i] = (uint16_t)indices[i];
+    } else {
+        uint32_t* dst = mesh->indices;
+        for (int i = 0; i < indexCount; i++) dst[i] = indices[i];
+    }
+}
+
+static uint32_t hash_position(Vec3 p){
+    uint32_t x, y, z;
+    memcpy(&x, &p.x, 4);
+    memcpy(&y, &p.y, 4);
+    memcpy(&z, &p.z, 4);
+    uint32_t h = x * 73856093u ^ y * 19349663u ^ z * 83492791u;
+    return h ^ (h >> 16);
+}
+
+int WeldMeshPositions(const Vertex* vertices, int vertexCount, uint32_t* weld, Vec3* positions){
+    uint32_t capacity = 16;
+    while (capacity < (uint32_t)vertexCount * 2) capacity <<= 1;
+    int* table = malloc(capacity * sizeof(int)); // first vertex at each position
+    memset(table, 0xFF, capacity * sizeof(int));
+
+    int unique = 0;
+    for (int i = 0; i < vertexCount; i++) {
+        Vec3 p = vertices[i].position;
+        uint32_t slot = hash_position(p) & (capacity - 1);
+        while (table[slot] >= 0 && memcmp(&vertices[table[slot]].position, &p, sizeof(Vec3)) != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (table[slot] < 0) {
+            table[slot] = i;
+            if (positions) positions[unique] = p;
+            weld[i] = (uint32_t)unique++;
+        } else {
+            weld[i] = weld[table[slot]];
+        }
+    }
+
+    free(table);
+    return unique;
+}
+
+void ComputeMeshBounds(Mesh* mesh){
+    if (mesh->vertex_count <= 0) {
+        mesh->bounds_min = mesh->bounds_max = (Vec3){0.0f, 0.0f, 0.0f};
+        mesh->bounds_radius = 0.0f;
+        return;
+    }
+
+    Vec3 lo = mesh->vertices[0].position;
+    Vec3 hi = lo;
+    for (int i = 1; i < mesh->vertex_count; i++) {
+        Vec3 p = mesh->vertices[i].position;
+        if (p.x < lo.x) lo.x = p.x;
+        if (p.y < lo.y) lo.y = p.y;
+        if (p.z < lo.z) lo.z = p.z;
+        if (p.x > hi.x) hi.x = p.x;
+        if (p.y > hi.y) hi.y = p.y;
+        if (p.z > hi.z) hi.z = p.z;
+    }
+    mesh->bounds_min = lo;
+    mesh->bounds_max = hi;
+
+    // tighter than half the diagonal for anything that is not a box
+    Vec3 c = {(lo.x + hi.x) * 0.5f, (lo.y + hi.y) * 0.5f, (lo.z + hi.z) * 0.5f};
+    float radius2 = 0.0f;
+    for (int i = 0; i < mesh->vertex_count; i++) {
+        Vec3 p = mesh->vertices[i].position;
+        float d2 = (p.x - c.x) * (p.x - c.x) + (p.y - c.y) * (p.y - c.y) + (p.z - c.z) * (p.z - c.z);
+        if (d2 > radius2) radius2 = d2;
+    }
+    mesh->bounds_radius = sqrtf(radius2);
+}
+
+void FreeMesh(Mesh* mesh){
+    if (mesh->cache) {
+        UnmapFile(mesh->cache);
+        FreeMeshData(mesh->cache);
+    } else {
+        FreeMeshData(mesh->vertices);
+        FreeMeshData(mesh->indices);
+        FreeMeshData(mesh->meshlets);
+    }
+    *mesh = (Mesh){0};
+}
+
+Mesh CreateDefaultCube(Vec3 pos){
+
+    static const Vertex vertices[] = {
+
+        // ===== Front (+Z) =====
+        {{-0.5f,-0.5f, 0.5f}, {0,0,1}, {0,0}},
+        {{ 0.5f,-0.5f, 0.5f}, {0,0,1}, {1,0}},
+        {{ 0.5f, 0.5f, 0.5f}, {0,0,1}, {1,1}},
+        {{-0.5f, 0.5f, 0.5f}, {0,0,1}, {0,1}},
+
+        // ===== Back (-Z) =====
+        {{ 0.5f,-0.5f,-0.5f}, {0,0,-1}, {0,0}},
+        {{-0.5f,-0.5f,-0.5f}, {0,0,-1}, {1,0}},
+        {{-0.5f, 0.5f,-0.5f}, {0,0,-1}, {1,1}},
+        {{ 0.5f, 0.5f,-0.5f}, {0,0,-1}, {0,1}},
+
+        // ===== Left (-X) =====
+        {{-0.5f,-0.5f,-0.5f}, {-1,0,0}, {0,0}},
+        {{-0.5f,-0.5f, 0.5f}, {-1,0,0}, {1,0}},
+        {{-0.5f, 0.5f, 0.5f}, {-1,0,0}, {1,1}},
+        {{-0.5f, 0.5f,-0.5f}, {-1,0,0}, {0,1}},
+
+        // ===== Right (+X) =====
+        {{ 0.5f,-0.5f, 0.5f}, {1,0,0}, {0,0}},
+        {{ 0.5f,-0.5f,-0.5f}, {1,0,0}, {1,0}},
+        {{ 0.5f, 0.5f,-0.5f}, {1,0,0}, {1,1}},
+        {{ 0.5f, 0.5f, 0.5f}, {1,0,0}, {0,1}},
+
+        // ===== Top (+Y) =====
+        {{-0.5f, 0.5f, 0.5f}, {0,1,0}, {0,0}},
+        {{ 0.5f, 0.5f, 0.5f}, {0,1,0}, {1,0}},
+        {{ 0.5f, 0.5f,-0.5f}, {0,1,0}, {1,1}},
+        {{-0.5f, 0.5f,-0.5f}, {0,1,0}, {0,1}},
+
+        // ===== Bottom (-Y) =====
+        {{-0.5f,-0.5f,-0.5f}, {0,-1,0}, {0,0}},
+        {{ 0.5f, 0.5f,-0.5f}, {0,-1,0}, {1,0}},
+        {{ 0.5f,-0.5f, 0.5f}, {0,-1,0}, {1,1}},
+        {{-0.5f,-0.5f, 0.5f}, {0,-1,0}, {0,1}},
+    };
+
+    // two triangles (0,1,2) (0,2,3) per face
+    static const uint16_t indices[] = {
+         0, 1, 2,  0, 2, 3,
+         4, 5, 6,  4, 6, 7,
+         8, 9,10,  8,10,11,
+        12,13,14, 12,14,15,
+        16,17,18, 16,18,19,
+        20,21,22, 20,22,23,
+    };
+
+    Mesh mesh = {
+        .position = pos,
+        .vertices = AllocMeshData(sizeof(vertices), "mesh vertices"),
+        .vertex_count = sizeof(vertices) / sizeof(Vertex),
+        .size = sizeof(vertices),
+        .indices = AllocMeshData(sizeof(indices) + 4, "mesh indices"),
+        .index_count = sizeof(indices) / sizeof(uint16_t),
+        .index_stride = sizeof(uint16_t),
+        .index_size = sizeof(indices),
+        .bounds_min = {-0.5f, -0.5f, -0.5f},
+        .bounds_max = { 0.5f,  0.5f,  0.5f},
+        .bounds_radius = 0.8660254f // sqrt(3) / 2
+    };
+    memcpy(mesh.vertices, vertices, sizeof(vertices));
+    memcpy(mesh.indices, indices, sizeof(indices));
+    return mesh;
+}
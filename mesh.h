@@ -0,0 +1,73 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct Vec3{
+    float x,y,z;
+} Vec3;
+
+typedef struct Vec2{
+    float x,y;
+} Vec2;
+
+typedef struct Vertex{
+    Vec3 position;
+    Vec3 normal;
+    Vec2 uv;
+} Vertex;
+
+typedef struct Mesh{
+    Vec3 position;
+    Vertex* vertices;
+    int vertex_count;
+    size_t size;
+    void* indices;
+    int index_count;
+    int index_stride;
+    size_t index_size;
+    Vec3 bounds_min;
+    Vec3 bounds_max;
+    float bounds_radius; // sphere around the bounds center
+    struct Meshlet* meshlets; // index list order, see BuildMeshMeshlets
+    int meshlet_count;
+    struct MappedFile* cache;
+} Mesh;
+
+// Every array a Mesh owns (vertices, indices, meshlets, the cache mapping)
+// comes from one process-wide pool, so meshes that are loaded and unloaded
+// over and over keep reusing the same blocks. tag names the array for the
+// leak report.
+void* AllocMeshData(size_t size, const char* tag);
+void FreeMeshData(void* ptr);
+struct Pool* MeshDataPool(void);
+
+// Stores a copy of indices in the mesh, as 16-bit when every vertex is
+// addressable with 16 bits and as 32-bit otherwise.
+void SetMeshIndices(Mesh* mesh, const uint32_t* indices, int indexCount);
+
+// Recomputes bounds_min/bounds_max and bounds_radius from the vertex positions.
+void ComputeMeshBounds(Mesh* mesh);
+
+// Gives every vertex a compact id shared by all vertices at exactly the same
+// position, so topology can be walked across uv and normal seams. positions,
+// when not NULL, receives the position of each id. Returns the number of
+// unique positions.
+int WeldMeshPositions(const Vertex* vertices, int vertexCount, uint32_t* weld, Vec3* positions);
+
+// Releases what the loaders returned: pooled arrays, or the mapped cache file
+// when the mesh came from LoadMeshCached.
+void FreeMesh(Mesh* mesh);
+
+// Unit cube centered on the origin, 24 vertices with per-face normals. Owns
+// its arrays like a loaded mesh, release with FreeMesh.
+Mesh CreateDefaultCube(Vec3 pos);
+
+static inline uint32_t GetMeshIndex(const Mesh* mesh, int i){
+    if (mesh->index_stride == 2) return ((const uint16_t*)mesh->indices)[i];
+    return ((const uint32_t*)mesh->indices)[i];
+}
+
+#endif
@@ -0,0 +1,240 @@
+#include "mesh_cache.h"
+#include "file_map.h"
+#include "obj_loader.h"
+#include "mesh_optimize.h"
+#include "meshlet.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_seconds(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline uint64_t rotl64(uint64_t x, int r){
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t mix64(uint64_t h){
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Four independent 64-bit lanes so the loop is not latency bound. Not a
+// cryptographic hash, only meant to notice edited source files.
+uint64_t HashBytes64(const void* data, size_t size){
+    const uint8_t* p = data;
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h[4] = {k, k ^ 0x1234567ull, k ^ 0x89ABCDEull, k ^ (uint64_t)size};
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t w;
+            memcpy(&w, p + i + lane * 8, 8);
+            h[lane] = rotl64(h[lane] ^ (w * k), 29) * 0xBF58476D1CE4E5B9ull;
+        }
+    }
+
+    uint64_t tail[4] = {0, 0, 0, 0};
+    memcpy(tail, p + i, size - i);
+    for (int lane = 0; lane < 4; lane++) {
+        h[lane] = rotl64(h[lane] ^ (tail[lane] * k), 29) * 0xBF58476D1CE4E5B9ull;
+    }
+
+    return mix64(h[0] ^ rotl64(h[1], 17) ^ rotl64(h[2], 31) ^ rotl64(h[3], 47) ^ (uint64_t)size);
+}
+
+static size_t align_up(size_t value, size_t align){
+    return (value + align - 1) & ~(align - 1);
+}
+
+bool WriteMeshCache(const char* cachePath, const Mesh* mesh, uint64_t sourceHash, uint64_t sourceSize, int lodCount, float lodError){
+    MeshCacheHeader header = {
+        .magic = MESH_CACHE_MAGIC,
+        .version = MESH_CACHE_VERSION,
+        .source_hash = sourceHash,
+        .source_size = sourceSize,
+        .vertex_stride = sizeof(Vertex),
+        .vertex_count = (uint32_t)mesh->vertex_count,
+        .index_stride = (uint32_t)mesh->index_stride,
+        .index_count = (uint32_t)mesh->index_count,
+        .bounds_min = mesh->bounds_min,
+        .bounds_max = mesh->bounds_max,
+        .bounds_radius = mesh->bounds_radius,
+        .lod_count = (uint32_t)lodCount,
+        .lod_error = lodError,
+        .meshlet_count = (uint32_t)mesh->meshlet_count
+    };
+    size_t meshletBytes = (size_t)mesh->meshlet_count * sizeof(Meshlet);
+    header.vertex_offset = align_up(sizeof(header), MESH_CACHE_ALIGN);
+    header.index_offset = align_up(header.vertex_offset + mesh->size, MESH_CACHE_ALIGN);
+    header.meshlet_offset = align_up(header.index_offset + mesh->index_size, MESH_CACHE_ALIGN);
+
+    char tmpPath[1024];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", cachePath);
+    FILE* file = fopen(tmpPath, "wb");
+    if(!file){
+        printf("[ERROR]: could not write mesh cache: %s\n", tmpPath);
+        return false;
+    }
+
+    static const uint8_t zeros[MESH_CACHE_ALIGN] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(zeros, 1, header.vertex_offset - sizeof(header), file) == header.vertex_offset - sizeof(header);
+    ok = ok && fwrite(mesh->vertices, 1, mesh->size, file) == mesh->size;
+    ok = ok && fwrite(zeros, 1, header.index_offset - header.vertex_offset - mesh->size, file) == header.index_offset - header.vertex_offset - mesh->size;
+    ok = ok && fwrite(mesh->indices, 1, mesh->index_size, file) == mesh->index_size;
+    ok = ok && fwrite(zeros, 1, header.meshlet_offset - header.index_offset - mesh->index_size, file) == header.meshlet_offset - header.index_offset - mesh->index_size;
+    ok = ok && fwrite(mesh->meshlets, 1, meshletBytes, file) == meshletBytes;
+    ok = (fclose(file) == 0) && ok;
+
+#ifdef _WIN32
+    remove(cachePath);
+#endif
+    if (!ok || rename(tmpPath, cachePath) != 0) {
+        printf("[ERROR]: could not write mesh cache: %s\n", cachePath);
+        remove(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+// Checks the cache against the source and, if it matches, builds a Mesh that
+// points into the mapping. Takes ownership of cache on success.
+static bool open_cache(MappedFile* cache, uint64_t sourceHash, uint64_t sourceSize, Vec3 pos, Mesh* out, MeshCacheHeader* outHeader){
+    MeshCacheHeader header;
+    if (cache->size < sizeof(header)) return false;
+    memcpy(&header, cache->data, sizeof(header));
+
+    if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION) return false;
+    if (header.source_hash != sourceHash || header.source_size != sourceSize) return false;
+    if (header.vertex_stride != sizeof(Vertex)) return false;
+    if (header.index_stride != 2 && header.index_stride != 4) return false;
+
+    uint64_t vertexBytes = (uint64_t)header.vertex_count * sizeof(Vertex);
+    uint64_t indexBytes = (uint64_t)header.index_count * header.index_stride;
+    uint64_t meshletBytes = (uint64_t)header.meshlet_count * sizeof(Meshlet);
+    if (header.vertex_offset % MESH_CACHE_ALIGN || header.index_offset % MESH_CACHE_ALIGN || header.meshlet_offset % MESH_CACHE_ALIGN) return false;
+    if (header.vertex_offset + vertexBytes > cache->size || header.index_offset + indexBytes > cache->size) return false;
+    if (header.meshlet_offset + meshletBytes > cache->size) return false;
+
+    MappedFile* owned = AllocMeshData(sizeof(MappedFile), "mesh cache mapping");
+    *owned = *cache;
+
+    *out = (Mesh){
+        .position = pos,
+        .vertices = (Vertex*)(cache->data + header.vertex_offset),
+        .vertex_count = (int)header.vertex_count,
+        .size = (size_t)vertexBytes,
+        .indices = (void*)(cache->data + header.index_offset),
+        .index_count = (int)header.index_count,
+        .index_stride = (int)header.index_stride,
+        .index_size = (size_t)indexBytes,
+        .bounds_min = header.bounds_min,
+        .bounds_max = header.bounds_max,
+        .bounds_radius = header.bounds_radius,
+        .meshlets = header.meshlet_count ? (Meshlet*)(cache->data + header.meshlet_offset) : NULL,
+        .meshlet_count = (int)header.meshlet_count,
+        .cache = owned
+    };
+    *outHeader = header;
+    return true;
+}
+
+static bool load_cache_file(const char* cachePath, uint64_t sourceHash, uint64_t sourceSize, Vec3 pos, Mesh* out, MeshCacheHeader* outHeader){
+    MappedFile cache;
+    if (!MapFile(cachePath, &cache)) return false;
+    if (!open_cache(&cache, sourceHash, sourceSize, pos, out, outHeader)) {
+        UnmapFile(&cache);
+        return false;
+    }
+    return true;
+}
+
+// Maps lod levels 1..lodCount-1. Fails if any of them is missing or stale.
+static bool load_lod_caches(const char* objPath, uint64_t sourceHash, uint64_t sourceSize, Vec3 pos, MeshLod* lods, int lodCount){
+    for (int i = 1; i < lodCount; i++) {
+        char lodPath[1024];
+        snprintf(lodPath, sizeof(lodPath), "%s.lod%d.meshcache", objPath, i);
+        MeshCacheHeader header;
+        if (!load_cache_file(lodPath, sourceHash, sourceSize, pos, &lods[i].mesh, &header)) {
+            FreeMeshLods(lods, i);
+            return false;
+        }
+        lods[i].error = header.lod_error;
+    }
+    return true;
+}
+
+static void write_lod_caches(const char* objPath, uint64_t sourceHash, uint64_t sourceSize, const MeshLod* lods, int lodCount){
+    for (int i = 1; i < lodCount; i++) {
+        char lodPath[1024];
+        snprintf(lodPath, sizeof(lodPath), "%s.lod%d.meshcache", objPath, i);
+        WriteMeshCache(lodPath, &lods[i].mesh, sourceHash, sourceSize, 0, lods[i].error);
+    }
+}
+
+Mesh LoadMeshCached(const char* objPath, Vec3 pos, MeshLod* lods, int* lodCount, MeshLoadInfo* info){
+    double start = now_seconds();
+
+    char cachePath[1024];
+    snprintf(cachePath, sizeof(cachePath), "%s.meshcache", objPath);
+
+    MappedFile source;
+    if(!MapFile(objPath, &source)){
+        printf("[ERROR]: could not open file: %s\n", objPath);
+        return (Mesh){0};
+    }
+    uint64_t sourceHash = HashBytes64(source.data, source.size);
+    uint64_t sourceSize = source.size;
+
+    Mesh mesh;
+    MeshCacheHeader header;
+    bool hit = load_cache_file(cachePath, sourceHash, sourceSize, pos, &mesh, &header);
+
+    MeshLod chain[MESH_LOD_COUNT];
+    MeshLod* levels = lods ? lods : chain;
+    int levelCount = 1;
+    if (hit) {
+        levelCount = (int)header.lod_count;
+        if (levelCount < 1 || levelCount > MESH_LOD_COUNT) {
+            levelCount = 1;
+        }
+        levels[0] = (MeshLod){ .mesh = mesh, .error = 0.0f };
+        if (lods && !load_lod_caches(objPath, sourceHash, sourceSize, pos, lods, levelCount)) {
+            levelCount = BuildMeshLods(&mesh, lods);
+            for (int i = 1; i < levelCount; i++) BuildMeshMeshlets(&lods[i].mesh);
+            write_lod_caches(objPath, sourceHash, sourceSize, lods, levelCount);
+        }
+    } else {
+        mesh = LoadObjFromMemory(source.data, source.size, pos, 1);
+        OptimizeMesh(&mesh, NULL, NULL);
+        BuildMeshMeshlets(&mesh);
+        levelCount = BuildMeshLods(&mesh, levels);
+        for (int i = 1; i < levelCount; i++) BuildMeshMeshlets(&levels[i].mesh);
+        WriteMeshCache(cachePath, &mesh, sourceHash, sourceSize, levelCount, 0.0f);
+        write_lod_caches(objPath, sourceHash, sourceSize, levels, levelCount);
+        if (!lods) {
+            FreeMeshLods(chain, levelCount);
+        }
+    }
+    UnmapFile(&source);
+
+    if (lodCount) {
+        *lodCount = lods ? levelCount : 1;
+    }
+    if (info) {
+        info->cache_hit = hit;
+        info->seconds = now_seconds() - start;
+    }
+    return mesh;
+}
@@ -0,0 +1,54 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "mesh.h"
+#include "mesh_simplify.h"
+
+// Binary mesh cache written next to each .obj as "<file>.meshcache".
+// It holds the final vertex and index arrays (after OptimizeMesh and
+// BuildMeshMeshlets), the meshlets and bounds, keyed by a hash of the .obj
+// bytes. LOD level i lives in "<file>.lod<i>.meshcache"
+// with the same layout, so every level owns its own mapping. Bump MESH_CACHE_VERSION whenever the Vertex layout or the
+// loader output changes.
+#define MESH_CACHE_MAGIC 0x4843534Du // "MSCH"
+#define MESH_CACHE_VERSION 5
+#define MESH_CACHE_ALIGN 64
+
+typedef struct MeshCacheHeader{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint32_t vertex_stride;
+    uint32_t vertex_count;
+    uint32_t index_stride;
+    uint32_t index_count;
+    Vec3 bounds_min;
+    Vec3 bounds_max;
+    float bounds_radius;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint32_t lod_count; // levels in the chain, base cache only
+    float lod_error;    // MeshLod.error, lod caches only
+    uint32_t meshlet_count;
+    uint64_t meshlet_offset;
+} MeshCacheHeader;
+
+typedef struct MeshLoadInfo{
+    bool cache_hit;
+    double seconds;
+} MeshLoadInfo;
+
+// Loads an .obj through its cache. On a hit the returned vertices and
+// indices point into the mapped cache file (release with FreeMesh). On a miss
+// the .obj is parsed, optimized and split into meshlets, its LOD chain is
+// built and all caches are rewritten. If lods is not NULL it receives the
+// chain like BuildMeshLods (lods[0] aliases the returned mesh, release with
+// FreeMeshLods) and *lodCount the number of levels. info may be NULL.
+Mesh LoadMeshCached(const char* objPath, Vec3 pos, MeshLod* lods, int* lodCount, MeshLoadInfo* info);
+
+bool WriteMeshCache(const char* cachePath, const Mesh* mesh, uint64_t sourceHash, uint64_t sourceSize, int lodCount, float lodError);
+
+uint64_t HashBytes64(const void* data, size_t size);
+
+#endif
@@ -0,0 +1,313 @@
+#include "mesh_optimize.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, int indexCount, int vertexCount, int cacheSize){
+    VertexCacheStats stats = {0};
+    if (indexCount < 3 || vertexCount <= 0) {
+        return stats;
+    }
+
+    // FIFO with timestamps: a vertex is cached if fewer than cacheSize misses
+    // happened since it was last inserted.
+    unsigned* insertedAt = calloc((size_t)vertexCount, sizeof(unsigned));
+    bool* referenced = calloc((size_t)vertexCount, sizeof(bool));
+    unsigned time = (unsigned)cacheSize + 1;
+    int misses = 0, unique = 0;
+
+    for (int i = 0; i < indexCount; i++) {
+        uint32_t v = indices[i];
+        if (time - insertedAt[v] > (unsigned)cacheSize) {
+            insertedAt[v] = time++;
+            misses++;
+        }
+        if (!referenced[v]) {
+            referenced[v] = true;
+            unique++;
+        }
+    }
+
+    stats.acmr = (float)misses / (float)(indexCount / 3);
+    stats.atvr = unique ? (float)misses / (float)unique : 0.0f;
+    free(insertedAt);
+    free(referenced);
+    return stats;
+}
+
+typedef struct TriangleAdjacency{
+    int* offsets;   // vertexCount + 1
+    int* triangles; // indexCount
+} TriangleAdjacency;
+
+static void build_adjacency(TriangleAdjacency* adj, const uint32_t* indices, int indexCount, int vertexCount){
+    adj->offsets = calloc((size_t)vertexCount + 1, sizeof(int));
+    adj->triangles = malloc((size_t)indexCount * sizeof(int) + 1);
+
+    for (int i = 0; i < indexCount; i++) adj->offsets[indices[i] + 1]++;
+    for (int v = 0; v < vertexCount; v++) adj->offsets[v + 1] += adj->offsets[v];
+
+    int* fill = malloc((size_t)vertexCount * sizeof(int) + 1);
+    memcpy(fill, adj->offsets, (size_t)vertexCount * sizeof(int));
+    for (int i = 0; i < indexCount; i++) adj->triangles[fill[indices[i]]++] = i / 3;
+    free(fill);
+}
+
+static void free_adjacency(TriangleAdjacency* adj){
+    free(adj->offsets);
+    free(adj->triangles);
+}
+
+void OptimizeVertexCache(uint32_t* out, const uint32_t* indices, int indexCount, int vertexCount, int cacheSize){
+    int triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount <= 0) {
+        return;
+    }
+
+    TriangleAdjacency adj;
+    build_adjacency(&adj, indices, indexCount, vertexCount);
+
+    int* live = malloc((size_t)vertexCount * sizeof(int));
+    int* cacheTime = calloc((size_t)vertexCount, sizeof(int));
+    bool* emitted = calloc((size_t)triangleCount, sizeof(bool));
+    int* deadEnd = malloc((size_t)indexCount * sizeof(int));
+    int* candidates = malloc((size_t)indexCount * sizeof(int));
+    for (int v = 0; v < vertexCount; v++) live[v] = adj.offsets[v + 1] - adj.offsets[v];
+
+    int deadEndTop = 0, outCount = 0;
+    int timestamp = cacheSize + 1;
+    int cursor = 0;
+    int fan = 0;
+
+    while (fan >= 0) {
+        int candidateCount = 0;
+
+        for (int a = adj.offsets[fan]; a < adj.offsets[fan + 1]; a++) {
+            int t = adj.triangles[a];
+            if (emitted[t]) continue;
+            emitted[t] = true;
+
+            for (int c = 0; c < 3; c++) {
+                int v = (int)indices[t * 3 + c];
+                out[outCount++] = (uint32_t)v;
+                deadEnd[deadEndTop++] = v;
+                candidates[candidateCount++] = v;
+                live[v]--;
+                if (timestamp - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = timestamp++;
+                }
+            }
+        }
+
+        // next fanning vertex: the candidate that stays in cache longest
+        // once its remaining triangles are emitted
+        int best = -1, bestPriority = -1;
+        for (int c = 0; c < candidateCount; c++) {
+            int v = candidates[c];
+            if (live[v] <= 0) continue;
+            int priority = 0;
+            if (timestamp - cacheTime[v] + 2 * live[v] <= cacheSize) {
+                priority = timestamp - cacheTime[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+
+        if (best < 0) {
+            while (deadEndTop > 0) {
+                int v = deadEnd[--deadEndTop];
+                if (live[v] > 0) {
+                    best = v;
+                    break;
+                }
+            }
+        }
+        if (best < 0) {
+            while (cursor < vertexCount) {
+                if (live[cursor] > 0) {
+                    best = cursor;
+                    break;
+                }
+                cursor++;
+            }
+        }
+        fan = best;
+    }
+
+    free(live);
+    free(cacheTime);
+    free(emitted);
+    free(deadEnd);
+    free(candidates);
+    free_adjacency(&adj);
+}
+
+typedef struct OverdrawCluster{
+    int first_triangle;
+    int triangle_count;
+    float sort_key;
+} OverdrawCluster;
+
+static int compare_clusters(const void* a, const void* b){
+    const OverdrawCluster* ca = a;
+    const OverdrawCluster* cb = b;
+    if (ca->sort_key > cb->sort_key) return -1;
+    if (ca->sort_key < cb->sort_key) return 1;
+    return ca->first_triangle - cb->first_triangle;
+}
+
+void OptimizeOverdraw(uint32_t* out, const uint32_t* indices, int indexCount, const Vertex* vertices, int vertexCount, int cacheSize){
+    int triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // a triangle that misses on all three corners starts a new cluster
+    unsigned* insertedAt = calloc((size_t)vertexCount, sizeof(unsigned));
+    unsigned time = (unsigned)cacheSize + 1;
+    OverdrawCluster* clusters = malloc((size_t)triangleCount * sizeof(OverdrawCluster));
+    int clusterCount = 0;
+
+    for (int t = 0; t < triangleCount; t++) {
+        int misses = 0;
+        for (int c = 0; c < 3; c++) {
+            uint32_t v = indices[t * 3 + c];
+            if (time - insertedAt[v] > (unsigned)cacheSize) {
+                insertedAt[v] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3) {
+            clusters[clusterCount++] = (OverdrawCluster){ .first_triangle = t };
+        }
+        clusters[clusterCount - 1].triangle_count++;
+    }
+    free(insertedAt);
+
+    // area weighted centroid of the whole mesh
+    double meshCenter[3] = {0, 0, 0}, meshArea = 0.0;
+    float* triArea = malloc((size_t)triangleCount * sizeof(float));
+    float* triData = malloc((size_t)triangleCount * 6 * sizeof(float)); // center xyz, normal xyz (area weighted)
+    for (int t = 0; t < triangleCount; t++) {
+        Vec3 a = vertices[indices[t * 3 + 0]].position;
+        Vec3 b = vertices[indices[t * 3 + 1]].position;
+        Vec3 c = vertices[indices[t * 3 + 2]].position;
+        float e1x = b.x - a.x, e1y = b.y - a.y, e1z = b.z - a.z;
+        float e2x = c.x - a.x, e2y = c.y - a.y, e2z = c.z - a.z;
+        float nx = e1y * e2z - e1z * e2y;
+        float ny = e1z * e2x - e1x * e2z;
+        float nz = e1x * e2y - e1y * e2x;
+        float area = 0.5f * sqrtf(nx * nx + ny * ny + nz * nz);
+
+        float* d = &triData[t * 6];
+        d[0] = (a.x + b.x + c.x) / 3.0f;
+        d[1] = (a.y + b.y + c.y) / 3.0f;
+        d[2] = (a.z + b.z + c.z) / 3.0f;
+        d[3] = nx * 0.5f;
+        d[4] = ny * 0.5f;
+        d[5] = nz * 0.5f;
+        triArea[t] = area;
+
+        meshCenter[0] += d[0] * area;
+        meshCenter[1] += d[1] * area;
+        meshCenter[2] += d[2] * area;
+        meshArea += area;
+    }
+    if (meshArea > 0.0) {
+        meshCenter[0] /= meshArea;
+        meshCenter[1] /= meshArea;
+        meshCenter[2] /= meshArea;
+    }
+
+    for (int k = 0; k < clusterCount; k++) {
+        OverdrawCluster* cluster = &clusters[k];
+        double center[3] = {0, 0, 0}, normal[3] = {0, 0, 0}, area = 0.0;
+        for (int t = cluster->first_triangle; t < cluster->first_triangle + cluster->triangle_count; t++) {
+            const float* d = &triData[t * 6];
+            center[0] += d[0] * triArea[t];
+            center[1] += d[1] * triArea[t];
+            center[2] += d[2] * triArea[t];
+            normal[0] += d[3];
+            normal[1] += d[4];
+            normal[2] += d[5];
+            area += triArea[t];
+        }
+        if (area > 0.0) {
+            center[0] /= area;
+            center[1] /= area;
+            center[2] /= area;
+        }
+        double len = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (len > 0.0) {
+            normal[0] /= len;
+            normal[1] /= len;
+            normal[2] /= len;
+        }
+        cluster->sort_key = (float)((center[0] - meshCenter[0]) * normal[0] +
+                                    (center[1] - meshCenter[1]) * normal[1] +
+                                    (center[2] - meshCenter[2]) * normal[2]);
+    }
+    free(triArea);
+    free(triData);
+
+    qsort(clusters, (size_t)clusterCount, sizeof(OverdrawCluster), compare_clusters);
+
+    int outCount = 0;
+    for (int k = 0; k < clusterCount; k++) {
+        memcpy(&out[outCount], &indices[clusters[k].first_triangle * 3], (size_t)clusters[k].triangle_count * 3 * sizeof(uint32_t));
+        outCount += clusters[k].triangle_count * 3;
+    }
+    free(clusters);
+}
+
+int OptimizeVertexFetch(Vertex* outVertices, uint32_t* indices, int indexCount, const Vertex* vertices, int vertexCount){
+    uint32_t* remap = malloc((size_t)vertexCount * sizeof(uint32_t) + 1);
+    memset(remap, 0xFF, (size_t)vertexCount * sizeof(uint32_t));
+
+    int next = 0;
+    for (int i = 0; i < indexCount; i++) {
+        uint32_t v = indices[i];
+        if (remap[v] == 0xFFFFFFFFu) {
+            remap[v] = (uint32_t)next;
+            outVertices[next++] = vertices[v];
+        }
+        indices[i] = remap[v];
+    }
+
+    free(remap);
+    return next;
+}
+
+void OptimizeMesh(Mesh* mesh, VertexCacheStats* before, VertexCacheStats* after){
+    int indexCount = mesh->index_count;
+    int vertexCount = mesh->vertex_count;
+    if (indexCount < 3 || vertexCount <= 0) {
+        return;
+    }
+
+    uint32_t* indices = malloc((size_t)indexCount * sizeof(uint32_t));
+    uint32_t* scratch = malloc((size_t)indexCount * sizeof(uint32_t));
+    for (int i = 0; i < indexCount; i++) indices[i] = GetMeshIndex(mesh, i);
+
+    if (before) *before = AnalyzeVertexCache(indices, indexCount, vertexCount, VERTEX_CACHE_SIZE);
+
+    OptimizeVertexCache(scratch, indices, indexCount, vertexCount, VERTEX_CACHE_SIZE);
+    OptimizeOverdraw(indices, scratch, indexCount, mesh->vertices, vertexCount, VERTEX_CACHE_SIZE);
+
+    Vertex* vertices = AllocMeshData((size_t)vertexCount * sizeof(Vertex), "mesh vertices");
+    int newCount = OptimizeVertexFetch(vertices, indices, indexCount, mesh->vertices, vertexCount);
+
+    FreeMeshData(mesh->vertices);
+    mesh->vertices = vertices;
+    mesh->vertex_count = newCount;
+    mesh->size = (size_t)newCount * sizeof(Vertex);
+    SetMeshIndices(mesh, indices, indexCount);
+
+    if (after) *after = AnalyzeVertexCache(indices, indexCount, newCount, VERTEX_CACHE_SIZE);
+
+    free(indices);
+    free(scratch);
+}
@@ -0,0 +1,33 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include "mesh.h"
+
+#define VERTEX_CACHE_SIZE 16
+
+typedef struct VertexCacheStats{
+    float acmr; // cache misses per triangle, 0.5 is ideal for regular grids, 3 is worst
+    float atvr; // cache misses per referenced vertex, 1 is ideal
+} VertexCacheStats;
+
+// Simulates a FIFO post-transform cache of cacheSize entries.
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, int indexCount, int vertexCount, int cacheSize);
+
+// Tipsify (Sander, Nehab, Barczak 2007): reorders triangles for a FIFO cache
+// of cacheSize entries. Writes indexCount indices to out.
+void OptimizeVertexCache(uint32_t* out, const uint32_t* indices, int indexCount, int vertexCount, int cacheSize);
+
+// Splits the cache-optimized order into clusters at cache restarts and sorts
+// the clusters so outward facing ones draw first, which lets early-Z reject
+// more of the fragments behind them. Keeps the order inside each cluster.
+void OptimizeOverdraw(uint32_t* out, const uint32_t* indices, int indexCount, const Vertex* vertices, int vertexCount, int cacheSize);
+
+// Reorders vertices by first use and rewrites the indices to match.
+// Unreferenced vertices are dropped. Returns the new vertex count.
+int OptimizeVertexFetch(Vertex* outVertices, uint32_t* indices, int indexCount, const Vertex* vertices, int vertexCount);
+
+// Runs all three passes on a mesh that owns its arrays (not a mapped cache
+// or static data). before/after may be NULL.
+void OptimizeMesh(Mesh* mesh, VertexCacheStats* before, VertexCacheStats* after);
+
+#endif
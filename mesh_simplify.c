@@ -0,0 +1,357 @@
+#include "mesh_simplify.h"
+#include "mesh_optimize.h"
+#include "mat4.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+const float MeshLodRatios[MESH_LOD_COUNT] = {1.0f, 0.5f, 0.25f, 0.1f};
+
+// Symmetric 4x4 error quadric for planes ax + by + cz + d = 0.
+typedef struct Quadric{
+    double a2, ab, ac, ad;
+    double b2, bc, bd;
+    double c2, cd;
+    double d2;
+} Quadric;
+
+static void quadric_add_plane(Quadric* q, double a, double b, double c, double d, double w){
+    q->a2 += w * a * a; q->ab += w * a * b; q->ac += w * a * c; q->ad += w * a * d;
+    q->b2 += w * b * b; q->bc += w * b * c; q->bd += w * b * d;
+    q->c2 += w * c * c; q->cd += w * c * d;
+    q->d2 += w * d * d;
+}
+
+static void quadric_add(Quadric* q, const Quadric* o){
+    q->a2 += o->a2; q->ab += o->ab; q->ac += o->ac; q->ad += o->ad;
+    q->b2 += o->b2; q->bc += o->bc; q->bd += o->bd;
+    q->c2 += o->c2; q->cd += o->cd;
+    q->d2 += o->d2;
+}
+
+static double quadric_eval(const Quadric* q, Vec3 p){
+    double x = p.x, y = p.y, z = p.z;
+    double e = q->a2 * x * x + 2.0 * q->ab * x * y + 2.0 * q->ac * x * z + 2.0 * q->ad * x
+             + q->b2 * y * y + 2.0 * q->bc * y * z + 2.0 * q->bd * y
+             + q->c2 * z * z + 2.0 * q->cd * z
+             + q->d2;
+    return e > 0.0 ? e : 0.0;
+}
+
+typedef struct Collapse{
+    uint32_t from, to;
+    double cost;
+} Collapse;
+
+static int compare_collapses(const void* a, const void* b){
+    double ca = ((const Collapse*)a)->cost, cb = ((const Collapse*)b)->cost;
+    return (ca > cb) - (ca < cb);
+}
+
+// true if moving 'from' onto 'to' flips or collapses any triangle around
+// 'from' that survives the collapse
+static bool collapse_flips(const uint32_t* tris, const int* adjOffsets, const int* adjTris, const Vec3* positions, uint32_t from, uint32_t to){
+    for (int a = adjOffsets[from]; a < adjOffsets[from + 1]; a++) {
+        const uint32_t* t = &tris[adjTris[a] * 3];
+        if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2]) continue;
+        if (t[0] == to || t[1] == to || t[2] == to) continue;
+
+        Vec3 p[3], q[3];
+        for (int c = 0; c < 3; c++) {
+            p[c] = positions[t[c]];
+            q[c] = t[c] == from ? positions[to] : p[c];
+        }
+        Vec3 before = Vec3Cross(Vec3Sub(p[1], p[0]), Vec3Sub(p[2], p[0]));
+        Vec3 after = Vec3Cross(Vec3Sub(q[1], q[0]), Vec3Sub(q[2], q[0]));
+        if (Vec3Dot(before, after) <= 0.0f) return true;
+    }
+    return false;
+}
+
+// Link condition: the edge may only collapse if the vertices shared by the
+// one-rings of 'from' and 'to' are exactly the apexes of the triangles on the
+// edge. Anything else pinches the surface into non-manifold geometry.
+static bool collapse_keeps_manifold(const uint32_t* tris, const int* adjOffsets, const int* adjTris, uint32_t from, uint32_t to){
+    int edgeTriangles = 0, shared = 0;
+    for (int a = adjOffsets[from]; a < adjOffsets[from + 1]; a++) {
+        const uint32_t* t = &tris[adjTris[a] * 3];
+        if (t[0] == to || t[1] == to || t[2] == to) edgeTriangles++;
+    }
+    for (int a = adjOffsets[from]; a < adjOffsets[from + 1]; a++) {
+        const uint32_t* t = &tris[adjTris[a] * 3];
+        for (int c = 0; c < 3; c++) {
+            uint32_t n = t[c];
+            if (n == from || n == to) continue;
+            // count each neighbour once: only at its first appearance
+            bool seen = false;
+            for (int b = adjOffsets[from]; b < a && !seen; b++) {
+                const uint32_t* o = &tris[adjTris[b] * 3];
+                seen = (o[0] == n || o[1] == n || o[2] == n);
+            }
+            for (int d = 0; d < c && !seen; d++) seen = (t[d] == n);
+            if (seen) continue;
+            for (int b = adjOffsets[to]; b < adjOffsets[to + 1]; b++) {
+                const uint32_t* o = &tris[adjTris[b] * 3];
+                if (o[0] == n || o[1] == n || o[2] == n) {
+                    shared++;
+                    break;
+                }
+            }
+        }
+    }
+    return shared == edgeTriangles;
+}
+
+Mesh SimplifyMesh(const Mesh* mesh, int targetIndexCount, float targetError, float* resultError){
+    int vertexCount = mesh->vertex_count;
+    int indexCount = mesh->index_count;
+    int triangleCount = indexCount / 3;
+
+    uint32_t* weld = malloc((size_t)vertexCount * sizeof(uint32_t) + 4);
+    Vec3* positions = malloc((size_t)vertexCount * sizeof(Vec3) + sizeof(Vec3));
+    int positionCount = WeldMeshPositions(mesh->vertices, vertexCount, weld, positions);
+
+    uint32_t* tris = malloc((size_t)indexCount * sizeof(uint32_t) + 4);
+    uint32_t* corners = malloc((size_t)indexCount * sizeof(uint32_t) + 4); // source vertex per corner
+    for (int i = 0; i < indexCount; i++) {
+        corners[i] = GetMeshIndex(mesh, i);
+        tris[i] = weld[corners[i]];
+    }
+
+    // plane quadrics, plus perpendicular planes along open borders so the
+    // outline of the mesh does not shrink
+    Quadric* quadrics = calloc((size_t)positionCount, sizeof(Quadric));
+    for (int t = 0; t < triangleCount; t++) {
+        Vec3 p0 = positions[tris[t * 3]], p1 = positions[tris[t * 3 + 1]], p2 = positions[tris[t * 3 + 2]];
+        Vec3 n = Vec3Cross(Vec3Sub(p1, p0), Vec3Sub(p2, p0));
+        float len = sqrtf(Vec3Dot(n, n));
+        if (len <= 0.0f) continue;
+        n = (Vec3){n.x / len, n.y / len, n.z / len};
+        double d = -Vec3Dot(n, p0);
+        for (int c = 0; c < 3; c++) quadric_add_plane(&quadrics[tris[t * 3 + c]], n.x, n.y, n.z, d, 1.0);
+    }
+
+    int* adjOffsets = calloc((size_t)positionCount + 1, sizeof(int));
+    int* adjTris = malloc((size_t)indexCount * sizeof(int) + 4);
+    for (int i = 0; i < indexCount; i++) adjOffsets[tris[i] + 1]++;
+    for (int v = 0; v < positionCount; v++) adjOffsets[v + 1] += adjOffsets[v];
+    int* fill = malloc((size_t)positionCount * sizeof(int) + 4);
+    memcpy(fill, adjOffsets, (size_t)positionCount * sizeof(int));
+    for (int i = 0; i < indexCount; i++) adjTris[fill[tris[i]]++] = i / 3;
+
+    for (int t = 0; t < triangleCount; t++) {
+        for (int e = 0; e < 3; e++) {
+            uint32_t a = tris[t * 3 + e], b = tris[t * 3 + (e + 1) % 3];
+            bool shared = false;
+            for (int k = adjOffsets[b]; k < adjOffsets[b + 1] && !shared; k++) {
+                const uint32_t* o = &tris[adjTris[k] * 3];
+                if (adjTris[k] == t) continue;
+                shared = (o[0] == a || o[1] == a || o[2] == a);
+            }
+            if (shared) continue;
+
+            Vec3 pa = positions[a], pb = positions[b];
+            Vec3 edge = Vec3Sub(pb, pa);
+            Vec3 n = Vec3Cross(Vec3Sub(positions[tris[t * 3 + 1]], positions[tris[t * 3]]), Vec3Sub(positions[tris[t * 3 + 2]], positions[tris[t * 3]]));
+            Vec3 side = Vec3Cross(edge, n);
+            float len = sqrtf(Vec3Dot(side, side));
+            if (len <= 0.0f) continue;
+            side = (Vec3){side.x / len, side.y / len, side.z / len};
+            double d = -Vec3Dot(side, pa);
+            quadric_add_plane(&quadrics[a], side.x, side.y, side.z, d, 10.0);
+            quadric_add_plane(&quadrics[b], side.x, side.y, side.z, d, 10.0);
+        }
+    }
+
+    uint32_t* remap = malloc((size_t)positionCount * sizeof(uint32_t) + 4);
+    bool* locked = malloc((size_t)positionCount + 1);
+    Collapse* collapses = malloc((size_t)indexCount * sizeof(Collapse) + sizeof(Collapse));
+    for (int v = 0; v < positionCount; v++) remap[v] = (uint32_t)v;
+
+    double maxCost = (double)targetError * targetError;
+    double worst = 0.0;
+    double passScale = 1.5;
+    // welding can leave triangles with repeated corners, which no pass
+    // visits, so they must not count towards the target
+    int liveTriangles = 0;
+    for (int t = 0; t < triangleCount; t++) {
+        const uint32_t* tri = &tris[t * 3];
+        if (tri[0] != tri[1] && tri[1] != tri[2] && tri[0] != tri[2]) liveTriangles++;
+    }
+
+    while (liveTriangles * 3 > targetIndexCount) {
+        // rebuild adjacency of the live triangles
+        memset(adjOffsets, 0, ((size_t)positionCount + 1) * sizeof(int));
+        for (int t = 0; t < triangleCount; t++) {
+            const uint32_t* tri = &tris[t * 3];
+            if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) continue;
+            for (int c = 0; c < 3; c++) adjOffsets[tri[c] + 1]++;
+        }
+        for (int v = 0; v < positionCount; v++) adjOffsets[v + 1] += adjOffsets[v];
+        memcpy(fill, adjOffsets, (size_t)positionCount * sizeof(int));
+        for (int t = 0; t < triangleCount; t++) {
+            const uint32_t* tri = &tris[t * 3];
+            if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) continue;
+            for (int c = 0; c < 3; c++) adjTris[fill[tri[c]]++] = t;
+        }
+
+        // cheapest direction of every edge; each edge shows up once per
+        // adjacent triangle, duplicates are harmless
+        int collapseCount = 0;
+        for (int t = 0; t < triangleCount; t++) {
+            const uint32_t* tri = &tris[t * 3];
+            if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) continue;
+            for (int e = 0; e < 3; e++) {
+                uint32_t a = tri[e], b = tri[(e + 1) % 3];
+                if (a > b) continue;
+                Quadric q = quadrics[a];
+                quadric_add(&q, &quadrics[b]);
+                double ab = quadric_eval(&q, positions[b]);
+                double ba = quadric_eval(&q, positions[a]);
+                collapses[collapseCount++] = ab <= ba ? (Collapse){a, b, ab} : (Collapse){b, a, ba};
+            }
+        }
+        if (collapseCount == 0) break;
+        qsort(collapses, (size_t)collapseCount, sizeof(Collapse), compare_collapses);
+
+        memset(locked, 0, (size_t)positionCount);
+        int budget = (liveTriangles * 3 - targetIndexCount) / 6 + 1;
+        int applied = 0;
+
+        // collapses skipped for locking come back next pass, so only take
+        // the ones that would also have made the cut without locks
+        double passCost = collapses[budget < collapseCount ? budget : collapseCount - 1].cost * passScale;
+        if (passCost > maxCost) passCost = maxCost;
+        for (int c = 0; c < collapseCount && applied < budget; c++) {
+            Collapse col = collapses[c];
+            if (col.cost > passCost) break;
+            if (locked[col.from] || locked[col.to]) continue;
+            if (!collapse_keeps_manifold(tris, adjOffsets, adjTris, col.from, col.to)) continue;
+            if (collapse_flips(tris, adjOffsets, adjTris, positions, col.from, col.to)) continue;
+
+            // everything around 'from' changes shape, so keep it out of the
+            // rest of this pass
+            for (int a = adjOffsets[col.from]; a < adjOffsets[col.from + 1]; a++) {
+                const uint32_t* tri = &tris[adjTris[a] * 3];
+                locked[tri[0]] = locked[tri[1]] = locked[tri[2]] = true;
+            }
+            remap[col.from] = col.to;
+            quadric_add(&quadrics[col.to], &quadrics[col.from]);
+            if (col.cost > worst) worst = col.cost;
+            applied++;
+        }
+        if (applied == 0) {
+            // the cheap edges are all blocked by flips or the link
+            // condition, widen the window before giving up
+            if (passCost >= maxCost) break;
+            passScale *= 4.0;
+            continue;
+        }
+        passScale = 1.5;
+
+        liveTriangles = 0;
+        for (int t = 0; t < triangleCount; t++) {
+            uint32_t* tri = &tris[t * 3];
+            for (int c = 0; c < 3; c++) {
+                while (remap[tri[c]] != tri[c]) tri[c] = remap[tri[c]];
+            }
+            if (tri[0] != tri[1] && tri[1] != tri[2] && tri[0] != tri[2]) liveTriangles++;
+        }
+    }
+
+    // emit the surviving triangles; each source vertex becomes one output
+    // vertex moved to the position it collapsed onto
+    uint32_t* vertexMap = malloc((size_t)vertexCount * sizeof(uint32_t) + 4);
+    memset(vertexMap, 0xFF, (size_t)vertexCount * sizeof(uint32_t));
+    Vertex* outVertices = AllocMeshData((size_t)vertexCount * sizeof(Vertex) + sizeof(Vertex), "mesh vertices");
+    uint32_t* outIndices = malloc((size_t)indexCount * sizeof(uint32_t) + 4);
+    int outVertexCount = 0, outIndexCount = 0;
+
+    for (int t = 0; t < triangleCount; t++) {
+        const uint32_t* tri = &tris[t * 3];
+        if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) continue;
+        for (int c = 0; c < 3; c++) {
+            uint32_t src = corners[t * 3 + c];
+            if (vertexMap[src] == 0xFFFFFFFFu) {
+                vertexMap[src] = (uint32_t)outVertexCount;
+                Vertex v = mesh->vertices[src];
+                v.position = positions[tri[c]];
+                outVertices[outVertexCount++] = v;
+            }
+            outIndices[outIndexCount++] = vertexMap[src];
+        }
+    }
+
+    Mesh out = {
+        .position = mesh->position,
+        .vertices = outVertices,
+        .vertex_count = outVertexCount,
+        .size = (size_t)outVertexCount * sizeof(Vertex)
+    };
+    SetMeshIndices(&out, outIndices, outIndexCount);
+    ComputeMeshBounds(&out);
+    OptimizeMesh(&out, NULL, NULL);
+
+    if (resultError) *resultError = (float)sqrt(worst);
+
+    free(weld);
+    free(positions);
+    free(tris);
+    free(corners);
+    free(quadrics);
+    free(adjOffsets);
+    free(adjTris);
+    free(fill);
+    free(remap);
+    free(locked);
+    free(collapses);
+    free(vertexMap);
+    free(outIndices);
+    return out;
+}
+
+int BuildMeshLods(const Mesh* mesh, MeshLod* lods){
+    float extent = fmaxf(mesh->bounds_max.x - mesh->bounds_min.x,
+                   fmaxf(mesh->bounds_max.y - mesh->bounds_min.y, mesh->bounds_max.z - mesh->bounds_min.z));
+    float maxError = extent * MESH_LOD_MAX_ERROR;
+
+    lods[0] = (MeshLod){ .mesh = *mesh, .error = 0.0f };
+    int count = 1;
+    for (int i = 1; i < MESH_LOD_COUNT; i++) {
+        int target = ((int)(mesh->index_count / 3 * MeshLodRatios[i])) * 3;
+
+        // every level starts from the base mesh so its error is measured
+        // against the original surface rather than piling up level by level
+        float error = 0.0f;
+        Mesh lod = SimplifyMesh(mesh, target, maxError, &error);
+
+        // stop once simplification stalls on the error budget, a level that
+        // is not meaningfully smaller only costs memory
+        if (lod.index_count >= lods[count - 1].mesh.index_count * 9 / 10) {
+            FreeMesh(&lod);
+            break;
+        }
+        lods[count++] = (MeshLod){ .mesh = lod, .error = error };
+    }
+    return count;
+}
+
+void FreeMeshLods(MeshLod* lods, int lodCount){
+    for (int i = 1; i < lodCount; i++) {
+        FreeMesh(&lods[i].mesh);
+    }
+}
+
+int SelectMeshLod(const MeshLod* lods, int lodCount, float viewDistance, float projScaleY, float screenHeight, float maxPixelError){
+    if (viewDistance <= 0.0f) {
+        return 0;
+    }
+    float pixelsPerUnit = projScaleY * screenHeight * 0.5f / viewDistance;
+
+    int selected = 0;
+    for (int i = 1; i < lodCount; i++) {
+        if (lods[i].error * pixelsPerUnit <= maxPixelError) selected = i;
+    }
+    return selected;
+}
@@ -0,0 +1,34 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include "mesh.h"
+
+#define MESH_LOD_COUNT 4
+#define MESH_LOD_MAX_ERROR 0.05f // relative to the largest bounds extent
+
+// Triangle ratios of lods[1..] relative to the base mesh.
+extern const float MeshLodRatios[MESH_LOD_COUNT];
+
+typedef struct MeshLod{
+    Mesh mesh;
+    float error; // object space error bound, 0 for the base mesh
+} MeshLod;
+
+// Quadric error metric simplification with half-edge collapses on the
+// position-welded mesh. Stops at targetIndexCount or when the next collapse
+// would exceed targetError (object space). Every output corner keeps the
+// normal and uv of its source vertex. The result owns its arrays.
+Mesh SimplifyMesh(const Mesh* mesh, int targetIndexCount, float targetError, float* resultError);
+
+// lods[0] aliases the base mesh, the other levels are simplified from it at
+// MeshLodRatios and owned by the chain. Levels that cannot get meaningfully
+// smaller within MESH_LOD_MAX_ERROR are dropped. Returns the number of levels.
+int BuildMeshLods(const Mesh* mesh, MeshLod* lods);
+void FreeMeshLods(MeshLod* lods, int lodCount);
+
+// Picks the coarsest level whose error projects to at most maxPixelError
+// pixels at the given view space distance. projScaleY is proj[1][1] of the
+// camera's perspective matrix.
+int SelectMeshLod(const MeshLod* lods, int lodCount, float viewDistance, float projScaleY, float screenHeight, float maxPixelError);
+
+#endif
@@ -0,0 +1,336 @@
+#include "meshlet.h"
+#include "mesh_optimize.h"
+#include "mat4.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Growth prefers triangles that face the way the cluster already does, at
+// this many new vertices' worth of cost for a triangle at right angles. It
+// only refuses one that would push the cone past what compute_bounds can
+// still cull, MESHLET_CONE_MIN_DOT from the axis.
+#define MESHLET_CONE_WEIGHT 2.0f
+#define MESHLET_CONE_MIN_DOT 0.1f
+
+// When no neighbour fits, for example at the end of a disconnected part,
+// growth continues with the nearest unused triangle among the next this
+// many in input order, if it lies within the expected meshlet radius.
+#define MESHLET_NEAREST_WINDOW 256
+
+typedef struct MeshletBuilder{
+    const uint32_t* indices;
+    const Vec3* normals; // unit triangle normals, zero for degenerate ones
+    const int* adj_offsets; // triangles around each welded position
+    const int* adj_triangles;
+    const uint32_t* weld;
+    bool* used;
+    uint32_t* stamp; // per vertex, the id of the meshlet that holds it
+    uint32_t* queued; // per triangle, the id of the meshlet it is a candidate of
+    int* candidates;
+    int candidate_count;
+    uint32_t id; // meshlet index + 1
+    int vertex_count;
+    int triangle_count;
+    Vec3 normal_sum;
+    const Vec3* centroids; // per triangle
+    Vec3 centroid_sum;
+    float reach; // expected meshlet radius
+} MeshletBuilder;
+
+static int new_vertices(const MeshletBuilder* b, int t){
+    const uint32_t* tri = &b->indices[t * 3];
+    int extra = 0;
+    for (int c = 0; c < 3; c++) {
+        if (b->stamp[tri[c]] == b->id) continue;
+        if (c > 0 && tri[c] == tri[0]) continue;
+        if (c > 1 && tri[c] == tri[1]) continue;
+        extra++;
+    }
+    return extra;
+}
+
+static void add_triangle(MeshletBuilder* b, int t, uint32_t* out){
+    const uint32_t* tri = &b->indices[t * 3];
+    b->used[t] = true;
+    for (int c = 0; c < 3; c++) {
+        out[c] = tri[c];
+        if (b->stamp[tri[c]] == b->id) continue;
+        b->stamp[tri[c]] = b->id;
+        b->vertex_count++;
+
+        uint32_t p = b->weld[tri[c]];
+        for (int a = b->adj_offsets[p]; a < b->adj_offsets[p + 1]; a++) {
+            int n = b->adj_triangles[a];
+            if (b->used[n] || b->queued[n] == b->id) continue;
+            b->queued[n] = b->id;
+            b->candidates[b->candidate_count++] = n;
+        }
+    }
+    Vec3 n = b->normals[t];
+    b->normal_sum = (Vec3){b->normal_sum.x + n.x, b->normal_sum.y + n.y, b->normal_sum.z + n.z};
+    Vec3 c = b->centroids[t];
+    b->centroid_sum = (Vec3){b->centroid_sum.x + c.x, b->centroid_sum.y + c.y, b->centroid_sum.z + c.z};
+    b->triangle_count++;
+}
+
+static Vec3 cluster_axis(const MeshletBuilder* b, float* len){
+    *len = sqrtf(Vec3Dot(b->normal_sum, b->normal_sum));
+    return *len > 0.0f ? (Vec3){b->normal_sum.x / *len, b->normal_sum.y / *len, b->normal_sum.z / *len} : (Vec3){0.0f, 0.0f, 0.0f};
+}
+
+// New vertices plus the weighted turn away from the cluster's average
+// normal, lowest first. Drops used candidates on the way; -1 when nothing
+// fits the limits.
+static int pick_candidate(MeshletBuilder* b){
+    float len;
+    Vec3 axis = cluster_axis(b, &len);
+
+    int best = -1, kept = 0;
+    float bestCost = 1e30f;
+    for (int i = 0; i < b->candidate_count; i++) {
+        int t = b->candidates[i];
+        if (b->used[t]) continue;
+        b->candidates[kept++] = t;
+
+        int extra = new_vertices(b, t);
+        if (b->vertex_count + extra > MESHLET_MAX_VERTICES) continue;
+        float facing = len > 0.0f ? Vec3Dot(b->normals[t], axis) : 1.0f;
+        if (facing < MESHLET_CONE_MIN_DOT) continue;
+        float cost = (float)extra + (1.0f - facing) * MESHLET_CONE_WEIGHT;
+        if (cost < bestCost) {
+            bestCost = cost;
+            best = t;
+        }
+    }
+    b->candidate_count = kept;
+    return best;
+}
+
+// The unused triangle closest to the cluster's center among the window
+// after seed, with the same cone weight; -1 when none is within reach.
+static int pick_nearest(MeshletBuilder* b, int seed, int triangleCount){
+    float len;
+    Vec3 axis = cluster_axis(b, &len);
+    float inv = 1.0f / (float)b->triangle_count;
+    Vec3 center = {b->centroid_sum.x * inv, b->centroid_sum.y * inv, b->centroid_sum.z * inv};
+    int best = -1;
+    float bestDistance = b->reach * b->reach;
+    int end = seed + MESHLET_NEAREST_WINDOW < triangleCount ? seed + MESHLET_NEAREST_WINDOW : triangleCount;
+    for (int t = seed; t < end; t++) {
+        if (b->used[t]) continue;
+        if (b->vertex_count + new_vertices(b, t) > MESHLET_MAX_VERTICES) continue;
+        float facing = len > 0.0f ? Vec3Dot(b->normals[t], axis) : 1.0f;
+        if (facing < MESHLET_CONE_MIN_DOT) continue;
+        Vec3 d = Vec3Sub(b->centroids[t], center);
+        float distance = Vec3Dot(d, d) * (1.0f + (1.0f - facing) * MESHLET_CONE_WEIGHT);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = t;
+        }
+    }
+    return best;
+}
+
+static void compute_bounds(Meshlet* m, const uint32_t* indices, const Vertex* vertices, const Vec3* normals, const uint32_t* triangles){
+    const uint32_t* tri = &indices[m->first_index];
+    int cornerCount = (int)m->triangle_count * 3;
+
+    Vec3 lo = vertices[tri[0]].position, hi = lo;
+    for (int i = 1; i < cornerCount; i++) {
+        Vec3 p = vertices[tri[i]].position;
+        lo = (Vec3){fminf(lo.x, p.x), fminf(lo.y, p.y), fminf(lo.z, p.z)};
+        hi = (Vec3){fmaxf(hi.x, p.x), fmaxf(hi.y, p.y), fmaxf(hi.z, p.z)};
+    }
+    m->center = (Vec3){(lo.x + hi.x) * 0.5f, (lo.y + hi.y) * 0.5f, (lo.z + hi.z) * 0.5f};
+    float radius2 = 0.0f;
+    for (int i = 0; i < cornerCount; i++) {
+        Vec3 d = Vec3Sub(vertices[tri[i]].position, m->center);
+        radius2 = fmaxf(radius2, Vec3Dot(d, d));
+    }
+    m->radius = sqrtf(radius2);
+
+    Vec3 sum = {0.0f, 0.0f, 0.0f};
+    for (uint32_t t = 0; t < m->triangle_count; t++) {
+        Vec3 n = normals[triangles[t]];
+        sum = (Vec3){sum.x + n.x, sum.y + n.y, sum.z + n.z};
+    }
+    float len = sqrtf(Vec3Dot(sum, sum));
+    m->cone_axis = len > 0.0f ? (Vec3){sum.x / len, sum.y / len, sum.z / len} : (Vec3){0.0f, 0.0f, 1.0f};
+
+    // the cone test is only worth it while the normals stay well inside a
+    // half space
+    float minDot = len > 0.0f ? 1.0f : -1.0f;
+    for (uint32_t t = 0; t < m->triangle_count; t++) {
+        Vec3 n = normals[triangles[t]];
+        if (Vec3Dot(n, n) > 0.0f) minDot = fminf(minDot, Vec3Dot(n, m->cone_axis));
+    }
+    m->cone_cutoff = minDot > MESHLET_CONE_MIN_DOT ? sqrtf(1.0f - minDot * minDot) : 1.0f;
+}
+
+int BuildMeshlets(Meshlet* out, uint32_t* outIndices, const uint32_t* indices, int indexCount, const Vertex* vertices, int vertexCount){
+    int triangleCount = indexCount / 3;
+    if (triangleCount <= 0 || vertexCount <= 0) {
+        return 0;
+    }
+
+    uint32_t* weld = malloc((size_t)vertexCount * sizeof(uint32_t));
+    int positionCount = WeldMeshPositions(vertices, vertexCount, weld, NULL);
+
+    int* adjOffsets = calloc((size_t)positionCount + 1, sizeof(int));
+    int* adjTriangles = malloc((size_t)triangleCount * 3 * sizeof(int));
+    for (int i = 0; i < triangleCount * 3; i++) adjOffsets[weld[indices[i]] + 1]++;
+    for (int p = 0; p < positionCount; p++) adjOffsets[p + 1] += adjOffsets[p];
+    int* fill = malloc((size_t)positionCount * sizeof(int));
+    memcpy(fill, adjOffsets, (size_t)positionCount * sizeof(int));
+    for (int i = 0; i < triangleCount * 3; i++) adjTriangles[fill[weld[indices[i]]]++] = i / 3;
+    free(fill);
+
+    Vec3* normals = malloc((size_t)triangleCount * sizeof(Vec3));
+    for (int t = 0; t < triangleCount; t++) {
+        Vec3 a = vertices[indices[t * 3]].position;
+        Vec3 n = Vec3Cross(Vec3Sub(vertices[indices[t * 3 + 1]].position, a), Vec3Sub(vertices[indices[t * 3 + 2]].position, a));
+        float len = sqrtf(Vec3Dot(n, n));
+        normals[t] = len > 0.0f ? (Vec3){n.x / len, n.y / len, n.z / len} : (Vec3){0.0f, 0.0f, 0.0f};
+    }
+
+    Vec3* centroids = malloc((size_t)triangleCount * sizeof(Vec3));
+    for (int t = 0; t < triangleCount; t++) {
+        Vec3 a = vertices[indices[t * 3]].position;
+        Vec3 p1 = vertices[indices[t * 3 + 1]].position;
+        Vec3 p2 = vertices[indices[t * 3 + 2]].position;
+        centroids[t] = (Vec3){(a.x + p1.x + p2.x) / 3.0f, (a.y + p1.y + p2.y) / 3.0f, (a.z + p1.z + p2.z) / 3.0f};
+    }
+    // a full meshlet's share of the mesh's extent
+    Vec3 lo = vertices[0].position, hi = lo;
+    for (int i = 1; i < vertexCount; i++) {
+        Vec3 p = vertices[i].position;
+        lo = (Vec3){fminf(lo.x, p.x), fminf(lo.y, p.y), fminf(lo.z, p.z)};
+        hi = (Vec3){fmaxf(hi.x, p.x), fmaxf(hi.y, p.y), fmaxf(hi.z, p.z)};
+    }
+    Vec3 extent = Vec3Sub(hi, lo);
+    float reach = sqrtf(Vec3Dot(extent, extent)) * sqrtf((float)MESHLET_MAX_TRIANGLES / (float)triangleCount);
+
+    MeshletBuilder b = {
+        .indices = indices,
+        .normals = normals,
+        .adj_offsets = adjOffsets,
+        .adj_triangles = adjTriangles,
+        .weld = weld,
+        .used = calloc((size_t)triangleCount, sizeof(bool)),
+        .stamp = calloc((size_t)vertexCount, sizeof(uint32_t)),
+        .queued = calloc((size_t)triangleCount, sizeof(uint32_t)),
+        .candidates = malloc((size_t)triangleCount * sizeof(int)),
+        .centroids = centroids,
+        .reach = reach
+    };
+    // source triangle of every output triangle, for the cone pass
+    uint32_t* order = malloc((size_t)triangleCount * sizeof(uint32_t));
+
+    int meshletCount = 0, emitted = 0, seed = 0;
+    while (emitted < triangleCount) {
+        while (b.used[seed]) seed++;
+
+        Meshlet* m = &out[meshletCount++];
+        *m = (Meshlet){ .first_index = (uint32_t)emitted * 3 };
+        b.id = (uint32_t)meshletCount;
+        b.vertex_count = 0;
+        b.triangle_count = 0;
+        b.candidate_count = 0;
+        b.normal_sum = (Vec3){0.0f, 0.0f, 0.0f};
+        b.centroid_sum = (Vec3){0.0f, 0.0f, 0.0f};
+
+        int t = seed;
+        while (t >= 0) {
+            order[emitted] = (uint32_t)t;
+            add_triangle(&b, t, &outIndices[emitted * 3]);
+            emitted++;
+            if (b.triangle_count == MESHLET_MAX_TRIANGLES) break;
+            t = pick_candidate(&b);
+            if (t < 0) {
+                while (seed < triangleCount - 1 && b.used[seed]) seed++;
+                t = pick_nearest(&b, seed, triangleCount);
+            }
+        }
+
+        m->triangle_count = (uint32_t)b.triangle_count;
+        m->vertex_count = (uint32_t)b.vertex_count;
+        compute_bounds(m, outIndices, vertices, normals, &order[m->first_index / 3]);
+    }
+
+    free(weld);
+    free(adjOffsets);
+    free(adjTriangles);
+    free(normals);
+    free(centroids);
+    free(b.used);
+    free(b.stamp);
+    free(b.queued);
+    free(b.candidates);
+    free(order);
+    return meshletCount;
+}
+
+void BuildMeshMeshlets(Mesh* mesh){
+    int indexCount = mesh->index_count;
+    int vertexCount = mesh->vertex_count;
+    if (indexCount < 3 || vertexCount <= 0) {
+        return;
+    }
+
+    uint32_t* indices = malloc((size_t)indexCount * sizeof(uint32_t));
+    uint32_t* ordered = malloc((size_t)indexCount * sizeof(uint32_t));
+    for (int i = 0; i < indexCount; i++) indices[i] = GetMeshIndex(mesh, i);
+
+    Meshlet* meshlets = malloc((size_t)(indexCount / 3) * sizeof(Meshlet));
+    int meshletCount = BuildMeshlets(meshlets, ordered, indices, indexCount, mesh->vertices, vertexCount);
+
+    // vertex positions do not change, so the meshlet bounds stay valid
+    Vertex* vertices = AllocMeshData((size_t)vertexCount * sizeof(Vertex), "mesh vertices");
+    int newCount = OptimizeVertexFetch(vertices, ordered, indexCount, mesh->vertices, vertexCount);
+
+    FreeMeshData(mesh->vertices);
+    mesh->vertices = vertices;
+    mesh->vertex_count = newCount;
+    mesh->size = (size_t)newCount * sizeof(Vertex);
+    SetMeshIndices(mesh, ordered, indexCount);
+
+    FreeMeshData(mesh->meshlets);
+    mesh->meshlets = AllocMeshData((size_t)meshletCount * sizeof(Meshlet), "mesh meshlets");
+    memcpy(mesh->meshlets, meshlets, (size_t)meshletCount * sizeof(Meshlet));
+    mesh->meshlet_count = meshletCount;
+
+    free(meshlets);
+    free(indices);
+    free(ordered);
+}
+
+int CullMeshlets(const Meshlet* meshlets, int count, const Frustum* frustum, Vec3 camera, MeshletDraw* draws, MeshletCullStats* stats){
+    int drawCount = 0, frustumCulled = 0, backfaceCulled = 0;
+    uint32_t drawEnd = 0;
+    for (int i = 0; i < count; i++) {
+        const Meshlet* m = &meshlets[i];
+        if (!SphereInFrustum(frustum, m->center, m->radius)) {
+            frustumCulled++;
+            continue;
+        }
+        Vec3 d = Vec3Sub(m->center, camera);
+        if (Vec3Dot(d, m->cone_axis) >= m->cone_cutoff * sqrtf(Vec3Dot(d, d)) + m->radius) {
+            backfaceCulled++;
+            continue;
+        }
+
+        // neighbours in the index list share one draw
+        if (drawCount > 0 && drawEnd == m->first_index) {
+            draws[drawCount - 1].index_count += m->triangle_count * 3;
+        } else {
+            draws[drawCount++] = (MeshletDraw){ .first_index = m->first_index, .index_count = m->triangle_count * 3 };
+        }
+        drawEnd = m->first_index + m->triangle_count * 3;
+    }
+    if (stats) {
+        stats->frustum_culled += frustumCulled;
+        stats->backface_culled += backfaceCulled;
+    }
+    return drawCount;
+}
@@ -0,0 +1,61 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include "mesh.h"
+#include "frustum_cull.h"
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// A cluster of neighbouring triangles that owns a contiguous range of the
+// mesh's index list, so it can be drawn on its own with an offset draw.
+// Bounds are in object space.
+//
+// The normal cone holds every triangle normal. A camera at c sees the
+// cluster from behind whenever
+//   dot(center - c, cone_axis) >= cone_cutoff * |center - c| + radius
+// Clusters whose normals spread too far get cone_cutoff 1, which never
+// passes.
+typedef struct Meshlet{
+    uint32_t first_index;
+    uint32_t triangle_count;
+    uint32_t vertex_count;
+    float radius;
+    Vec3 center;
+    float cone_cutoff; // sine of the cone's half angle
+    Vec3 cone_axis;
+} Meshlet;
+
+// Greedily grows clusters over shared positions, preferring triangles that
+// add no new vertices and face the way the cluster already does. A cluster
+// is only closed by the vertex and triangle limits or a normal cone too
+// wide to cull; when it runs out of neighbours it continues with the
+// nearest unused triangle. A new cluster is seeded at the first unused
+// triangle of the input order, so a cache and overdraw optimized order
+// carries over. Writes the reordered
+// indices to outIndices and up to indexCount / 3 meshlets to out, returns
+// the number of meshlets.
+int BuildMeshlets(Meshlet* out, uint32_t* outIndices, const uint32_t* indices, int indexCount, const Vertex* vertices, int vertexCount);
+
+// Reorders the indices of a mesh that owns its arrays into meshlet order,
+// refetches the vertices to match and stores the meshlets in the mesh.
+void BuildMeshMeshlets(Mesh* mesh);
+
+// A run of surviving meshlets that are next to each other in the index list.
+typedef struct MeshletDraw{
+    uint32_t first_index;
+    uint32_t index_count;
+} MeshletDraw;
+
+typedef struct MeshletCullStats{
+    int frustum_culled;
+    int backface_culled;
+} MeshletCullStats;
+
+// Tests every meshlet against the frustum and its normal cone from camera,
+// both in the meshlets' object space, and merges the survivors into draws.
+// draws needs room for count entries. Returns the number of draws; the
+// culled counts are added to stats, which may be NULL.
+int CullMeshlets(const Meshlet* meshlets, int count, const Frustum* frustum, Vec3 camera, MeshletDraw* draws, MeshletCullStats* stats);
+
+#endif
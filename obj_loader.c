@@ -0,0 +1,568 @@
+#include "obj_loader.h"
+#include "file_map.h"
+#include "memory_system.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <float.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define MIN_CHUNK_BYTES (64 * 1024)
+#define MAX_CHUNKS 64
+
+// Raw face record: v/vt/vn for three corners plus the attribute counts seen
+// when the face was read, so relative (negative) indices resolve exactly as a
+// sequential reader would.
+typedef struct ObjFace{
+    int idx[9];
+    int pos_count, uv_count, norm_count;
+} ObjFace;
+
+// Fully resolved face corner. Missing normals and uvs are -1.
+typedef struct ObjCorner{
+    int v, vt, vn;
+} ObjCorner;
+
+typedef struct ObjChunk{
+    const char *begin, *end;
+    Arena* scratch; // only touched by the thread working on the chunk
+
+    Vec3* positions;
+    Vec3* normals;
+    Vec2* uvs;
+    ObjFace* faces;
+    int pos_count;
+    int norm_count;
+    int uv_count;
+    int face_count;
+
+    // filled in after every chunk has been parsed
+    int pos_base, norm_base, uv_base;
+    ObjCorner* corners;
+    int corner_count;
+} ObjChunk;
+
+static const double pow10_table[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline int is_space(char c){
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f' || c == '\n';
+}
+
+static inline int is_digit(char c){
+    return (unsigned char)(c - '0') < 10;
+}
+
+static const char* skip_space(const char* p, const char* end){
+    while (p < end && is_space(*p)) p++;
+    return p;
+}
+
+// strtof on a bounded, non terminated token. Used for everything the fast
+// path does not handle exactly (hex, inf/nan, long mantissas, huge exponents).
+static const char* parse_float_slow(const char* p, const char* end, float* out){
+    char buf[128];
+    size_t len = (size_t)(end - p);
+    if (len > sizeof(buf) - 1) len = sizeof(buf) - 1;
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+
+    char* stop;
+    float value = strtof(buf, &stop);
+    if (stop == buf) return NULL;
+    *out = value;
+    return p + (stop - buf);
+}
+
+// Parses a float with the same result as sscanf("%f") in the C locale.
+// Decimal inputs with up to 19 significant digits and |exponent| <= 22 are
+// converted with a single correctly rounded double operation; the rare values
+// that land exactly on a float rounding midpoint go through strtof instead.
+static const char* parse_float(const char* p, const char* end, float* out){
+    p = skip_space(p, end);
+    const char* start = p;
+
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    if (p + 1 < end && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        return parse_float_slow(start, end, out);
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0, any = 0, truncated = 0;
+
+    while (p < end && is_digit(*p)) {
+        any = 1;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            if (mantissa) digits++;
+        } else {
+            exponent++;
+            truncated |= (*p != '0');
+        }
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && is_digit(*p)) {
+            any = 1;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            } else {
+                truncated |= (*p != '0');
+            }
+            p++;
+        }
+    }
+    if (!any) {
+        return parse_float_slow(start, end, out);
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        int exp_negative = 0;
+        if (e < end && (*e == '-' || *e == '+')) {
+            exp_negative = (*e == '-');
+            e++;
+        }
+        if (e < end && is_digit(*e)) {
+            int exp_value = 0;
+            while (e < end && is_digit(*e)) {
+                if (exp_value < 100000) exp_value = exp_value * 10 + (*e - '0');
+                e++;
+            }
+            exponent += exp_negative ? -exp_value : exp_value;
+            p = e;
+        }
+    }
+
+    if (truncated || mantissa > (1ull << 53) || exponent < -22 || exponent > 22) {
+        return parse_float_slow(start, end, out);
+    }
+
+    double value = (double)mantissa;
+    if (exponent < 0) value /= pow10_table[-exponent];
+    else if (exponent > 0) value *= pow10_table[exponent];
+
+    if (value != 0.0) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        if ((bits & 0x1FFFFFFFull) == 0x10000000ull || value < FLT_MIN || value > FLT_MAX) {
+            return parse_float_slow(start, end, out);
+        }
+    }
+
+    *out = negative ? -(float)value : (float)value;
+    return p;
+}
+
+// Parses an int with the same result as sscanf("%d").
+static const char* parse_int(const char* p, const char* end, int* out){
+    p = skip_space(p, end);
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    if (p >= end || !is_digit(*p)) return NULL;
+
+    long long value = 0;
+    while (p < end && is_digit(*p)) {
+        value = value * 10 + (*p - '0');
+        if (value > 0xFFFFFFFFll) value = 0xFFFFFFFFll;
+        p++;
+    }
+    *out = (int)(negative ? -value : value);
+    return p;
+}
+
+static int parse_floats(const char* p, const char* end, float* out, int count){
+    for (int i = 0; i < count; i++) {
+        p = parse_float(p, end, &out[i]);
+        if (!p) return 0;
+    }
+    return 1;
+}
+
+static int parse_face(const char* p, const char* end, int* idx){
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            if (j > 0) {
+                if (p >= end || *p != '/') return 0;
+                p++;
+            }
+            p = parse_int(p, end, &idx[i * 3 + j]);
+            if (!p) return 0;
+        }
+    }
+    return 1;
+}
+
+// Sizes the record arrays from the line prefixes, so they are allocated
+// once at their final size instead of growing in the arena. Lines that fail
+// to parse later only leave the counts too high.
+static void reserve_records(ObjChunk* chunk){
+    int positions = 0, normals = 0, uvs = 0, faces = 0;
+    const char* p = chunk->begin;
+    const char* end = chunk->end;
+    while (p < end) {
+        const char* line_end = memchr(p, '\n', (size_t)(end - p));
+        if (!line_end) line_end = end;
+        if (line_end - p >= 2) {
+            if (p[0] == 'v') {
+                positions += p[1] == ' ';
+                normals += p[1] == 'n';
+                uvs += p[1] == 't';
+            } else {
+                faces += p[0] == 'f' && p[1] == ' ';
+            }
+        }
+        p = line_end + 1;
+    }
+
+    chunk->positions = ArenaAlloc(chunk->scratch, (size_t)positions * sizeof(Vec3));
+    chunk->normals = ArenaAlloc(chunk->scratch, (size_t)normals * sizeof(Vec3));
+    chunk->uvs = ArenaAlloc(chunk->scratch, (size_t)uvs * sizeof(Vec2));
+    chunk->faces = ArenaAlloc(chunk->scratch, (size_t)faces * sizeof(ObjFace));
+}
+
+static void parse_chunk(ObjChunk* chunk){
+    const char* p = chunk->begin;
+    const char* end = chunk->end;
+    float f[3];
+
+    reserve_records(chunk);
+
+    while (p < end) {
+        const char* line_end = memchr(p, '\n', (size_t)(end - p));
+        if (!line_end) line_end = end;
+
+        if (line_end - p >= 2) {
+            if (p[0] == 'v' && p[1] == ' ') {
+                if (parse_floats(p + 1, line_end, f, 3))
+                    chunk->positions[chunk->pos_count++] = (Vec3){f[0], f[1], f[2]};
+            }
+            else if (p[0] == 'v' && p[1] == 'n') {
+                if (parse_floats(p + 2, line_end, f, 3))
+                    chunk->normals[chunk->norm_count++] = (Vec3){f[0], f[1], f[2]};
+            }
+            else if (p[0] == 'v' && p[1] == 't') {
+                if (parse_floats(p + 2, line_end, f, 2))
+                    chunk->uvs[chunk->uv_count++] = (Vec2){f[0], f[1]};
+            }
+            else if (p[0] == 'f' && p[1] == ' ') {
+                ObjFace face;
+                if (parse_face(p + 1, line_end, face.idx)) {
+                    face.pos_count = chunk->pos_count;
+                    face.uv_count = chunk->uv_count;
+                    face.norm_count = chunk->norm_count;
+                    chunk->faces[chunk->face_count++] = face;
+                }
+            }
+        }
+
+        p = line_end + 1;
+    }
+}
+
+static int resolve_index(int idx, int count) {
+    if (idx < 0) return count + idx;
+    return idx - 1;
+}
+
+static void resolve_chunk(ObjChunk* chunk){
+    chunk->corners = ArenaAlloc(chunk->scratch, (size_t)(chunk->face_count * 3 + 1) * sizeof(ObjCorner));
+    chunk->corner_count = 0;
+
+    for (int f = 0; f < chunk->face_count; f++) {
+        const ObjFace* face = &chunk->faces[f];
+        int pos_count = chunk->pos_base + face->pos_count;
+        int uv_count = chunk->uv_base + face->uv_count;
+        int norm_count = chunk->norm_base + face->norm_count;
+
+        for (int i = 0; i < 3; i++) {
+            int vi = resolve_index(face->idx[i * 3 + 0], pos_count);
+            int vti = resolve_index(face->idx[i * 3 + 1], uv_count);
+            int vni = resolve_index(face->idx[i * 3 + 2], norm_count);
+            if (vi < 0 || vi >= pos_count) continue;
+
+            ObjCorner* corner = &chunk->corners[chunk->corner_count++];
+            corner->v = vi;
+            corner->vt = (vti >= 0 && vti < uv_count) ? vti : -1;
+            corner->vn = (vni >= 0 && vni < norm_count) ? vni : -1;
+        }
+    }
+}
+
+static inline uint32_t hash_corner(ObjCorner c){
+    uint32_t h = (uint32_t)c.v * 0x9E3779B1u;
+    h ^= (uint32_t)c.vt * 0x85EBCA77u;
+    h ^= (uint32_t)c.vn * 0xC2B2AE3Du;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 13;
+    return h;
+}
+
+// Collapses identical (v, vt, vn) corners into one vertex with an open
+// addressing (linear probing) table and writes the index list. Vertices keep
+// the order of their first use.
+static void build_indexed(const ObjChunk* chunks, int chunkCount, const Vec3* positions, const Vec3* normals, const Vec2* uvs, Arena* scratch, Mesh* mesh){
+    int corner_total = 0;
+    for (int i = 0; i < chunkCount; i++) corner_total += chunks[i].corner_count;
+
+    uint32_t capacity = 16;
+    while (capacity < (uint32_t)corner_total * 2) capacity <<= 1;
+    typedef struct { ObjCorner key; int vertex; } Slot;
+    Slot* table = ArenaAlloc(scratch, capacity * sizeof(Slot));
+    for (uint32_t i = 0; i < capacity; i++) table[i].vertex = -1;
+
+    uint32_t* indices = ArenaAlloc(scratch, (size_t)(corner_total + 1) * sizeof(uint32_t));
+    Vertex* vertices = ArenaAlloc(scratch, (size_t)(corner_total + 1) * sizeof(Vertex));
+    int vert_count = 0, index_count = 0;
+
+    for (int c = 0; c < chunkCount; c++) {
+        for (int i = 0; i < chunks[c].corner_count; i++) {
+            ObjCorner corner = chunks[c].corners[i];
+            uint32_t slot = hash_corner(corner) & (capacity - 1);
+            while (table[slot].vertex >= 0) {
+                ObjCorner key = table[slot].key;
+                if (key.v == corner.v && key.vt == corner.vt && key.vn == corner.vn) break;
+                slot = (slot + 1) & (capacity - 1);
+            }
+
+            if (table[slot].vertex < 0) {
+                table[slot].key = corner;
+                table[slot].vertex = vert_count;
+                Vertex* vertex = &vertices[vert_count++];
+                vertex->position = positions[corner.v];
+                vertex->normal = corner.vn >= 0 ? normals[corner.vn] : (Vec3){0.0f, 1.0f, 0.0f};
+                vertex->uv = corner.vt >= 0 ? uvs[corner.vt] : (Vec2){0.0f, 0.0f};
+            }
+            indices[index_count++] = (uint32_t)table[slot].vertex;
+        }
+    }
+
+    mesh->vertices = AllocMeshData((size_t)(vert_count + 1) * sizeof(Vertex), "mesh vertices");
+    memcpy(mesh->vertices, vertices, (size_t)vert_count * sizeof(Vertex));
+    mesh->vertex_count = vert_count;
+    mesh->size = vert_count * sizeof(Vertex);
+    SetMeshIndices(mesh, indices, index_count);
+    ComputeMeshBounds(mesh);
+}
+
+static void* parse_chunk_thread(void* arg){
+    parse_chunk(arg);
+    return NULL;
+}
+
+static void* resolve_chunk_thread(void* arg){
+    resolve_chunk(arg);
+    return NULL;
+}
+
+// Runs fn on every chunk, chunk 0 on the calling thread and the rest on their
+// own threads. Falls back to serial execution when threads are unavailable.
+static void run_chunks(ObjChunk* chunks, int chunkCount, void (*fn)(ObjChunk*), void* (*threadFn)(void*)){
+#ifndef _WIN32
+    pthread_t threads[MAX_CHUNKS];
+    int started[MAX_CHUNKS] = {0};
+    for (int i = 1; i < chunkCount; i++) {
+        started[i] = pthread_create(&threads[i], NULL, threadFn, &chunks[i]) == 0;
+    }
+    fn(&chunks[0]);
+    for (int i = 1; i < chunkCount; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+        else fn(&chunks[i]);
+    }
+#else
+    (void)threadFn;
+    for (int i = 0; i < chunkCount; i++) {
+        fn(&chunks[i]);
+    }
+#endif
+}
+
+static int default_thread_count(void){
+#ifndef _WIN32
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+// Scratch arenas for one load, one per chunk so parse threads never share
+// one. A finished load resets its set and puts it back for the next, so
+// there are only ever as many sets as loads that ran at the same time.
+typedef struct ObjScratch{
+    Arena arenas[MAX_CHUNKS];
+    struct ObjScratch* next;
+} ObjScratch;
+
+#define OBJ_SCRATCH_BLOCK (256 * 1024)
+#define OBJ_SCRATCH_KEEP (16 * 1024 * 1024) // per arena, larger loads give it back
+
+static atomic_flag scratchLock = ATOMIC_FLAG_INIT;
+static ObjScratch* freeScratch;
+
+static void lock_scratch(void){
+    AcquireSpinLock(&scratchLock);
+}
+
+static void unlock_scratch(void){
+    ReleaseSpinLock(&scratchLock);
+}
+
+static ObjScratch* acquire_scratch(void){
+    lock_scratch();
+    ObjScratch* scratch = freeScratch;
+    if (scratch) freeScratch = scratch->next;
+    unlock_scratch();
+    if (!scratch) {
+        scratch = malloc(sizeof(ObjScratch));
+        if (!scratch) {
+            printf("[ERROR]: could not allocate obj scratch arenas\n");
+            return NULL;
+        }
+        for (int i = 0; i < MAX_CHUNKS; i++) InitArena(&scratch->arenas[i], "obj scratch", OBJ_SCRATCH_BLOCK);
+    }
+    return scratch;
+}
+
+static void release_scratch(ObjScratch* scratch, int used){
+    for (int i = 0; i < used; i++) {
+        if (scratch->arenas[i].reserved > OBJ_SCRATCH_KEEP) TrimArena(&scratch->arenas[i]);
+        else ResetArena(&scratch->arenas[i]);
+    }
+    lock_scratch();
+    scratch->next = freeScratch;
+    freeScratch = scratch;
+    unlock_scratch();
+}
+
+MemoryStats GetObjScratchStats(void){
+    MemoryStats total = {0};
+    lock_scratch();
+    for (const ObjScratch* scratch = freeScratch; scratch; scratch = scratch->next) {
+        for (int i = 0; i < MAX_CHUNKS; i++) {
+            const MemoryStats* stats = &scratch->arenas[i].stats;
+            total.bytes += stats->bytes;
+            total.peak_bytes += stats->peak_bytes;
+            total.total_bytes += stats->total_bytes;
+            total.allocations += stats->allocations;
+            total.frees += stats->frees;
+        }
+    }
+    unlock_scratch();
+    return total;
+}
+
+void FreeObjScratch(void){
+    lock_scratch();
+    ObjScratch* scratch = freeScratch;
+    freeScratch = NULL;
+    unlock_scratch();
+    while (scratch) {
+        ObjScratch* next = scratch->next;
+        for (int i = 0; i < MAX_CHUNKS; i++) DestroyArena(&scratch->arenas[i]);
+        free(scratch);
+        scratch = next;
+    }
+}
+
+Mesh LoadObjFromMemory(const char* data, size_t size, Vec3 pos, int threadCount){
+    int chunkCount = threadCount > 0 ? threadCount : default_thread_count();
+    if (chunkCount > MAX_CHUNKS) chunkCount = MAX_CHUNKS;
+    if ((size_t)chunkCount > size / MIN_CHUNK_BYTES) chunkCount = (int)(size / MIN_CHUNK_BYTES);
+    if (chunkCount < 1) chunkCount = 1;
+
+    ObjChunk chunks[MAX_CHUNKS];
+    memset(chunks, 0, sizeof(chunks));
+    ObjScratch* scratch = acquire_scratch();
+    if (!scratch) {
+        return (Mesh){0};
+    }
+
+    // split at line boundaries so no record straddles two chunks
+    const char* data_end = data + size;
+    const char* cursor = data;
+    for (int i = 0; i < chunkCount; i++) {
+        const char* split = data_end;
+        if (i < chunkCount - 1) {
+            split = data + size * (size_t)(i + 1) / (size_t)chunkCount;
+            if (split < cursor) split = cursor;
+            const char* nl = memchr(split, '\n', (size_t)(data_end - split));
+            split = nl ? nl + 1 : data_end;
+        }
+        chunks[i].begin = cursor;
+        chunks[i].end = split;
+        chunks[i].scratch = &scratch->arenas[i];
+        cursor = split;
+    }
+
+    run_chunks(chunks, chunkCount, parse_chunk, parse_chunk_thread);
+
+    int pos_total = 0, norm_total = 0, uv_total = 0;
+    for (int i = 0; i < chunkCount; i++) {
+        chunks[i].pos_base = pos_total;
+        chunks[i].norm_base = norm_total;
+        chunks[i].uv_base = uv_total;
+        pos_total += chunks[i].pos_count;
+        norm_total += chunks[i].norm_count;
+        uv_total += chunks[i].uv_count;
+    }
+
+    Vec3* positions = chunks[0].positions;
+    Vec3* normals = chunks[0].normals;
+    Vec2* uvs = chunks[0].uvs;
+    if (chunkCount > 1) {
+        positions = ArenaAlloc(chunks[0].scratch, (size_t)(pos_total + 1) * sizeof(Vec3));
+        normals = ArenaAlloc(chunks[0].scratch, (size_t)(norm_total + 1) * sizeof(Vec3));
+        uvs = ArenaAlloc(chunks[0].scratch, (size_t)(uv_total + 1) * sizeof(Vec2));
+        for (int i = 0; i < chunkCount; i++) {
+            if (chunks[i].pos_count) memcpy(positions + chunks[i].pos_base, chunks[i].positions, (size_t)chunks[i].pos_count * sizeof(Vec3));
+            if (chunks[i].norm_count) memcpy(normals + chunks[i].norm_base, chunks[i].normals, (size_t)chunks[i].norm_count * sizeof(Vec3));
+            if (chunks[i].uv_count) memcpy(uvs + chunks[i].uv_base, chunks[i].uvs, (size_t)chunks[i].uv_count * sizeof(Vec2));
+        }
+    }
+    run_chunks(chunks, chunkCount, resolve_chunk, resolve_chunk_thread);
+
+    Mesh mesh = { .position = pos };
+    build_indexed(chunks, chunkCount, positions, normals, uvs, chunks[0].scratch, &mesh);
+
+    release_scratch(scratch, chunkCount);
+    return mesh;
+}
+
+static Mesh load_obj(const char *filePath, Vec3 pos, int threadCount){
+    MappedFile file;
+    if(!MapFile(filePath, &file)){
+        printf("[ERROR]: could not open file: %s\n", filePath);
+        return (Mesh){0};
+    }
+
+    Mesh mesh = LoadObjFromMemory(file.data, file.size, pos, threadCount);
+    UnmapFile(&file);
+    return mesh;
+}
+
+Mesh LoadObjFromFile(const char *filePath, Vec3 pos){
+    return load_obj(filePath, pos, 1);
+}
+
+Mesh LoadObjFromFileThreaded(const char *filePath, Vec3 pos, int threadCount){
+    return load_obj(filePath, pos, threadCount);
+}
@@ -0,0 +1,28 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "mesh.h"
+#include "memory_system.h"
+
+// Parses the v/vn/vt/f records of a Wavefront .obj into an indexed triangle
+// list with one vertex per unique v/vt/vn corner. Only the first three corners
+// of a face are used, and every corner needs the full v/vt/vn form. The
+// returned arrays come from the mesh pool, release with FreeMesh.
+Mesh LoadObjFromFile(const char *filePath, Vec3 pos);
+
+// Same output as LoadObjFromFile, but the file is split into line-aligned
+// chunks that are parsed on up to threadCount threads (0 = one per core).
+Mesh LoadObjFromFileThreaded(const char *filePath, Vec3 pos, int threadCount);
+
+// Parses .obj text that is already in memory. data does not need to be NUL
+// terminated.
+Mesh LoadObjFromMemory(const char* data, size_t size, Vec3 pos, int threadCount);
+
+// Parsing works in scratch arenas that are reset after each load and kept
+// for the next one. The counters are summed over every arena and are only
+// complete while no load is running; FreeObjScratch must not race a load
+// either.
+MemoryStats GetObjScratchStats(void);
+void FreeObjScratch(void);
+
+#endif
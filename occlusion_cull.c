@@ -0,0 +1,308 @@
+#include "occlusion_cull.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCCLUSION_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define OCCLUSION_NEON 1
+#endif
+
+#define OCCLUSION_LANES 4
+
+bool InitOcclusionBuffer(OcclusionBuffer* buffer, int width, int height){
+    width = (width + OCCLUSION_LANES - 1) / OCCLUSION_LANES * OCCLUSION_LANES;
+    float* depth = malloc((size_t)width * height * sizeof(float));
+    if (!depth) {
+        printf("[ERROR]: could not allocate a %dx%d occlusion buffer\n", width, height);
+        return false;
+    }
+    *buffer = (OcclusionBuffer){ .depth = depth, .width = width, .height = height };
+    ClearOcclusionBuffer(buffer);
+    return true;
+}
+
+void DestroyOcclusionBuffer(OcclusionBuffer* buffer){
+    free(buffer->depth);
+    free(buffer->screen);
+    *buffer = (OcclusionBuffer){0};
+}
+
+void ClearOcclusionBuffer(OcclusionBuffer* buffer){
+    int count = buffer->width * buffer->height;
+    for (int i = 0; i < count; i++) buffer->depth[i] = 1.0f;
+    buffer->triangles = 0;
+}
+
+// Screen position of a clip space point: x and y in buffer pixels, z / w.
+// Returns false behind the near plane.
+static bool project(const float mvp[16], Vec3 p, float width, float height, float out[3]){
+    float x = mvp[0] * p.x + mvp[4] * p.y + mvp[8] * p.z + mvp[12];
+    float y = mvp[1] * p.x + mvp[5] * p.y + mvp[9] * p.z + mvp[13];
+    float z = mvp[2] * p.x + mvp[6] * p.y + mvp[10] * p.z + mvp[14];
+    float w = mvp[3] * p.x + mvp[7] * p.y + mvp[11] * p.z + mvp[15];
+    if (!(z >= 0.0f) || !(w > 0.0f)) return false;
+    float inv = 1.0f / w;
+    out[0] = (x * inv * 0.5f + 0.5f) * width;
+    out[1] = (y * inv * 0.5f + 0.5f) * height;
+    out[2] = z * inv;
+    return true;
+}
+
+// Edge functions e = a * x + b * y + c, all >= 0 inside, and the depth plane
+// z = dzdx * x + dzdy * y + z0, at pixel centers.
+typedef struct RasterTriangle{
+    float a[3], b[3], c[3];
+    float dzdx, dzdy, z0;
+    float zmin, zmax;
+    int x0, x1, y0, y1;
+} RasterTriangle;
+
+static bool setup_triangle(const float* v0, const float* v1, const float* v2, int width, int height, RasterTriangle* t){
+    float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+    if (!(area > 0.0f)) return false; // back facing or degenerate
+
+    float minX = fminf(v0[0], fminf(v1[0], v2[0])), maxX = fmaxf(v0[0], fmaxf(v1[0], v2[0]));
+    float minY = fminf(v0[1], fminf(v1[1], v2[1])), maxY = fmaxf(v0[1], fmaxf(v1[1], v2[1]));
+    float fx0 = ceilf(fmaxf(minX - 0.5f, 0.0f)), fx1 = floorf(fminf(maxX - 0.5f, (float)(width - 1)));
+    float fy0 = ceilf(fmaxf(minY - 0.5f, 0.0f)), fy1 = floorf(fminf(maxY - 0.5f, (float)(height - 1)));
+    if (fx0 > fx1 || fy0 > fy1) return false;
+    t->x0 = (int)fx0;
+    t->x1 = (int)fx1;
+    t->y0 = (int)fy0;
+    t->y1 = (int)fy1;
+
+    // edge i runs between the two vertices other than i
+    const float* v[3] = {v0, v1, v2};
+    float inv = 1.0f / area;
+    t->dzdx = t->dzdy = t->z0 = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        const float* j = v[(i + 1) % 3];
+        const float* k = v[(i + 2) % 3];
+        t->a[i] = j[1] - k[1];
+        t->b[i] = k[0] - j[0];
+        t->c[i] = (k[1] - j[1]) * j[0] - (k[0] - j[0]) * j[1];
+        t->dzdx += t->a[i] * v[i][2] * inv;
+        t->dzdy += t->b[i] * v[i][2] * inv;
+        t->z0 += t->c[i] * v[i][2] * inv;
+    }
+    t->zmin = fminf(v0[2], fminf(v1[2], v2[2]));
+    t->zmax = fmaxf(v0[2], fmaxf(v1[2], v2[2]));
+    return true;
+}
+
+static void raster_triangle_scalar(OcclusionBuffer* buffer, const RasterTriangle* t){
+    for (int y = t->y0; y <= t->y1; y++) {
+        float py = (float)y + 0.5f;
+        float rowE0 = t->b[0] * py + t->c[0];
+        float rowE1 = t->b[1] * py + t->c[1];
+        float rowE2 = t->b[2] * py + t->c[2];
+        float rowZ = t->dzdy * py + t->z0;
+        float* row = buffer->depth + (size_t)y * buffer->width;
+        for (int x = t->x0; x <= t->x1; x++) {
+            float px = (float)x + 0.5f;
+            float e0 = t->a[0] * px + rowE0;
+            float e1 = t->a[1] * px + rowE1;
+            float e2 = t->a[2] * px + rowE2;
+            if (!(e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)) continue;
+            float z = fmaxf(fminf(t->dzdx * px + rowZ, t->zmax), t->zmin);
+            if (z < row[x]) row[x] = z;
+        }
+    }
+}
+
+// Whole aligned groups of four pixels; lanes outside the triangle's bounds
+// or edges keep their depth.
+static void raster_triangle_simd(OcclusionBuffer* buffer, const RasterTriangle* t){
+#if defined(OCCLUSION_SSE2)
+    const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 a0 = _mm_set1_ps(t->a[0]), a1 = _mm_set1_ps(t->a[1]), a2 = _mm_set1_ps(t->a[2]);
+    __m128 dzdx = _mm_set1_ps(t->dzdx);
+    __m128 zmin = _mm_set1_ps(t->zmin), zmax = _mm_set1_ps(t->zmax);
+    __m128 left = _mm_set1_ps((float)t->x0), right = _mm_set1_ps((float)t->x1);
+    int start = t->x0 & ~(OCCLUSION_LANES - 1);
+
+    for (int y = t->y0; y <= t->y1; y++) {
+        float py = (float)y + 0.5f;
+        __m128 rowE0 = _mm_set1_ps(t->b[0] * py + t->c[0]);
+        __m128 rowE1 = _mm_set1_ps(t->b[1] * py + t->c[1]);
+        __m128 rowE2 = _mm_set1_ps(t->b[2] * py + t->c[2]);
+        __m128 rowZ = _mm_set1_ps(t->dzdy * py + t->z0);
+        float* row = buffer->depth + (size_t)y * buffer->width;
+        for (int x = start; x <= t->x1; x += OCCLUSION_LANES) {
+            __m128 ix = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+            __m128 px = _mm_add_ps(ix, _mm_set1_ps(0.5f));
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), rowE0);
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), rowE1);
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), rowE2);
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+            inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(ix, left), _mm_cmple_ps(ix, right)));
+            if (_mm_movemask_ps(inside) == 0) continue;
+
+            __m128 z = _mm_max_ps(_mm_min_ps(_mm_add_ps(_mm_mul_ps(dzdx, px), rowZ), zmax), zmin);
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 nearer = _mm_min_ps(z, old);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+        }
+    }
+#elif defined(OCCLUSION_NEON)
+    const float laneInit[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    const float32x4_t lanes = vld1q_f32(laneInit);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t a0 = vdupq_n_f32(t->a[0]), a1 = vdupq_n_f32(t->a[1]), a2 = vdupq_n_f32(t->a[2]);
+    float32x4_t dzdx = vdupq_n_f32(t->dzdx);
+    float32x4_t zmin = vdupq_n_f32(t->zmin), zmax = vdupq_n_f32(t->zmax);
+    float32x4_t left = vdupq_n_f32((float)t->x0), right = vdupq_n_f32((float)t->x1);
+    int start = t->x0 & ~(OCCLUSION_LANES - 1);
+
+    for (int y = t->y0; y <= t->y1; y++) {
+        float py = (float)y + 0.5f;
+        float32x4_t rowE0 = vdupq_n_f32(t->b[0] * py + t->c[0]);
+        float32x4_t rowE1 = vdupq_n_f32(t->b[1] * py + t->c[1]);
+        float32x4_t rowE2 = vdupq_n_f32(t->b[2] * py + t->c[2]);
+        float32x4_t rowZ = vdupq_n_f32(t->dzdy * py + t->z0);
+        float* row = buffer->depth + (size_t)y * buffer->width;
+        for (int x = start; x <= t->x1; x += OCCLUSION_LANES) {
+            float32x4_t ix = vaddq_f32(vdupq_n_f32((float)x), lanes);
+            float32x4_t px = vaddq_f32(ix, vdupq_n_f32(0.5f));
+            float32x4_t e0 = vaddq_f32(vmulq_f32(a0, px), rowE0);
+            float32x4_t e1 = vaddq_f32(vmulq_f32(a1, px), rowE1);
+            float32x4_t e2 = vaddq_f32(vmulq_f32(a2, px), rowE2);
+            uint32x4_t inside = vandq_u32(vandq_u32(vcgeq_f32(e0, zero), vcgeq_f32(e1, zero)), vcgeq_f32(e2, zero));
+            inside = vandq_u32(inside, vandq_u32(vcgeq_f32(ix, left), vcleq_f32(ix, right)));
+            if (vmaxvq_u32(inside) == 0) continue;
+
+            float32x4_t z = vmaxq_f32(vminq_f32(vaddq_f32(vmulq_f32(dzdx, px), rowZ), zmax), zmin);
+            float32x4_t old = vld1q_f32(row + x);
+            vst1q_f32(row + x, vbslq_f32(inside, vminq_f32(z, old), old));
+        }
+    }
+#else
+    raster_triangle_scalar(buffer, t);
+#endif
+}
+
+static bool reserve_screen(OcclusionBuffer* buffer, int vertexCount){
+    if (vertexCount <= buffer->screen_capacity) return true;
+    float* screen = realloc(buffer->screen, (size_t)vertexCount * 4 * sizeof(float));
+    if (!screen) {
+        printf("[ERROR]: could not allocate occlusion scratch for %d vertices\n", vertexCount);
+        return false;
+    }
+    buffer->screen = screen;
+    buffer->screen_capacity = vertexCount;
+    return true;
+}
+
+static void rasterize(OcclusionBuffer* buffer, const float mvp[16], const Mesh* mesh, bool simd){
+    if (!reserve_screen(buffer, mesh->vertex_count)) return;
+
+    // every vertex once; the fourth float marks vertices behind the near plane
+    float width = (float)buffer->width, height = (float)buffer->height;
+    for (int i = 0; i < mesh->vertex_count; i++) {
+        float* s = buffer->screen + (size_t)i * 4;
+        s[3] = project(mvp, mesh->vertices[i].position, width, height, s) ? 1.0f : 0.0f;
+    }
+
+    for (int i = 0; i + 2 < mesh->index_count; i += 3) {
+        const float* v0 = buffer->screen + (size_t)GetMeshIndex(mesh, i) * 4;
+        const float* v1 = buffer->screen + (size_t)GetMeshIndex(mesh, i + 1) * 4;
+        const float* v2 = buffer->screen + (size_t)GetMeshIndex(mesh, i + 2) * 4;
+        if (v0[3] == 0.0f || v1[3] == 0.0f || v2[3] == 0.0f) continue;
+
+        RasterTriangle t;
+        if (!setup_triangle(v0, v1, v2, buffer->width, buffer->height, &t)) continue;
+        if (simd) {
+            raster_triangle_simd(buffer, &t);
+        } else {
+            raster_triangle_scalar(buffer, &t);
+        }
+        buffer->triangles++;
+    }
+}
+
+void RasterizeOccluder(OcclusionBuffer* buffer, const float mvp[16], const Mesh* mesh){
+    rasterize(buffer, mvp, mesh, true);
+}
+
+void RasterizeOccluderScalar(OcclusionBuffer* buffer, const float mvp[16], const Mesh* mesh){
+    rasterize(buffer, mvp, mesh, false);
+}
+
+// Pixels the box's screen rectangle touches, and its nearest depth. Returns
+// false if the box crosses the near plane.
+static bool project_box(const OcclusionBuffer* buffer, const float mvp[16], Vec3 lo, Vec3 hi, int rect[4], float* nearest){
+    float minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY, minZ = INFINITY;
+    for (int c = 0; c < 8; c++) {
+        Vec3 p = { c & 1 ? hi.x : lo.x, c & 2 ? hi.y : lo.y, c & 4 ? hi.z : lo.z };
+        float s[3];
+        if (!project(mvp, p, (float)buffer->width, (float)buffer->height, s)) return false;
+        minX = fminf(minX, s[0]);
+        maxX = fmaxf(maxX, s[0]);
+        minY = fminf(minY, s[1]);
+        maxY = fmaxf(maxY, s[1]);
+        minZ = fminf(minZ, s[2]);
+    }
+    rect[0] = (int)floorf(fmaxf(minX, 0.0f));
+    rect[1] = (int)ceilf(fminf(maxX, (float)buffer->width)) - 1;
+    rect[2] = (int)floorf(fmaxf(minY, 0.0f));
+    rect[3] = (int)ceilf(fminf(maxY, (float)buffer->height)) - 1;
+    *nearest = minZ;
+    return true;
+}
+
+bool OcclusionTestBoxScalar(const OcclusionBuffer* buffer, const float mvp[16], Vec3 boundsMin, Vec3 boundsMax){
+    int rect[4];
+    float nearest;
+    if (!project_box(buffer, mvp, boundsMin, boundsMax, rect, &nearest)) return true;
+    for (int y = rect[2]; y <= rect[3]; y++) {
+        const float* row = buffer->depth + (size_t)y * buffer->width;
+        for (int x = rect[0]; x <= rect[1]; x++) {
+            if (nearest <= row[x]) return true;
+        }
+    }
+    return false;
+}
+
+bool OcclusionTestBox(const OcclusionBuffer* buffer, const float mvp[16], Vec3 boundsMin, Vec3 boundsMax){
+#if defined(OCCLUSION_SSE2) || defined(OCCLUSION_NEON)
+    int rect[4];
+    float nearest;
+    if (!project_box(buffer, mvp, boundsMin, boundsMax, rect, &nearest)) return true;
+    int start = rect[0] & ~(OCCLUSION_LANES - 1);
+#if defined(OCCLUSION_SSE2)
+    const __m128i lanes = _mm_set_epi32(3, 2, 1, 0);
+    __m128 z = _mm_set1_ps(nearest);
+    __m128i left = _mm_set1_epi32(rect[0] - 1), right = _mm_set1_epi32(rect[1] + 1);
+    for (int y = rect[2]; y <= rect[3]; y++) {
+        const float* row = buffer->depth + (size_t)y * buffer->width;
+        for (int x = start; x <= rect[1]; x += OCCLUSION_LANES) {
+            __m128i ix = _mm_add_epi32(_mm_set1_epi32(x), lanes);
+            __m128 inRect = _mm_castsi128_ps(_mm_and_si128(_mm_cmpgt_epi32(ix, left), _mm_cmplt_epi32(ix, right)));
+            if (_mm_movemask_ps(_mm_and_ps(inRect, _mm_cmple_ps(z, _mm_loadu_ps(row + x))))) return true;
+        }
+    }
+#else
+    const int32_t laneInit[4] = {0, 1, 2, 3};
+    const int32x4_t lanes = vld1q_s32(laneInit);
+    float32x4_t z = vdupq_n_f32(nearest);
+    int32x4_t left = vdupq_n_s32(rect[0]), right = vdupq_n_s32(rect[1]);
+    for (int y = rect[2]; y <= rect[3]; y++) {
+        const float* row = buffer->depth + (size_t)y * buffer->width;
+        for (int x = start; x <= rect[1]; x += OCCLUSION_LANES) {
+            int32x4_t ix = vaddq_s32(vdupq_n_s32(x), lanes);
+            uint32x4_t inRect = vandq_u32(vcgeq_s32(ix, left), vcleq_s32(ix, right));
+            if (vmaxvq_u32(vandq_u32(inRect, vcleq_f32(z, vld1q_f32(row + x))))) return true;
+        }
+    }
+#endif
+    return false;
+#else
+    return OcclusionTestBoxScalar(buffer, mvp, boundsMin, boundsMax);
+#endif
+}
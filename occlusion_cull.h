@@ -0,0 +1,42 @@
+#ifndef OCCLUSION_CULL_H
+#define OCCLUSION_CULL_H
+
+#include "mesh.h"
+
+// Small CPU depth buffer for occlusion culling. Occluder meshes are
+// rasterized into it four pixels at a time, then object bounds are tested
+// against it, so draws hidden behind the occluders are dropped before they
+// are recorded. Depth is clip z / w in SDL GPU's [0, 1] range, 1 is far.
+//
+// Coverage is sampled at pixel centers, so an object peeking out from
+// behind an occluder by less than one buffer pixel may be culled.
+typedef struct OcclusionBuffer{
+    float* depth; // width * height, rows bottom to top
+    int width; // a multiple of four
+    int height;
+    float* screen; // per-vertex scratch of the occluder being rasterized
+    int screen_capacity;
+    uint32_t triangles; // occluder triangles rasterized since the last clear
+} OcclusionBuffer;
+
+// width is rounded up to a multiple of four.
+bool InitOcclusionBuffer(OcclusionBuffer* buffer, int width, int height);
+void DestroyOcclusionBuffer(OcclusionBuffer* buffer);
+
+void ClearOcclusionBuffer(OcclusionBuffer* buffer);
+
+// Rasterizes the front faces (counter-clockwise) of mesh under the
+// column-major mvp, keeping the nearest depth per pixel. Triangles that
+// cross the near plane are skipped, which only ever loses occlusion.
+void RasterizeOccluder(OcclusionBuffer* buffer, const float mvp[16], const Mesh* mesh);
+
+// One pixel at a time with the same arithmetic, as a reference for tests and
+// benchmarks.
+void RasterizeOccluderScalar(OcclusionBuffer* buffer, const float mvp[16], const Mesh* mesh);
+
+// False when the box boundsMin..boundsMax is behind the occluders at every
+// pixel it covers. Boxes that cross the near plane are always visible.
+bool OcclusionTestBox(const OcclusionBuffer* buffer, const float mvp[16], Vec3 boundsMin, Vec3 boundsMax);
+bool OcclusionTestBoxScalar(const OcclusionBuffer* buffer, const float mvp[16], Vec3 boundsMin, Vec3 boundsMax);
+
+#endif
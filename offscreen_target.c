@@ -0,0 +1,109 @@
+#include "offscreen_target.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+bool InitOffscreenTarget(OffscreenTarget* target, SDL_GPUDevice* device, Uint32 width, Uint32 height){
+    *target = (OffscreenTarget){ .device = device, .width = width, .height = height };
+
+    SDL_GPUTextureCreateInfo colorInfo = {
+        .type = SDL_GPU_TEXTURETYPE_2D,
+        .format = OFFSCREEN_FORMAT,
+        .usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET,
+        .width = width,
+        .height = height,
+        .layer_count_or_depth = 1,
+        .num_levels = 1,
+        .sample_count = SDL_GPU_SAMPLECOUNT_1
+    };
+    SDL_GPUTransferBufferCreateInfo readbackInfo = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD,
+        .size = width * height * 4
+    };
+    target->color = SDL_CreateGPUTexture(device, &colorInfo);
+    target->readback = SDL_CreateGPUTransferBuffer(device, &readbackInfo);
+    if (!target->color || !target->readback) {
+        printf("[ERROR]: could not create a %ux%u offscreen target, %s\n", width, height, SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+void DestroyOffscreenTarget(OffscreenTarget* target){
+    if (target->color) SDL_ReleaseGPUTexture(target->device, target->color);
+    if (target->readback) SDL_ReleaseGPUTransferBuffer(target->device, target->readback);
+    *target = (OffscreenTarget){0};
+}
+
+void RecordOffscreenReadback(OffscreenTarget* target, SDL_GPUCommandBuffer* cmd){
+    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmd);
+    SDL_GPUTextureRegion source = {
+        .texture = target->color,
+        .w = target->width,
+        .h = target->height,
+        .d = 1
+    };
+    SDL_GPUTextureTransferInfo destination = {
+        .transfer_buffer = target->readback,
+        .offset = 0,
+        .pixels_per_row = target->width,
+        .rows_per_layer = target->height
+    };
+    SDL_DownloadFromGPUTexture(copyPass, &source, &destination);
+    SDL_EndGPUCopyPass(copyPass);
+}
+
+bool SaveOffscreenImage(OffscreenTarget* target, const char* path){
+    void* pixels = SDL_MapGPUTransferBuffer(target->device, target->readback, false);
+    if (!pixels) {
+        printf("[ERROR]: could not map the offscreen readback, %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_Surface* surface = SDL_CreateSurfaceFrom((int)target->width, (int)target->height, SDL_PIXELFORMAT_RGBA32, pixels, (int)target->width * 4);
+    bool saved = surface && SDL_SaveBMP(surface, path);
+    if (!saved) {
+        printf("[ERROR]: could not write %s, %s\n", path, SDL_GetError());
+    }
+    if (surface) SDL_DestroySurface(surface);
+    SDL_UnmapGPUTransferBuffer(target->device, target->readback);
+    return saved;
+}
+
+int CompareOffscreenImage(OffscreenTarget* target, const char* referencePath, int tolerance){
+    SDL_Surface* loaded = SDL_LoadBMP(referencePath);
+    SDL_Surface* reference = loaded ? SDL_ConvertSurface(loaded, SDL_PIXELFORMAT_RGBA32) : NULL;
+    if (loaded) SDL_DestroySurface(loaded);
+    if (!reference) {
+        printf("[ERROR]: could not load reference image %s, %s\n", referencePath, SDL_GetError());
+        return -1;
+    }
+    if ((Uint32)reference->w != target->width || (Uint32)reference->h != target->height) {
+        printf("[ERROR]: reference image %s is %dx%d, the offscreen target %ux%u\n", referencePath,
+            reference->w, reference->h, target->width, target->height);
+        SDL_DestroySurface(reference);
+        return -1;
+    }
+
+    const Uint8* pixels = SDL_MapGPUTransferBuffer(target->device, target->readback, false);
+    if (!pixels) {
+        printf("[ERROR]: could not map the offscreen readback, %s\n", SDL_GetError());
+        SDL_DestroySurface(reference);
+        return -1;
+    }
+    int different = 0;
+    for (Uint32 y = 0; y < target->height; y++) {
+        const Uint8* row = pixels + (size_t)y * target->width * 4;
+        const Uint8* expected = (const Uint8*)reference->pixels + (size_t)y * reference->pitch;
+        for (Uint32 x = 0; x < target->width; x++) {
+            for (int c = 0; c < 4; c++) {
+                if (abs(row[x * 4 + c] - expected[x * 4 + c]) > tolerance) {
+                    different++;
+                    break;
+                }
+            }
+        }
+    }
+    SDL_UnmapGPUTransferBuffer(target->device, target->readback);
+    SDL_DestroySurface(reference);
+    return different;
+}
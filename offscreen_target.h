@@ -0,0 +1,35 @@
+#ifndef OFFSCREEN_TARGET_H
+#define OFFSCREEN_TARGET_H
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_gpu.h>
+
+// Linear like the SDR swapchain, so an offscreen image has the values a
+// window would show.
+#define OFFSCREEN_FORMAT SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM
+
+// Color target for rendering without a window, plus a download buffer the
+// size of one image to read it back.
+typedef struct OffscreenTarget{
+    SDL_GPUDevice* device;
+    SDL_GPUTexture* color;
+    SDL_GPUTransferBuffer* readback;
+    Uint32 width, height;
+} OffscreenTarget;
+
+bool InitOffscreenTarget(OffscreenTarget* target, SDL_GPUDevice* device, Uint32 width, Uint32 height);
+void DestroyOffscreenTarget(OffscreenTarget* target);
+
+// Records a copy pass that downloads the color target, so it goes after the
+// render pass. The pixels can be read once cmd has finished on the GPU.
+void RecordOffscreenReadback(OffscreenTarget* target, SDL_GPUCommandBuffer* cmd);
+
+// Writes the last readback as a 32-bit BMP.
+bool SaveOffscreenImage(OffscreenTarget* target, const char* path);
+
+// Counts the pixels of the last readback where any channel differs from the
+// image at referencePath by more than tolerance. Returns -1 when the
+// reference cannot be loaded or has another size.
+int CompareOffscreenImage(OffscreenTarget* target, const char* referencePath, int tolerance);
+
+#endif
@@ -0,0 +1,160 @@
+#include "profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+uint64_t ProfilerNow(void){
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+bool InitProfiler(Profiler* profiler, bool tracing){
+    memset(profiler, 0, sizeof(*profiler));
+    profiler->origin_ns = ProfilerNow();
+    if (tracing) {
+        profiler->events = malloc(PROFILER_MAX_EVENTS * sizeof(ProfileEvent));
+        if (!profiler->events) {
+            printf("[ERROR]: could not allocate the trace buffer\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+void DestroyProfiler(Profiler* profiler){
+    free(profiler->events);
+    memset(profiler, 0, sizeof(*profiler));
+}
+
+void RecordProfileEvent(Profiler* profiler, const char* name, int track, uint64_t startNs, uint64_t durationNs){
+    ProfileScopeStats* stats = NULL;
+    for (int i = 0; i < profiler->scope_count; i++) {
+        if (profiler->scopes[i].name == name) {
+            stats = &profiler->scopes[i];
+            break;
+        }
+    }
+    if (!stats && profiler->scope_count < PROFILER_MAX_SCOPES) {
+        stats = &profiler->scopes[profiler->scope_count++];
+        *stats = (ProfileScopeStats){ .name = name };
+    }
+    if (stats) {
+        stats->total_ns += durationNs;
+        stats->count++;
+        if (durationNs > stats->max_ns) stats->max_ns = durationNs;
+    }
+
+    if (!profiler->events) {
+        return;
+    }
+    if (profiler->event_count >= PROFILER_MAX_EVENTS) {
+        profiler->dropped_events++;
+        return;
+    }
+    profiler->events[profiler->event_count++] = (ProfileEvent){
+        .name = name,
+        .start_ns = startNs,
+        .duration_ns = durationNs,
+        .track = track
+    };
+}
+
+void EndProfileScope(Profiler* profiler, ProfileScope scope){
+    uint64_t now = ProfilerNow();
+    RecordProfileEvent(profiler, scope.name, PROFILE_TRACK_CPU, scope.start_ns, now - scope.start_ns);
+}
+
+void ProfilerEndFrame(Profiler* profiler, uint64_t frameStartNs){
+    uint64_t now = ProfilerNow();
+    RecordProfileEvent(profiler, "frame", PROFILE_TRACK_CPU, frameStartNs, now - frameStartNs);
+
+    profiler->frame_ms[profiler->frame_head] = (float)((double)(now - frameStartNs) * 1e-6);
+    profiler->frame_head = (profiler->frame_head + 1) % PROFILER_HISTORY;
+    if (profiler->frame_count < PROFILER_HISTORY) profiler->frame_count++;
+}
+
+static int compare_floats(const void* a, const void* b){
+    float fa = *(const float*)a, fb = *(const float*)b;
+    return (fa > fb) - (fa < fb);
+}
+
+// Nearest rank on the sorted samples.
+static float percentile(const float* sorted, int count, float p){
+    int rank = (int)(p * (float)count + 0.999f);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+FrameTimeStats ComputeFrameTimeStats(float* ms, int count){
+    FrameTimeStats stats = { .frames = count };
+    if (count == 0) {
+        return stats;
+    }
+
+    qsort(ms, (size_t)count, sizeof(float), compare_floats);
+
+    double total = 0.0;
+    for (int i = 0; i < count; i++) total += ms[i];
+
+    stats.p50_ms = percentile(ms, count, 0.50f);
+    stats.p95_ms = percentile(ms, count, 0.95f);
+    stats.p99_ms = percentile(ms, count, 0.99f);
+    stats.avg_ms = (float)(total / count);
+    stats.max_ms = ms[count - 1];
+    return stats;
+}
+
+FrameTimeStats GetFrameTimeStats(const Profiler* profiler){
+    float sorted[PROFILER_HISTORY];
+    memcpy(sorted, profiler->frame_ms, (size_t)profiler->frame_count * sizeof(float));
+    return ComputeFrameTimeStats(sorted, profiler->frame_count);
+}
+
+void PrintProfilerReport(Profiler* profiler){
+    FrameTimeStats frame = GetFrameTimeStats(profiler);
+    printf("Frame (last %d): p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, avg %.3f ms (%.0f fps), max %.3f ms\n",
+        frame.frames, frame.p50_ms, frame.p95_ms, frame.p99_ms, frame.avg_ms,
+        frame.avg_ms > 0.0f ? 1000.0f / frame.avg_ms : 0.0f, frame.max_ms);
+
+    for (int i = 0; i < profiler->scope_count; i++) {
+        const ProfileScopeStats* s = &profiler->scopes[i];
+        if (s->count == 0) continue;
+        printf("  %-20s avg %8.3f ms  max %8.3f ms  (%u)\n", s->name,
+            (double)s->total_ns / s->count * 1e-6, (double)s->max_ns * 1e-6, s->count);
+    }
+    profiler->scope_count = 0;
+}
+
+bool WriteChromeTrace(const Profiler* profiler, const char* path){
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        printf("[ERROR]: could not write trace: %s\n", path);
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"CPU\"}},\n", PROFILE_TRACK_CPU);
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU (fence)\"}}", PROFILE_TRACK_GPU);
+    for (int i = 0; i < profiler->event_count; i++) {
+        const ProfileEvent* e = &profiler->events[i];
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            e->name, e->track, (double)(e->start_ns - profiler->origin_ns) * 1e-3, (double)e->duration_ns * 1e-3);
+    }
+    fprintf(file, "\n]}\n");
+
+    bool ok = fclose(file) == 0;
+    if (!ok) {
+        printf("[ERROR]: could not write trace: %s\n", path);
+    } else if (profiler->dropped_events) {
+        printf("Trace: buffer full, dropped %llu events\n", (unsigned long long)profiler->dropped_events);
+    }
+    return ok;
+}
@@ -0,0 +1,93 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PROFILER_HISTORY 512        // frames kept for the percentiles
+#define PROFILER_MAX_SCOPES 16      // distinct scope names in the report
+#define PROFILER_MAX_EVENTS 262144  // trace events kept for the JSON dump
+
+enum {
+    PROFILE_TRACK_CPU = 0,
+    PROFILE_TRACK_GPU = 1
+};
+
+typedef struct ProfileEvent{
+    const char* name; // string literal, compared by pointer
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    int track;
+} ProfileEvent;
+
+typedef struct ProfileScopeStats{
+    const char* name;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint32_t count;
+} ProfileScopeStats;
+
+typedef struct FrameTimeStats{
+    float p50_ms, p95_ms, p99_ms;
+    float avg_ms, max_ms;
+    int frames;
+} FrameTimeStats;
+
+typedef struct Profiler{
+    uint64_t origin_ns;
+
+    float frame_ms[PROFILER_HISTORY]; // ring
+    int frame_head;
+    int frame_count;
+
+    ProfileScopeStats scopes[PROFILER_MAX_SCOPES]; // since the last report
+    int scope_count;
+
+    ProfileEvent* events; // NULL unless tracing
+    int event_count;
+    uint64_t dropped_events;
+} Profiler;
+
+typedef struct ProfileScope{
+    const char* name;
+    uint64_t start_ns;
+} ProfileScope;
+
+// Monotonic clock in nanoseconds.
+uint64_t ProfilerNow(void);
+
+bool InitProfiler(Profiler* profiler, bool tracing);
+void DestroyProfiler(Profiler* profiler);
+
+static inline ProfileScope BeginProfileScope(const char* name){
+    return (ProfileScope){ name, ProfilerNow() };
+}
+void EndProfileScope(Profiler* profiler, ProfileScope scope);
+
+// Times the statement or block that follows it:
+//   PROFILE_SCOPE(&profiler, "submit") { ... }
+// Leaving the block with break, return or goto skips the measurement.
+#define PROFILE_SCOPE(profiler, name) \
+    for (ProfileScope profileScope_ = BeginProfileScope(name), *profileOnce_ = &profileScope_; \
+         profileOnce_; EndProfileScope((profiler), profileScope_), profileOnce_ = NULL)
+
+// For timings that are not a CPU scope, like GPU work measured from fences.
+void RecordProfileEvent(Profiler* profiler, const char* name, int track, uint64_t startNs, uint64_t durationNs);
+
+void ProfilerEndFrame(Profiler* profiler, uint64_t frameStartNs);
+
+FrameTimeStats GetFrameTimeStats(const Profiler* profiler);
+
+// The same percentiles over any list of frame times. Sorts ms in place.
+FrameTimeStats ComputeFrameTimeStats(float* ms, int count);
+
+// Prints the frame time percentiles and the per-scope averages since the
+// previous report, then starts a new scope window.
+void PrintProfilerReport(Profiler* profiler);
+
+// Writes the recorded events in the Chrome trace event format, which
+// chrome://tracing and ui.perfetto.dev both open.
+bool WriteChromeTrace(const Profiler* profiler, const char* path);
+
+#endif
@@ -0,0 +1,113 @@
+#include "range_allocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void insert_free(RangeAllocator* allocator, int at, FreeRange range){
+    if (allocator->free_count >= allocator->free_capacity) {
+        allocator->free_capacity = allocator->free_capacity ? allocator->free_capacity * 2 : 16;
+        allocator->free_ranges = realloc(allocator->free_ranges, allocator->free_capacity * sizeof(FreeRange));
+    }
+    memmove(&allocator->free_ranges[at + 1], &allocator->free_ranges[at], (allocator->free_count - at) * sizeof(FreeRange));
+    allocator->free_ranges[at] = range;
+    allocator->free_count++;
+}
+
+static void remove_free(RangeAllocator* allocator, int at){
+    memmove(&allocator->free_ranges[at], &allocator->free_ranges[at + 1], (allocator->free_count - at - 1) * sizeof(FreeRange));
+    allocator->free_count--;
+}
+
+void InitRangeAllocator(RangeAllocator* allocator, uint32_t capacity){
+    *allocator = (RangeAllocator){ .capacity = capacity };
+    if (capacity > 0) {
+        insert_free(allocator, 0, (FreeRange){0, capacity});
+    }
+}
+
+void DestroyRangeAllocator(RangeAllocator* allocator){
+    free(allocator->free_ranges);
+    *allocator = (RangeAllocator){0};
+}
+
+bool AllocRange(RangeAllocator* allocator, uint32_t size, uint32_t* offset){
+    if (size == 0) {
+        *offset = 0;
+        return true;
+    }
+
+    int best = -1;
+    for (int i = 0; i < allocator->free_count; i++) {
+        uint32_t rangeSize = allocator->free_ranges[i].size;
+        if (rangeSize >= size && (best < 0 || rangeSize < allocator->free_ranges[best].size)) {
+            best = i;
+            if (rangeSize == size) break;
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+
+    FreeRange* range = &allocator->free_ranges[best];
+    *offset = range->offset;
+    if (range->size == size) {
+        remove_free(allocator, best);
+    } else {
+        range->offset += size;
+        range->size -= size;
+    }
+
+    allocator->used += size;
+    allocator->alloc_count++;
+    return true;
+}
+
+void FreeRangeAt(RangeAllocator* allocator, uint32_t offset, uint32_t size){
+    if (size == 0) {
+        return;
+    }
+
+    // first free range that starts after the released one
+    int lo = 0, hi = allocator->free_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (allocator->free_ranges[mid].offset < offset) lo = mid + 1;
+        else hi = mid;
+    }
+
+    bool mergePrev = lo > 0 && allocator->free_ranges[lo - 1].offset + allocator->free_ranges[lo - 1].size == offset;
+    bool mergeNext = lo < allocator->free_count && offset + size == allocator->free_ranges[lo].offset;
+
+    if (mergePrev && mergeNext) {
+        allocator->free_ranges[lo - 1].size += size + allocator->free_ranges[lo].size;
+        remove_free(allocator, lo);
+    } else if (mergePrev) {
+        allocator->free_ranges[lo - 1].size += size;
+    } else if (mergeNext) {
+        allocator->free_ranges[lo].offset = offset;
+        allocator->free_ranges[lo].size += size;
+    } else {
+        insert_free(allocator, lo, (FreeRange){offset, size});
+    }
+
+    allocator->used -= size;
+    allocator->alloc_count--;
+}
+
+RangeAllocatorStats GetRangeAllocatorStats(const RangeAllocator* allocator){
+    RangeAllocatorStats stats = {
+        .capacity = allocator->capacity,
+        .used = allocator->used,
+        .allocations = allocator->alloc_count,
+        .free_ranges = allocator->free_count
+    };
+
+    uint32_t totalFree = 0;
+    for (int i = 0; i < allocator->free_count; i++) {
+        totalFree += allocator->free_ranges[i].size;
+        if (allocator->free_ranges[i].size > stats.largest_free) stats.largest_free = allocator->free_ranges[i].size;
+    }
+    stats.occupancy = allocator->capacity ? (float)allocator->used / (float)allocator->capacity : 0.0f;
+    stats.fragmentation = totalFree ? 1.0f - (float)stats.largest_free / (float)totalFree : 0.0f;
+    return stats;
+}
@@ -0,0 +1,41 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct FreeRange{
+    uint32_t offset;
+    uint32_t size;
+} FreeRange;
+
+// Free-list suballocator over [0, capacity) in abstract units. Free ranges
+// are kept sorted by offset and merged with their neighbours on release.
+typedef struct RangeAllocator{
+    uint32_t capacity;
+    uint32_t used;
+    uint32_t alloc_count;
+    FreeRange* free_ranges;
+    int free_count, free_capacity;
+} RangeAllocator;
+
+typedef struct RangeAllocatorStats{
+    uint32_t capacity;
+    uint32_t used;
+    uint32_t allocations;
+    int free_ranges;
+    uint32_t largest_free;
+    float occupancy;      // used / capacity
+    float fragmentation;  // 1 - largest_free / total_free
+} RangeAllocatorStats;
+
+void InitRangeAllocator(RangeAllocator* allocator, uint32_t capacity);
+void DestroyRangeAllocator(RangeAllocator* allocator);
+
+// Best-fit allocation. Returns false when no free range is large enough.
+bool AllocRange(RangeAllocator* allocator, uint32_t size, uint32_t* offset);
+void FreeRangeAt(RangeAllocator* allocator, uint32_t offset, uint32_t size);
+
+RangeAllocatorStats GetRangeAllocatorStats(const RangeAllocator* allocator);
+
+#endif
@@ -0,0 +1,123 @@
+#include "render_queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RENDER_QUEUE_INITIAL 256
+
+static uint64_t field(uint32_t value, int bits){
+    return (uint64_t)(value & ((1u << bits) - 1));
+}
+
+// The bits of a non-negative float grow with its value, and their top half
+// keeps 7 mantissa bits: depth precision relative to the distance, like a
+// log depth, with no near or far plane to pick.
+static uint64_t quantize_depth(float depth){
+    if (!(depth > 0.0f)) return 0;
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits >> (32 - RENDER_KEY_DEPTH_BITS - 1);
+}
+
+uint64_t MakeRenderKey(RenderPass pass, uint32_t pipeline, uint32_t material, uint32_t texture, uint32_t mesh, float depth){
+    uint64_t state = field(pipeline, RENDER_KEY_PIPELINE_BITS) << (RENDER_KEY_MATERIAL_BITS + RENDER_KEY_TEXTURE_BITS) |
+                     field(material, RENDER_KEY_MATERIAL_BITS) << RENDER_KEY_TEXTURE_BITS |
+                     field(texture, RENDER_KEY_TEXTURE_BITS);
+    uint64_t z = quantize_depth(depth);
+    uint64_t key = (uint64_t)pass << 62 | field(mesh, RENDER_KEY_MESH_BITS);
+    if (pass == RENDER_PASS_OPAQUE) {
+        return key | state << (RENDER_KEY_DEPTH_BITS + RENDER_KEY_MESH_BITS) | z << RENDER_KEY_MESH_BITS;
+    }
+    uint64_t far = ((1u << RENDER_KEY_DEPTH_BITS) - 1) - z;
+    return key | far << (62 - RENDER_KEY_DEPTH_BITS) | state << RENDER_KEY_MESH_BITS;
+}
+
+void ClearRenderQueue(RenderQueue* queue){
+    queue->count = 0;
+}
+
+static bool reserve_items(RenderQueue* queue, int count){
+    if (queue->count + count <= queue->capacity) return true;
+    int capacity = queue->capacity ? queue->capacity : RENDER_QUEUE_INITIAL;
+    while (capacity < queue->count + count) capacity *= 2;
+    RenderItem* items = realloc(queue->items, (size_t)capacity * sizeof(RenderItem));
+    if (items) queue->items = items;
+    RenderItem* scratch = items ? malloc((size_t)capacity * sizeof(RenderItem)) : NULL;
+    if (!scratch) {
+        printf("[ERROR]: could not grow render queue to %d items\n", capacity);
+        return false;
+    }
+    free(queue->scratch);
+    queue->scratch = scratch;
+    queue->capacity = capacity;
+    return true;
+}
+
+bool PushRenderItem(RenderQueue* queue, uint64_t key, uint32_t draw){
+    if (!reserve_items(queue, 1)) return false;
+    queue->items[queue->count++] = (RenderItem){ .key = key, .draw = draw };
+    return true;
+}
+
+bool AppendRenderItems(RenderQueue* queue, const RenderItem* items, int count){
+    if (count <= 0) return true;
+    if (!reserve_items(queue, count)) return false;
+    memcpy(queue->items + queue->count, items, (size_t)count * sizeof(RenderItem));
+    queue->count += count;
+    return true;
+}
+
+void SortRenderQueue(RenderQueue* queue){
+    int count = queue->count;
+    if (count < 2) return;
+
+    // every histogram in one read of the keys
+    uint32_t histograms[8][256] = {{0}};
+    for (int i = 0; i < count; i++) {
+        uint64_t key = queue->items[i].key;
+        for (int d = 0; d < 8; d++) {
+            histograms[d][(key >> (d * 8)) & 0xFF]++;
+        }
+    }
+
+    RenderItem* src = queue->items;
+    RenderItem* dst = queue->scratch;
+    for (int d = 0; d < 8; d++) {
+        uint32_t* histogram = histograms[d];
+        if (histogram[(src[0].key >> (d * 8)) & 0xFF] == (uint32_t)count) continue;
+
+        uint32_t offset = 0;
+        for (int b = 0; b < 256; b++) {
+            uint32_t n = histogram[b];
+            histogram[b] = offset;
+            offset += n;
+        }
+        for (int i = 0; i < count; i++) {
+            dst[histogram[(src[i].key >> (d * 8)) & 0xFF]++] = src[i];
+        }
+        RenderItem* swap = src;
+        src = dst;
+        dst = swap;
+    }
+    queue->items = src;
+    queue->scratch = dst;
+}
+
+void FreeRenderQueue(RenderQueue* queue){
+    free(queue->items);
+    free(queue->scratch);
+    *queue = (RenderQueue){0};
+}
+
+uint32_t RenderBindsIssued(const RenderBinds* binds){
+    uint32_t total = 0;
+    for (int i = 0; i < RENDER_BIND_COUNT; i++) total += binds->issued[i];
+    return total;
+}
+
+uint32_t RenderBindsSkipped(const RenderBinds* binds){
+    uint32_t total = 0;
+    for (int i = 0; i < RENDER_BIND_COUNT; i++) total += binds->skipped[i];
+    return total;
+}
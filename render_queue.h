@@ -0,0 +1,107 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Sort key layout, high bits first. Opaque draws group by state and go front
+// to back inside a group; transparent ones go back to front before anything
+// else. Ids are masked to their field width.
+//
+//   opaque:      pass:2 pipeline:6 material:8 texture:10 depth:16 mesh:22
+//   transparent: pass:2 far-depth:16 pipeline:6 material:8 texture:10 mesh:22
+#define RENDER_KEY_PIPELINE_BITS 6
+#define RENDER_KEY_MATERIAL_BITS 8
+#define RENDER_KEY_TEXTURE_BITS 10
+#define RENDER_KEY_DEPTH_BITS 16
+#define RENDER_KEY_MESH_BITS 22
+
+typedef enum RenderPass{
+    RENDER_PASS_OPAQUE,
+    RENDER_PASS_TRANSPARENT
+} RenderPass;
+
+uint64_t MakeRenderKey(RenderPass pass, uint32_t pipeline, uint32_t material, uint32_t texture, uint32_t mesh, float depth);
+
+// draw indexes the caller's own array of draw records.
+typedef struct RenderItem{
+    uint64_t key;
+    uint32_t draw;
+} RenderItem;
+
+// Items gathered for one frame. The arrays are kept between frames, so a
+// steady scene does not allocate.
+typedef struct RenderQueue{
+    RenderItem* items;
+    RenderItem* scratch;
+    int count;
+    int capacity;
+} RenderQueue;
+
+void ClearRenderQueue(RenderQueue* queue);
+bool PushRenderItem(RenderQueue* queue, uint64_t key, uint32_t draw);
+
+// Merges a list of items built elsewhere, e.g. on a job worker.
+bool AppendRenderItems(RenderQueue* queue, const RenderItem* items, int count);
+
+// Stable LSD radix sort on the keys, 8 bits per pass. Passes whose byte is
+// the same in every key are skipped, so narrow scenes sort in few passes.
+void SortRenderQueue(RenderQueue* queue);
+
+void FreeRenderQueue(RenderQueue* queue);
+
+typedef enum RenderBind{
+    RENDER_BIND_PIPELINE,
+    RENDER_BIND_TEXTURE,
+    RENDER_BIND_INDEX_BUFFER,
+    RENDER_BIND_STORAGE_BUFFER,
+    RENDER_BIND_UNIFORMS,
+    RENDER_BIND_COUNT
+} RenderBind;
+
+// Last bound value per slot, so an emitter only issues binds that change
+// something. Counters accumulate until the caller clears them.
+typedef struct RenderBinds{
+    uintptr_t bound[RENDER_BIND_COUNT];
+    bool valid[RENDER_BIND_COUNT];
+    uint32_t issued[RENDER_BIND_COUNT];
+    uint32_t skipped[RENDER_BIND_COUNT];
+} RenderBinds;
+
+// Forget the bound state, at the start of every render pass.
+static inline void InvalidateRenderBinds(RenderBinds* binds){
+    for (int i = 0; i < RENDER_BIND_COUNT; i++) binds->valid[i] = false;
+}
+
+// True if value has to be bound now; records it as bound either way.
+static inline bool RenderBindChanged(RenderBinds* binds, RenderBind slot, uintptr_t value){
+    if (binds->valid[slot] && binds->bound[slot] == value) {
+        binds->skipped[slot]++;
+        return false;
+    }
+    binds->bound[slot] = value;
+    binds->valid[slot] = true;
+    binds->issued[slot]++;
+    return true;
+}
+
+// For data pushed by value, such as uniforms: true if data differs from the
+// bytes in last, the caller's copy of the previous push, which is updated.
+// A pointer to the data says nothing about whether the contents repeat.
+static inline bool RenderBindDataChanged(RenderBinds* binds, RenderBind slot, void* last, const void* data, size_t size){
+    if (binds->valid[slot] && memcmp(last, data, size) == 0) {
+        binds->skipped[slot]++;
+        return false;
+    }
+    memcpy(last, data, size);
+    binds->valid[slot] = true;
+    binds->issued[slot]++;
+    return true;
+}
+
+uint32_t RenderBindsIssued(const RenderBinds* binds);
+uint32_t RenderBindsSkipped(const RenderBinds* binds);
+
+#endif
@@ -0,0 +1,53 @@
+#include "scene_instances.h"
+
+#include <math.h>
+
+void BuildInstanceGrid(InstanceData* instances, int count, const Mesh* mesh, float scale){
+    int side = 1;
+    while (side * side * side < count) side++;
+
+    float spacing = mesh->bounds_radius * scale * 2.2f;
+    float half = (float)(side - 1) * 0.5f;
+    Vec3 center = {
+        (mesh->bounds_min.x + mesh->bounds_max.x) * 0.5f * scale,
+        (mesh->bounds_min.y + mesh->bounds_max.y) * 0.5f * scale,
+        (mesh->bounds_min.z + mesh->bounds_max.z) * 0.5f * scale
+    };
+
+    for (int i = 0; i < count; i++) {
+        int x = i % side, y = (i / side) % side, z = i / (side * side);
+        float yaw = (float)((i * 2654435761u) >> 8) * (6.2831853f / 16777216.0f);
+
+        instances[i] = (InstanceData){
+            .position = {
+                ((float)x - half) * spacing - center.x,
+                ((float)y - half) * spacing - center.y,
+                ((float)z - half) * spacing - center.z
+            },
+            .scale = scale,
+            .rotation = {0.0f, sinf(yaw * 0.5f), 0.0f, cosf(yaw * 0.5f)}
+        };
+    }
+}
+
+void InstanceMatrix(const InstanceData* instance, float out[16]){
+    float x = instance->rotation[0], y = instance->rotation[1], z = instance->rotation[2], w = instance->rotation[3];
+    float s = instance->scale;
+
+    out[0] = (1.0f - 2.0f * (y * y + z * z)) * s;
+    out[1] = (2.0f * (x * y + z * w)) * s;
+    out[2] = (2.0f * (x * z - y * w)) * s;
+    out[3] = 0.0f;
+    out[4] = (2.0f * (x * y - z * w)) * s;
+    out[5] = (1.0f - 2.0f * (x * x + z * z)) * s;
+    out[6] = (2.0f * (y * z + x * w)) * s;
+    out[7] = 0.0f;
+    out[8] = (2.0f * (x * z + y * w)) * s;
+    out[9] = (2.0f * (y * z - x * w)) * s;
+    out[10] = (1.0f - 2.0f * (x * x + y * y)) * s;
+    out[11] = 0.0f;
+    out[12] = instance->position[0];
+    out[13] = instance->position[1];
+    out[14] = instance->position[2];
+    out[15] = 1.0f;
+}
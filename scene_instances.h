@@ -0,0 +1,22 @@
+#ifndef SCENE_INSTANCES_H
+#define SCENE_INSTANCES_H
+
+#include "mesh.h"
+
+// One instance as vertex_instanced.vert reads it from its storage buffer
+// (std430): translation and uniform scale, then a unit quaternion.
+typedef struct InstanceData{
+    float position[3];
+    float scale;
+    float rotation[4]; // x, y, z, w
+} InstanceData;
+
+// Fills a cube-shaped block of count instances centered on the origin, each
+// scaled by scale and spaced so neighbouring copies of mesh do not overlap.
+// Every instance gets its own yaw so the block does not look like a stamp.
+void BuildInstanceGrid(InstanceData* instances, int count, const Mesh* mesh, float scale);
+
+// Column-major model matrix of an instance, for drawing it without instancing.
+void InstanceMatrix(const InstanceData* instance, float out[16]);
+
+#endif
@@ -0,0 +1,255 @@
+#include "staging_uploader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STAGING_BUFFER_ALIGN 16
+#define STAGING_TEXTURE_ALIGN 512
+
+static Uint32 align_up(Uint32 value, Uint32 align){
+    return (value + align - 1) & ~(align - 1);
+}
+
+bool InitStagingUploader(StagingUploader* uploader, SDL_GPUDevice* device, Uint32 capacity){
+    *uploader = (StagingUploader){0};
+    uploader->device = device;
+    uploader->capacity = capacity;
+
+    SDL_GPUTransferBufferCreateInfo info = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = capacity,
+        .props = 0
+    };
+    uploader->buffer = SDL_CreateGPUTransferBuffer(device, &info);
+    if(!uploader->buffer){
+        printf("[ERROR]: could not create staging buffer, %s\n", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+static void unmap_staging(StagingUploader* uploader){
+    if (uploader->mapped) {
+        SDL_UnmapGPUTransferBuffer(uploader->device, uploader->buffer);
+        uploader->mapped = NULL;
+    }
+}
+
+static void retire_oldest(StagingUploader* uploader){
+    StagingSubmit* submit = &uploader->inflight[uploader->inflight_first];
+    SDL_ReleaseGPUFence(uploader->device, submit->fence);
+    uploader->used -= submit->bytes;
+    uploader->inflight_first = (uploader->inflight_first + 1) % STAGING_MAX_INFLIGHT;
+    uploader->inflight_count--;
+
+    if (uploader->used == 0) {
+        uploader->head = 0;
+    }
+}
+
+static void wait_oldest(StagingUploader* uploader){
+    StagingSubmit* submit = &uploader->inflight[uploader->inflight_first];
+    SDL_WaitForGPUFences(uploader->device, true, &submit->fence, 1);
+    uploader->stats.stalls++;
+    retire_oldest(uploader);
+}
+
+void RetireStagingUploads(StagingUploader* uploader){
+    while (uploader->inflight_count > 0 &&
+           SDL_QueryGPUFence(uploader->device, uploader->inflight[uploader->inflight_first].fence)) {
+        retire_oldest(uploader);
+    }
+}
+
+void WaitStagingUploads(StagingUploader* uploader){
+    while (uploader->inflight_count > 0) {
+        wait_oldest(uploader);
+    }
+}
+
+bool FlushStagingUploads(StagingUploader* uploader){
+    if (uploader->pending_count == 0) {
+        return true;
+    }
+    unmap_staging(uploader);
+
+    if (uploader->inflight_count == STAGING_MAX_INFLIGHT) {
+        wait_oldest(uploader);
+    }
+
+    SDL_GPUCommandBuffer* cmd = SDL_AcquireGPUCommandBuffer(uploader->device);
+    if(!cmd){
+        printf("[ERROR]: could not acquire upload command buffer, %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmd);
+
+    for (int i = 0; i < uploader->pending_count; i++) {
+        const StagedUpload* upload = &uploader->pending[i];
+        if (upload->type == STAGED_UPLOAD_BUFFER) {
+            SDL_GPUTransferBufferLocation src = {
+                .transfer_buffer = uploader->buffer,
+                .offset = upload->src_offset
+            };
+            SDL_UploadToGPUBuffer(copyPass, &src, &upload->buffer, false);
+        } else {
+            SDL_GPUTextureTransferInfo src = {
+                .transfer_buffer = uploader->buffer,
+                .offset = upload->src_offset,
+                .pixels_per_row = upload->pixels_per_row,
+                .rows_per_layer = upload->rows_per_layer
+            };
+            SDL_UploadToGPUTexture(copyPass, &src, &upload->texture, false);
+        }
+    }
+
+    SDL_EndGPUCopyPass(copyPass);
+    SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd);
+    if(!fence){
+        printf("[ERROR]: could not submit uploads, %s\n", SDL_GetError());
+        return false;
+    }
+
+    int slot = (uploader->inflight_first + uploader->inflight_count) % STAGING_MAX_INFLIGHT;
+    uploader->inflight[slot] = (StagingSubmit){ .fence = fence, .bytes = uploader->pending_bytes };
+    uploader->inflight_count++;
+
+    uploader->pending_count = 0;
+    uploader->pending_bytes = 0;
+    uploader->stats.submits++;
+    return true;
+}
+
+// Replaces the ring with one that can hold size bytes. Everything in flight
+// has to finish first because the old buffer is released.
+static bool grow_staging(StagingUploader* uploader, Uint32 size){
+    FlushStagingUploads(uploader);
+    WaitStagingUploads(uploader);
+
+    Uint32 capacity = uploader->capacity;
+    while (capacity < size) capacity *= 2;
+
+    SDL_ReleaseGPUTransferBuffer(uploader->device, uploader->buffer);
+    SDL_GPUTransferBufferCreateInfo info = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = capacity,
+        .props = 0
+    };
+    uploader->buffer = SDL_CreateGPUTransferBuffer(uploader->device, &info);
+    if(!uploader->buffer){
+        printf("[ERROR]: could not grow staging buffer, %s\n", SDL_GetError());
+        return false;
+    }
+    uploader->capacity = capacity;
+    uploader->head = 0;
+    uploader->used = 0;
+    uploader->stats.resizes++;
+    return true;
+}
+
+// Finds size contiguous bytes in the ring, wrapping to the start when the
+// tail is too short. Flushes and waits on the oldest submission when full.
+static Uint8* alloc_staging(StagingUploader* uploader, Uint32 size, Uint32 align, Uint32* offset){
+    if (size > uploader->capacity && !grow_staging(uploader, size)) {
+        return NULL;
+    }
+
+    for (;;) {
+        Uint32 start = align_up(uploader->head, align);
+        Uint32 padding = start - uploader->head;
+        if (start + size > uploader->capacity) {
+            start = 0;
+            padding = uploader->capacity - uploader->head;
+        }
+
+        if (uploader->used + padding + size <= uploader->capacity) {
+            if (!uploader->mapped) {
+                uploader->mapped = SDL_MapGPUTransferBuffer(uploader->device, uploader->buffer, false);
+                if(!uploader->mapped){
+                    printf("[ERROR]: could not map staging buffer, %s\n", SDL_GetError());
+                    return NULL;
+                }
+            }
+            uploader->head = start + size;
+            uploader->used += padding + size;
+            uploader->pending_bytes += padding + size;
+            uploader->stats.bytes_staged += size;
+            uploader->stats.uploads++;
+            *offset = start;
+            return uploader->mapped + start;
+        }
+
+        int inflight = uploader->inflight_count;
+        RetireStagingUploads(uploader);
+        if (uploader->inflight_count != inflight) {
+            continue;
+        }
+        if (uploader->pending_count > 0) {
+            FlushStagingUploads(uploader);
+        }
+        if (uploader->inflight_count == 0) {
+            return NULL;
+        }
+        wait_oldest(uploader);
+    }
+}
+
+static StagedUpload* push_pending(StagingUploader* uploader){
+    if (uploader->pending_count >= uploader->pending_capacity) {
+        uploader->pending_capacity = uploader->pending_capacity ? uploader->pending_capacity * 2 : 32;
+        uploader->pending = realloc(uploader->pending, uploader->pending_capacity * sizeof(StagedUpload));
+    }
+    return &uploader->pending[uploader->pending_count++];
+}
+
+void* StageBufferUpload(StagingUploader* uploader, SDL_GPUBuffer* dst, Uint32 dstOffset, Uint32 size){
+    Uint32 offset;
+    Uint8* data = alloc_staging(uploader, size, STAGING_BUFFER_ALIGN, &offset);
+    if (!data) return NULL;
+
+    StagedUpload* upload = push_pending(uploader);
+    *upload = (StagedUpload){
+        .type = STAGED_UPLOAD_BUFFER,
+        .src_offset = offset,
+        .buffer = { .buffer = dst, .offset = dstOffset, .size = size }
+    };
+    return data;
+}
+
+void* StageTextureUpload(StagingUploader* uploader, const SDL_GPUTextureRegion* dst, Uint32 size){
+    Uint32 offset;
+    Uint8* data = alloc_staging(uploader, size, STAGING_TEXTURE_ALIGN, &offset);
+    if (!data) return NULL;
+
+    StagedUpload* upload = push_pending(uploader);
+    *upload = (StagedUpload){
+        .type = STAGED_UPLOAD_TEXTURE,
+        .src_offset = offset,
+        .texture = *dst,
+        .pixels_per_row = dst->w,
+        .rows_per_layer = dst->h
+    };
+    return data;
+}
+
+bool StageBufferData(StagingUploader* uploader, SDL_GPUBuffer* dst, Uint32 dstOffset, const void* data, Uint32 size){
+    void* staged = StageBufferUpload(uploader, dst, dstOffset, size);
+    if (!staged) return false;
+    SDL_memcpy(staged, data, size);
+    return true;
+}
+
+bool StageTextureData(StagingUploader* uploader, const SDL_GPUTextureRegion* dst, const void* data, Uint32 size){
+    void* staged = StageTextureUpload(uploader, dst, size);
+    if (!staged) return false;
+    SDL_memcpy(staged, data, size);
+    return true;
+}
+
+void DestroyStagingUploader(StagingUploader* uploader){
+    unmap_staging(uploader);
+    WaitStagingUploads(uploader);
+    SDL_ReleaseGPUTransferBuffer(uploader->device, uploader->buffer);
+    free(uploader->pending);
+    *uploader = (StagingUploader){0};
+}
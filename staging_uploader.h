@@ -0,0 +1,79 @@
+#ifndef STAGING_UPLOADER_H
+#define STAGING_UPLOADER_H
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_gpu.h>
+
+#define STAGING_MAX_INFLIGHT 16
+
+typedef enum StagedUploadType{
+    STAGED_UPLOAD_BUFFER,
+    STAGED_UPLOAD_TEXTURE
+} StagedUploadType;
+
+typedef struct StagedUpload{
+    StagedUploadType type;
+    Uint32 src_offset;
+    SDL_GPUBufferRegion buffer;
+    SDL_GPUTextureRegion texture;
+    Uint32 pixels_per_row;
+    Uint32 rows_per_layer;
+} StagedUpload;
+
+typedef struct StagingSubmit{
+    SDL_GPUFence* fence;
+    Uint32 bytes;
+} StagingSubmit;
+
+typedef struct StagingStats{
+    Uint64 bytes_staged;
+    Uint32 uploads;
+    Uint32 submits;
+    Uint32 stalls;
+    Uint32 resizes;
+} StagingStats;
+
+// One persistent upload transfer buffer used as a ring. Uploads are staged
+// into it, recorded into a single copy pass on flush and retired by fence,
+// so nothing has to wait for the whole device to go idle.
+typedef struct StagingUploader{
+    SDL_GPUDevice* device;
+    SDL_GPUTransferBuffer* buffer;
+    Uint8* mapped;
+    Uint32 capacity;
+    Uint32 head;
+    Uint32 used;
+    Uint32 pending_bytes;
+
+    StagedUpload* pending;
+    int pending_count, pending_capacity;
+
+    StagingSubmit inflight[STAGING_MAX_INFLIGHT];
+    int inflight_first, inflight_count;
+
+    StagingStats stats;
+} StagingUploader;
+
+bool InitStagingUploader(StagingUploader* uploader, SDL_GPUDevice* device, Uint32 capacity);
+void DestroyStagingUploader(StagingUploader* uploader);
+
+// Reserve staging memory for an upload and return where to write it. The
+// pointer is only valid until the next Stage/Flush call on this uploader.
+void* StageBufferUpload(StagingUploader* uploader, SDL_GPUBuffer* dst, Uint32 dstOffset, Uint32 size);
+void* StageTextureUpload(StagingUploader* uploader, const SDL_GPUTextureRegion* dst, Uint32 size);
+
+bool StageBufferData(StagingUploader* uploader, SDL_GPUBuffer* dst, Uint32 dstOffset, const void* data, Uint32 size);
+bool StageTextureData(StagingUploader* uploader, const SDL_GPUTextureRegion* dst, const void* data, Uint32 size);
+
+// Records every pending upload into one copy pass and submits it. Work that
+// is submitted to the device afterwards is ordered after the copies, so
+// callers only need to wait when they touch the staging memory themselves.
+bool FlushStagingUploads(StagingUploader* uploader);
+
+// Releases ring space of submissions whose fences have signaled. Cheap
+// enough to call once per frame.
+void RetireStagingUploads(StagingUploader* uploader);
+
+void WaitStagingUploads(StagingUploader* uploader);
+
+#endif
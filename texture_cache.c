@@ -0,0 +1,128 @@
+#include "texture_cache.h"
+#include "file_map.h"
+#include "mesh_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_seconds(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static size_t align_up(size_t value, size_t align){
+    return (value + align - 1) & ~(align - 1);
+}
+
+bool WriteTextureCache(const char* cachePath, const TextureMips* mips, uint64_t sourceHash, uint64_t sourceSize){
+    TextureCacheHeader header = {
+        .magic = TEXTURE_CACHE_MAGIC,
+        .version = TEXTURE_CACHE_VERSION,
+        .source_hash = sourceHash,
+        .source_size = sourceSize,
+        .width = mips->width,
+        .height = mips->height,
+        .level_count = (uint32_t)mips->level_count,
+        .bytes_per_pixel = 4,
+        .pixel_offset = align_up(sizeof(header), TEXTURE_CACHE_ALIGN),
+        .pixel_size = mips->size
+    };
+
+    char tmpPath[1024];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", cachePath);
+    FILE* file = fopen(tmpPath, "wb");
+    if(!file){
+        printf("[ERROR]: could not write texture cache: %s\n", tmpPath);
+        return false;
+    }
+
+    static const uint8_t zeros[TEXTURE_CACHE_ALIGN] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(zeros, 1, header.pixel_offset - sizeof(header), file) == header.pixel_offset - sizeof(header);
+    ok = ok && fwrite(mips->pixels, 1, mips->size, file) == mips->size;
+    ok = (fclose(file) == 0) && ok;
+
+#ifdef _WIN32
+    remove(cachePath);
+#endif
+    if (!ok || rename(tmpPath, cachePath) != 0) {
+        printf("[ERROR]: could not write texture cache: %s\n", cachePath);
+        remove(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+// Checks the cache against the source and, if it matches, points the mips
+// into the mapping. Takes ownership of cache on success.
+static bool open_cache(MappedFile* cache, uint64_t sourceHash, uint64_t sourceSize, TextureMips* out){
+    TextureCacheHeader header;
+    if (cache->size < sizeof(header)) return false;
+    memcpy(&header, cache->data, sizeof(header));
+
+    if (header.magic != TEXTURE_CACHE_MAGIC || header.version != TEXTURE_CACHE_VERSION) return false;
+    if (header.source_hash != sourceHash || header.source_size != sourceSize) return false;
+    if (header.bytes_per_pixel != 4 || header.width == 0 || header.height == 0) return false;
+    if (header.level_count != (uint32_t)TextureMipLevelCount(header.width, header.height)) return false;
+
+    TextureMips mips = { .width = header.width, .height = header.height, .level_count = (int)header.level_count };
+    for (int l = 0; l < mips.level_count; l++) {
+        mips.level_offset[l] = mips.size;
+        mips.size += (size_t)TextureMipSize(header.width, l) * TextureMipSize(header.height, l) * 4;
+    }
+    if (header.pixel_size != mips.size || header.pixel_offset % TEXTURE_CACHE_ALIGN) return false;
+    if (header.pixel_offset + header.pixel_size > cache->size) return false;
+
+    MappedFile* owned = malloc(sizeof(MappedFile));
+    *owned = *cache;
+    mips.pixels = (uint8_t*)(cache->data + header.pixel_offset);
+    mips.cache = owned;
+    *out = mips;
+    return true;
+}
+
+bool LoadTextureCached(const char* path, TextureDecodeFn decode, TextureMips* out, TextureLoadInfo* info){
+    double start = now_seconds();
+    *out = (TextureMips){0};
+
+    char cachePath[1024];
+    snprintf(cachePath, sizeof(cachePath), "%s.texcache", path);
+
+    MappedFile source;
+    if(!MapFile(path, &source)){
+        printf("[ERROR]: could not open file: %s\n", path);
+        return false;
+    }
+    uint64_t sourceHash = HashBytes64(source.data, source.size);
+    uint64_t sourceSize = source.size;
+
+    MappedFile cache;
+    bool hit = false;
+    if (MapFile(cachePath, &cache)) {
+        hit = open_cache(&cache, sourceHash, sourceSize, out);
+        if (!hit) UnmapFile(&cache);
+    }
+
+    bool ok = hit;
+    if (!hit) {
+        uint32_t width = 0, height = 0;
+        ok = decode(source.data, source.size, NULL, 0, &width, &height) && AllocTextureMips(width, height, out);
+        ok = ok && decode(source.data, source.size, out->pixels, width * 4, &width, &height) && GenerateTextureMips(out);
+        if (ok) {
+            WriteTextureCache(cachePath, out, sourceHash, sourceSize);
+        } else {
+            FreeTextureMips(out);
+            printf("[ERROR]: could not decode texture: %s\n", path);
+        }
+    }
+    UnmapFile(&source);
+
+    if (info) {
+        info->cache_hit = hit;
+        info->seconds = now_seconds() - start;
+    }
+    return ok;
+}
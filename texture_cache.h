@@ -0,0 +1,44 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "texture_mips.h"
+
+// Binary texture cache written next to each image as "<file>.texcache".
+// It holds the RGBA8 mip chain exactly as BuildTextureMips lays it out,
+// keyed by a hash of the image bytes, so a warm load is one mapping and no
+// decode. Bump TEXTURE_CACHE_VERSION whenever the filter or layout changes.
+#define TEXTURE_CACHE_MAGIC 0x48435854u // "TXCH"
+#define TEXTURE_CACHE_VERSION 1
+#define TEXTURE_CACHE_ALIGN 64
+
+typedef struct TextureCacheHeader{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+    uint32_t bytes_per_pixel;
+    uint64_t pixel_offset;
+    uint64_t pixel_size;
+} TextureCacheHeader;
+
+typedef struct TextureLoadInfo{
+    bool cache_hit;
+    double seconds;
+} TextureLoadInfo;
+
+// Decodes the bytes of an image file. Called with rgba NULL to read the size,
+// then again to write RGBA8 rows pitch bytes apart into rgba, which is level 0
+// of the mip chain, so the image is never copied after decoding.
+typedef bool (*TextureDecodeFn)(const void* data, size_t size, uint8_t* rgba, uint32_t pitch, uint32_t* width, uint32_t* height);
+
+// Loads an image through its cache. On a hit the returned pixels point into
+// the mapped cache file, on a miss the file is decoded, its mips are built
+// and the cache is rewritten. Release with FreeTextureMips. info may be NULL.
+bool LoadTextureCached(const char* path, TextureDecodeFn decode, TextureMips* out, TextureLoadInfo* info);
+
+bool WriteTextureCache(const char* cachePath, const TextureMips* mips, uint64_t sourceHash, uint64_t sourceSize);
+
+#endif
@@ -0,0 +1,232 @@
+#include "texture_mips.h"
+#include "file_map.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sched.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTURE_MIPS_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TEXTURE_MIPS_NEON 1
+#endif
+
+// Linear values are 16-bit; encoding looks up the top 12 bits, which is
+// finer than one sRGB step everywhere on the curve.
+#define LINEAR_TO_SRGB_BITS 12
+
+static uint16_t srgbToLinear[256];
+static uint8_t linearToSrgb[1 << LINEAR_TO_SRGB_BITS];
+static atomic_int tablesState;
+
+static float srgb_decode(float c){
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float srgb_encode(float c){
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// First caller fills the tables, concurrent callers wait for it.
+static void init_tables(void){
+    if (atomic_load_explicit(&tablesState, memory_order_acquire) == 2) return;
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&tablesState, &expected, 1)) {
+        for (int i = 0; i < 256; i++) {
+            srgbToLinear[i] = (uint16_t)lrintf(srgb_decode(i / 255.0f) * 65535.0f);
+        }
+        for (int i = 0; i < 1 << LINEAR_TO_SRGB_BITS; i++) {
+            float linear = (i + 0.5f) / (float)(1 << LINEAR_TO_SRGB_BITS);
+            linearToSrgb[i] = (uint8_t)lrintf(srgb_encode(linear) * 255.0f);
+        }
+        atomic_store_explicit(&tablesState, 2, memory_order_release);
+    } else {
+        while (atomic_load_explicit(&tablesState, memory_order_acquire) != 2) {
+#ifndef _WIN32
+            sched_yield();
+#endif
+        }
+    }
+}
+
+int TextureMipLevelCount(uint32_t width, uint32_t height){
+    uint32_t size = width > height ? width : height;
+    int levels = 1;
+    while (size > 1 && levels < TEXTURE_MAX_LEVELS) {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
+bool AllocTextureMips(uint32_t width, uint32_t height, TextureMips* out){
+    *out = (TextureMips){ .width = width, .height = height, .level_count = TextureMipLevelCount(width, height) };
+    for (int l = 0; l < out->level_count; l++) {
+        out->level_offset[l] = out->size;
+        out->size += (size_t)TextureMipSize(width, l) * TextureMipSize(height, l) * 4;
+    }
+    out->pixels = width && height ? malloc(out->size) : NULL;
+    if (!out->pixels) {
+        *out = (TextureMips){0};
+        return false;
+    }
+    return true;
+}
+
+static void decode_level0(const uint8_t* src, uint32_t count, uint16_t* linear){
+    for (uint32_t i = 0; i < count; i++) {
+        linear[i * 4 + 0] = srgbToLinear[src[i * 4 + 0]];
+        linear[i * 4 + 1] = srgbToLinear[src[i * 4 + 1]];
+        linear[i * 4 + 2] = srgbToLinear[src[i * 4 + 2]];
+        linear[i * 4 + 3] = (uint16_t)(src[i * 4 + 3] * 257);
+    }
+}
+
+static void encode_level(const uint16_t* linear, uint32_t count, uint8_t* dst){
+    for (uint32_t i = 0; i < count; i++) {
+        dst[i * 4 + 0] = linearToSrgb[linear[i * 4 + 0] >> (16 - LINEAR_TO_SRGB_BITS)];
+        dst[i * 4 + 1] = linearToSrgb[linear[i * 4 + 1] >> (16 - LINEAR_TO_SRGB_BITS)];
+        dst[i * 4 + 2] = linearToSrgb[linear[i * 4 + 2] >> (16 - LINEAR_TO_SRGB_BITS)];
+        dst[i * 4 + 3] = (uint8_t)((linear[i * 4 + 3] * 255u + 32767u) / 65535u);
+    }
+}
+
+static inline uint16_t avg16(uint32_t a, uint32_t b){
+    return (uint16_t)((a + b + 1) >> 1);
+}
+
+// One destination pixel: rows first, then columns, rounding like pavgw so
+// the SIMD path matches bit for bit. Odd sizes clamp the second sample.
+static void downsample_pixel(const uint16_t* row0, const uint16_t* row1, uint32_t x0, uint32_t x1, uint16_t* dst){
+    for (int c = 0; c < 4; c++) {
+        uint16_t left = avg16(row0[x0 * 4 + c], row1[x0 * 4 + c]);
+        uint16_t right = avg16(row0[x1 * 4 + c], row1[x1 * 4 + c]);
+        dst[c] = avg16(left, right);
+    }
+}
+
+static void downsample_scalar(const uint16_t* src, uint32_t width, uint32_t height, uint16_t* dst){
+    uint32_t dstWidth = TextureMipSize(width, 1), dstHeight = TextureMipSize(height, 1);
+    for (uint32_t y = 0; y < dstHeight; y++) {
+        const uint16_t* row0 = src + (size_t)(2 * y) * width * 4;
+        const uint16_t* row1 = src + (size_t)(2 * y + 1 < height ? 2 * y + 1 : 2 * y) * width * 4;
+        for (uint32_t x = 0; x < dstWidth; x++) {
+            uint32_t x1 = 2 * x + 1 < width ? 2 * x + 1 : 2 * x;
+            downsample_pixel(row0, row1, 2 * x, x1, dst + ((size_t)y * dstWidth + x) * 4);
+        }
+    }
+}
+
+#if defined(TEXTURE_MIPS_SSE2) || defined(TEXTURE_MIPS_NEON)
+// Two destination pixels per step: four source pixels from each row are
+// averaged vertically, then the even and odd pixels are split apart and
+// averaged horizontally.
+static void downsample_simd(const uint16_t* src, uint32_t width, uint32_t height, uint16_t* dst){
+    uint32_t dstWidth = TextureMipSize(width, 1), dstHeight = TextureMipSize(height, 1);
+    // pairs of destination pixels whose four source pixels all exist
+    uint32_t simdPixels = (width / 2) & ~1u;
+    for (uint32_t y = 0; y < dstHeight; y++) {
+        const uint16_t* row0 = src + (size_t)(2 * y) * width * 4;
+        const uint16_t* row1 = src + (size_t)(2 * y + 1 < height ? 2 * y + 1 : 2 * y) * width * 4;
+        uint16_t* out = dst + (size_t)y * dstWidth * 4;
+        uint32_t x = 0;
+        for (; x < simdPixels; x += 2) {
+#if defined(TEXTURE_MIPS_SSE2)
+            __m128i a = _mm_avg_epu16(_mm_loadu_si128((const __m128i*)(row0 + x * 8)), _mm_loadu_si128((const __m128i*)(row1 + x * 8)));
+            __m128i b = _mm_avg_epu16(_mm_loadu_si128((const __m128i*)(row0 + x * 8 + 8)), _mm_loadu_si128((const __m128i*)(row1 + x * 8 + 8)));
+            __m128i even = _mm_unpacklo_epi64(a, b);
+            __m128i odd = _mm_unpackhi_epi64(a, b);
+            _mm_storeu_si128((__m128i*)(out + x * 4), _mm_avg_epu16(even, odd));
+#else
+            uint16x8_t a = vrhaddq_u16(vld1q_u16(row0 + x * 8), vld1q_u16(row1 + x * 8));
+            uint16x8_t b = vrhaddq_u16(vld1q_u16(row0 + x * 8 + 8), vld1q_u16(row1 + x * 8 + 8));
+            uint16x8_t even = vcombine_u16(vget_low_u16(a), vget_low_u16(b));
+            uint16x8_t odd = vcombine_u16(vget_high_u16(a), vget_high_u16(b));
+            vst1q_u16(out + x * 4, vrhaddq_u16(even, odd));
+#endif
+        }
+        for (; x < dstWidth; x++) {
+            uint32_t x1 = 2 * x + 1 < width ? 2 * x + 1 : 2 * x;
+            downsample_pixel(row0, row1, 2 * x, x1, out + x * 4);
+        }
+    }
+}
+#endif
+
+typedef void (*DownsampleFn)(const uint16_t* src, uint32_t width, uint32_t height, uint16_t* dst);
+
+static bool generate_mips(TextureMips* mips, DownsampleFn downsample){
+    if (mips->level_count == 1) return true;
+    init_tables();
+
+    // every level is filtered from the linear copy of the previous one, so
+    // rounding to 8 bits happens once per level and never compounds
+    size_t texels = (size_t)mips->width * mips->height;
+    uint16_t* current = malloc(texels * 4 * sizeof(uint16_t));
+    uint16_t* next = malloc((size_t)TextureMipSize(mips->width, 1) * TextureMipSize(mips->height, 1) * 4 * sizeof(uint16_t));
+    if (!current || !next) {
+        free(current);
+        free(next);
+        return false;
+    }
+    decode_level0(mips->pixels, (uint32_t)texels, current);
+
+    for (int l = 1; l < mips->level_count; l++) {
+        uint32_t w = TextureMipSize(mips->width, l - 1), h = TextureMipSize(mips->height, l - 1);
+        downsample(current, w, h, next);
+        encode_level(next, TextureMipSize(mips->width, l) * TextureMipSize(mips->height, l), mips->pixels + mips->level_offset[l]);
+        uint16_t* swap = current;
+        current = next;
+        next = swap;
+    }
+    free(current);
+    free(next);
+    return true;
+}
+
+#if defined(TEXTURE_MIPS_SSE2) || defined(TEXTURE_MIPS_NEON)
+#define downsample_best downsample_simd
+#else
+#define downsample_best downsample_scalar
+#endif
+
+bool GenerateTextureMips(TextureMips* mips){
+    return generate_mips(mips, downsample_best);
+}
+
+static bool build_mips(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t pitch, TextureMips* out, DownsampleFn downsample){
+    if (!AllocTextureMips(width, height, out)) return false;
+    for (uint32_t y = 0; y < height; y++) {
+        memcpy(out->pixels + (size_t)y * width * 4, rgba + (size_t)y * pitch, (size_t)width * 4);
+    }
+    if (!generate_mips(out, downsample)) {
+        FreeTextureMips(out);
+        return false;
+    }
+    return true;
+}
+
+bool BuildTextureMips(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t pitch, TextureMips* out){
+    return build_mips(rgba, width, height, pitch, out, downsample_best);
+}
+
+bool BuildTextureMipsScalar(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t pitch, TextureMips* out){
+    return build_mips(rgba, width, height, pitch, out, downsample_scalar);
+}
+
+void FreeTextureMips(TextureMips* mips){
+    if (mips->cache) {
+        UnmapFile(mips->cache);
+        free(mips->cache);
+    } else {
+        free(mips->pixels);
+    }
+    *mips = (TextureMips){0};
+}
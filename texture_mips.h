@@ -0,0 +1,49 @@
+#ifndef TEXTURE_MIPS_H
+#define TEXTURE_MIPS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TEXTURE_MAX_LEVELS 16
+
+// An RGBA8 image with its full mip chain, level 0 first, every level tightly
+// packed (pitch = width * 4). Color channels are sRGB encoded, alpha is
+// linear.
+typedef struct TextureMips{
+    uint32_t width;
+    uint32_t height;
+    int level_count;
+    uint8_t* pixels;
+    size_t size;
+    size_t level_offset[TEXTURE_MAX_LEVELS];
+    struct MappedFile* cache;
+} TextureMips;
+
+// Levels down to 1x1: floor(log2(max(width, height))) + 1.
+int TextureMipLevelCount(uint32_t width, uint32_t height);
+
+static inline uint32_t TextureMipSize(uint32_t size, int level){
+    return size >> level ? size >> level : 1;
+}
+
+// Allocates the chain with level 0 uninitialized, for decoders that write
+// the image in place before GenerateTextureMips.
+bool AllocTextureMips(uint32_t width, uint32_t height, TextureMips* out);
+
+// Fills levels 1 and up from level 0.
+bool GenerateTextureMips(TextureMips* mips);
+
+// Copies the image (rows pitch bytes apart) into level 0 and builds every
+// smaller level with a 2x2 box filter. Color is averaged in linear light and
+// re-encoded to sRGB, so the chain does not darken. The filter runs in 16-bit
+// linear on SSE2/NEON.
+bool BuildTextureMips(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t pitch, TextureMips* out);
+
+// Same output as BuildTextureMips one pixel at a time, as a reference.
+bool BuildTextureMipsScalar(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t pitch, TextureMips* out);
+
+// Releases what BuildTextureMips or LoadTextureCached returned.
+void FreeTextureMips(TextureMips* mips);
+
+#endif
@@ -0,0 +1,53 @@
+#version 450
+
+// Instanced variant of vertex.vert. Every instance reads its transform from
+// the storage buffer by gl_InstanceIndex, see scene_instances.h. Set and
+// binding numbers follow SDL GPU's SPIR-V layout: vertex storage buffers in
+// set 0, vertex uniform buffers in set 1.
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+struct Instance {
+    vec4 positionScale;
+    vec4 rotation;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+layout(set = 1, binding = 0) uniform FrameUniforms {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+} frame;
+
+// mvp and normalMatrix of the whole block, each instance adds its own
+// transform on top
+layout(set = 1, binding = 1) uniform DrawUniforms {
+    mat4 mvp;
+    mat3 normalMatrix;
+} draw;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec4 debugColor;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    Instance instance = instances[gl_InstanceIndex];
+    vec3 position = rotate(instance.rotation, inPosition) * instance.positionScale.w + instance.positionScale.xyz;
+
+    gl_Position = draw.mvp * vec4(position, 1.0);
+
+    debugColor = vec4(instance.positionScale.xyz * 0.01 + 0.5, 1.0);
+
+    fragNormal = draw.normalMatrix * rotate(instance.rotation, inNormal);
+    fragTexCoord = inTexCoord;
+}
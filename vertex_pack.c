@@ -0,0 +1,262 @@
+#include "vertex_pack.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VERTEX_PACK_SSE2 1
+#endif
+
+VertexQuantization GetVertexQuantization(const Mesh* mesh){
+    return (VertexQuantization){
+        .offset = mesh->bounds_min,
+        .scale = {
+            mesh->bounds_max.x - mesh->bounds_min.x,
+            mesh->bounds_max.y - mesh->bounds_min.y,
+            mesh->bounds_max.z - mesh->bounds_min.z
+        }
+    };
+}
+
+static inline uint32_t float_bits(float f){
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static inline float bits_float(uint32_t u){
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// Round-to-nearest-even float to half, after Fabian Giesen's
+// float_to_half_fast3_rtne. The SSE2 path below is the same algorithm.
+uint16_t FloatToHalf(float value){
+    const uint32_t f32infty = 255u << 23;
+    const uint32_t f16max = (127u + 16u) << 23;
+    const uint32_t denormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+    uint32_t u = float_bits(value);
+    uint32_t sign = u & 0x80000000u;
+    u ^= sign;
+
+    uint32_t o;
+    if (u >= f16max) {
+        o = (u > f32infty) ? 0x7E00u : 0x7C00u;
+    } else if (u < (113u << 23)) {
+        o = float_bits(bits_float(u) + bits_float(denormMagic)) - denormMagic;
+    } else {
+        uint32_t mantOdd = (u >> 13) & 1u;
+        u += ((uint32_t)(15 - 127) << 23) + 0xFFFu;
+        u += mantOdd;
+        o = u >> 13;
+    }
+    return (uint16_t)(o | (sign >> 16));
+}
+
+float HalfToFloat(uint16_t value){
+    uint32_t sign = (uint32_t)(value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+
+    if (exponent == 0) {
+        float f = ldexpf((float)mantissa, -24);
+        return sign ? -f : f;
+    }
+    if (exponent == 31) {
+        return bits_float(sign | 0x7F800000u | (mantissa << 13));
+    }
+    return bits_float(sign | ((exponent + 112u) << 23) | (mantissa << 13));
+}
+
+static inline float sign_not_zero(float v){
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+static inline float clampf(float v, float lo, float hi){
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static inline float inv_extent(float extent){
+    return extent > 0.0f ? 1.0f / extent : 0.0f;
+}
+
+static void pack_one(const Vertex* v, Vec3 lo, Vec3 inv, PackedVertex* out){
+    // lrintf rounds to nearest even, like _mm_cvtps_epi32
+    out->position[0] = (uint16_t)lrintf(clampf((v->position.x - lo.x) * inv.x, 0.0f, 1.0f) * 65535.0f);
+    out->position[1] = (uint16_t)lrintf(clampf((v->position.y - lo.y) * inv.y, 0.0f, 1.0f) * 65535.0f);
+    out->position[2] = (uint16_t)lrintf(clampf((v->position.z - lo.z) * inv.z, 0.0f, 1.0f) * 65535.0f);
+    out->position[3] = 0;
+
+    Vec3 n = v->normal;
+    float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    float rl1 = l1 > 0.0f ? 1.0f / l1 : 0.0f;
+    float px = n.x * rl1, py = n.y * rl1;
+    if (n.z < 0.0f) {
+        float ox = (1.0f - fabsf(py)) * sign_not_zero(px);
+        float oy = (1.0f - fabsf(px)) * sign_not_zero(py);
+        px = ox;
+        py = oy;
+    }
+    out->normal[0] = (int16_t)lrintf(clampf(px, -1.0f, 1.0f) * 32767.0f);
+    out->normal[1] = (int16_t)lrintf(clampf(py, -1.0f, 1.0f) * 32767.0f);
+
+    out->uv[0] = FloatToHalf(v->uv.x);
+    out->uv[1] = FloatToHalf(v->uv.y);
+}
+
+void PackVerticesScalar(const Mesh* mesh, PackedVertex* out){
+    VertexQuantization q = GetVertexQuantization(mesh);
+    Vec3 inv = { inv_extent(q.scale.x), inv_extent(q.scale.y), inv_extent(q.scale.z) };
+    for (int i = 0; i < mesh->vertex_count; i++) {
+        pack_one(&mesh->vertices[i], q.offset, inv, &out[i]);
+    }
+}
+
+#ifdef VERTEX_PACK_SSE2
+
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b){
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128i select_si(__m128i mask, __m128i a, __m128i b){
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128 clamp_ps(__m128 v, __m128 lo, __m128 hi){
+    return _mm_min_ps(_mm_max_ps(v, lo), hi);
+}
+
+static inline __m128i half_ps(__m128 value){
+    const __m128i signMask = _mm_set1_epi32((int)0x80000000u);
+    const __m128i f32infty = _mm_set1_epi32(255 << 23);
+    const __m128i f16max = _mm_set1_epi32((127 + 16) << 23);
+    const __m128i denormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normalLimit = _mm_set1_epi32(113 << 23);
+
+    __m128i u = _mm_castps_si128(value);
+    __m128i sign = _mm_and_si128(u, signMask);
+    u = _mm_xor_si128(u, sign);
+
+    __m128i infNan = select_si(_mm_cmpgt_epi32(u, f32infty), _mm_set1_epi32(0x7E00), _mm_set1_epi32(0x7C00));
+    __m128i denorm = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(u), _mm_castsi128_ps(denormMagic))), denormMagic);
+    __m128i mantOdd = _mm_and_si128(_mm_srli_epi32(u, 13), _mm_set1_epi32(1));
+    __m128i normal = _mm_add_epi32(u, _mm_set1_epi32((int)(((uint32_t)(15 - 127) << 23) + 0xFFFu)));
+    normal = _mm_srli_epi32(_mm_add_epi32(normal, mantOdd), 13);
+
+    __m128i o = select_si(_mm_cmplt_epi32(u, normalLimit), denorm, normal);
+    o = select_si(_mm_cmplt_epi32(u, f16max), o, infNan);
+    return _mm_or_si128(o, _mm_srli_epi32(sign, 16));
+}
+
+// Packs two vectors of four 32-bit lanes (each holding a value below 65536)
+// into interleaved 16-bit pairs: a0 b0 a1 b1 ...
+static inline __m128i interleave16(__m128i a, __m128i b){
+    return _mm_or_si128(a, _mm_slli_epi32(b, 16));
+}
+
+void PackVertices(const Mesh* mesh, PackedVertex* out){
+    VertexQuantization q = GetVertexQuantization(mesh);
+    Vec3 inv = { inv_extent(q.scale.x), inv_extent(q.scale.y), inv_extent(q.scale.z) };
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 unorm = _mm_set1_ps(65535.0f);
+    const __m128 snorm = _mm_set1_ps(32767.0f);
+    const __m128 loX = _mm_set1_ps(q.offset.x), loY = _mm_set1_ps(q.offset.y), loZ = _mm_set1_ps(q.offset.z);
+    const __m128 invX = _mm_set1_ps(inv.x), invY = _mm_set1_ps(inv.y), invZ = _mm_set1_ps(inv.z);
+
+    int count = mesh->vertex_count;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float* src = (const float*)&mesh->vertices[i];
+
+        // AoS -> SoA: rows are px py pz nx / ny nz u v of four vertices
+        __m128 a0 = _mm_loadu_ps(src + 0), b0 = _mm_loadu_ps(src + 4);
+        __m128 a1 = _mm_loadu_ps(src + 8), b1 = _mm_loadu_ps(src + 12);
+        __m128 a2 = _mm_loadu_ps(src + 16), b2 = _mm_loadu_ps(src + 20);
+        __m128 a3 = _mm_loadu_ps(src + 24), b3 = _mm_loadu_ps(src + 28);
+        _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+        _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+        __m128 px = a0, py = a1, pz = a2, nx = a3;
+        __m128 ny = b0, nz = b1, tu = b2, tv = b3;
+
+        __m128i qx = _mm_cvtps_epi32(_mm_mul_ps(clamp_ps(_mm_mul_ps(_mm_sub_ps(px, loX), invX), zero, one), unorm));
+        __m128i qy = _mm_cvtps_epi32(_mm_mul_ps(clamp_ps(_mm_mul_ps(_mm_sub_ps(py, loY), invY), zero, one), unorm));
+        __m128i qz = _mm_cvtps_epi32(_mm_mul_ps(clamp_ps(_mm_mul_ps(_mm_sub_ps(pz, loZ), invZ), zero, one), unorm));
+
+        __m128 l1 = _mm_add_ps(_mm_add_ps(_mm_and_ps(nx, absMask), _mm_and_ps(ny, absMask)), _mm_and_ps(nz, absMask));
+        __m128 rl1 = _mm_and_ps(_mm_cmpgt_ps(l1, zero), _mm_div_ps(one, l1));
+        __m128 ox = _mm_mul_ps(nx, rl1), oy = _mm_mul_ps(ny, rl1);
+        __m128 signX = select_ps(_mm_cmpge_ps(ox, zero), one, minusOne);
+        __m128 signY = select_ps(_mm_cmpge_ps(oy, zero), one, minusOne);
+        __m128 foldX = _mm_mul_ps(_mm_sub_ps(one, _mm_and_ps(oy, absMask)), signX);
+        __m128 foldY = _mm_mul_ps(_mm_sub_ps(one, _mm_and_ps(ox, absMask)), signY);
+        __m128 lower = _mm_cmplt_ps(nz, zero);
+        ox = select_ps(lower, foldX, ox);
+        oy = select_ps(lower, foldY, oy);
+        __m128i sx = _mm_cvtps_epi32(_mm_mul_ps(clamp_ps(ox, minusOne, one), snorm));
+        __m128i sy = _mm_cvtps_epi32(_mm_mul_ps(clamp_ps(oy, minusOne, one), snorm));
+
+        __m128i hu = half_ps(tu), hv = half_ps(tv);
+
+        // each vertex is four 32-bit words: x|y, z|0, nx|ny, u|v
+        __m128i w0 = interleave16(qx, qy);
+        __m128i w1 = qz;
+        __m128i w2 = interleave16(_mm_and_si128(sx, _mm_set1_epi32(0xFFFF)), _mm_and_si128(sy, _mm_set1_epi32(0xFFFF)));
+        __m128i w3 = interleave16(hu, hv);
+
+        __m128i t0 = _mm_unpacklo_epi32(w0, w1), t1 = _mm_unpacklo_epi32(w2, w3);
+        __m128i t2 = _mm_unpackhi_epi32(w0, w1), t3 = _mm_unpackhi_epi32(w2, w3);
+        _mm_storeu_si128((__m128i*)&out[i + 0], _mm_unpacklo_epi64(t0, t1));
+        _mm_storeu_si128((__m128i*)&out[i + 1], _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128((__m128i*)&out[i + 2], _mm_unpacklo_epi64(t2, t3));
+        _mm_storeu_si128((__m128i*)&out[i + 3], _mm_unpackhi_epi64(t2, t3));
+    }
+
+    for (; i < count; i++) {
+        pack_one(&mesh->vertices[i], q.offset, inv, &out[i]);
+    }
+}
+
+#else
+
+void PackVertices(const Mesh* mesh, PackedVertex* out){
+    PackVerticesScalar(mesh, out);
+}
+
+#endif
+
+static inline float snorm16(int16_t v){
+    float f = (float)v / 32767.0f;
+    return f < -1.0f ? -1.0f : f;
+}
+
+Vertex UnpackVertex(const PackedVertex* packed, VertexQuantization quant){
+    Vertex v;
+    v.position.x = quant.offset.x + (float)packed->position[0] / 65535.0f * quant.scale.x;
+    v.position.y = quant.offset.y + (float)packed->position[1] / 65535.0f * quant.scale.y;
+    v.position.z = quant.offset.z + (float)packed->position[2] / 65535.0f * quant.scale.z;
+
+    float ex = snorm16(packed->normal[0]);
+    float ey = snorm16(packed->normal[1]);
+    Vec3 n = { ex, ey, 1.0f - fabsf(ex) - fabsf(ey) };
+    float t = n.z < 0.0f ? -n.z : 0.0f;
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    float len = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+    if (len > 0.0f) {
+        n.x /= len;
+        n.y /= len;
+        n.z /= len;
+    }
+    v.normal = n;
+
+    v.uv.x = HalfToFloat(packed->uv[0]);
+    v.uv.y = HalfToFloat(packed->uv[1]);
+    return v;
+}
@@ -0,0 +1,36 @@
+#ifndef VERTEX_PACK_H
+#define VERTEX_PACK_H
+
+#include "mesh.h"
+
+// 16 byte vertex used by the packed pipeline (vertex_packed.vert):
+//   position  4 x unorm16, xyz relative to the mesh bounds, w unused
+//   normal    2 x snorm16, octahedral encoding
+//   uv        2 x half float
+typedef struct PackedVertex{
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t uv[2];
+} PackedVertex;
+
+// Positions decode as offset + unorm * scale. The renderer folds this into
+// the model matrix, so the shader only sees normalized positions.
+typedef struct VertexQuantization{
+    Vec3 offset;
+    Vec3 scale;
+} VertexQuantization;
+
+VertexQuantization GetVertexQuantization(const Mesh* mesh);
+
+// Packs every vertex of the mesh into out (vertex_count entries). Uses SSE2
+// four vertices at a time when available; the result is identical to
+// PackVerticesScalar.
+void PackVertices(const Mesh* mesh, PackedVertex* out);
+void PackVerticesScalar(const Mesh* mesh, PackedVertex* out);
+
+Vertex UnpackVertex(const PackedVertex* packed, VertexQuantization quant);
+
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+#endif
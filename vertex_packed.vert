@@ -0,0 +1,42 @@
+#version 450
+
+// Packed vertex layout, see vertex_pack.h. Positions arrive as unorm16 in
+// [0,1] relative to the mesh bounds; the dequantization is folded into
+// draw.mvp on the CPU.
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormalOct;
+layout(location = 2) in vec2 inTexCoord;
+
+// SDL GPU puts vertex uniform slot N at set 1, binding N.
+layout(set = 1, binding = 0) uniform FrameUniforms {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+} frame;
+
+layout(set = 1, binding = 1) uniform DrawUniforms {
+    mat4 mvp;
+    mat3 normalMatrix;
+} draw;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec4 debugColor;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    gl_Position = draw.mvp * vec4(inPosition.xyz, 1.0);
+
+    fragNormal = draw.normalMatrix * octDecode(inNormalOct);
+    debugColor = vec4(fragNormal * 0.5 + 0.5, 1.0);
+    fragTexCoord = inTexCoord;
+}